@@ -15,7 +15,9 @@
  */
 
 #include <iostream>
+#include <memory>
 #include <random>
+#include <vector>
 #include <qcoreapplication.h>
 #include <QStringList>
 #include <QUrl>
@@ -23,7 +25,9 @@
 #include <QFileInfo>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QDir>
 #include <QNetworkProxy>
+#include <QSocketNotifier>
 #include <qdebug.h>
 
 #include "account.h"
@@ -32,9 +36,13 @@
 #include "simplesslerrorhandler.h"
 #include "syncengine.h"
 #include "common/syncjournaldb.h"
+#include "common/synctrace.h"
+#include "common/utility.h"
 #include "config.h"
 
 #include "cmd.h"
+#include "multifoldersync.h"
+#include "syncwatcher.h"
 
 #include "theme.h"
 #include "netrcparser.h"
@@ -45,6 +53,9 @@
 #ifdef Q_OS_WIN32
 #include <windows.h>
 #else
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
 #include <termios.h>
 #include <unistd.h>
 #endif
@@ -76,6 +87,17 @@ struct CmdOptions
     int restartTimes;
     int downlimit;
     int uplimit;
+    QString traceFile;
+    bool watch;
+    int pollInterval;
+    QString folderManifest;
+    int parallelSyncs;
+};
+
+struct FolderPair
+{
+    QString localPath; // absolute, ends with a /
+    QString remotePath; // starts with a /
 };
 
 // we can't use csync_set_userdata because the SyncEngine sets it already.
@@ -165,6 +187,7 @@ void help()
     std::cout << binaryName << " - command line " APPLICATION_NAME " client tool" << std::endl;
     std::cout << "" << std::endl;
     std::cout << "Usage: " << binaryName << " [OPTION] <source_dir> <server_url>" << std::endl;
+    std::cout << "       " << binaryName << " [OPTION] --folders <file> <server_url>" << std::endl;
     std::cout << "" << std::endl;
     std::cout << "A proxy can either be set manually using --httpproxy." << std::endl;
     std::cout << "Otherwise, the setting from a configured sync client will be used." << std::endl;
@@ -188,6 +211,13 @@ void help()
     std::cout << "  -h                     Sync hidden files,do not ignore them" << std::endl;
     std::cout << "  --version, -v          Display version and exit" << std::endl;
     std::cout << "  --logdebug             More verbose logging" << std::endl;
+    std::cout << "  --trace [file]         Write a Chrome trace of the sync phases to [file]" << std::endl;
+    std::cout << "  --watch                Keep running and sync whenever local or remote files change" << std::endl;
+    std::cout << "  --poll-interval [s]    Check the server for changes every s seconds in --watch mode (default 30)" << std::endl;
+    std::cout << "  --folders [file]       Sync the folders listed in [file] instead of <source_dir>:" << std::endl;
+    std::cout << "                         one per line, the local directory and the remote folder" << std::endl;
+    std::cout << "                         below <server_url> separated by a tab" << std::endl;
+    std::cout << "  --parallel [n]         Sync at most n of the --folders at the same time (default 4)" << std::endl;
     std::cout << "" << std::endl;
     exit(0);
 }
@@ -216,16 +246,19 @@ void parseOptions(const QStringList &app_args, CmdOptions *options)
 
     options->target_url = args.takeLast();
 
-    options->source_dir = args.takeLast();
-    if (!options->source_dir.endsWith('/')) {
-        options->source_dir.append('/');
-    }
-    QFileInfo fi(options->source_dir);
-    if (!fi.exists()) {
-        std::cerr << "Source dir '" << qPrintable(options->source_dir) << "' does not exist." << std::endl;
-        exit(1);
+    // With --folders, the local directories are in the manifest
+    if (!args.contains("--folders")) {
+        options->source_dir = args.takeLast();
+        if (!options->source_dir.endsWith('/')) {
+            options->source_dir.append('/');
+        }
+        QFileInfo fi(options->source_dir);
+        if (!fi.exists()) {
+            std::cerr << "Source dir '" << qPrintable(options->source_dir) << "' does not exist." << std::endl;
+            exit(1);
+        }
+        options->source_dir = fi.absoluteFilePath();
     }
-    options->source_dir = fi.absoluteFilePath();
 
     QStringListIterator it(args);
     // skip file name;
@@ -268,14 +301,203 @@ void parseOptions(const QStringList &app_args, CmdOptions *options)
         } else if (option == "--logdebug") {
             Logger::instance()->setLogFile("-");
             Logger::instance()->setLogDebug(true);
+        } else if (option == "--trace" && !it.peekNext().startsWith("-")) {
+            options->traceFile = it.next();
+        } else if (option == "--watch") {
+            options->watch = true;
+        } else if (option == "--poll-interval" && !it.peekNext().startsWith("-")) {
+            options->pollInterval = it.next().toInt();
+        } else if (option == "--folders" && !it.peekNext().startsWith("-")) {
+            options->folderManifest = it.next();
+        } else if (option == "--parallel" && !it.peekNext().startsWith("-")) {
+            options->parallelSyncs = it.next().toInt();
         } else {
             help();
         }
     }
 
-    if (options->target_url.isEmpty() || options->source_dir.isEmpty()) {
+    if (options->target_url.isEmpty() || (options->source_dir.isEmpty() && options->folderManifest.isEmpty())
+        || options->pollInterval <= 0 || options->parallelSyncs <= 0) {
         help();
     }
+
+    if (!options->folderManifest.isEmpty() && (options->watch || !options->unsyncedfolders.isEmpty())) {
+        std::cerr << "--folders can't be combined with --watch or --unsyncedfolders." << std::endl;
+        exit(1);
+    }
+}
+
+/* Whether path is parent itself or below it. Both are clean paths. */
+static bool isSameOrBelow(const QString &path, const QString &parent, Qt::CaseSensitivity cs)
+{
+    if (path.compare(parent, cs) == 0)
+        return true;
+    const QString prefix = parent.endsWith('/') ? parent : QString(parent + QLatin1Char('/'));
+    return path.startsWith(prefix, cs);
+}
+
+/* Reads the --folders manifest. Empty lines and lines starting with # are skipped.
+   The local directory and the remote folder are separated by a tab, or by spaces
+   if neither of them contains one. Remote folders are below remoteRoot.
+   The folders must not overlap, neither locally nor remotely: two engines would
+   sync the same files. */
+static QVector<FolderPair> readFolderManifest(const QString &fileName, const QString &remoteRoot)
+{
+    QFile f(fileName);
+    if (!f.open(QFile::ReadOnly)) {
+        std::cerr << "Could not open the folder list '" << qPrintable(fileName) << "'." << std::endl;
+        exit(1);
+    }
+
+    QVector<FolderPair> folders;
+    QStringList canonicalPaths; // for the overlap checks, symlinks resolved
+    QVector<int> lineNumbers;
+    const auto localCs = Utility::fsCasePreserving() ? Qt::CaseInsensitive : Qt::CaseSensitive;
+    int lineNumber = 0;
+    foreach (const QString &rawLine, QString::fromUtf8(f.readAll()).split('\n')) {
+        ++lineNumber;
+        const QString line = rawLine.trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        QStringList fields = line.split('\t', QString::SkipEmptyParts);
+        if (fields.size() == 1)
+            fields = line.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+        if (fields.size() != 2) {
+            std::cerr << qPrintable(fileName) << ":" << lineNumber
+                      << ": Expected a local directory and a remote folder." << std::endl;
+            exit(1);
+        }
+
+        FolderPair pair;
+        QFileInfo fi(fields.at(0).trimmed());
+        if (!fi.isDir()) {
+            std::cerr << "Source dir '" << qPrintable(fields.at(0)) << "' does not exist." << std::endl;
+            exit(1);
+        }
+        pair.localPath = fi.absoluteFilePath();
+        if (!pair.localPath.endsWith('/'))
+            pair.localPath.append('/');
+
+        // Remote folders typically start with a / and don't end with one
+        pair.remotePath = QDir::cleanPath(remoteRoot + QLatin1Char('/') + fields.at(1).trimmed());
+
+        const QString canonicalPath = fi.canonicalFilePath();
+        for (int i = 0; i < folders.size(); ++i) {
+            if (isSameOrBelow(canonicalPath, canonicalPaths.at(i), localCs)
+                || isSameOrBelow(canonicalPaths.at(i), canonicalPath, localCs)) {
+                std::cerr << qPrintable(fileName) << ":" << lineNumber
+                          << ": Local directory '" << qPrintable(fields.at(0)) << "' overlaps with the one on line "
+                          << lineNumbers.at(i) << "." << std::endl;
+                exit(1);
+            }
+            if (isSameOrBelow(pair.remotePath, folders.at(i).remotePath, Qt::CaseSensitive)
+                || isSameOrBelow(folders.at(i).remotePath, pair.remotePath, Qt::CaseSensitive)) {
+                std::cerr << qPrintable(fileName) << ":" << lineNumber
+                          << ": Remote folder '" << qPrintable(pair.remotePath) << "' overlaps with the one on line "
+                          << lineNumbers.at(i) << "." << std::endl;
+                exit(1);
+            }
+        }
+
+        folders.append(pair);
+        canonicalPaths.append(canonicalPath);
+        lineNumbers.append(lineNumber);
+    }
+
+    if (folders.isEmpty()) {
+        std::cerr << "The folder list '" << qPrintable(fileName) << "' is empty." << std::endl;
+        exit(1);
+    }
+    return folders;
+}
+
+#ifdef Q_OS_UNIX
+static int stopSignalFds[2];
+
+static void stopSignalHandler(int)
+{
+    char c = 1;
+    ssize_t written = ::write(stopSignalFds[0], &c, sizeof(c));
+    Q_UNUSED(written);
+}
+
+/* SIGINT and SIGTERM stop the watcher instead of killing the process in the middle of a sync.
+   The handler only writes to a socket, the event loop does the rest. */
+static void stopOnSignals(SyncWatcher *watcher)
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, stopSignalFds) != 0) {
+        qWarning() << "Could not create the socket pair for signal handling";
+        return;
+    }
+    auto notifier = new QSocketNotifier(stopSignalFds[1], QSocketNotifier::Read, watcher);
+    QObject::connect(notifier, &QSocketNotifier::activated, watcher, [notifier, watcher]() {
+        notifier->setEnabled(false);
+        watcher->stop();
+    });
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopSignalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+}
+#endif
+
+static bool loadExcludes(SyncEngine &engine, const CmdOptions &options)
+{
+    bool hasUserExcludeFile = !options.exclude.isEmpty();
+    QString systemExcludeFile = ConfigFile::excludeFileFromSystem();
+
+    // Always try to load the user-provided exclude list if one is specified
+    if (hasUserExcludeFile) {
+        engine.excludedFiles().addExcludeFilePath(options.exclude);
+    }
+    // Load the system list if available, or if there's no user-provided list
+    if (!hasUserExcludeFile || QFile::exists(systemExcludeFile)) {
+        engine.excludedFiles().addExcludeFilePath(systemExcludeFile);
+    }
+
+    return engine.excludedFiles().reloadExcludeFiles();
+}
+
+/* Syncs all folders of the --folders manifest with the one account, several at a time */
+static int syncFolders(QCoreApplication &app, const CmdOptions &options, AccountPtr account,
+    const QUrl &credentialFreeUrl, const QString &remoteRoot, const QString &user)
+{
+    const auto folders = readFolderManifest(options.folderManifest, remoteRoot);
+
+    // The engines are destroyed before their journals
+    std::vector<std::unique_ptr<SyncJournalDb>> journals;
+    std::vector<std::unique_ptr<SyncEngine>> engines;
+    MultiFolderSync multiSync(options.parallelSyncs, options.uplimit, options.downlimit, options.restartTimes);
+
+    for (const auto &folder : folders) {
+        QString dbPath = folder.localPath + SyncJournalDb::makeDbName(folder.localPath, credentialFreeUrl, folder.remotePath, user);
+        journals.emplace_back(new SyncJournalDb(dbPath));
+        engines.emplace_back(new SyncEngine(account, folder.localPath, folder.remotePath, journals.back().get()));
+
+        SyncEngine &engine = *engines.back();
+        engine.setIgnoreHiddenFiles(options.ignoreHiddenFiles);
+        if (!loadExcludes(engine, options)) {
+            qFatal("Cannot load system exclude list or list supplied via --exclude");
+            return EXIT_FAILURE;
+        }
+        multiSync.addFolder(folder.localPath, &engine);
+    }
+
+    QObject::connect(&multiSync, &MultiFolderSync::finished, &app, &QCoreApplication::quit);
+    multiSync.start();
+    app.exec();
+
+    multiSync.printReport(std::cout);
+
+    if (!options.traceFile.isEmpty())
+        SyncTrace::writeChromeTrace(options.traceFile);
+
+    return multiSync.allSucceeded() ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 /* If the selective sync list is different from before, we need to disable the read from db
@@ -324,9 +546,15 @@ int main(int argc, char **argv)
     options.restartTimes = 3;
     options.uplimit = 0;
     options.downlimit = 0;
+    options.watch = false;
+    options.pollInterval = 30;
+    options.parallelSyncs = 4;
 
     parseOptions(app.arguments(), &options);
 
+    if (!options.traceFile.isEmpty())
+        SyncTrace::setEnabled(true);
+
     if (options.silent) {
         qInstallMessageHandler(nullMessageHandler);
     } else {
@@ -474,7 +702,12 @@ int main(int argc, char **argv)
     }
 
     // much lower age than the default since this utility is usually made to be run right after a change in the tests
-    SyncEngine::minimumFileAgeForUpload = 0;
+    // When watching, files are picked up while they are written: keep the default.
+    if (!options.watch)
+        SyncEngine::minimumFileAgeForUpload = 0;
+
+    if (!options.folderManifest.isEmpty())
+        return syncFolders(app, options, account, credentialFreeUrl, folder, user);
 
     int restartCount = 0;
 restart_sync:
@@ -509,31 +742,36 @@ restart_sync:
     SyncEngine engine(account, options.source_dir, folder, &db);
     engine.setIgnoreHiddenFiles(options.ignoreHiddenFiles);
     engine.setNetworkLimits(options.uplimit, options.downlimit);
-    QObject::connect(&engine, &SyncEngine::finished,
-        [&app](bool result) { app.exit(result ? EXIT_SUCCESS : EXIT_FAILURE); });
+    if (!options.watch) {
+        QObject::connect(&engine, &SyncEngine::finished,
+            [&app](bool result) { app.exit(result ? EXIT_SUCCESS : EXIT_FAILURE); });
+    }
     QObject::connect(&engine, &SyncEngine::transmissionProgress, &cmd, &Cmd::transmissionProgressSlot);
 
 
-    // Exclude lists
-
-    bool hasUserExcludeFile = !options.exclude.isEmpty();
-    QString systemExcludeFile = ConfigFile::excludeFileFromSystem();
-
-    // Always try to load the user-provided exclude list if one is specified
-    if (hasUserExcludeFile) {
-        engine.excludedFiles().addExcludeFilePath(options.exclude);
-    }
-    // Load the system list if available, or if there's no user-provided list
-    if (!hasUserExcludeFile || QFile::exists(systemExcludeFile)) {
-        engine.excludedFiles().addExcludeFilePath(systemExcludeFile);
-    }
-
-    if (!engine.excludedFiles().reloadExcludeFiles()) {
+    if (!loadExcludes(engine, options)) {
         qFatal("Cannot load system exclude list or list supplied via --exclude");
         return EXIT_FAILURE;
     }
 
 
+    if (options.watch) {
+        // The engine and the journal stay open, the watcher runs the syncs until it is stopped
+        SyncWatcher watcher(&engine, folder, std::chrono::seconds(options.pollInterval), options.restartTimes);
+        QObject::connect(&watcher, &SyncWatcher::stopped, &app, &QCoreApplication::quit);
+#ifdef Q_OS_UNIX
+        stopOnSignals(&watcher);
+#endif
+        watcher.start();
+
+        int resultCode = app.exec();
+
+        if (!options.traceFile.isEmpty())
+            SyncTrace::writeChromeTrace(options.traceFile);
+
+        return resultCode;
+    }
+
     // Have to be done async, else, an error before exec() does not terminate the event loop.
     QMetaObject::invokeMethod(&engine, "startSync", Qt::QueuedConnection);
 
@@ -548,5 +786,8 @@ restart_sync:
         qWarning() << "Another sync is needed, but not done because restart count is exceeded" << restartCount;
     }
 
+    if (!options.traceFile.isEmpty())
+        SyncTrace::writeChromeTrace(options.traceFile);
+
     return resultCode;
 }
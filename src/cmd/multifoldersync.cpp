@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "multifoldersync.h"
+
+#include <QLoggingCategory>
+
+#include "progressdispatcher.h"
+#include "syncengine.h"
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcMultiFolderSync, "cmd.multifoldersync", QtInfoMsg)
+
+MultiFolderSync::MultiFolderSync(int maxParallelSyncs, int uploadLimit, int downloadLimit,
+    int maxFollowUpSyncs, QObject *parent)
+    : QObject(parent)
+    , _maxParallelSyncs(qMax(1, maxParallelSyncs))
+    , _uploadLimit(uploadLimit)
+    , _downloadLimit(downloadLimit)
+    , _maxFollowUpSyncs(maxFollowUpSyncs)
+{
+}
+
+void MultiFolderSync::addFolder(const QString &name, SyncEngine *engine)
+{
+    FolderRun run;
+    run.name = name;
+    run.engine = engine;
+    _folders.append(run);
+}
+
+void MultiFolderSync::start()
+{
+    // Connect by index: the vector is complete now and does not move anymore
+    for (int i = 0; i < _folders.size(); ++i) {
+        SyncEngine *engine = _folders[i].engine;
+        connect(engine, &SyncEngine::itemCompleted, this, [this, i](const SyncFileItemPtr &item) {
+            itemCompleted(_folders[i], *item);
+        });
+        connect(engine, &SyncEngine::finished, this, [this, i](bool success) {
+            syncFinished(_folders[i], success);
+        });
+    }
+
+    qCInfo(lcMultiFolderSync) << "Syncing" << _folders.size() << "folders," << _maxParallelSyncs << "at a time";
+    _timer.start();
+    startNext();
+}
+
+bool MultiFolderSync::allSucceeded() const
+{
+    for (const auto &run : _folders) {
+        if (!run.success)
+            return false;
+    }
+    return true;
+}
+
+void MultiFolderSync::startNext()
+{
+    for (auto &run : _folders) {
+        if (_running >= _maxParallelSyncs)
+            break;
+        if (!run.running && !run.done)
+            startSync(run);
+    }
+
+    if (_running == 0) {
+        _elapsedMs = _timer.elapsed();
+        emit finished();
+    }
+}
+
+void MultiFolderSync::startSync(FolderRun &run)
+{
+    if (run.syncs == 0)
+        run.timer.start();
+    run.running = true;
+    ++run.syncs;
+    ++_running;
+    updateNetworkLimits();
+
+    qCInfo(lcMultiFolderSync) << "Starting sync" << run.syncs << "of" << run.name;
+    // Queued: the engine may finish right away, and this may be called from its finished() signal
+    QMetaObject::invokeMethod(run.engine, "startSync", Qt::QueuedConnection);
+}
+
+void MultiFolderSync::itemCompleted(FolderRun &run, const SyncFileItem &item)
+{
+    if (item.hasErrorStatus()) {
+        ++run.errors;
+        return;
+    }
+    if (item._status != SyncFileItem::Success || !ProgressInfo::isSizeDependent(item))
+        return;
+
+    if (item._direction == SyncFileItem::Up) {
+        ++run.uploadedFiles;
+        run.uploadedBytes += item._size;
+    } else if (item._direction == SyncFileItem::Down) {
+        ++run.downloadedFiles;
+        run.downloadedBytes += item._size;
+    }
+}
+
+void MultiFolderSync::syncFinished(FolderRun &run, bool success)
+{
+    run.running = false;
+    --_running;
+
+    if (run.engine->isAnotherSyncNeeded() != NoFollowUpSync && run.syncs <= _maxFollowUpSyncs) {
+        qCInfo(lcMultiFolderSync) << "Restarting sync of" << run.name << ", because another sync is needed";
+        startSync(run);
+        return;
+    }
+
+    run.done = true;
+    run.success = success;
+    run.elapsedMs = run.timer.elapsed();
+    qCInfo(lcMultiFolderSync) << "Sync of" << run.name << (success ? "succeeded" : "failed")
+                              << "after" << run.elapsedMs << "ms";
+
+    updateNetworkLimits();
+    startNext();
+}
+
+void MultiFolderSync::updateNetworkLimits()
+{
+    if (_running == 0 || (_uploadLimit == 0 && _downloadLimit == 0))
+        return;
+
+    // Every running engine gets its share, but at least 1 KB/s: 0 would mean unlimited
+    const int upload = _uploadLimit > 0 ? qMax(1000, _uploadLimit / _running) : _uploadLimit;
+    const int download = _downloadLimit > 0 ? qMax(1000, _downloadLimit / _running) : _downloadLimit;
+    for (auto &run : _folders) {
+        if (run.running)
+            run.engine->setNetworkLimits(upload, download);
+    }
+}
+
+static QString formatBytes(qint64 bytes)
+{
+    return QString::number(bytes / (1000. * 1000.), 'f', 1) + QLatin1String(" MB");
+}
+
+static QString formatRate(qint64 bytes, qint64 ms)
+{
+    if (ms <= 0)
+        return QStringLiteral("-");
+    return QString::number(bytes / (1000. * ms), 'f', 1) + QLatin1String(" MB/s");
+}
+
+static QString formatSeconds(qint64 ms)
+{
+    return QString::number(ms / 1000., 'f', 1) + QLatin1String(" s");
+}
+
+void MultiFolderSync::printReport(std::ostream &out) const
+{
+    const auto row = [&out](const QString &name, const QString &result, const QString &time,
+                         const QString &up, const QString &down, const QString &errors) {
+        out << qPrintable(name.leftJustified(40)) << " "
+            << qPrintable(result.leftJustified(7)) << " "
+            << qPrintable(time.rightJustified(9)) << " "
+            << qPrintable(up.rightJustified(26)) << " "
+            << qPrintable(down.rightJustified(26)) << " "
+            << qPrintable(errors.rightJustified(6)) << std::endl;
+    };
+    const auto transfers = [](qint64 files, qint64 bytes) -> QString {
+        return QString::number(files) + QLatin1String(" files, ") + formatBytes(bytes);
+    };
+
+    out << std::endl;
+    row(QStringLiteral("Folder"), QStringLiteral("Result"), QStringLiteral("Time"),
+        QStringLiteral("Uploaded"), QStringLiteral("Downloaded"), QStringLiteral("Errors"));
+
+    int succeeded = 0;
+    qint64 uploadedFiles = 0, uploadedBytes = 0, downloadedFiles = 0, downloadedBytes = 0, errors = 0;
+    for (const auto &run : _folders) {
+        row(run.name, run.success ? QStringLiteral("ok") : QStringLiteral("failed"), formatSeconds(run.elapsedMs),
+            transfers(run.uploadedFiles, run.uploadedBytes), transfers(run.downloadedFiles, run.downloadedBytes),
+            QString::number(run.errors));
+        if (run.success)
+            ++succeeded;
+        uploadedFiles += run.uploadedFiles;
+        uploadedBytes += run.uploadedBytes;
+        downloadedFiles += run.downloadedFiles;
+        downloadedBytes += run.downloadedBytes;
+        errors += run.errors;
+    }
+
+    row(QStringLiteral("Total"), QString::number(succeeded) + QLatin1Char('/') + QString::number(_folders.size()),
+        formatSeconds(_elapsedMs), transfers(uploadedFiles, uploadedBytes),
+        transfers(downloadedFiles, downloadedBytes), QString::number(errors));
+    out << "Throughput: " << qPrintable(formatRate(uploadedBytes, _elapsedMs)) << " up, "
+        << qPrintable(formatRate(downloadedBytes, _elapsedMs)) << " down" << std::endl;
+}
+}
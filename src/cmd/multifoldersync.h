@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MULTIFOLDERSYNC_H
+#define MULTIFOLDERSYNC_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+#include <ostream>
+
+#include "syncfileitem.h"
+
+namespace OCC {
+
+class SyncEngine;
+
+/**
+ * @brief Syncs several folders of one account at the same time, for owncloudcmd --folders
+ *
+ * The engines share the account and so its network access manager, its
+ * connections and its credentials. At most maxParallelSyncs of them run
+ * at once, the others wait for a free slot.
+ *
+ * The upload and download limits are for all running syncs together: they
+ * are split evenly between the running engines and adjusted whenever a
+ * sync starts or finishes.
+ *
+ * @ingroup cmd
+ */
+class MultiFolderSync : public QObject
+{
+    Q_OBJECT
+public:
+    MultiFolderSync(int maxParallelSyncs, int uploadLimit, int downloadLimit,
+        int maxFollowUpSyncs, QObject *parent = 0);
+
+    /** The engine is not owned and must outlive this object */
+    void addFolder(const QString &name, SyncEngine *engine);
+
+    /** Starts the first syncs, finished() is emitted once all folders are done */
+    void start();
+
+    bool allSucceeded() const;
+
+    /** Time, results and transferred files of every folder, and the totals */
+    void printReport(std::ostream &out) const;
+
+signals:
+    void finished();
+
+private:
+    struct FolderRun
+    {
+        QString name;
+        SyncEngine *engine = nullptr;
+        bool running = false;
+        bool done = false;
+        bool success = false;
+        int syncs = 0;
+        QElapsedTimer timer;
+        qint64 elapsedMs = 0;
+
+        qint64 uploadedFiles = 0;
+        qint64 uploadedBytes = 0;
+        qint64 downloadedFiles = 0;
+        qint64 downloadedBytes = 0;
+        qint64 errors = 0;
+    };
+
+    void startNext();
+    void startSync(FolderRun &run);
+    void itemCompleted(FolderRun &run, const SyncFileItem &item);
+    void syncFinished(FolderRun &run, bool success);
+    void updateNetworkLimits();
+
+    int _maxParallelSyncs;
+    int _uploadLimit;
+    int _downloadLimit;
+    int _maxFollowUpSyncs;
+    int _running = 0;
+    QVector<FolderRun> _folders;
+    QElapsedTimer _timer;
+    qint64 _elapsedMs = 0;
+};
+}
+
+#endif
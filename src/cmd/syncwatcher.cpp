@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "syncwatcher.h"
+
+#include <QLoggingCategory>
+
+#include "common/syncjournaldb.h"
+#include "common/syncjournalfilerecord.h"
+#include "filesystem.h"
+#include "folderwatcher.h"
+#include "networkjobs.h"
+#include "syncengine.h"
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcSyncWatcher, "cmd.syncwatcher", QtInfoMsg)
+
+// A sync starts once no change was reported for this long...
+static const std::chrono::milliseconds defaultSyncDelay(1000);
+// ...but changes that keep coming don't delay it for more than this
+static const std::chrono::milliseconds defaultMaximumSyncDelay(10000);
+
+SyncWatcher::SyncWatcher(SyncEngine *engine, const QString &remotePath,
+    std::chrono::milliseconds pollInterval, int maxFollowUpSyncs, QObject *parent)
+    : QObject(parent)
+    , _engine(engine)
+    , _remotePath(remotePath)
+    , _maxFollowUpSyncs(maxFollowUpSyncs)
+    , _syncDelay(defaultSyncDelay)
+    , _maximumSyncDelay(defaultMaximumSyncDelay)
+{
+    // The tracker has to see the results before slotSyncFinished() looks at its paths
+    connect(_engine, &SyncEngine::itemCompleted,
+        &_localDiscoveryTracker, &LocalDiscoveryTracker::slotItemCompleted);
+    connect(_engine, &SyncEngine::finished,
+        &_localDiscoveryTracker, &LocalDiscoveryTracker::slotSyncFinished);
+    connect(_engine, &SyncEngine::finished, this, &SyncWatcher::slotSyncFinished);
+    connect(_engine, &SyncEngine::rootEtag, this, &SyncWatcher::slotRootEtag);
+
+    _syncTimer.setSingleShot(true);
+    _syncTimer.setInterval(_syncDelay.count());
+    connect(&_syncTimer, &QTimer::timeout, this, &SyncWatcher::startSync);
+
+    _pollTimer.setInterval(pollInterval.count());
+    connect(&_pollTimer, &QTimer::timeout, this, &SyncWatcher::slotPollRemote);
+}
+
+SyncWatcher::~SyncWatcher()
+{
+}
+
+void SyncWatcher::setSyncDelays(std::chrono::milliseconds delay, std::chrono::milliseconds maximumDelay)
+{
+    _syncDelay = delay;
+    _maximumSyncDelay = maximumDelay;
+    _syncTimer.setInterval(_syncDelay.count());
+}
+
+void SyncWatcher::start()
+{
+    _folderWatcher.reset(createFolderWatcher());
+    connect(_folderWatcher.data(), &FolderWatcher::pathChanged,
+        this, &SyncWatcher::slotPathChanged);
+    connect(_folderWatcher.data(), &FolderWatcher::lostChanges,
+        this, &SyncWatcher::slotLostChanges);
+    connect(_folderWatcher.data(), &FolderWatcher::becameUnreliable, this, [](const QString &message) {
+        qCWarning(lcSyncWatcher) << "Local changes can't be tracked reliably, every poll does a full local discovery:" << message;
+    });
+    connect(_folderWatcher.data(), &FolderWatcher::ready,
+        this, &SyncWatcher::slotWatcherReady);
+
+    _pollTimer.start();
+    startSync();
+}
+
+FolderWatcher *SyncWatcher::createFolderWatcher()
+{
+    auto watcher = new FolderWatcher(this, [this](const QString &path) {
+        return _engine->excludedFiles().isExcluded(path, _engine->localPath(), _engine->ignoreHiddenFiles());
+    });
+    watcher->init(_engine->localPath());
+    return watcher;
+}
+
+void SyncWatcher::stop()
+{
+    qCInfo(lcSyncWatcher) << "Stopping";
+    _stopping = true;
+    _syncTimer.stop();
+    _pollTimer.stop();
+    if (_engineStartPending) {
+        // The engine didn't start yet, aborting it would be a no-op
+        qCInfo(lcSyncWatcher) << "Cancelling the pending sync start";
+        _engineStartPending = false;
+        _syncRunning = false;
+        emit stopped();
+    } else if (_syncRunning) {
+        _engine->abort();
+    } else {
+        emit stopped();
+    }
+}
+
+void SyncWatcher::slotPathChanged(const QString &path)
+{
+    if (!path.startsWith(_engine->localPath())) {
+        qCDebug(lcSyncWatcher) << "Changed path is not contained in folder, ignoring:" << path;
+        return;
+    }
+
+    // Remember it before checking for our own changes, like Folder does
+    auto relativePathBytes = path.midRef(_engine->localPath().size()).toUtf8();
+    _localDiscoveryTracker.addTouchedPath(relativePathBytes);
+
+#ifndef Q_OS_MAC
+    // On OSX the folder watcher does not report changes done by our own process
+    if (_engine->wasFileTouched(path)) {
+        qCDebug(lcSyncWatcher) << "Changed path was touched by SyncEngine, ignoring:" << path;
+        return;
+    }
+#endif
+
+    SyncJournalFileRecord record;
+    if (_engine->journal()->getFileRecord(relativePathBytes, &record)
+        && record.isValid()
+        && !FileSystem::fileChanged(path, record._fileSize, record._modtime)) {
+        qCDebug(lcSyncWatcher) << "Ignoring spurious notification for file" << relativePathBytes;
+        return;
+    }
+
+    scheduleSync();
+}
+
+void SyncWatcher::slotLostChanges()
+{
+    qCInfo(lcSyncWatcher) << "The folder watcher lost changes, the next sync does a full local discovery";
+    _hasDoneFullLocalDiscovery = false;
+    scheduleSync();
+}
+
+void SyncWatcher::slotWatcherReady()
+{
+    // Changes made while the watches were set up may have been missed
+    if (!_hasDoneFullLocalDiscovery)
+        scheduleSync();
+}
+
+void SyncWatcher::slotPollRemote()
+{
+    if (_syncRunning || _etagJob)
+        return;
+
+    if (_retryOnPoll || !_folderWatcher->isReliable()) {
+        startSync();
+        return;
+    }
+
+    _etagJob = new RequestEtagJob(_engine->account(), _remotePath, this);
+    _etagJob->setTimeout(60 * 1000);
+    connect(_etagJob.data(), &RequestEtagJob::etagRetreived, this, &SyncWatcher::slotEtagRetrieved);
+    _etagJob->start();
+    // The job deletes itself when it is finished, which resets the guard
+}
+
+void SyncWatcher::slotEtagRetrieved(const QString &etag)
+{
+    if (_lastEtag != etag) {
+        qCInfo(lcSyncWatcher) << "Compare etag with previous etag: last:" << _lastEtag << ", received:" << etag << "-> CHANGED";
+        _lastEtag = etag;
+        scheduleSync();
+    }
+}
+
+void SyncWatcher::slotRootEtag(const QString &etag)
+{
+    _lastEtag = etag;
+}
+
+void SyncWatcher::scheduleSync()
+{
+    if (_stopping)
+        return;
+    if (_syncRunning) {
+        _syncPending = true;
+        return;
+    }
+
+    if (!_firstChangeTimer.isValid())
+        _firstChangeTimer.start();
+    if (!_syncTimer.isActive() || !_firstChangeTimer.hasExpired(_maximumSyncDelay.count() - _syncDelay.count()))
+        _syncTimer.start();
+}
+
+void SyncWatcher::startSync()
+{
+    if (_stopping)
+        return;
+    if (_syncRunning) {
+        _syncPending = true;
+        return;
+    }
+    _syncTimer.stop();
+    _firstChangeTimer.invalidate();
+    _syncPending = false;
+    _retryOnPoll = false;
+    _syncRunning = true;
+
+    if (_folderWatcher->isReliable() && _folderWatcher->isReady() && _hasDoneFullLocalDiscovery) {
+        qCInfo(lcSyncWatcher) << "Starting sync, local discovery of"
+                              << _localDiscoveryTracker.localDiscoveryPaths().size() << "touched paths";
+        _engine->setLocalDiscoveryOptions(
+            LocalDiscoveryStyle::DatabaseAndFilesystem,
+            _localDiscoveryTracker.localDiscoveryPaths());
+        _localDiscoveryTracker.startSyncPartialDiscovery();
+    } else {
+        qCInfo(lcSyncWatcher) << "Starting sync with a full local discovery";
+        _engine->setLocalDiscoveryOptions(LocalDiscoveryStyle::FilesystemOnly);
+        _localDiscoveryTracker.startSyncFullDiscovery();
+    }
+    // Changes in directories that aren't watched yet could be missed by
+    // this discovery and by the watcher
+    _watcherReadyAtSyncStart = _folderWatcher->isReady();
+
+    // Queued, the engine may still be in its finished() signal. stop() can
+    // cancel the start until then.
+    _engineStartPending = true;
+    QMetaObject::invokeMethod(this, "slotStartEngine", Qt::QueuedConnection);
+}
+
+void SyncWatcher::slotStartEngine()
+{
+    if (!_engineStartPending)
+        return;
+    _engineStartPending = false;
+    _engine->startSync();
+}
+
+void SyncWatcher::slotSyncFinished(bool success)
+{
+    _syncRunning = false;
+
+    if (success
+        && _engine->lastLocalDiscoveryStyle() == LocalDiscoveryStyle::FilesystemOnly
+        && _watcherReadyAtSyncStart) {
+        _hasDoneFullLocalDiscovery = true;
+    }
+
+    if (_stopping) {
+        emit stopped();
+        return;
+    }
+
+    const auto anotherSyncNeeded = _engine->isAnotherSyncNeeded();
+    if (success && anotherSyncNeeded == ImmediateFollowUp && _followUpSyncs < _maxFollowUpSyncs) {
+        ++_followUpSyncs;
+        qCInfo(lcSyncWatcher) << "Another sync is needed, follow-up sync" << _followUpSyncs;
+        QMetaObject::invokeMethod(this, "startSync", Qt::QueuedConnection);
+        return;
+    }
+    _followUpSyncs = 0;
+
+    if (_syncPending) {
+        scheduleSync();
+    } else if (!success || anotherSyncNeeded != NoFollowUpSync
+        || !_localDiscoveryTracker.localDiscoveryPaths().empty()) {
+        // Failures, and items that failed within a successful sync, are
+        // retried with the next poll instead of immediately
+        qCInfo(lcSyncWatcher) << "Sync" << (success ? "needs to be repeated," : "failed,") << "retrying with the next poll";
+        _retryOnPoll = true;
+    }
+}
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef SYNCWATCHER_H
+#define SYNCWATCHER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPointer>
+#include <QScopedPointer>
+#include <QTimer>
+
+#include <chrono>
+
+#include "localdiscoverytracker.h"
+
+namespace OCC {
+
+class FolderWatcher;
+class RequestEtagJob;
+class SyncEngine;
+
+/**
+ * @brief Keeps a folder in sync, for owncloudcmd --watch
+ *
+ * The engine and its journal stay alive between the syncs, so after the
+ * first full discovery the local side only looks at the paths reported
+ * by the FolderWatcher. The remote side is polled through the root etag.
+ *
+ * Bursts of changes are debounced into a single sync.
+ *
+ * @ingroup cmd
+ */
+class SyncWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    SyncWatcher(SyncEngine *engine, const QString &remotePath,
+        std::chrono::milliseconds pollInterval, int maxFollowUpSyncs, QObject *parent = 0);
+    ~SyncWatcher();
+
+    /**
+     * A sync starts once no change was reported for delay, but at the
+     * latest maximumDelay after the first change. Defaults to 1 s and 10 s.
+     */
+    void setSyncDelays(std::chrono::milliseconds delay, std::chrono::milliseconds maximumDelay);
+
+    /** Sets up the folder watcher and starts the first sync */
+    void start();
+
+public slots:
+    /**
+     * Aborts a running sync, stopped() is emitted once the engine is idle
+     *
+     * A sync that was scheduled but did not start yet is cancelled.
+     */
+    void stop();
+
+signals:
+    void stopped();
+
+private slots:
+    void slotPathChanged(const QString &path);
+    void slotLostChanges();
+    void slotWatcherReady();
+    void slotPollRemote();
+    void slotEtagRetrieved(const QString &etag);
+    void slotRootEtag(const QString &etag);
+    void slotSyncFinished(bool success);
+    void startSync();
+    void slotStartEngine();
+
+protected:
+    /** Creates the watcher for the engine's local path, called by start() */
+    virtual FolderWatcher *createFolderWatcher();
+
+private:
+    void scheduleSync();
+
+    SyncEngine *_engine;
+    QString _remotePath;
+    int _maxFollowUpSyncs;
+    std::chrono::milliseconds _syncDelay;
+    std::chrono::milliseconds _maximumSyncDelay;
+    QScopedPointer<FolderWatcher> _folderWatcher;
+    LocalDiscoveryTracker _localDiscoveryTracker;
+
+    QTimer _syncTimer; // debounces the changes
+    QElapsedTimer _firstChangeTimer; // since the first change waiting for a sync
+    QTimer _pollTimer;
+    QPointer<RequestEtagJob> _etagJob;
+    QString _lastEtag;
+
+    bool _syncRunning = false;
+    bool _engineStartPending = false; // the engine's startSync() is queued
+    bool _hasDoneFullLocalDiscovery = false;
+    bool _watcherReadyAtSyncStart = false;
+    bool _syncPending = false; // a sync was requested while one was running
+    bool _retryOnPoll = false; // the last sync asked to be repeated later
+    bool _stopping = false;
+    int _followUpSyncs = 0;
+};
+}
+
+#endif
@@ -18,10 +18,16 @@
 #include "config.h"
 #include "filesystembase.h"
 #include "common/checksums.h"
+#include "common/synctrace.h"
 
+#include <QCryptographicHash>
 #include <QLoggingCategory>
 #include <qtconcurrentrun.h>
 
+#ifdef ZLIB_FOUND
+#include <zlib.h>
+#endif
+
 /** \file checksums.cpp
  *
  * \brief Computing and validating file checksums
@@ -187,6 +193,7 @@ QByteArray ComputeChecksum::computeNow(const QString &filePath, const QByteArray
         return QByteArray();
     }
 
+    SyncTraceScope trace("checksum", "checksum", filePath);
     if (checksumType == checkSumMD5C) {
         return FileSystem::calcMd5(filePath);
     } else if (checksumType == checkSumSHA1C) {
@@ -204,6 +211,31 @@ QByteArray ComputeChecksum::computeNow(const QString &filePath, const QByteArray
     return QByteArray();
 }
 
+QByteArray ComputeChecksum::computeNowOnData(const QByteArray &data, const QByteArray &checksumType)
+{
+    if (!checksumComputationEnabled()) {
+        qCWarning(lcChecksums) << "Checksum computation disabled by environment variable";
+        return QByteArray();
+    }
+
+    if (checksumType == checkSumMD5C) {
+        return QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex();
+    } else if (checksumType == checkSumSHA1C) {
+        return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+    }
+#ifdef ZLIB_FOUND
+    else if (checksumType == checkSumAdlerC) {
+        unsigned int adler = adler32(0L, Z_NULL, 0);
+        adler = adler32(adler, reinterpret_cast<const Bytef *>(data.constData()), data.size());
+        return QByteArray::number(adler, 16);
+    }
+#endif
+    if (!checksumType.isEmpty()) {
+        qCWarning(lcChecksums) << "Unknown checksum type:" << checksumType;
+    }
+    return QByteArray();
+}
+
 void ComputeChecksum::slotCalculationDone()
 {
     QByteArray checksum = _watcher.future().result();
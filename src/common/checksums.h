@@ -91,6 +91,11 @@ public:
      */
     static QByteArray computeNow(const QString &filePath, const QByteArray &checksumType);
 
+    /**
+     * Computes the checksum of data that is already in memory.
+     */
+    static QByteArray computeNowOnData(const QByteArray &data, const QByteArray &checksumType);
+
 signals:
     void done(const QByteArray &checksumType, const QByteArray &checksum);
 
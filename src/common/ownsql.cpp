@@ -382,19 +382,19 @@ void SqlQuery::bindValue(int pos, const QVariant &value)
         break;
     }
     case QVariant::String: {
-        if (!value.toString().isNull()) {
-            // lifetime of string == lifetime of its qvariant
-            const QString *str = static_cast<const QString *>(value.constData());
-            res = sqlite3_bind_text16(_stmt, pos, str->utf16(),
-                (str->size()) * sizeof(QChar), SQLITE_TRANSIENT);
+        const QString *str = static_cast<const QString *>(value.constData());
+        if (!str->isNull()) {
+            // The database is UTF-8, converting here spares SQLite a copy and a conversion
+            const auto &utf8 = keepBoundData(pos, str->toUtf8());
+            res = sqlite3_bind_text(_stmt, pos, utf8.constData(), utf8.size(), SQLITE_STATIC);
         } else {
             res = sqlite3_bind_null(_stmt, pos);
         }
         break;
     }
     case QVariant::ByteArray: {
-        auto ba = value.toByteArray();
-        res = sqlite3_bind_text(_stmt, pos, ba.constData(), ba.size(), SQLITE_TRANSIENT);
+        const auto &ba = keepBoundData(pos, value.toByteArray());
+        res = sqlite3_bind_text(_stmt, pos, ba.constData(), ba.size(), SQLITE_STATIC);
         break;
     }
     default: {
@@ -411,6 +411,55 @@ void SqlQuery::bindValue(int pos, const QVariant &value)
     ASSERT(res == SQLITE_OK);
 }
 
+void SqlQuery::bindInt64(int pos, qint64 value)
+{
+    qCDebug(lcSql) << "SQL bind" << pos << value;
+    if (!_stmt) {
+        ASSERT(false);
+        return;
+    }
+    checkBindResult(pos, sqlite3_bind_int64(_stmt, pos, value));
+}
+
+void SqlQuery::bindText(int pos, const QByteArray &utf8)
+{
+    qCDebug(lcSql) << "SQL bind" << pos << utf8;
+    if (!_stmt) {
+        ASSERT(false);
+        return;
+    }
+    const auto &data = keepBoundData(pos, utf8);
+    checkBindResult(pos, sqlite3_bind_text(_stmt, pos, data.constData(), data.size(), SQLITE_STATIC));
+}
+
+void SqlQuery::bindBlob(int pos, const QByteArray &data)
+{
+    qCDebug(lcSql) << "SQL bind" << pos << data.size() << "bytes";
+    if (!_stmt) {
+        ASSERT(false);
+        return;
+    }
+    const auto &kept = keepBoundData(pos, data);
+    checkBindResult(pos, sqlite3_bind_blob(_stmt, pos, kept.constData(), kept.size(), SQLITE_STATIC));
+}
+
+void SqlQuery::checkBindResult(int pos, int res)
+{
+    if (res != SQLITE_OK) {
+        qCWarning(lcSql) << "ERROR binding SQL value at" << pos << "error:" << res;
+    }
+    ASSERT(res == SQLITE_OK);
+}
+
+const QByteArray &SqlQuery::keepBoundData(int pos, const QByteArray &data)
+{
+    // Parameter positions start at 1
+    if (_boundData.size() <= pos)
+        _boundData.resize(pos + 1);
+    _boundData[pos] = data;
+    return _boundData[pos];
+}
+
 bool SqlQuery::nullValue(int index)
 {
     return sqlite3_column_type(_stmt, index) == SQLITE_NULL;
@@ -418,7 +467,9 @@ bool SqlQuery::nullValue(int index)
 
 QString SqlQuery::stringValue(int index)
 {
-    return QString::fromUtf16(static_cast<const ushort *>(sqlite3_column_text16(_stmt, index)));
+    // The database is UTF-8, sqlite3_column_text16 would convert and cache a copy
+    auto text = reinterpret_cast<const char *>(sqlite3_column_text(_stmt, index));
+    return QString::fromUtf8(text, sqlite3_column_bytes(_stmt, index));
 }
 
 int SqlQuery::intValue(int index)
@@ -437,6 +488,13 @@ QByteArray SqlQuery::baValue(int index)
         sqlite3_column_bytes(_stmt, index));
 }
 
+QByteArray SqlQuery::baValueView(int index)
+{
+    // sqlite3_column_text makes sure the data is zero terminated
+    auto text = reinterpret_cast<const char *>(sqlite3_column_text(_stmt, index));
+    return QByteArray::fromRawData(text, sqlite3_column_bytes(_stmt, index));
+}
+
 QString SqlQuery::error() const
 {
     return _error;
@@ -463,6 +521,7 @@ void SqlQuery::finish()
         return;
     SQLITE_DO(sqlite3_finalize(_stmt));
     _stmt = 0;
+    _boundData.clear();
     if (_sqldb) {
         _sqldb->_queries.remove(this);
     }
@@ -473,6 +532,7 @@ void SqlQuery::reset_and_clear_bindings()
     if (_stmt) {
         SQLITE_DO(sqlite3_reset(_stmt));
         SQLITE_DO(sqlite3_clear_bindings(_stmt));
+        _boundData.clear();
     }
 }
 
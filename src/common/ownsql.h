@@ -22,6 +22,7 @@
 #include <QObject>
 #include <QVariant>
 #include <QSet>
+#include <QVector>
 
 #include "ocsynclib.h"
 
@@ -126,23 +127,43 @@ public:
     int intValue(int index);
     quint64 int64Value(int index);
     QByteArray baValue(int index);
+    /**
+     * Like baValue(), but points into SQLite's buffer instead of copying.
+     *
+     * The data is zero terminated and only valid until the next call to
+     * next(), reset_and_clear_bindings() or finish().
+     */
+    QByteArray baValueView(int index);
     bool isSelect();
     bool isPragma();
     bool exec();
     bool next();
     void bindValue(int pos, const QVariant &value);
+    void bindInt64(int pos, qint64 value);
+    /**
+     * Binds UTF-8 text without copying: the query keeps a reference to
+     * the data until the parameter is bound again or the bindings are cleared.
+     */
+    void bindText(int pos, const QByteArray &utf8);
+    /** Same as bindText, but for binary data */
+    void bindBlob(int pos, const QByteArray &data);
     QString lastQuery() const;
     int numRowsAffected();
     void reset_and_clear_bindings();
     void finish();
 
 private:
+    void checkBindResult(int pos, int res);
+    const QByteArray &keepBoundData(int pos, const QByteArray &data);
+
     SqlDatabase *_sqldb = nullptr;
     sqlite3 *_db = nullptr;
     sqlite3_stmt *_stmt = nullptr;
     QString _error;
     int _errId;
     QByteArray _sql;
+    // Text and blobs are bound with SQLITE_STATIC, this keeps them alive
+    QVector<QByteArray> _boundData;
 };
 
 } // namespace OCC
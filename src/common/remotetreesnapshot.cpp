@@ -0,0 +1,474 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "remotetreesnapshot.h"
+#include "syncjournaldb.h"
+#include "filesystembase.h"
+
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcRemoteTreeSnapshot, "sync.database.remotetreesnapshot", QtInfoMsg)
+
+/*
+ * File layout, in host byte order since the file never leaves the machine:
+ *
+ *   FileHeader
+ *   for each entry: RecordHeader, path, etag, fileId, checksumHeader,
+ *                   remotePerm with a terminating zero
+ *   padding to 8 bytes
+ *   index: quint64 offset of each record, sorted like getFilesBelowPath()
+ */
+namespace {
+    const char magic[8] = { 'o', 'c', 'r', 't', 'r', 'e', 'e', 0 };
+    const quint32 currentVersion = 1;
+
+    struct FileHeader
+    {
+        char magic[8];
+        quint32 version;
+        quint32 recordHeaderSize;
+        qint64 generation;
+        qint64 entryCount;
+        qint64 indexOffset;
+    };
+
+    struct RecordHeader
+    {
+        quint64 inode;
+        qint64 modtime;
+        qint64 fileSize;
+        quint32 pathSize;
+        quint16 etagSize;
+        quint16 fileIdSize;
+        quint16 checksumSize;
+        quint8 remotePermSize; // without the terminating zero
+        quint8 type;
+        quint8 serverHasIgnoredFiles;
+        quint8 reserved[3];
+    };
+
+    /* Entries that changed are merged into the previous snapshot up to this many */
+    const qint64 maxUpdateChanges = 100000;
+
+    /* Records read from the journal while it is locked */
+    const int readChunkSize = 10000;
+
+    /* Compares path + '/' with key, like SQLite compares path||'/' */
+    int compareWithSlash(const QByteArray &path, const QByteArray &key)
+    {
+        int common = qMin(path.size(), key.size());
+        int result = std::memcmp(path.constData(), key.constData(), common);
+        if (result != 0)
+            return result;
+        if (path.size() >= key.size())
+            return 1;
+        uchar next = key.at(path.size());
+        if (next != '/')
+            return uchar('/') < next ? -1 : 1;
+        return path.size() + 1 < key.size() ? -1 : 0;
+    }
+
+    /* Compares a + '/' with b + '/', the order of the snapshot */
+    int comparePaths(const QByteArray &a, const QByteArray &b)
+    {
+        int common = qMin(a.size(), b.size());
+        int result = std::memcmp(a.constData(), b.constData(), common);
+        if (result != 0 || a.size() == b.size())
+            return result;
+        if (a.size() < b.size())
+            return uchar('/') <= uchar(b.at(common)) ? -1 : 1;
+        return uchar(a.at(common)) < uchar('/') ? -1 : 1;
+    }
+
+    RemoteTreeSnapshot::Entry entryFromRecord(const SyncJournalFileRecord &rec)
+    {
+        RemoteTreeSnapshot::Entry entry;
+        entry.path = rec._path;
+        entry.etag = rec._etag;
+        entry.fileId = rec._fileId;
+        entry.checksumHeader = rec._checksumHeader;
+        entry.remotePerm = rec._remotePerm;
+        entry.inode = rec._inode;
+        entry.modtime = rec._modtime;
+        entry.fileSize = rec._fileSize;
+        entry.type = rec._type;
+        entry.serverHasIgnoredFiles = rec._serverHasIgnoredFiles;
+        return entry;
+    }
+}
+
+/* Appends the records and writes the index and the header at the end */
+class RemoteTreeSnapshot::Writer
+{
+public:
+    explicit Writer(QSaveFile *file)
+        : _file(file)
+    {
+        FileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        _buffer.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    qint64 entryCount() const { return qint64(_offsets.size()); }
+
+    void append(const Entry &entry)
+    {
+        const QByteArray remotePerm = entry.remotePerm.toString();
+        if (!_ok
+            || entry.etag.size() > std::numeric_limits<quint16>::max()
+            || entry.fileId.size() > std::numeric_limits<quint16>::max()
+            || entry.checksumHeader.size() > std::numeric_limits<quint16>::max()
+            || remotePerm.size() > std::numeric_limits<quint8>::max()) {
+            _ok = false;
+            return;
+        }
+
+        RecordHeader record;
+        std::memset(&record, 0, sizeof(record));
+        record.inode = entry.inode;
+        record.modtime = entry.modtime;
+        record.fileSize = entry.fileSize;
+        record.pathSize = entry.path.size();
+        record.etagSize = entry.etag.size();
+        record.fileIdSize = entry.fileId.size();
+        record.checksumSize = entry.checksumHeader.size();
+        record.remotePermSize = remotePerm.size();
+        record.type = entry.type;
+        record.serverHasIgnoredFiles = entry.serverHasIgnoredFiles;
+
+        _offsets.push_back(_pos + _buffer.size());
+        _buffer.append(reinterpret_cast<const char *>(&record), sizeof(record));
+        _buffer.append(entry.path);
+        _buffer.append(entry.etag);
+        _buffer.append(entry.fileId);
+        _buffer.append(entry.checksumHeader);
+        _buffer.append(remotePerm);
+        _buffer.append('\0');
+
+        if (_buffer.size() > 1024 * 1024)
+            flush();
+    }
+
+    bool finish(qint64 generation)
+    {
+        // The index is aligned so it can be read in place
+        const qint64 end = _pos + _buffer.size();
+        _buffer.append(QByteArray((8 - end % 8) % 8, '\0'));
+        const qint64 indexOffset = _pos + _buffer.size();
+        flush();
+
+        const qint64 indexSize = qint64(_offsets.size() * sizeof(quint64));
+        if (!_ok || _file->write(reinterpret_cast<const char *>(_offsets.data()), indexSize) != indexSize)
+            return false;
+
+        FileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = currentVersion;
+        header.recordHeaderSize = sizeof(RecordHeader);
+        header.generation = generation;
+        header.entryCount = _offsets.size();
+        header.indexOffset = indexOffset;
+        return _file->seek(0)
+            && _file->write(reinterpret_cast<const char *>(&header), sizeof(header)) == qint64(sizeof(header));
+    }
+
+private:
+    void flush()
+    {
+        if (_file->write(_buffer) != _buffer.size())
+            _ok = false;
+        _pos += _buffer.size();
+        _buffer.clear();
+    }
+
+    QSaveFile *_file;
+    std::vector<quint64> _offsets;
+    qint64 _pos = 0; // of the start of the buffer
+    QByteArray _buffer;
+    bool _ok = true;
+};
+
+RemoteTreeSnapshot::RemoteTreeSnapshot() = default;
+
+RemoteTreeSnapshot::~RemoteTreeSnapshot()
+{
+    close();
+}
+
+bool RemoteTreeSnapshot::write(SyncJournalDb *journal)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Any change to the records after this point invalidates the generation.
+    // If only a few records changed since the previous snapshot, it is updated.
+    const QString fileName = journal->remoteTreeSnapshotFilePath();
+    RemoteTreeSnapshot previous;
+    QVector<QByteArray> changedPaths;
+    qint64 generation = 0;
+    if (previous.open(fileName)) {
+        const int maxChanges = int(qMin<qint64>(previous.entryCount() / 10, maxUpdateChanges));
+        generation = journal->startRemoteTreeSnapshotGeneration(previous.generation(), maxChanges, &changedPaths);
+    } else {
+        generation = journal->startRemoteTreeSnapshotGeneration();
+    }
+    if (changedPaths.isEmpty())
+        previous.close();
+    if (!generation)
+        return false;
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(lcRemoteTreeSnapshot) << "Could not open" << fileName << file.errorString();
+        return false;
+    }
+
+    Writer writer(&file);
+    const bool dbOk = previous.isOpen()
+        ? updateEntries(journal, previous, &changedPaths, &writer)
+        : readEntries(journal, &writer);
+    // The file of the previous snapshot is about to be replaced
+    previous.close();
+    if (!dbOk || !writer.finish(generation)) {
+        qCWarning(lcRemoteTreeSnapshot) << "Could not write the remote tree snapshot";
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit()) {
+        qCWarning(lcRemoteTreeSnapshot) << "Could not write" << fileName << file.errorString();
+        return false;
+    }
+    FileSystem::setFileHidden(fileName, true);
+
+    qCInfo(lcRemoteTreeSnapshot) << "Wrote" << writer.entryCount() << "entries to" << fileName
+                                 << "with" << changedPaths.size() << "updated paths"
+                                 << "in" << timer.elapsed() << "ms";
+    return true;
+}
+
+bool RemoteTreeSnapshot::readEntries(SyncJournalDb *journal, Writer *writer)
+{
+    // The journal is read in chunks, so that other users of it only wait
+    // for one chunk. The chunks are ordered by path, but the snapshot is
+    // ordered by path||'/', where "a" comes after "a-b" and before "a/b".
+    // So an entry waits until no other entry can sort before it.
+    std::vector<Entry> pending;
+    QByteArray lastPath;
+    QVector<SyncJournalFileRecord> chunk;
+    forever {
+        chunk.clear();
+        const int count = journal->getFilesAfterPath(lastPath, readChunkSize, [&chunk](const SyncJournalFileRecord &rec) {
+            chunk.append(rec);
+        });
+        if (count < 0)
+            return false;
+
+        for (const auto &rec : chunk) {
+            while (!pending.empty()) {
+                const QByteArray &top = pending.back().path;
+                if (rec._path.size() > top.size() && rec._path.startsWith(top)
+                    && uchar(rec._path.at(top.size())) < uchar('/')) {
+                    break;
+                }
+                writer->append(pending.back());
+                pending.pop_back();
+            }
+            pending.push_back(entryFromRecord(rec));
+        }
+
+        if (count < readChunkSize)
+            break;
+        lastPath = chunk.last()._path;
+    }
+    while (!pending.empty()) {
+        writer->append(pending.back());
+        pending.pop_back();
+    }
+    return true;
+}
+
+bool RemoteTreeSnapshot::updateEntries(SyncJournalDb *journal, const RemoteTreeSnapshot &previous,
+    QVector<QByteArray> *changedPaths, Writer *writer)
+{
+    std::sort(changedPaths->begin(), changedPaths->end(), [](const QByteArray &a, const QByteArray &b) {
+        return comparePaths(a, b) < 0;
+    });
+
+    // The current record of a changed path replaces the old entry, if any
+    bool dbOk = true;
+    int next = 0;
+    auto appendChanged = [&]() {
+        SyncJournalFileRecord rec;
+        if (!journal->getFileRecord(changedPaths->at(next++), &rec))
+            dbOk = false;
+        else if (rec.isValid())
+            writer->append(entryFromRecord(rec));
+    };
+    bool ok = previous.forEachBelow(QByteArray(), [&](const Entry &entry) {
+        while (next < changedPaths->size() && comparePaths(changedPaths->at(next), entry.path) < 0)
+            appendChanged();
+        if (next < changedPaths->size() && changedPaths->at(next) == entry.path) {
+            appendChanged();
+            return;
+        }
+        writer->append(entry);
+    });
+    while (next < changedPaths->size())
+        appendChanged();
+    return ok && dbOk;
+}
+
+bool RemoteTreeSnapshot::open(const QString &fileName)
+{
+    close();
+
+    _file.setFileName(fileName);
+    if (!_file.open(QIODevice::ReadOnly))
+        return false;
+    _size = _file.size();
+    if (_size < qint64(sizeof(FileHeader))) {
+        close();
+        return false;
+    }
+    _data = _file.map(0, _size);
+    if (!_data) {
+        qCWarning(lcRemoteTreeSnapshot) << "Could not map" << fileName << _file.errorString();
+        close();
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, _data, sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0
+        || header.version != currentVersion
+        || header.recordHeaderSize != sizeof(RecordHeader)
+        || header.entryCount < 0
+        || header.indexOffset < qint64(sizeof(FileHeader))
+        || header.indexOffset % 8 != 0
+        || header.entryCount > (_size - header.indexOffset) / qint64(sizeof(quint64))) {
+        qCWarning(lcRemoteTreeSnapshot) << "Invalid remote tree snapshot" << fileName;
+        close();
+        return false;
+    }
+
+    _generation = header.generation;
+    _entryCount = header.entryCount;
+    _index = _data + header.indexOffset;
+    return true;
+}
+
+void RemoteTreeSnapshot::close()
+{
+    if (_data)
+        _file.unmap(const_cast<uchar *>(_data));
+    _file.close();
+    _data = nullptr;
+    _index = nullptr;
+    _size = 0;
+    _generation = 0;
+    _entryCount = 0;
+}
+
+QByteArray RemoteTreeSnapshot::entryPath(qint64 index) const
+{
+    quint64 offset;
+    std::memcpy(&offset, _index + index * sizeof(quint64), sizeof(offset));
+    RecordHeader record;
+    if (offset + sizeof(RecordHeader) > quint64(_size))
+        return QByteArray();
+    std::memcpy(&record, _data + offset, sizeof(record));
+    if (offset + sizeof(RecordHeader) + record.pathSize > quint64(_size))
+        return QByteArray();
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(_data + offset + sizeof(RecordHeader)), record.pathSize);
+}
+
+bool RemoteTreeSnapshot::readEntry(qint64 index, Entry *entry) const
+{
+    quint64 offset;
+    std::memcpy(&offset, _index + index * sizeof(quint64), sizeof(offset));
+    RecordHeader record;
+    if (offset + sizeof(RecordHeader) > quint64(_size))
+        return false;
+    std::memcpy(&record, _data + offset, sizeof(record));
+
+    const quint64 dataSize = quint64(record.pathSize) + record.etagSize + record.fileIdSize
+        + record.checksumSize + record.remotePermSize + 1;
+    if (offset + sizeof(RecordHeader) + dataSize > quint64(_size))
+        return false;
+
+    auto data = reinterpret_cast<const char *>(_data + offset + sizeof(RecordHeader));
+    entry->path = QByteArray::fromRawData(data, record.pathSize);
+    data += record.pathSize;
+    entry->etag = QByteArray::fromRawData(data, record.etagSize);
+    data += record.etagSize;
+    entry->fileId = QByteArray::fromRawData(data, record.fileIdSize);
+    data += record.fileIdSize;
+    entry->checksumHeader = QByteArray::fromRawData(data, record.checksumSize);
+    data += record.checksumSize;
+    if (data[record.remotePermSize] != '\0')
+        return false;
+    entry->remotePerm = RemotePermissions(record.remotePermSize ? data : nullptr);
+    entry->inode = record.inode;
+    entry->modtime = record.modtime;
+    entry->fileSize = record.fileSize;
+    entry->type = static_cast<ItemType>(record.type);
+    entry->serverHasIgnoredFiles = record.serverHasIgnoredFiles;
+    return true;
+}
+
+bool RemoteTreeSnapshot::forEachBelow(const QByteArray &path, const std::function<void(const Entry &)> &callback) const
+{
+    if (!_data)
+        return false;
+
+    const QByteArray key = path.isEmpty() ? QByteArray() : path + '/';
+
+    // Find the first entry with path + '/' > key, this skips path itself
+    qint64 first = 0;
+    qint64 count = _entryCount;
+    while (count > 0) {
+        qint64 step = count / 2;
+        if (compareWithSlash(entryPath(first + step), key) <= 0) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+
+    Entry entry;
+    for (qint64 i = first; i < _entryCount; ++i) {
+        if (!readEntry(i, &entry))
+            return false;
+        if (!entry.path.startsWith(key))
+            break;
+        callback(entry);
+    }
+    return true;
+}
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef REMOTETREESNAPSHOT_H
+#define REMOTETREESNAPSHOT_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QVector>
+
+#include <functional>
+
+#include "csync.h"
+#include "ocsynclib.h"
+#include "remotepermissions.h"
+
+namespace OCC {
+
+class SyncJournalDb;
+
+/**
+ * @brief Memory mapped copy of the file records of the journal
+ * @ingroup libsync
+ *
+ * When the etag of a remote directory did not change, the discovery takes
+ * everything below it from the journal. For big trees most of that time is
+ * spent stepping through SQLite rows. The snapshot has the same records,
+ * sorted like SyncJournalDb::getFilesBelowPath() returns them, in a file
+ * that is mapped into memory. A subtree is found with a binary search.
+ *
+ * The snapshot is only valid while the generation it was written with
+ * matches SyncJournalDb::remoteTreeSnapshotGeneration().
+ */
+class OCSYNC_EXPORT RemoteTreeSnapshot
+{
+    Q_DISABLE_COPY(RemoteTreeSnapshot)
+public:
+    /**
+     * One file record. The byte arrays point into the mapped file and are
+     * only valid as long as the snapshot is open.
+     */
+    struct Entry
+    {
+        QByteArray path;
+        QByteArray etag;
+        QByteArray fileId;
+        QByteArray checksumHeader;
+        RemotePermissions remotePerm;
+        quint64 inode = 0;
+        qint64 modtime = 0;
+        qint64 fileSize = 0;
+        ItemType type = ItemTypeSkip;
+        bool serverHasIgnoredFiles = false;
+    };
+
+    RemoteTreeSnapshot();
+    ~RemoteTreeSnapshot();
+
+    /**
+     * Writes the records of the journal to journal->remoteTreeSnapshotFilePath().
+     *
+     * When only a few records changed since the previous snapshot, their
+     * entries are replaced in a copy of it. Otherwise the whole metadata
+     * table is read, in chunks. Either way this is meant to run outside of
+     * the main thread.
+     */
+    static bool write(SyncJournalDb *journal);
+
+    /** Maps the file, returns false if it is not a valid snapshot */
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const { return _data != nullptr; }
+
+    qint64 generation() const { return _generation; }
+    qint64 entryCount() const { return _entryCount; }
+
+    /**
+     * Calls the callback for every entry below path (not for path itself),
+     * in the same order as SyncJournalDb::getFilesBelowPath().
+     *
+     * Returns false if the file turned out to be corrupt.
+     */
+    bool forEachBelow(const QByteArray &path, const std::function<void(const Entry &)> &callback) const;
+
+private:
+    class Writer;
+    static bool readEntries(SyncJournalDb *journal, Writer *writer);
+    static bool updateEntries(SyncJournalDb *journal, const RemoteTreeSnapshot &previous,
+        QVector<QByteArray> *changedPaths, Writer *writer);
+
+    bool readEntry(qint64 index, Entry *entry) const;
+    QByteArray entryPath(qint64 index) const;
+
+    QFile _file;
+    const uchar *_data = nullptr;
+    qint64 _size = 0;
+    qint64 _generation = 0;
+    qint64 _entryCount = 0;
+    const uchar *_index = nullptr;
+};
+}
+
+#endif // REMOTETREESNAPSHOT_H
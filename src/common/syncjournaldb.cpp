@@ -30,6 +30,7 @@
 #include "filesystembase.h"
 #include "common/asserts.h"
 #include "common/checksums.h"
+#include "common/synctrace.h"
 
 #include "common/c_jhash.h"
 
@@ -50,6 +51,25 @@ Q_LOGGING_CATEGORY(lcDb, "sync.database", QtInfoMsg)
         " FROM metadata" \
         "  LEFT JOIN checksumtype as contentchecksumtype ON metadata.contentChecksumTypeId == contentchecksumtype.id"
 
+// phash of the parent directory, the one of the root is getPHash("")
+static qint64 getParentPHash(const QByteArray &path)
+{
+    int slash = path.lastIndexOf('/');
+    return SyncJournalDb::getPHash(slash == -1 ? QByteArray() : path.left(slash));
+}
+
+// SQL function parent_phash(path), used to fill in the parentPhash column
+static void parentPHashSqlFunction(sqlite3_context *context, int, sqlite3_value **argv)
+{
+    auto text = reinterpret_cast<const char *>(sqlite3_value_text(argv[0]));
+    if (!text) {
+        sqlite3_result_null(context);
+        return;
+    }
+    const auto path = QByteArray::fromRawData(text, sqlite3_value_bytes(argv[0]));
+    sqlite3_result_int64(context, getParentPHash(path));
+}
+
 static void fillFileRecordFromGetQuery(SyncJournalFileRecord &rec, SqlQuery &query)
 {
     rec._path = query.baValue(0);
@@ -58,7 +78,7 @@ static void fillFileRecordFromGetQuery(SyncJournalFileRecord &rec, SqlQuery &que
     rec._type = static_cast<ItemType>(query.intValue(3));
     rec._etag = query.baValue(4);
     rec._fileId = query.baValue(5);
-    rec._remotePerm = RemotePermissions(query.baValue(6).constData());
+    rec._remotePerm = RemotePermissions(query.baValueView(6).constData());
     rec._fileSize = query.int64Value(7);
     rec._serverHasIgnoredFiles = (query.intValue(8) > 0);
     rec._checksumHeader = query.baValue(9);
@@ -304,6 +324,13 @@ bool SyncJournalDb::checkConnect()
         return false;
     }
 
+    if (sqlite3_create_function(_db.sqliteDb(), "parent_phash", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+            nullptr, &parentPHashSqlFunction, nullptr, nullptr) != SQLITE_OK) {
+        qCWarning(lcDb) << "Error registering the parent_phash function:" << _db.error();
+        close();
+        return false;
+    }
+
     SqlQuery pragma1(_db);
     pragma1.prepare("SELECT sqlite_version();");
     if (!pragma1.exec()) {
@@ -466,6 +493,22 @@ bool SyncJournalDb::checkConnect()
         return sqlFail("Create table datafingerprint", createQuery);
     }
 
+    // create the local discovery state tables, filled on clean shutdown.
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS localdiscoverystate("
+                        "shutdownTime INTEGER,"
+                        "lastFullDiscoveryTime INTEGER"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail("Create table localdiscoverystate", createQuery);
+    }
+
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS localdiscoverypaths("
+                        "path TEXT PRIMARY KEY"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail("Create table localdiscoverypaths", createQuery);
+    }
+
     // create the conflicts table.
     createQuery.prepare("CREATE TABLE IF NOT EXISTS conflicts("
                         "path TEXT PRIMARY KEY,"
@@ -707,6 +750,42 @@ bool SyncJournalDb::updateMetadataTableStructure()
         commitInternal("update database structure: add contentChecksumTypeId col");
     }
 
+    if (columns.indexOf("parentPhash") == -1) {
+        SqlQuery query(_db);
+        query.prepare("ALTER TABLE metadata ADD COLUMN parentPhash INTEGER(8);");
+        if (!query.exec()) {
+            sqlFail("updateMetadataTableStructure: add parentPhash column", query);
+            re = false;
+        }
+        commitInternal("update database structure: add parentPhash col");
+    }
+
+    if (1) {
+        SqlQuery query(_db);
+        query.prepare("CREATE INDEX IF NOT EXISTS metadata_parent ON metadata(parentPhash);");
+        if (!query.exec()) {
+            sqlFail("updateMetadataTableStructure: create index parentPhash", query);
+            re = false;
+        }
+        // Records of a journal written without the column, like by an older client
+        query.prepare("UPDATE metadata SET parentPhash = parent_phash(path) WHERE parentPhash IS NULL;");
+        if (!query.exec()) {
+            sqlFail("updateMetadataTableStructure: fill parentPhash", query);
+            re = false;
+        }
+        commitInternal("update database structure: add parentPhash index");
+    }
+
+    if (1) {
+        SqlQuery query(_db);
+        query.prepare("CREATE INDEX IF NOT EXISTS metadata_checksum ON metadata(contentChecksum);");
+        if (!query.exec()) {
+            sqlFail("updateMetadataTableStructure: create index contentChecksum", query);
+            re = false;
+        }
+        commitInternal("update database structure: add contentChecksum index");
+    }
+
     if (!tableColumns("uploadinfo").contains("contentChecksum")) {
         SqlQuery query(_db);
         query.prepare("ALTER TABLE uploadinfo ADD COLUMN contentChecksum TEXT;");
@@ -855,27 +934,28 @@ bool SyncJournalDb::setFileRecord(const SyncJournalFileRecord &_record)
 
         if (!_setFileRecordQuery.initOrReset(QByteArrayLiteral(
             "INSERT OR REPLACE INTO metadata "
-            "(phash, pathlen, path, inode, uid, gid, mode, modtime, type, md5, fileid, remotePerm, filesize, ignoredChildrenRemote, contentChecksum, contentChecksumTypeId) "
-            "VALUES (?1 , ?2, ?3 , ?4 , ?5 , ?6 , ?7,  ?8 , ?9 , ?10, ?11, ?12, ?13, ?14, ?15, ?16);"), _db)) {
+            "(phash, pathlen, path, inode, uid, gid, mode, modtime, type, md5, fileid, remotePerm, filesize, ignoredChildrenRemote, contentChecksum, contentChecksumTypeId, parentPhash) "
+            "VALUES (?1 , ?2, ?3 , ?4 , ?5 , ?6 , ?7,  ?8 , ?9 , ?10, ?11, ?12, ?13, ?14, ?15, ?16, ?17);"), _db)) {
             return false;
         }
 
-        _setFileRecordQuery.bindValue(1, phash);
-        _setFileRecordQuery.bindValue(2, plen);
-        _setFileRecordQuery.bindValue(3, record._path);
-        _setFileRecordQuery.bindValue(4, record._inode);
-        _setFileRecordQuery.bindValue(5, 0); // uid Not used
-        _setFileRecordQuery.bindValue(6, 0); // gid Not used
-        _setFileRecordQuery.bindValue(7, 0); // mode Not used
-        _setFileRecordQuery.bindValue(8, record._modtime);
-        _setFileRecordQuery.bindValue(9, record._type);
-        _setFileRecordQuery.bindValue(10, etag);
-        _setFileRecordQuery.bindValue(11, fileId);
-        _setFileRecordQuery.bindValue(12, remotePerm);
-        _setFileRecordQuery.bindValue(13, record._fileSize);
-        _setFileRecordQuery.bindValue(14, record._serverHasIgnoredFiles ? 1 : 0);
-        _setFileRecordQuery.bindValue(15, checksum);
-        _setFileRecordQuery.bindValue(16, contentChecksumTypeId);
+        _setFileRecordQuery.bindInt64(1, phash);
+        _setFileRecordQuery.bindInt64(2, plen);
+        _setFileRecordQuery.bindText(3, record._path);
+        _setFileRecordQuery.bindInt64(4, record._inode);
+        _setFileRecordQuery.bindInt64(5, 0); // uid Not used
+        _setFileRecordQuery.bindInt64(6, 0); // gid Not used
+        _setFileRecordQuery.bindInt64(7, 0); // mode Not used
+        _setFileRecordQuery.bindInt64(8, record._modtime);
+        _setFileRecordQuery.bindInt64(9, record._type);
+        _setFileRecordQuery.bindText(10, etag);
+        _setFileRecordQuery.bindText(11, fileId);
+        _setFileRecordQuery.bindText(12, remotePerm);
+        _setFileRecordQuery.bindInt64(13, record._fileSize);
+        _setFileRecordQuery.bindInt64(14, record._serverHasIgnoredFiles ? 1 : 0);
+        _setFileRecordQuery.bindText(15, checksum);
+        _setFileRecordQuery.bindInt64(16, contentChecksumTypeId);
+        _setFileRecordQuery.bindInt64(17, getParentPHash(record._path));
 
         if (!_setFileRecordQuery.exec()) {
             return false;
@@ -943,7 +1023,7 @@ bool SyncJournalDb::getFileRecord(const QByteArray &filename, SyncJournalFileRec
         if (!_getFileRecordQuery.initOrReset(QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE phash=?1"), _db))
             return false;
 
-        _getFileRecordQuery.bindValue(1, getPHash(filename));
+        _getFileRecordQuery.bindInt64(1, getPHash(filename));
 
         if (!_getFileRecordQuery.exec()) {
             close();
@@ -982,7 +1062,7 @@ bool SyncJournalDb::getFileRecordByInode(quint64 inode, SyncJournalFileRecord *r
     if (!_getFileRecordQueryByInode.initOrReset(QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE inode=?1"), _db))
         return false;
 
-    _getFileRecordQueryByInode.bindValue(1, inode);
+    _getFileRecordQueryByInode.bindInt64(1, inode);
 
     if (!_getFileRecordQueryByInode.exec())
         return false;
@@ -1006,7 +1086,7 @@ bool SyncJournalDb::getFileRecordsByFileId(const QByteArray &fileId, const std::
     if (!_getFileRecordQueryByFileId.initOrReset(QByteArrayLiteral(GET_FILE_RECORD_QUERY " WHERE fileid=?1"), _db))
         return false;
 
-    _getFileRecordQueryByFileId.bindValue(1, fileId);
+    _getFileRecordQueryByFileId.bindText(1, fileId);
 
     if (!_getFileRecordQueryByFileId.exec())
         return false;
@@ -1020,6 +1100,39 @@ bool SyncJournalDb::getFileRecordsByFileId(const QByteArray &fileId, const std::
     return true;
 }
 
+bool SyncJournalDb::getFileRecordsByChecksum(const QByteArray &checksumHeader, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
+{
+    QByteArray checksumType, checksum;
+    if (!parseChecksumHeader(checksumHeader, &checksumType, &checksum) || checksum.isEmpty())
+        return true; // no error, yet nothing found
+
+    QMutexLocker locker(&_mutex);
+
+    if (_metadataTableIsEmpty)
+        return true;
+
+    if (!checkConnect())
+        return false;
+
+    if (!_getFileRecordQueryByChecksum.initOrReset(QByteArrayLiteral(GET_FILE_RECORD_QUERY
+            " WHERE contentChecksum=?1 AND contentchecksumtype.name=?2"), _db))
+        return false;
+
+    _getFileRecordQueryByChecksum.bindValue(1, checksum);
+    _getFileRecordQueryByChecksum.bindValue(2, checksumType);
+
+    if (!_getFileRecordQueryByChecksum.exec())
+        return false;
+
+    while (_getFileRecordQueryByChecksum.next()) {
+        SyncJournalFileRecord rec;
+        fillFileRecordFromGetQuery(rec, _getFileRecordQueryByChecksum);
+        rowCallback(rec);
+    }
+
+    return true;
+}
+
 bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback)
 {
     QMutexLocker locker(&_mutex);
@@ -1056,7 +1169,7 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
             return false;
         }
         query = &_getFilesBelowPathQuery;
-        query->bindValue(1, path);
+        query->bindText(1, path);
     }
 
     if (!query->exec()) {
@@ -1072,8 +1185,75 @@ bool SyncJournalDb::getFilesBelowPath(const QByteArray &path, const std::functio
     return true;
 }
 
+int SyncJournalDb::getFilesAfterPath(const QByteArray &afterPath, int maxCount, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (_metadataTableIsEmpty)
+        return 0; // no error, yet nothing found
+
+    if (!checkConnect())
+        return -1;
+
+    // Unlike ORDER BY path||'/', this can step through the metadata_path index
+    if (!_getFilesAfterPathQuery.initOrReset(QByteArrayLiteral(
+            GET_FILE_RECORD_QUERY " WHERE path > ?1 ORDER BY path ASC LIMIT ?2"), _db)) {
+        return -1;
+    }
+    _getFilesAfterPathQuery.bindText(1, afterPath);
+    _getFilesAfterPathQuery.bindInt64(2, maxCount);
+
+    if (!_getFilesAfterPathQuery.exec()) {
+        return -1;
+    }
+
+    int count = 0;
+    while (_getFilesAfterPathQuery.next()) {
+        SyncJournalFileRecord rec;
+        fillFileRecordFromGetQuery(rec, _getFilesAfterPathQuery);
+        rowCallback(rec);
+        ++count;
+    }
+    return count;
+}
+
+bool SyncJournalDb::getFilesInDirectory(const QByteArray &path, const std::function<void(const SyncJournalFileRecord &)> &rowCallback)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (_metadataTableIsEmpty)
+        return true; // no error, yet nothing found
+
+    if (!checkConnect())
+        return false;
+
+    // The parentPhash index bounds this to the direct children
+    if (!_getFilesInDirectoryQuery.initOrReset(QByteArrayLiteral(
+            GET_FILE_RECORD_QUERY " WHERE parentPhash == ?1"), _db)) {
+        return false;
+    }
+    _getFilesInDirectoryQuery.bindInt64(1, getPHash(path));
+
+    if (!_getFilesInDirectoryQuery.exec()) {
+        return false;
+    }
+
+    while (_getFilesInDirectoryQuery.next()) {
+        SyncJournalFileRecord rec;
+        fillFileRecordFromGetQuery(rec, _getFilesInDirectoryQuery);
+        // Skip the records of other directories with the same hash
+        int slash = rec._path.lastIndexOf('/');
+        if ((slash == -1 ? QByteArray() : rec._path.left(slash)) != path)
+            continue;
+        rowCallback(rec);
+    }
+
+    return true;
+}
+
 bool SyncJournalDb::postSyncCleanup(const QSet<QString> &filepathsToKeep,
-    const QSet<QString> &prefixesToKeep)
+    const QSet<QString> &prefixesToKeep,
+    const QSet<QString> &subtreesToKeep)
 {
     QMutexLocker locker(&_mutex);
 
@@ -1101,6 +1281,13 @@ bool SyncJournalDb::postSyncCleanup(const QSet<QString> &filepathsToKeep,
                 }
             }
         }
+        if (!keep && !subtreesToKeep.isEmpty()) {
+            // Look up each parent directory
+            int slashPos = file.size();
+            while (!keep && (slashPos = file.lastIndexOf('/', slashPos - 1)) > 0) {
+                keep = subtreesToKeep.contains(file.left(slashPos));
+            }
+        }
         if (!keep) {
             superfluousItems.append(query.baValue(0));
         }
@@ -1886,6 +2073,196 @@ void SyncJournalDb::setDataFingerprint(const QByteArray &dataFingerprint)
     _setDataFingerprintQuery2.exec();
 }
 
+void SyncJournalDb::setLocalDiscoveryState(const LocalDiscoveryState &state)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return;
+    }
+
+    startTransaction();
+
+    SqlQuery query(_db);
+    query.prepare("DELETE FROM localdiscoverypaths;");
+    query.exec();
+    query.prepare("DELETE FROM localdiscoverystate;");
+    query.exec();
+
+    SqlQuery insQuery("INSERT INTO localdiscoverypaths (path) VALUES (?1);", _db);
+    for (const auto &path : state._paths) {
+        insQuery.reset_and_clear_bindings();
+        insQuery.bindValue(1, path);
+        if (!insQuery.exec()) {
+            qCWarning(lcDb) << "SQL error when saving local discovery path" << path << insQuery.error();
+        }
+    }
+
+    // Written last: only a complete state gets the marker
+    query.prepare("INSERT INTO localdiscoverystate (shutdownTime, lastFullDiscoveryTime) VALUES (?1, ?2);");
+    query.bindValue(1, state._shutdownTime);
+    query.bindValue(2, state._lastFullDiscoveryTime);
+    if (!query.exec()) {
+        qCWarning(lcDb) << "SQL error when saving local discovery state" << query.error();
+    }
+
+    commitInternal("setLocalDiscoveryState");
+}
+
+SyncJournalDb::LocalDiscoveryState SyncJournalDb::takeLocalDiscoveryState()
+{
+    LocalDiscoveryState state;
+
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return state;
+    }
+
+    SqlQuery query("SELECT shutdownTime, lastFullDiscoveryTime FROM localdiscoverystate;", _db);
+    if (!query.exec()) {
+        return state;
+    }
+    if (query.next()) {
+        state._shutdownTime = query.int64Value(0);
+        state._lastFullDiscoveryTime = query.int64Value(1);
+    }
+
+    if (state.isValid()) {
+        query.prepare("SELECT path FROM localdiscoverypaths;");
+        if (!query.exec()) {
+            return LocalDiscoveryState();
+        }
+        while (query.next()) {
+            state._paths.insert(query.baValue(0));
+        }
+    }
+
+    startTransaction();
+    query.prepare("DELETE FROM localdiscoverystate;");
+    query.exec();
+    query.prepare("DELETE FROM localdiscoverypaths;");
+    query.exec();
+    commitInternal("takeLocalDiscoveryState");
+
+    return state;
+}
+
+bool SyncJournalDb::createRemoteTreeSnapshotTable()
+{
+    SqlQuery createQuery(_db);
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS remotetreesnapshot("
+                        "generation INTEGER,"
+                        "valid INTEGER"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail("Create table remotetreesnapshot", createQuery);
+    }
+
+    createQuery.prepare("CREATE TABLE IF NOT EXISTS remotetreesnapshotchanges("
+                        "path TEXT PRIMARY KEY"
+                        ");");
+    if (!createQuery.exec()) {
+        return sqlFail("Create table remotetreesnapshotchanges", createQuery);
+    }
+
+    // Whatever changes the file records invalidates the remote tree snapshot.
+    // The paths are logged for updating the snapshot, once one was started.
+    struct MetadataEvent
+    {
+        const char *event;
+        QList<QByteArray> paths;
+    };
+    static const MetadataEvent metadataEvents[] = {
+        { "INSERT", { "new.path" } },
+        { "UPDATE", { "old.path", "new.path" } },
+        { "DELETE", { "old.path" } },
+    };
+    for (const auto &event : metadataEvents) {
+        QByteArray body = "UPDATE remotetreesnapshot SET valid = 0;";
+        for (const auto &path : event.paths) {
+            body += " INSERT OR IGNORE INTO remotetreesnapshotchanges (path) SELECT " + path + " FROM remotetreesnapshot;";
+        }
+        createQuery.prepare(QByteArray("CREATE TRIGGER IF NOT EXISTS remotetreesnapshot_on_")
+            + QByteArray(event.event).toLower() + " AFTER " + event.event + " ON metadata"
+            + " BEGIN " + body + " END;");
+        if (!createQuery.exec()) {
+            return sqlFail("Create trigger remotetreesnapshot", createQuery);
+        }
+    }
+    return true;
+}
+
+qint64 SyncJournalDb::remoteTreeSnapshotGeneration()
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return 0;
+    }
+
+    // The table only exists once a snapshot was written
+    if (tableColumns("remotetreesnapshot").isEmpty()) {
+        return 0;
+    }
+
+    SqlQuery query("SELECT generation FROM remotetreesnapshot WHERE valid;", _db);
+    if (!query.exec() || !query.next()) {
+        return 0;
+    }
+    return query.int64Value(0);
+}
+
+qint64 SyncJournalDb::startRemoteTreeSnapshotGeneration(qint64 baseGeneration, int maxChanges,
+    QVector<QByteArray> *changedPaths)
+{
+    QMutexLocker locker(&_mutex);
+    if (!checkConnect()) {
+        return 0;
+    }
+
+    // Not in the transaction, which would be left open when this fails
+    if (!createRemoteTreeSnapshotTable()) {
+        return 0;
+    }
+
+    // Increasing, so that an old snapshot file never matches
+    qint64 generation = QDateTime::currentMSecsSinceEpoch();
+
+    startTransaction();
+    SqlQuery query(_db);
+    if (changedPaths && maxChanges > 0) {
+        query.prepare("SELECT generation FROM remotetreesnapshot;");
+        if (query.exec() && query.next() && query.int64Value(0) == baseGeneration) {
+            // One more than allowed, to know whether there were too many
+            query.prepare("SELECT path FROM remotetreesnapshotchanges LIMIT ?1;");
+            query.bindInt64(1, maxChanges + 1);
+            if (query.exec()) {
+                while (query.next()) {
+                    changedPaths->append(query.baValue(0));
+                }
+            }
+            if (changedPaths->size() > maxChanges) {
+                changedPaths->clear();
+            }
+        }
+    }
+    query.prepare("DELETE FROM remotetreesnapshotchanges;");
+    query.exec();
+    query.prepare("DELETE FROM remotetreesnapshot;");
+    query.exec();
+    query.prepare("INSERT INTO remotetreesnapshot (generation, valid) VALUES (?1, 1);");
+    query.bindInt64(1, generation);
+    if (!query.exec()) {
+        qCWarning(lcDb) << "SQL error when starting a remote tree snapshot" << query.error();
+        generation = 0;
+    }
+    commitInternal("startRemoteTreeSnapshotGeneration");
+    return generation;
+}
+
+QString SyncJournalDb::remoteTreeSnapshotFilePath() const
+{
+    return databaseFilePath() + QLatin1String("-remotetree");
+}
+
 void SyncJournalDb::setConflictRecord(const ConflictRecord &record)
 {
     QMutexLocker locker(&_mutex);
@@ -2001,6 +2378,7 @@ void SyncJournalDb::commitIfNeededAndStartNewTransaction(const QString &context)
 void SyncJournalDb::commitInternal(const QString &context, bool startTrans)
 {
     qCDebug(lcDb) << "Transaction commit " << context << (startTrans ? "and starting new transaction" : "");
+    SyncTraceScope trace("journal", "journal commit", context);
     commitTransaction();
 
     if (startTrans) {
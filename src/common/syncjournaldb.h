@@ -24,6 +24,7 @@
 #include <QDateTime>
 #include <QHash>
 #include <functional>
+#include <set>
 
 #include "common/utility.h"
 #include "common/ownsql.h"
@@ -59,7 +60,19 @@ public:
     bool getFileRecord(const QByteArray &filename, SyncJournalFileRecord *rec);
     bool getFileRecordByInode(quint64 inode, SyncJournalFileRecord *rec);
     bool getFileRecordsByFileId(const QByteArray &fileId, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    /// All files whose content checksum matches checksumHeader, like "SHA1:abc"
+    bool getFileRecordsByChecksum(const QByteArray &checksumHeader, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
     bool getFilesBelowPath(const QByteArray &path, const std::function<void(const SyncJournalFileRecord&)> &rowCallback);
+    /// Like getFilesBelowPath, but only for the direct children of path, in no particular order
+    bool getFilesInDirectory(const QByteArray &path, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
+    /**
+     * Up to maxCount records with a path greater than afterPath, ordered by path
+     * (not like getFilesBelowPath). Reading the whole table in such chunks
+     * doesn't block the other functions for the full scan.
+     *
+     * Returns the number of records, -1 on error.
+     */
+    int getFilesAfterPath(const QByteArray &afterPath, int maxCount, const std::function<void(const SyncJournalFileRecord &)> &rowCallback);
     bool setFileRecord(const SyncJournalFileRecord &record);
 
     /// Like setFileRecord, but preserves checksums
@@ -195,8 +208,15 @@ public:
      */
     void forceRemoteDiscoveryNextSync();
 
+    /**
+     * Deletes all file records that are not kept.
+     *
+     * A record is kept if its path is in filepathsToKeep, starts with one
+     * of prefixesToKeep or is below one of the directories in subtreesToKeep.
+     */
     bool postSyncCleanup(const QSet<QString> &filepathsToKeep,
-        const QSet<QString> &prefixesToKeep);
+        const QSet<QString> &prefixesToKeep,
+        const QSet<QString> &subtreesToKeep = QSet<QString>());
 
     /* Because sqlite transactions are really slow, we encapsulate everything in big transactions
      * Commit will actually commit the transaction and create a new one.
@@ -222,6 +242,60 @@ public:
     void setDataFingerprint(const QByteArray &dataFingerprint);
     QByteArray dataFingerprint();
 
+    /**
+     * Local discovery state saved on a clean shutdown
+     *
+     * Allows the next start to skip the full local discovery, see
+     * Folder::saveLocalDiscoveryState().
+     */
+    struct LocalDiscoveryState
+    {
+        /// msecs since epoch, 0 if no state was saved
+        qint64 _shutdownTime = 0;
+        /// msecs since epoch of the last successful full local discovery
+        qint64 _lastFullDiscoveryTime = 0;
+        /// paths that were still dirty, see LocalDiscoveryTracker
+        std::set<QByteArray> _paths;
+
+        bool isValid() const { return _shutdownTime > 0; }
+    };
+
+    void setLocalDiscoveryState(const LocalDiscoveryState &state);
+
+    /**
+     * Returns the saved state and removes it from the database.
+     *
+     * The state is consumed so that it can't be reused after an unclean
+     * shutdown that happens later on.
+     */
+    LocalDiscoveryState takeLocalDiscoveryState();
+
+    /**
+     * Generation of the valid remote tree snapshot, 0 if there is none.
+     * The table and the triggers only exist once a snapshot was started.
+     *
+     * Any change to the file records invalidates the generation (this is
+     * done by triggers), so a snapshot file with this generation is known to
+     * contain the same records as the metadata table. See RemoteTreeSnapshot.
+     */
+    qint64 remoteTreeSnapshotGeneration();
+
+    /**
+     * Starts a new remote tree snapshot generation and returns it.
+     *
+     * The snapshot must be written after this call. Returns 0 on error.
+     *
+     * The paths of the records that changed since the last start are logged.
+     * If that generation was baseGeneration and no more than maxChanges paths
+     * were logged, they are stored in changedPaths, so that the snapshot of
+     * baseGeneration can be updated instead of being written from scratch.
+     */
+    qint64 startRemoteTreeSnapshotGeneration(qint64 baseGeneration = 0, int maxChanges = 0,
+        QVector<QByteArray> *changedPaths = nullptr);
+
+    /// Where the remote tree snapshot is stored, next to the database
+    QString remoteTreeSnapshotFilePath() const;
+
 
     // Conflict record functions
 
@@ -263,6 +337,10 @@ private:
     QVector<QByteArray> tableColumns(const QByteArray &table);
     bool checkConnect();
 
+    // The remotetreesnapshot table and its triggers on metadata, only
+    // created once the remote tree snapshot is used
+    bool createRemoteTreeSnapshotTable();
+
     // Same as forceRemoteDiscoveryNextSync but without acquiring the lock
     void forceRemoteDiscoveryNextSyncLocked();
 
@@ -280,8 +358,11 @@ private:
     SqlQuery _getFileRecordQuery;
     SqlQuery _getFileRecordQueryByInode;
     SqlQuery _getFileRecordQueryByFileId;
+    SqlQuery _getFileRecordQueryByChecksum;
     SqlQuery _getFilesBelowPathQuery;
     SqlQuery _getAllFilesQuery;
+    SqlQuery _getFilesInDirectoryQuery;
+    SqlQuery _getFilesAfterPathQuery;
     SqlQuery _setFileRecordQuery;
     SqlQuery _setFileRecordChecksumQuery;
     SqlQuery _setFileRecordLocalMetadataQuery;
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "synctrace.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThread>
+
+#include <vector>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcSyncTrace, "sync.trace", QtInfoMsg)
+
+std::atomic<bool> SyncTrace::_enabled(!qEnvironmentVariableIsEmpty("OWNCLOUD_SYNC_TRACE"));
+
+namespace {
+    struct Event
+    {
+        const char *category;
+        const char *name;
+        QString detail;
+        qint64 start;
+        qint64 duration;
+        bool async;
+    };
+
+    // Readers only look at the first count events and follow next once it is set
+    struct Chunk
+    {
+        static const int capacity = 1024;
+        Event events[capacity];
+        std::atomic<int> count{ 0 };
+        std::atomic<Chunk *> next{ nullptr };
+    };
+
+    struct ThreadBuffer
+    {
+        int threadId;
+        QString threadName;
+        Chunk *first;
+        Chunk *last; // only used by the owning thread
+    };
+
+    // Buffers are never freed, they are registered once per thread
+    QMutex buffersMutex;
+    std::vector<ThreadBuffer *> buffers;
+    thread_local ThreadBuffer *threadBuffer = nullptr;
+
+    ThreadBuffer *currentThreadBuffer()
+    {
+        if (!threadBuffer) {
+            auto buffer = new ThreadBuffer;
+            auto thread = QThread::currentThread();
+            buffer->threadName = thread->objectName();
+            if (buffer->threadName.isEmpty() && QCoreApplication::instance()
+                && thread == QCoreApplication::instance()->thread()) {
+                buffer->threadName = QStringLiteral("main");
+            }
+            buffer->first = buffer->last = new Chunk;
+
+            QMutexLocker lock(&buffersMutex);
+            buffer->threadId = int(buffers.size()) + 1;
+            if (buffer->threadName.isEmpty())
+                buffer->threadName = QStringLiteral("thread %1").arg(buffer->threadId);
+            buffers.push_back(buffer);
+            threadBuffer = buffer;
+        }
+        return threadBuffer;
+    }
+
+    void appendJsonString(QByteArray &out, const QString &string)
+    {
+        out += '"';
+        for (char c : string.toUtf8()) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (uchar(c) < 0x20) {
+                out += "\\u00";
+                out += QByteArray::number(uchar(c), 16).rightJustified(2, '0');
+            } else {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+
+    void appendEvent(QByteArray &out, const Event &event, char phase, qint64 timestamp,
+        int threadId, qint64 pid, qint64 asyncId, bool withDetail)
+    {
+        out += ",\n{\"name\":";
+        appendJsonString(out, QString::fromUtf8(event.name));
+        out += ",\"cat\":";
+        appendJsonString(out, QString::fromUtf8(event.category));
+        out += ",\"ph\":\"";
+        out += phase;
+        out += "\",\"ts\":" + QByteArray::number(timestamp);
+        if (phase == 'X')
+            out += ",\"dur\":" + QByteArray::number(event.duration);
+        if (asyncId)
+            out += ",\"id\":" + QByteArray::number(asyncId);
+        out += ",\"pid\":" + QByteArray::number(pid) + ",\"tid\":" + QByteArray::number(threadId);
+        if (withDetail && !event.detail.isEmpty()) {
+            out += ",\"args\":{\"detail\":";
+            appendJsonString(out, event.detail);
+            out += '}';
+        }
+        out += '}';
+    }
+}
+
+void SyncTrace::setEnabled(bool enabled)
+{
+    _enabled.store(enabled, std::memory_order_relaxed);
+}
+
+QString SyncTrace::fileFromEnvironment()
+{
+    return QString::fromLocal8Bit(qgetenv("OWNCLOUD_SYNC_TRACE"));
+}
+
+qint64 SyncTrace::now()
+{
+    static const QElapsedTimer clock = [] {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return clock.nsecsElapsed() / 1000;
+}
+
+void SyncTrace::addSpan(const char *category, const char *name, qint64 start, const QString &detail, bool async)
+{
+    if (!isEnabled())
+        return;
+    const qint64 end = now();
+
+    ThreadBuffer *buffer = currentThreadBuffer();
+    Chunk *chunk = buffer->last;
+    int index = chunk->count.load(std::memory_order_relaxed);
+    if (index == Chunk::capacity) {
+        auto next = new Chunk;
+        chunk->next.store(next, std::memory_order_release);
+        buffer->last = chunk = next;
+        index = 0;
+    }
+    Event &event = chunk->events[index];
+    event.category = category;
+    event.name = name;
+    event.detail = detail;
+    event.start = start;
+    event.duration = end - start;
+    event.async = async;
+    chunk->count.store(index + 1, std::memory_order_release);
+}
+
+QByteArray SyncTrace::chromeTrace()
+{
+    std::vector<ThreadBuffer *> snapshot;
+    {
+        QMutexLocker lock(&buffersMutex);
+        snapshot = buffers;
+    }
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    qint64 asyncId = 0;
+    QByteArray out = "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":"
+        + QByteArray::number(pid) + ",\"args\":{\"name\":";
+    appendJsonString(out, QCoreApplication::applicationName());
+    out += "}}";
+
+    for (const ThreadBuffer *buffer : snapshot) {
+        out += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + QByteArray::number(pid)
+            + ",\"tid\":" + QByteArray::number(buffer->threadId) + ",\"args\":{\"name\":";
+        appendJsonString(out, buffer->threadName);
+        out += "}}";
+
+        for (const Chunk *chunk = buffer->first; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            const int count = chunk->count.load(std::memory_order_acquire);
+            for (int i = 0; i < count; ++i) {
+                const Event &event = chunk->events[i];
+                if (event.async) {
+                    ++asyncId;
+                    appendEvent(out, event, 'b', event.start, buffer->threadId, pid, asyncId, true);
+                    appendEvent(out, event, 'e', event.start + event.duration, buffer->threadId, pid, asyncId, false);
+                } else {
+                    appendEvent(out, event, 'X', event.start, buffer->threadId, pid, 0, true);
+                }
+            }
+        }
+    }
+    out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return out;
+}
+
+bool SyncTrace::writeChromeTrace(const QString &fileName)
+{
+    QSaveFile file(fileName);
+    const QByteArray trace = chromeTrace();
+    if (!file.open(QIODevice::WriteOnly) || file.write(trace) != trace.size() || !file.commit()) {
+        qCWarning(lcSyncTrace) << "Could not write the trace to" << fileName << file.errorString();
+        return false;
+    }
+    qCInfo(lcSyncTrace) << "Wrote the trace to" << fileName;
+    return true;
+}
+}
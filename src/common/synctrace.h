@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#pragma once
+
+#include "ocsynclib.h"
+
+#include <QByteArray>
+#include <QString>
+
+#include <atomic>
+
+namespace OCC {
+
+/**
+ * @brief Timed spans of the sync phases, exported as Chrome trace events
+ * @ingroup libsync
+ *
+ * Tracing is off unless setEnabled() was called or the OWNCLOUD_SYNC_TRACE
+ * environment variable is set. That variable names the file SyncEngine
+ * writes the trace to after every sync. While tracing is off, a span costs
+ * an atomic load.
+ *
+ * Every thread appends to its own buffer without locking. The buffers only
+ * grow while tracing is on: this is for looking at a few syncs, not for
+ * leaving it on all the time.
+ *
+ * The written file can be opened in chrome://tracing or ui.perfetto.dev.
+ */
+class OCSYNC_EXPORT SyncTrace
+{
+public:
+    static bool isEnabled() { return _enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    /// The value of OWNCLOUD_SYNC_TRACE
+    static QString fileFromEnvironment();
+
+    /// Microseconds on the trace's clock
+    static qint64 now();
+
+    /**
+     * Records a span from start until now on the current thread.
+     *
+     * name and category must be string literals or otherwise outlive the
+     * trace. Spans that overlap others on the same thread instead of
+     * nesting, like network jobs, must be async.
+     */
+    static void addSpan(const char *category, const char *name, qint64 start,
+        const QString &detail = QString(), bool async = false);
+
+    /// The spans of all threads in the Chrome trace event JSON format
+    static QByteArray chromeTrace();
+    static bool writeChromeTrace(const QString &fileName);
+
+private:
+    static std::atomic<bool> _enabled;
+};
+
+/**
+ * @brief Records a span from construction to destruction
+ * @ingroup libsync
+ */
+class OCSYNC_EXPORT SyncTraceScope
+{
+public:
+    SyncTraceScope(const char *category, const char *name, const QString &detail = QString())
+        : _category(category)
+        , _name(name)
+    {
+        if (SyncTrace::isEnabled()) {
+            _detail = detail;
+            _start = SyncTrace::now();
+        }
+    }
+
+    ~SyncTraceScope()
+    {
+        if (_start >= 0)
+            SyncTrace::addSpan(_category, _name, _start, _detail);
+    }
+
+private:
+    Q_DISABLE_COPY(SyncTraceScope)
+
+    const char *_category;
+    const char *_name;
+    QString _detail;
+    qint64 _start = -1;
+};
+}
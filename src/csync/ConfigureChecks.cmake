@@ -52,4 +52,16 @@ if (WIN32)
   check_function_exists(__mingw_asprintf HAVE___MINGW_ASPRINTF)
 endif(WIN32)
 
+if (LINUX)
+  # statx through io_uring needs the kernel headers of Linux 5.6
+  check_cxx_source_compiles("
+    #include <linux/io_uring.h>
+    #include <sys/stat.h>
+    int main() {
+        struct io_uring_sqe sqe;
+        sqe.statx_flags = 0;
+        return IORING_OP_STATX + STATX_MTIME;
+    }" HAVE_IO_URING_STATX)
+endif (LINUX)
+
 set(CSYNC_REQUIRED_LIBRARIES ${CMAKE_REQUIRED_LIBRARIES} CACHE INTERNAL "csync required system libraries")
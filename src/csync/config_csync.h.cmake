@@ -13,6 +13,7 @@
 #cmakedefine HAVE_UTIMES 1
 #cmakedefine HAVE_LSTAT 1
 #cmakedefine HAVE_FNMATCH 1
+#cmakedefine HAVE_IO_URING_STATX 1
 
 #cmakedefine HAVE___MINGW_ASPRINTF 1
 #cmakedefine HAVE_ASPRINTF 1
@@ -48,6 +48,11 @@
 #include "csync_rename.h"
 #include "common/c_jhash.h"
 #include "common/syncjournalfilerecord.h"
+#include "common/synctrace.h"
+
+#include <QFuture>
+#include <QThread>
+#include <qtconcurrentrun.h>
 
 Q_LOGGING_CATEGORY(lcCSync, "sync.csync.csync", QtInfoMsg)
 
@@ -88,7 +93,10 @@ int csync_update(CSYNC *ctx) {
 
   qCInfo(lcCSync, "## Starting local discovery ##");
 
-  rc = csync_ftw(ctx, ctx->local.uri, csync_walker, MAX_DEPTH);
+  {
+    OCC::SyncTraceScope trace("discovery", "local discovery", QString::fromUtf8(ctx->local.uri));
+    rc = csync_ftw(ctx, ctx->local.uri, csync_walker, MAX_DEPTH);
+  }
   if (rc < 0) {
     if(ctx->status_code == CSYNC_STATUS_OK) {
         ctx->status_code = csync_errno_to_status(errno, CSYNC_STATUS_UPDATE_ERROR);
@@ -106,7 +114,11 @@ int csync_update(CSYNC *ctx) {
 
   qCInfo(lcCSync, "## Starting remote discovery ##");
 
-  rc = csync_ftw(ctx, "", csync_walker, MAX_DEPTH);
+  {
+    // The PROPFINDs it waits for are traced separately by the discovery jobs
+    OCC::SyncTraceScope trace("discovery", "remote discovery");
+    rc = csync_ftw(ctx, "", csync_walker, MAX_DEPTH);
+  }
   if (rc < 0) {
       if(ctx->status_code == CSYNC_STATUS_OK) {
           ctx->status_code = csync_errno_to_status(errno, CSYNC_STATUS_UPDATE_ERROR);
@@ -135,6 +147,9 @@ int csync_reconcile(CSYNC *ctx) {
 
   ctx->current = LOCAL_REPLICA;
 
+  csync_reconcile_mark_clean_subtrees(ctx);
+  qCInfo(lcCSync) << "Skipping" << ctx->clean_subtrees.size() << "subtrees that are unchanged on both replicas";
+
   csync_reconcile_updates(ctx);
 
   qCInfo(lcCSync) << "Reconciliation for local replica took " << timer.elapsed() / 1000.
@@ -147,6 +162,8 @@ int csync_reconcile(CSYNC *ctx) {
 
   csync_reconcile_updates(ctx);
 
+  csync_reconcile_check_clean_subtrees(ctx);
+
   qCInfo(lcCSync) << "Reconciliation for remote replica took " << timer.elapsed() / 1000.
                   << "seconds visiting " << ctx->remote.files.size() << " files.";
 
@@ -155,23 +172,9 @@ int csync_reconcile(CSYNC *ctx) {
 }
 
 /*
- * local visitor which calls the user visitor with repacked stat info.
+ * Finds the entry of the other tree that corresponds to cur. Only reads the trees.
  */
-static int _csync_treewalk_visitor(csync_file_stat_t *cur, CSYNC * ctx, const csync_treewalk_visit_func &visitor) {
-    csync_s::FileMap *other_tree = nullptr;
-
-    /* we need the opposite tree! */
-    switch (ctx->current) {
-    case LOCAL_REPLICA:
-        other_tree = &ctx->remote.files;
-        break;
-    case REMOTE_REPLICA:
-        other_tree = &ctx->local.files;
-        break;
-    default:
-        break;
-    }
-
+static csync_file_stat_t *_csync_treewalk_find_other(csync_file_stat_t *cur, CSYNC *ctx, const csync_s::FileMap *other_tree) {
     csync_s::FileMap::const_iterator other_file_it = other_tree->find(cur->path);
 
     if (other_file_it == other_tree->cend()) {
@@ -188,8 +191,13 @@ static int _csync_treewalk_visitor(csync_file_stat_t *cur, CSYNC * ctx, const cs
             other_file_it = other_tree->find(renamed_path);
     }
 
-    csync_file_stat_t *other = (other_file_it != other_tree->cend()) ? other_file_it->second.get() : NULL;
+    return (other_file_it != other_tree->cend()) ? other_file_it->second.get() : NULL;
+}
 
+/*
+ * local visitor which calls the user visitor with repacked stat info.
+ */
+static int _csync_treewalk_visitor(csync_file_stat_t *cur, csync_file_stat_t *other, CSYNC * ctx, const csync_treewalk_visit_func &visitor) {
     ctx->status_code = CSYNC_STATUS_OK;
 
     Q_ASSERT(visitor);
@@ -199,10 +207,48 @@ static int _csync_treewalk_visitor(csync_file_stat_t *cur, CSYNC * ctx, const cs
 /*
  * treewalk function, called from its wrappers below.
  */
-static int _csync_walk_tree(CSYNC *ctx, csync_s::FileMap &tree, const csync_treewalk_visit_func &visitor)
+static int _csync_walk_tree(CSYNC *ctx, csync_s::FileMap &tree, const csync_s::FileMap &other_tree, const csync_treewalk_visit_func &visitor)
 {
+    if (!ctx->parallel_reconcile) {
+        for (auto &pair : tree) {
+            // Everything below ctx->clean_subtrees is unchanged on both sides
+            if (pair.second->in_clean_subtree)
+                continue;
+            csync_file_stat_t *other = _csync_treewalk_find_other(pair.second.get(), ctx, &other_tree);
+            if (_csync_treewalk_visitor(pair.second.get(), other, ctx, visitor) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    // The lookups in the other tree don't depend on each other: do them on the
+    // thread pool, each thread on its own range. The visitor still runs in tree order.
+    std::vector<csync_file_stat_t *> entries;
+    entries.reserve(tree.size());
     for (auto &pair : tree) {
-        if (_csync_treewalk_visitor(pair.second.get(), ctx, visitor) < 0) {
+        if (!pair.second->in_clean_subtree)
+            entries.push_back(pair.second.get());
+    }
+    std::vector<csync_file_stat_t *> others(entries.size(), nullptr);
+
+    const size_t threadCount = qMax(1, QThread::idealThreadCount());
+    const size_t chunkSize = (entries.size() + threadCount - 1) / threadCount;
+    QVector<QFuture<void>> futures;
+    for (size_t begin = 0; begin < entries.size(); begin += chunkSize) {
+        const size_t end = qMin(begin + chunkSize, entries.size());
+        futures.append(QtConcurrent::run([&, begin, end]() {
+            for (size_t i = begin; i < end; ++i) {
+                others[i] = _csync_treewalk_find_other(entries[i], ctx, &other_tree);
+            }
+        }));
+    }
+    for (auto &future : futures) {
+        future.waitForFinished();
+    }
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (_csync_treewalk_visitor(entries[i], others[i], ctx, visitor) < 0) {
             return -1;
         }
     }
@@ -216,7 +262,7 @@ int csync_walk_remote_tree(CSYNC *ctx, const csync_treewalk_visit_func &visitor)
 {
     ctx->status_code = CSYNC_STATUS_OK;
     ctx->current = REMOTE_REPLICA;
-    return _csync_walk_tree(ctx, ctx->remote.files, visitor);
+    return _csync_walk_tree(ctx, ctx->remote.files, ctx->local.files, visitor);
 }
 
 /*
@@ -226,7 +272,7 @@ int csync_walk_local_tree(CSYNC *ctx, const csync_treewalk_visit_func &visitor)
 {
     ctx->status_code = CSYNC_STATUS_OK;
     ctx->current = LOCAL_REPLICA;
-    return _csync_walk_tree(ctx, ctx->local.files, visitor);
+    return _csync_walk_tree(ctx, ctx->local.files, ctx->remote.files, visitor);
 }
 
 int csync_s::reinitialize() {
@@ -235,10 +281,14 @@ int csync_s::reinitialize() {
   status_code = CSYNC_STATUS_OK;
 
   remote.read_from_db = 0;
+  remote.snapshot = nullptr;
   read_remote_from_db = true;
 
   local.files.clear();
   remote.files.clear();
+  local.db_subtrees.clear();
+  remote.db_subtrees.clear();
+  clean_subtrees.clear();
 
   renames.folder_renamed_from.clear();
   renames.folder_renamed_to.clear();
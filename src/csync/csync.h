@@ -160,6 +160,7 @@ struct OCSYNC_EXPORT csync_file_stat_s {
   bool child_modified BITFIELD(1);
   bool has_ignored_files BITFIELD(1); // Specify that a directory, or child directory contains ignored files.
   bool is_hidden BITFIELD(1); // Not saved in the DB, only used during discovery for local files.
+  bool in_clean_subtree BITFIELD(1); // Unchanged on both replicas, skipped by reconcile and treewalk. See csync_s::clean_subtrees
 
   QByteArray path;
   QByteArray rename_path;
@@ -187,6 +188,7 @@ struct OCSYNC_EXPORT csync_file_stat_s {
     , child_modified(false)
     , has_ignored_files(false)
     , is_hidden(false)
+    , in_clean_subtree(false)
     , error_status(CSYNC_STATUS_OK)
     , instruction(CSYNC_INSTRUCTION_NONE)
   { }
@@ -290,6 +292,8 @@ using csync_treewalk_visit_func = std::function<int(csync_file_stat_t *cur, csyn
 /**
  * @brief Walk the local file tree and call a visitor function for each file.
  *
+ * Entries below the directories in ctx->clean_subtrees are not visited.
+ *
  * @param ctx           The csync context.
  * @param visitor       A callback function to handle the file info.
  *
@@ -300,6 +304,8 @@ int OCSYNC_EXPORT csync_walk_local_tree(CSYNC *ctx, const csync_treewalk_visit_f
 /**
  * @brief Walk the remote file tree and call a visitor function for each file.
  *
+ * Entries below the directories in ctx->clean_subtrees are not visited.
+ *
  * @param ctx           The csync context.
  * @param visitor       A callback function to handle the file info.
  *
@@ -38,9 +38,11 @@
 #include <stdbool.h>
 #include <map>
 #include <set>
+#include <vector>
 #include <functional>
 
 #include "common/syncjournaldb.h"
+#include "common/remotetreesnapshot.h"
 #include "config_csync.h"
 #include "std/c_lib.h"
 #include "std/c_private.h"
@@ -154,6 +156,29 @@ struct OCSYNC_EXPORT csync_s {
    */
   std::function<CSYNC_EXCLUDE_TYPE(const char *path, ItemType filetype)> exclude_traversal_fn;
 
+  /**
+   * A directory whose contents were filled from the db by fill_tree_from_db().
+   */
+  struct DbSubtree {
+      std::vector<csync_file_stat_t *> entries; // in the order of the db query, owned by the FileMap
+      bool pure = true; // false if any record was skipped or is not a plain unchanged file or directory
+  };
+  typedef std::map<QByteArray, DbSubtree> DbSubtreeMap;
+
+  /**
+   * A directory that was filled with the same records from the db on both
+   * replicas and is unchanged on both sides.
+   *
+   * Reconcile and the treewalk skip the entries below it: they would only
+   * pair each unchanged entry with the unchanged entry of the same path.
+   * Users of the treewalk must treat everything below path as seen.
+   */
+  struct CleanSubtree {
+      QByteArray path;
+      bool has_files;
+  };
+  std::vector<CleanSubtree> clean_subtrees;
+
   struct {
     std::unordered_map<ByteArrayRef, QByteArray, ByteArrayRefHash> folder_renamed_to; // map from->to
     std::unordered_map<ByteArrayRef, QByteArray, ByteArrayRefHash> folder_renamed_from; // map to->from
@@ -162,12 +187,17 @@ struct OCSYNC_EXPORT csync_s {
   struct {
     char *uri = nullptr;
     FileMap files;
+    DbSubtreeMap db_subtrees;
   } local;
 
   struct {
     FileMap files;
+    DbSubtreeMap db_subtrees;
     bool read_from_db = false;
     OCC::RemotePermissions root_perms; /* Permission of the root folder. (Since the root folder is not in the db tree, we need to keep a separate entry.) */
+    /* If set, unchanged subtrees are read from it instead of the db, as long as its
+     * generation matches the db. Owned by the SyncEngine. */
+    OCC::RemoteTreeSnapshot *snapshot = nullptr;
   } remote;
 
   /* replica we are currently walking */
@@ -199,6 +229,13 @@ struct OCSYNC_EXPORT csync_s {
 
   bool upload_conflict_files = false;
 
+  /**
+   * Whether reconcile and the treewalk may use the global thread pool.
+   *
+   * See csync_reconcile_updates().
+   */
+  bool parallel_reconcile = false;
+
   /**
    * Whether new remote files should start out as virtual.
    */
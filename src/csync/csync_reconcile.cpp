@@ -29,7 +29,12 @@
 #include "common/asserts.h"
 #include "common/syncjournalfilerecord.h"
 
+#include <algorithm>
+
+#include <QFuture>
 #include <QLoggingCategory>
+#include <QThread>
+#include <qtconcurrentrun.h>
 Q_LOGGING_CATEGORY(lcReconcile, "sync.csync.reconciler", QtInfoMsg)
 
 // Needed for PRIu64 on MinGW in C++ mode.
@@ -508,22 +513,183 @@ static void _csync_merge_algorithm_visitor(csync_file_stat_t *cur, CSYNC * ctx)
     }
 }
 
+/* Whether reconciling cur only reads and writes cur and the entry of the
+ * same path in the other tree. Virtual files are excluded because they look
+ * at entries with and without the suffix. */
+static bool _csync_reconcile_is_self_contained(csync_file_stat_t *cur, const csync_s::FileMap *other_tree)
+{
+    csync_file_stat_t *other = other_tree->findFile(cur->path);
+    if (!other) {
+        return false;
+    }
+    auto isVirtual = [](const csync_file_stat_t *fs) {
+        return fs->type == ItemTypeVirtualFile || fs->type == ItemTypeVirtualFileDownload;
+    };
+    return !isVirtual(cur) && !isVirtual(other);
+}
+
+/* Runs the visitor for all the self contained entries on the thread pool.
+ * Returns the remaining entries, in tree order. */
+static std::vector<csync_file_stat_t *> _csync_reconcile_parallel(CSYNC *ctx, csync_s::FileMap *tree, const csync_s::FileMap *other_tree)
+{
+    std::vector<csync_file_stat_t *> sequential;
+    std::vector<std::vector<csync_file_stat_t *>> partitions;
+    QHash<QByteArray, size_t> partitionIndex;
+
+    /* Partition by the top level directory, everything else stays in tree order */
+    for (auto &pair : *tree) {
+        csync_file_stat_t *cur = pair.second.get();
+        if (cur->in_clean_subtree && cur->instruction == CSYNC_INSTRUCTION_NONE) {
+            continue;
+        }
+        if (!_csync_reconcile_is_self_contained(cur, other_tree)) {
+            sequential.push_back(cur);
+            continue;
+        }
+        const QByteArray topLevel = cur->path.left(cur->path.indexOf('/'));
+        auto it = partitionIndex.find(topLevel);
+        if (it == partitionIndex.end()) {
+            it = partitionIndex.insert(topLevel, partitions.size());
+            partitions.emplace_back();
+        }
+        partitions[*it].push_back(cur);
+    }
+
+    /* Spread the partitions over the threads, biggest first */
+    std::vector<size_t> order(partitions.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return partitions[a].size() > partitions[b].size();
+    });
+    const size_t threadCount = qMax(1, QThread::idealThreadCount());
+    std::vector<std::vector<size_t>> buckets(qMin(threadCount, partitions.size()));
+    std::vector<size_t> bucketLoad(buckets.size(), 0);
+    for (size_t index : order) {
+        size_t bucket = std::min_element(bucketLoad.begin(), bucketLoad.end()) - bucketLoad.begin();
+        buckets[bucket].push_back(index);
+        bucketLoad[bucket] += partitions[index].size();
+    }
+
+    QVector<QFuture<void>> futures;
+    for (const auto &bucket : buckets) {
+        futures.append(QtConcurrent::run([ctx, &partitions, &bucket]() {
+            for (size_t index : bucket) {
+                for (csync_file_stat_t *cur : partitions[index]) {
+                    _csync_merge_algorithm_visitor(cur, ctx);
+                }
+            }
+        }));
+    }
+    for (auto &future : futures) {
+        future.waitForFinished();
+    }
+
+    return sequential;
+}
+
 void csync_reconcile_updates(CSYNC *ctx) {
   csync_s::FileMap *tree = nullptr;
+  csync_s::FileMap *other_tree = nullptr;
 
   switch (ctx->current) {
     case LOCAL_REPLICA:
       tree = &ctx->local.files;
+      other_tree = &ctx->remote.files;
       break;
     case REMOTE_REPLICA:
       tree = &ctx->remote.files;
+      other_tree = &ctx->local.files;
       break;
     default:
       break;
   }
 
+  /* Entries that have a non virtual partner of the same path only touch
+   * that pair, so they can be reconciled concurrently. Without directory
+   * renames, the remaining entries only touch entries that no pair touches:
+   * reconciling them afterwards gives the same result.
+   */
+  if (ctx->parallel_reconcile && ctx->renames.folder_renamed_to.empty()) {
+    for (csync_file_stat_t *cur : _csync_reconcile_parallel(ctx, tree, other_tree)) {
+      _csync_merge_algorithm_visitor(cur, ctx);
+    }
+    return;
+  }
+
   for (auto &pair : *tree) {
-    _csync_merge_algorithm_visitor(pair.second.get(), ctx);
+    csync_file_stat_t *cur = pair.second.get();
+    /* Unchanged and paired with an unchanged entry: nothing to reconcile */
+    if (cur->in_clean_subtree && cur->instruction == CSYNC_INSTRUCTION_NONE) {
+      continue;
+    }
+    _csync_merge_algorithm_visitor(cur, ctx);
+  }
+}
+
+void csync_reconcile_mark_clean_subtrees(CSYNC *ctx) {
+  ctx->clean_subtrees.clear();
+
+  for (const auto &localIt : ctx->local.db_subtrees) {
+    const QByteArray &path = localIt.first;
+    const csync_s::DbSubtree &local = localIt.second;
+    auto remoteIt = ctx->remote.db_subtrees.find(path);
+    if (path.isEmpty() || remoteIt == ctx->remote.db_subtrees.end()) {
+      continue;
+    }
+    const csync_s::DbSubtree &remote = remoteIt->second;
+    if (!local.pure || !remote.pure || local.entries.size() != remote.entries.size()) {
+      continue;
+    }
+
+    /* The directory itself is reconciled normally, but must be unchanged */
+    csync_file_stat_t *localDir = ctx->local.files.findFile(path);
+    csync_file_stat_t *remoteDir = ctx->remote.files.findFile(path);
+    if (!localDir || !remoteDir
+        || localDir->type != ItemTypeDirectory || remoteDir->type != ItemTypeDirectory
+        || localDir->instruction != CSYNC_INSTRUCTION_NONE
+        || remoteDir->instruction != CSYNC_INSTRUCTION_NONE) {
+      continue;
+    }
+
+    /* Both were filled by the same query, but the db may have changed in between */
+    bool same = std::equal(local.entries.begin(), local.entries.end(), remote.entries.begin(),
+        [](const csync_file_stat_t *a, const csync_file_stat_t *b) {
+            return a->path == b->path && a->type == b->type;
+        });
+    if (!same) {
+      continue;
+    }
+
+    bool hasFiles = false;
+    for (size_t i = 0; i < local.entries.size(); ++i) {
+      local.entries[i]->in_clean_subtree = true;
+      remote.entries[i]->in_clean_subtree = true;
+      hasFiles = hasFiles || local.entries[i]->type == ItemTypeFile;
+    }
+    ctx->clean_subtrees.push_back({ path, hasFiles });
+  }
+}
+
+void csync_reconcile_check_clean_subtrees(CSYNC *ctx) {
+  for (auto &clean : ctx->clean_subtrees) {
+    const csync_s::DbSubtree &local = ctx->local.db_subtrees[clean.path];
+    const csync_s::DbSubtree &remote = ctx->remote.db_subtrees[clean.path];
+
+    clean.has_files = false;
+    for (size_t i = 0; i < local.entries.size(); ++i) {
+      csync_file_stat_t *localEntry = local.entries[i];
+      csync_file_stat_t *remoteEntry = remote.entries[i];
+      if (localEntry->instruction != CSYNC_INSTRUCTION_NONE
+          || remoteEntry->instruction != CSYNC_INSTRUCTION_NONE) {
+        qCInfo(lcReconcile, "%s was changed by reconcile, walking it", localEntry->path.constData());
+        localEntry->in_clean_subtree = false;
+        remoteEntry->in_clean_subtree = false;
+      } else if (localEntry->type == ItemTypeFile) {
+        clean.has_files = true;
+      }
+    }
   }
 }
 
@@ -50,6 +50,27 @@
  */
 void OCSYNC_EXPORT csync_reconcile_updates(CSYNC *ctx);
 
+/**
+ * @brief Find the subtrees that reconcile and the treewalk can skip.
+ *
+ * Called after the update phase. Fills ctx->clean_subtrees with the
+ * directories that were read from the db with the same records on both
+ * replicas and marks the entries below them.
+ *
+ * @param  ctx          The csync context to use.
+ */
+void OCSYNC_EXPORT csync_reconcile_mark_clean_subtrees(CSYNC *ctx);
+
+/**
+ * @brief Unmark entries of clean subtrees that reconcile changed anyway.
+ *
+ * Reconciling a renamed or conflicting entry elsewhere may change the
+ * instruction of an entry in a clean subtree. Such pairs must be walked.
+ *
+ * @param  ctx          The csync context to use.
+ */
+void OCSYNC_EXPORT csync_reconcile_check_clean_subtrees(CSYNC *ctx);
+
 /**
  * }@
  */
@@ -539,12 +539,39 @@ int csync_walker(CSYNC *ctx, std::unique_ptr<csync_file_stat_t> fs) {
   return rc;
 }
 
+static std::unique_ptr<csync_file_stat_t> fileStatFromSnapshotEntry(const OCC::RemoteTreeSnapshot::Entry &entry)
+{
+    // The entry points into the mapped file, the byte arrays need a copy
+    std::unique_ptr<csync_file_stat_t> st(new csync_file_stat_t);
+    st->path = QByteArray(entry.path.constData(), entry.path.size());
+    st->inode = entry.inode;
+    st->modtime = entry.modtime;
+    st->type = entry.type;
+    st->etag = QByteArray(entry.etag.constData(), entry.etag.size());
+    st->file_id = QByteArray(entry.fileId.constData(), entry.fileId.size());
+    st->remotePerm = entry.remotePerm;
+    st->size = entry.fileSize;
+    st->has_ignored_files = entry.serverHasIgnoredFiles;
+    st->checksumHeader = QByteArray(entry.checksumHeader.constData(), entry.checksumHeader.size());
+    return st;
+}
+
 static bool fill_tree_from_db(CSYNC *ctx, const char *uri, bool singleFile = false)
 {
     int64_t count = 0;
     QByteArray skipbase;
     auto &files = ctx->current == LOCAL_REPLICA ? ctx->local.files : ctx->remote.files;
-    auto rowCallback = [ctx, &count, &skipbase, &files](const OCC::SyncJournalFileRecord &rec) {
+
+    /* Remember what was filled, reconcile compares it with the other replica */
+    csync_s::DbSubtree *subtree = nullptr;
+    if (!singleFile) {
+        auto &subtrees = ctx->current == LOCAL_REPLICA ? ctx->local.db_subtrees : ctx->remote.db_subtrees;
+        subtree = &subtrees[QByteArray(uri)];
+        *subtree = csync_s::DbSubtree();
+    }
+
+    /* Returns false if the entry shall not appear in the tree */
+    auto acceptRow = [ctx, &skipbase, subtree](const QByteArray &path, const QByteArray &etag) {
         if (ctx->current == REMOTE_REPLICA) {
             /* When selective sync is used, the database may have subtrees with a parent
              * whose etag is _invalid_. These are ignored and shall not appear in the
@@ -553,25 +580,30 @@ static bool fill_tree_from_db(CSYNC *ctx, const char *uri, bool singleFile = fal
              * _invalid_, but that is not a problem as the next discovery will retrieve
              * their correct etags again and we don't run into this case.
              */
-            if (rec._etag == "_invalid_") {
-                qCInfo(lcUpdate, "%s selective sync excluded", rec._path.constData());
-                skipbase = rec._path;
+            if (etag == "_invalid_") {
+                qCInfo(lcUpdate, "%s selective sync excluded", path.constData());
+                skipbase = QByteArray(path.constData(), path.size());
                 skipbase += '/';
-                return;
+                if (subtree)
+                    subtree->pure = false;
+                return false;
             }
 
             /* Skip over all entries with the same base path. Note that this depends
              * strongly on the ordering of the retrieved items. */
-            if (!skipbase.isEmpty() && rec._path.startsWith(skipbase)) {
-                qCDebug(lcUpdate, "%s selective sync excluded because the parent is", rec._path.constData());
-                return;
+            if (!skipbase.isEmpty() && path.startsWith(skipbase)) {
+                qCDebug(lcUpdate, "%s selective sync excluded because the parent is", path.constData());
+                if (subtree)
+                    subtree->pure = false;
+                return false;
             } else {
                 skipbase.clear();
             }
         }
+        return true;
+    };
 
-        std::unique_ptr<csync_file_stat_t> st = csync_file_stat_t::fromSyncJournalFileRecord(rec);
-
+    auto storeRow = [ctx, &count, &files, subtree](std::unique_ptr<csync_file_stat_t> st) {
         /* Check for exclusion from the tree.
          * Note that this is only a safety net in case the ignore list changes
          * without a full remote discovery being triggered. */
@@ -581,6 +613,8 @@ static bool fill_tree_from_db(CSYNC *ctx, const char *uri, bool singleFile = fal
         if (excluded != CSYNC_NOT_EXCLUDED) {
             qInfo(lcUpdate, "%s excluded from db read (%d)", st->path.constData(), excluded);
 
+            if (subtree)
+                subtree->pure = false;
             if (excluded == CSYNC_FILE_EXCLUDE_AND_REMOVE
                     || excluded == CSYNC_FILE_SILENTLY_EXCLUDED) {
                 return;
@@ -589,11 +623,45 @@ static bool fill_tree_from_db(CSYNC *ctx, const char *uri, bool singleFile = fal
             st->instruction = CSYNC_INSTRUCTION_IGNORE;
         }
 
+        if (subtree) {
+            if ((st->type != ItemTypeFile && st->type != ItemTypeDirectory)
+                || OCC::Utility::isConflictFile(st->path.constData())) {
+                subtree->pure = false;
+            }
+            subtree->entries.push_back(st.get());
+        }
+
         /* store into result list. */
-        files[rec._path] = std::move(st);
+        QByteArray path = st->path;
+        files[path] = std::move(st);
         ++count;
     };
 
+    auto rowCallback = [&acceptRow, &storeRow](const OCC::SyncJournalFileRecord &rec) {
+        if (acceptRow(rec._path, rec._etag))
+            storeRow(csync_file_stat_t::fromSyncJournalFileRecord(rec));
+    };
+
+    /* The snapshot only has what the db has, so it can answer as long as
+     * nothing changed the file records since it was written. */
+    auto snapshot = ctx->remote.snapshot;
+    if (!singleFile && ctx->current == REMOTE_REPLICA && snapshot
+        && snapshot->generation() == ctx->statedb->remoteTreeSnapshotGeneration()) {
+        bool ok = snapshot->forEachBelow(QByteArray(uri), [&acceptRow, &storeRow](const OCC::RemoteTreeSnapshot::Entry &entry) {
+            if (acceptRow(entry.path, entry.etag))
+                storeRow(fileStatFromSnapshotEntry(entry));
+        });
+        if (ok) {
+            qInfo(lcUpdate, "%" PRId64 " entries read below path %s from the remote tree snapshot.", count, uri);
+            return true;
+        }
+        qCWarning(lcUpdate, "The remote tree snapshot is corrupt, reading from db");
+        ctx->remote.snapshot = nullptr;
+        count = 0;
+        skipbase.clear();
+        *subtree = csync_s::DbSubtree();
+    }
+
     if (singleFile) {
         OCC::SyncJournalFileRecord record;
         if (ctx->statedb->getFileRecord(QByteArray(uri), &record) && record.isValid()) {
@@ -0,0 +1,283 @@
+/*
+ * libcsync -- a library to sync a directory with another
+ *
+ * Copyright (c) by ownCloud GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "config_csync.h"
+#include "vio/csync_vio_local_batchstat.h"
+
+#ifdef HAVE_IO_URING_STATX
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(lcCSyncBatchStat, "sync.csync.vio_local.batchstat", QtInfoMsg)
+#endif
+
+static void _csync_vio_local_fstatat(int dirfd, csync_batch_stat_t *entry)
+{
+  struct stat sb;
+
+  if (fstatat(dirfd, entry->name, &sb, AT_SYMLINK_NOFOLLOW) < 0) {
+    entry->error = errno;
+    return;
+  }
+  entry->error = 0;
+  entry->mode = sb.st_mode;
+  entry->inode = sb.st_ino;
+  entry->modtime = sb.st_mtime;
+  entry->size = sb.st_size;
+}
+
+#ifdef HAVE_IO_URING_STATX
+namespace {
+
+/*
+ * Just enough of an io_uring to run statx: the rings are mapped and
+ * driven with the raw system calls, there is no dependency on liburing.
+ */
+class StatxRing
+{
+public:
+  static const unsigned depth = 64;
+
+  StatxRing();
+  ~StatxRing() { reset(); }
+
+  bool isValid() const { return _fd >= 0; }
+
+  /*
+   * Fills all entries. Returns false if the kernel rejected statx on the
+   * ring, the ring should not be used anymore then.
+   */
+  bool stat(int dirfd, csync_batch_stat_t *entries, size_t count);
+
+private:
+  StatxRing(const StatxRing &) = delete;
+  StatxRing &operator=(const StatxRing &) = delete;
+
+  void reset();
+
+  int _fd = -1;
+  void *_sqRing = MAP_FAILED;
+  size_t _sqRingSize = 0;
+  void *_cqRing = MAP_FAILED;
+  size_t _cqRingSize = 0;
+  void *_sqesMap = MAP_FAILED;
+  size_t _sqesSize = 0;
+
+  unsigned _sqEntries = 0;
+  unsigned *_sqHead = nullptr;
+  unsigned *_sqTail = nullptr;
+  unsigned _sqMask = 0;
+  unsigned *_sqArray = nullptr;
+  io_uring_sqe *_sqes = nullptr;
+  unsigned *_cqHead = nullptr;
+  unsigned *_cqTail = nullptr;
+  unsigned _cqMask = 0;
+  io_uring_cqe *_cqes = nullptr;
+};
+
+StatxRing::StatxRing()
+{
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  _fd = syscall(__NR_io_uring_setup, depth, &params);
+  if (_fd < 0)
+    return;
+
+  _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (singleMmap)
+    _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+
+  _sqRing = mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+  if (_sqRing == MAP_FAILED) {
+    reset();
+    return;
+  }
+  if (singleMmap) {
+    _cqRing = _sqRing;
+  } else {
+    _cqRing = mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+    if (_cqRing == MAP_FAILED) {
+      reset();
+      return;
+    }
+  }
+  _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  _sqesMap = mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+  if (_sqesMap == MAP_FAILED) {
+    reset();
+    return;
+  }
+
+  auto sq = static_cast<char *>(_sqRing);
+  auto cq = static_cast<char *>(_cqRing);
+  _sqEntries = params.sq_entries;
+  _sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  _sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  _sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  _sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  _sqes = static_cast<io_uring_sqe *>(_sqesMap);
+  _cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  _cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  _cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  _cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+void StatxRing::reset()
+{
+  const int error = errno;
+  if (_sqesMap != MAP_FAILED)
+    munmap(_sqesMap, _sqesSize);
+  if (_cqRing != MAP_FAILED && _cqRing != _sqRing)
+    munmap(_cqRing, _cqRingSize);
+  if (_sqRing != MAP_FAILED)
+    munmap(_sqRing, _sqRingSize);
+  _sqesMap = _cqRing = _sqRing = MAP_FAILED;
+  if (_fd >= 0)
+    close(_fd);
+  _fd = -1;
+  errno = error;
+}
+
+bool StatxRing::stat(int dirfd, csync_batch_stat_t *entries, size_t count)
+{
+  bool rejected = false;
+  std::vector<struct statx> results(std::min<size_t>(count, _sqEntries));
+
+  for (size_t done = 0; done < count;) {
+    const unsigned batch = std::min<size_t>(count - done, results.size());
+
+    // This thread is the only producer, the kernel only reads the tail
+    unsigned tail = *_sqTail;
+    for (unsigned i = 0; i < batch; ++i) {
+      const unsigned index = tail & _sqMask;
+      io_uring_sqe *sqe = &_sqes[index];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_STATX;
+      sqe->fd = dirfd;
+      sqe->addr = reinterpret_cast<uintptr_t>(entries[done + i].name);
+      sqe->len = STATX_TYPE | STATX_MODE | STATX_INO | STATX_MTIME | STATX_SIZE;
+      sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+      sqe->off = reinterpret_cast<uintptr_t>(&results[i]);
+      sqe->user_data = i;
+      _sqArray[index] = index;
+      ++tail;
+    }
+    __atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+
+    unsigned submitted = 0;
+    unsigned completed = 0;
+    while (completed < batch) {
+      const long rc = syscall(__NR_io_uring_enter, _fd, batch - submitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (rc < 0 && errno != EINTR && completed == submitted) {
+        // Nothing in flight: take back what was not submitted and stat it here
+        __atomic_store_n(_sqTail, __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+        for (size_t i = done; i < count; ++i) {
+          if (entries[i].error == -1)
+            _csync_vio_local_fstatat(dirfd, &entries[i]);
+        }
+        return false;
+      }
+      if (rc > 0)
+        submitted += rc;
+
+      unsigned head = *_cqHead;
+      const unsigned cqTail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+      for (; head != cqTail; ++head) {
+        const io_uring_cqe &cqe = _cqes[head & _cqMask];
+        csync_batch_stat_t *entry = &entries[done + cqe.user_data];
+        const struct statx &result = results[cqe.user_data];
+        if (cqe.res == -EINVAL) {
+          // Kernels before 5.6 don't know the operation
+          rejected = true;
+          _csync_vio_local_fstatat(dirfd, entry);
+        } else if (cqe.res < 0) {
+          entry->error = -cqe.res;
+        } else {
+          entry->error = 0;
+          entry->mode = result.stx_mode;
+          entry->inode = result.stx_ino;
+          entry->modtime = result.stx_mtime.tv_sec;
+          entry->size = result.stx_size;
+        }
+        ++completed;
+      }
+      __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+    }
+    done += batch;
+  }
+  return !rejected;
+}
+
+std::atomic<bool> ringUnavailable(false);
+thread_local std::unique_ptr<StatxRing> threadRing;
+
+StatxRing *currentThreadRing()
+{
+  if (!threadRing && !ringUnavailable.load(std::memory_order_relaxed)) {
+    threadRing.reset(new StatxRing);
+    if (!threadRing->isValid()) {
+      qCInfo(lcCSyncBatchStat) << "io_uring is not available, using fstatat:" << strerror(errno);
+      ringUnavailable = true;
+    }
+  }
+  return ringUnavailable.load(std::memory_order_relaxed) ? nullptr : threadRing.get();
+}
+}
+#endif
+
+void csync_vio_local_batch_stat(int dirfd, csync_batch_stat_t *entries, size_t count)
+{
+  // -1 marks the entries that were not handled yet
+  for (size_t i = 0; i < count; ++i)
+    entries[i].error = -1;
+
+#ifdef HAVE_IO_URING_STATX
+  if (count > 1) {
+    if (StatxRing *ring = currentThreadRing()) {
+      if (!ring->stat(dirfd, entries, count)) {
+        qCInfo(lcCSyncBatchStat) << "statx through io_uring failed, using fstatat";
+        ringUnavailable = true;
+        threadRing.reset();
+      }
+      return;
+    }
+  }
+#endif
+
+  for (size_t i = 0; i < count; ++i)
+    _csync_vio_local_fstatat(dirfd, &entries[i]);
+}
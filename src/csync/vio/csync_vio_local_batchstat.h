@@ -0,0 +1,51 @@
+/*
+ * libcsync -- a library to sync a directory with another
+ *
+ * Copyright (c) by ownCloud GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _CSYNC_VIO_LOCAL_BATCHSTAT_H
+#define _CSYNC_VIO_LOCAL_BATCHSTAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Linux only: the stat of many directory entries at once, see
+ * csync_vio_local_batch_stat().
+ */
+
+typedef struct csync_batch_stat_s {
+  const char *name; /* relative to the directory */
+  int error; /* the errno, 0 on success */
+  mode_t mode;
+  ino_t inode;
+  int64_t modtime;
+  int64_t size;
+} csync_batch_stat_t;
+
+/*
+ * Stats the entries relative to dirfd like lstat would.
+ *
+ * The requests are submitted in batches through an io_uring of the calling
+ * thread. Where io_uring or its statx operation is not available (old
+ * kernels, seccomp filters), fstatat is called for one entry after the other.
+ */
+void csync_vio_local_batch_stat(int dirfd, csync_batch_stat_t *entries, size_t count);
+
+#endif /* _CSYNC_VIO_LOCAL_BATCHSTAT_H */
@@ -35,19 +35,154 @@
 
 #include "vio/csync_vio_local.h"
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "vio/csync_vio_local_batchstat.h"
+#endif
+
 Q_LOGGING_CATEGORY(lcCSyncVIOLocal, "sync.csync.vio_local", QtInfoMsg)
 
 /*
  * directory functions
  */
 
+static int _csync_vio_local_stat_mb(const mbchar_t *wuri, csync_file_stat_t *buf);
+
+static void _csync_vio_local_fill_type(mode_t mode, csync_file_stat_t *buf)
+{
+    switch (mode & S_IFMT) {
+    case S_IFDIR:
+        buf->type = ItemTypeDirectory;
+        break;
+    case S_IFREG:
+        buf->type = ItemTypeFile;
+        break;
+    case S_IFLNK:
+    case S_IFSOCK:
+        buf->type = ItemTypeSoftLink;
+        break;
+    default:
+        buf->type = ItemTypeSkip;
+        break;
+    }
+}
+
+#ifdef __linux__
+
+/*
+ * On Linux the directory is read with getdents64 and all entries of a
+ * buffer are stat'ed in one batch, relative to the directory.
+ */
+typedef struct dhandle_s {
+  int fd = -1;
+  QByteArray path;
+  alignas(struct dirent64) char buffer[32 * 1024];
+  std::vector<csync_batch_stat_t> entries;
+  std::vector<unsigned char> types;
+  size_t next = 0;
+} dhandle_t;
+
+csync_vio_handle_t *csync_vio_local_opendir(const char *name) {
+  mbchar_t *dirname = c_utf8_path_to_locale(name);
+  int fd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  c_free_locale_string(dirname);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  dhandle_t *handle = new dhandle_t;
+  handle->fd = fd;
+  handle->path = name;
+  return (csync_vio_handle_t *) handle;
+}
+
+int csync_vio_local_closedir(csync_vio_handle_t *dhandle) {
+  if (dhandle == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+
+  dhandle_t *handle = (dhandle_t *) dhandle;
+  int rc = close(handle->fd);
+  delete handle;
+  return rc;
+}
+
+/* Reads the next entries and stats them, returns false at the end */
+static bool _csync_vio_local_read_batch(dhandle_t *handle) {
+  handle->entries.clear();
+  handle->types.clear();
+  handle->next = 0;
+
+  while (handle->entries.empty()) {
+    long size = syscall(SYS_getdents64, handle->fd, handle->buffer, sizeof(handle->buffer));
+    if (size <= 0) {
+      return false;
+    }
+    for (long offset = 0; offset < size;) {
+      const struct dirent64 *dirent = reinterpret_cast<const struct dirent64 *>(handle->buffer + offset);
+      offset += dirent->d_reclen;
+      if (qstrcmp(dirent->d_name, ".") == 0 || qstrcmp(dirent->d_name, "..") == 0) {
+        continue;
+      }
+      csync_batch_stat_t entry;
+      entry.name = dirent->d_name;
+      handle->entries.push_back(entry);
+      handle->types.push_back(dirent->d_type);
+    }
+  }
+
+  csync_vio_local_batch_stat(handle->fd, handle->entries.data(), handle->entries.size());
+  return true;
+}
+
+std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *dhandle) {
+  dhandle_t *handle = (dhandle_t *) dhandle;
+
+  if (handle->next == handle->entries.size() && !_csync_vio_local_read_batch(handle)) {
+    return {};
+  }
+  const csync_batch_stat_t &entry = handle->entries[handle->next];
+  const unsigned char d_type = handle->types[handle->next];
+  ++handle->next;
+
+  std::unique_ptr<csync_file_stat_t> file_stat(new csync_file_stat_t);
+  file_stat->path = c_utf8_from_locale(entry.name);
+  if (file_stat->path.isNull()) {
+      file_stat->original_path = handle->path + '/' + entry.name;
+      qCWarning(lcCSyncVIOLocal) << "Invalid characters in file/directory name, please rename:" << entry.name << handle->path;
+      if (d_type == DT_DIR) {
+          file_stat->type = ItemTypeDirectory;
+      } else if (d_type == DT_REG) {
+          file_stat->type = ItemTypeFile;
+      }
+      return file_stat;
+  }
+
+  if (entry.error != 0) {
+      // Will get excluded by _csync_detect_update.
+      file_stat->type = ItemTypeSkip;
+      return file_stat;
+  }
+
+  _csync_vio_local_fill_type(entry.mode, file_stat.get());
+  file_stat->inode = entry.inode;
+  file_stat->modtime = entry.modtime;
+  file_stat->size = entry.size;
+  return file_stat;
+}
+
+#else
+
 typedef struct dhandle_s {
   DIR *dh;
   char *path;
 } dhandle_t;
 
-static int _csync_vio_local_stat_mb(const mbchar_t *wuri, csync_file_stat_t *buf);
-
 csync_vio_handle_t *csync_vio_local_opendir(const char *name) {
   dhandle_t *handle = NULL;
   mbchar_t *dirname = NULL;
@@ -141,6 +276,8 @@ std::unique_ptr<csync_file_stat_t> csync_vio_local_readdir(csync_vio_handle_t *d
 }
 
 
+#endif
+
 int csync_vio_local_stat(const char *uri, csync_file_stat_t *buf)
 {
     mbchar_t *wuri = c_utf8_path_to_locale(uri);
@@ -158,21 +295,7 @@ static int _csync_vio_local_stat_mb(const mbchar_t *wuri, csync_file_stat_t *buf
         return -1;
     }
 
-    switch (sb.st_mode & S_IFMT) {
-    case S_IFDIR:
-      buf->type = ItemTypeDirectory;
-      break;
-    case S_IFREG:
-      buf->type = ItemTypeFile;
-      break;
-    case S_IFLNK:
-    case S_IFSOCK:
-      buf->type = ItemTypeSoftLink;
-      break;
-    default:
-      buf->type = ItemTypeSkip;
-      break;
-  }
+    _csync_vio_local_fill_type(sb.st_mode, buf);
 
 #ifdef __APPLE__
   if (sb.st_flags & UF_HIDDEN) {
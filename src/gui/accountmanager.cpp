@@ -22,6 +22,8 @@
 #include <cookiejar.h>
 #include <QSettings>
 #include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QNetworkAccessManager>
 
 namespace {
@@ -33,6 +35,7 @@ static const char caCertsKeyC[] = "CaCertificates";
 static const char accountsC[] = "Accounts";
 static const char versionC[] = "version";
 static const char serverVersionC[] = "serverVersion";
+static const char capabilitiesC[] = "capabilities";
 
 // The maximum versions that this client can read
 static const int maxAccountsVersion = 2;
@@ -80,6 +83,7 @@ bool AccountManager::restore()
         if (!skipSettingsKeys.contains(settings->group())) {
             if (auto acc = loadAccountHelper(*settings)) {
                 acc->_id = accountId;
+                acc->restoreSslSession();
                 if (auto accState = AccountState::loadFromSettings(acc, *settings)) {
                     addAccountState(accState);
                 }
@@ -213,6 +217,9 @@ void AccountManager::saveAccountHelper(Account *acc, QSettings &settings, bool s
     settings.setValue(QLatin1String(versionC), maxAccountVersion);
     settings.setValue(QLatin1String(urlC), acc->_url.toString());
     settings.setValue(QLatin1String(serverVersionC), acc->_serverVersion);
+    // Lets the connection check report success before fresh capabilities arrive
+    settings.setValue(QLatin1String(capabilitiesC),
+        QJsonDocument(QJsonObject::fromVariantMap(acc->capabilities().raw())).toJson(QJsonDocument::Compact));
     if (acc->_credentials) {
         if (saveCredentials) {
             // Only persist the credentials if the parameter is set, on migration from 1.8.x
@@ -251,6 +258,7 @@ void AccountManager::saveAccountHelper(Account *acc, QSettings &settings, bool s
             jar->save(acc->cookieJarPath());
         }
     }
+    acc->saveSslSession();
 }
 
 AccountPtr AccountManager::loadAccountHelper(QSettings &settings)
@@ -290,6 +298,8 @@ AccountPtr AccountManager::loadAccountHelper(QSettings &settings)
     qCInfo(lcAccountManager) << "Account for" << acc->url() << "using auth type" << authType;
 
     acc->_serverVersion = settings.value(QLatin1String(serverVersionC)).toString();
+    acc->setCapabilities(QJsonDocument::fromJson(
+        settings.value(QLatin1String(capabilitiesC)).toByteArray()).object().toVariantMap());
 
     // We want to only restore settings for that auth type and the user value
     acc->_settingsMap.insert(QLatin1String(userC), settings.value(userC));
@@ -345,6 +355,7 @@ void AccountManager::deleteAccount(AccountState *account)
     // Forget account credentials, cookies
     account->account()->credentials()->forgetSensitiveData();
     QFile::remove(account->account()->cookieJarPath());
+    QFile::remove(account->account()->sslSessionPath());
 
     auto settings = ConfigFile::settingsWithGroup(QLatin1String(accountsC));
     settings->remove(account->account()->id());
@@ -19,6 +19,7 @@
 #include "creds/httpcredentials.h"
 #include "logger.h"
 #include "configfile.h"
+#include "owncloudpropagator.h"
 
 #include <QSettings>
 #include <QTimer>
@@ -264,6 +265,8 @@ void AccountState::slotConnectionValidatorResult(ConnectionValidator::Status sta
     switch (status) {
     case ConnectionValidator::Connected:
         if (_state != Connected) {
+            // Before the syncs start, so their parallel jobs find open connections
+            account()->warmUpConnections(OwncloudPropagator::hardMaximumActiveJob(account()));
             setState(Connected);
         }
         break;
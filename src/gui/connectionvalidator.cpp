@@ -38,6 +38,7 @@ ConnectionValidator::ConnectionValidator(AccountPtr account, QObject *parent)
     , _account(account)
     , _isCheckingServerAndAuth(false)
 {
+    _duration.start();
 }
 
 void ConnectionValidator::checkServerAndAuth()
@@ -99,6 +100,7 @@ void ConnectionValidator::slotStatusFound(const QUrl &url, const QJsonObject &in
     // https://github.com/owncloud/core/pull/27473/files
     // so this string can be empty.
     QString serverVersion = CheckServerJob::version(info);
+    logStep("status.php");
 
     // status.php was found.
     qCInfo(lcConnectionValidator) << "** Application: ownCloud found: "
@@ -174,6 +176,7 @@ void ConnectionValidator::checkAuthentication()
     job->setProperties(QList<QByteArray>() << "getlastmodified");
     connect(job, &PropfindJob::result, this, &ConnectionValidator::slotAuthSuccess);
     connect(job, &PropfindJob::finishedWithError, this, &ConnectionValidator::slotAuthFailed);
+    _pendingReplies |= AuthReply;
     job->start();
 }
 
@@ -209,19 +212,26 @@ void ConnectionValidator::slotAuthFailed(QNetworkReply *reply)
 void ConnectionValidator::slotAuthSuccess()
 {
     _errors.clear();
+    _pendingReplies &= ~AuthReply;
+    logStep("authentication");
     if (!_isCheckingServerAndAuth) {
         reportResult(Connected);
         return;
     }
+
+    // These don't depend on each other, send them all at once
     checkServerCapabilities();
+    fetchUser();
 }
 
 void ConnectionValidator::checkServerCapabilities()
 {
-    // The main flow now needs the capabilities
+    _haveCachedCapabilities = !_account->capabilities().raw().isEmpty();
+
     JsonApiJob *job = new JsonApiJob(_account, QLatin1String("ocs/v1.php/cloud/capabilities"), this);
     job->setTimeout(timeoutToUseMsec);
     QObject::connect(job, &JsonApiJob::jsonReceived, this, &ConnectionValidator::slotCapabilitiesRecieved);
+    _pendingReplies |= CapabilitiesReply;
     job->start();
 
     // And we'll retrieve the ocs config in parallel
@@ -238,17 +248,34 @@ void ConnectionValidator::checkServerCapabilities()
 
 void ConnectionValidator::slotCapabilitiesRecieved(const QJsonDocument &json)
 {
+    if (_resultReported && _reportedStatus != Connected)
+        return;
+    _pendingReplies &= ~CapabilitiesReply;
+    logStep("capabilities");
+
     auto caps = json.object().value("ocs").toObject().value("data").toObject().value("capabilities").toObject();
-    qCInfo(lcConnectionValidator) << "Server capabilities" << caps;
-    _account->setCapabilities(caps.toVariantMap());
+    if (caps.isEmpty()) {
+        qCWarning(lcConnectionValidator) << "Could not fetch the server capabilities";
+        // Keep the ones from the last run, if any
+        if (!_haveCachedCapabilities)
+            _account->setCapabilities(QVariantMap());
+    } else {
+        qCInfo(lcConnectionValidator) << "Server capabilities" << caps;
+        const QVariantMap capsMap = caps.toVariantMap();
+        if (capsMap != _account->capabilities().raw()) {
+            _account->setCapabilities(capsMap);
+            // They are cached with the account
+            emit _account->wantsAccountSaved(_account.data());
+        }
 
-    // New servers also report the version in the capabilities
-    QString serverVersion = caps["core"].toObject()["status"].toObject()["version"].toString();
-    if (!serverVersion.isEmpty() && !setAndCheckServerVersion(serverVersion)) {
-        return;
+        // New servers also report the version in the capabilities
+        QString serverVersion = caps["core"].toObject()["status"].toObject()["version"].toString();
+        if (!serverVersion.isEmpty() && !setAndCheckServerVersion(serverVersion)) {
+            return;
+        }
     }
 
-    fetchUser();
+    checkDone();
 }
 
 void ConnectionValidator::ocsConfigReceived(const QJsonDocument &json, AccountPtr account)
@@ -267,6 +294,7 @@ void ConnectionValidator::fetchUser()
     JsonApiJob *job = new JsonApiJob(_account, QLatin1String("ocs/v1.php/cloud/user"), this);
     job->setTimeout(timeoutToUseMsec);
     QObject::connect(job, &JsonApiJob::jsonReceived, this, &ConnectionValidator::slotUserFetched);
+    _pendingReplies |= UserReply;
     job->start();
 }
 
@@ -301,6 +329,11 @@ bool ConnectionValidator::setAndCheckServerVersion(const QString &version)
 
 void ConnectionValidator::slotUserFetched(const QJsonDocument &json)
 {
+    if (_resultReported && _reportedStatus != Connected)
+        return;
+    _pendingReplies &= ~UserReply;
+    logStep("user");
+
     QString user = json.object().value("ocs").toObject().value("data").toObject().value("id").toString();
     if (!user.isEmpty()) {
         _account->setDavUser(user);
@@ -310,26 +343,52 @@ void ConnectionValidator::slotUserFetched(const QJsonDocument &json)
         _account->setDavDisplayName(displayName);
     }
 #ifndef TOKEN_AUTH_ONLY
-    AvatarJob *job = new AvatarJob(_account, _account->davUser(), 128, this);
+    // Nothing waits for the avatar, so it is not parented to this
+    AvatarJob *job = new AvatarJob(_account, _account->davUser(), 128, _account.data());
     job->setTimeout(20 * 1000);
-    QObject::connect(job, &AvatarJob::avatarPixmap, this, &ConnectionValidator::slotAvatarImage);
+    auto account = _account;
+    QObject::connect(job, &AvatarJob::avatarPixmap, _account.data(), [account](const QImage &img) {
+        account->setAvatar(img);
+    });
     job->start();
-#else
-    reportResult(Connected);
 #endif
+
+    checkDone();
 }
 
-#ifndef TOKEN_AUTH_ONLY
-void ConnectionValidator::slotAvatarImage(const QImage &img)
+void ConnectionValidator::checkDone()
 {
-    _account->setAvatar(img);
+    if (_resultReported) {
+        // Only the fresh capabilities were still missing
+        if (!_pendingReplies)
+            deleteLater();
+        return;
+    }
+
+    int waitFor = AuthReply | UserReply;
+    if (!_haveCachedCapabilities)
+        waitFor |= CapabilitiesReply;
+    if (_pendingReplies & waitFor)
+        return;
     reportResult(Connected);
 }
-#endif
+
+void ConnectionValidator::logStep(const char *step)
+{
+    qCInfo(lcConnectionValidator) << "Connection check:" << step << "done after" << _duration.elapsed() << "ms";
+}
 
 void ConnectionValidator::reportResult(Status status)
 {
+    qCInfo(lcConnectionValidator) << "Connection check finished with" << status << "after" << _duration.elapsed() << "ms"
+                                  << (_pendingReplies & CapabilitiesReply ? "using the cached capabilities" : "");
+    _resultReported = true;
+    _reportedStatus = status;
     emit connectionResult(status, _errors);
+
+    // Stay around to apply the fresh capabilities, see checkDone()
+    if (status == Connected && _pendingReplies)
+        return;
     deleteLater();
 }
 
@@ -20,6 +20,7 @@
 #include <QStringList>
 #include <QVariantMap>
 #include <QNetworkReply>
+#include <QElapsedTimer>
 #include "accountfwd.h"
 
 namespace OCC {
@@ -28,11 +29,18 @@ namespace OCC {
  * This is a job-like class to check that the server is up and that we are connected.
  * There are two entry points: checkServerAndAuth and checkAuthentication
  * checkAuthentication is the quick version that only does the propfind
- * while checkServerAndAuth is doing the 4 calls.
+ * while checkServerAndAuth also fetches the capabilities and the user.
  *
  * We cannot use the capabilites call to test the login and the password because of
  * https://github.com/owncloud/core/issues/12930
  *
+ * Once the authentication succeeded, the capabilities, ocs config and user
+ * requests are sent at the same time instead of one after another, which
+ * saves round trips on slow links. They wait for the authentication so
+ * wrong credentials only cost one failed request. If capabilities from a
+ * previous run are known, success is reported without waiting for the
+ * fresh ones: the validator stays around to apply them when they arrive.
+ *
  * Here follows the state machine
 
 \code{.unparsed}
@@ -54,24 +62,21 @@ namespace OCC {
         |
         +-> slotAuthFailed --> X
         |
-        +-> slotAuthSuccess --+--> X (depending if coming from checkServerAndAuth or not)
+        +-> slotAuthSuccess --+--> X (if not coming from checkServerAndAuth)
                               |
   +---------------------------+
   |
-  +-> checkServerCapabilities --------------v (in parallel)
-        JsonApiJob (cloud/capabilities)     JsonApiJob (ocs/v1.php/config)
-        |                                   +-> ocsConfigReceived
-        +-> slotCapabilitiesRecieved -+
-                                      |
-  +-----------------------------------+
-  |
-  +-> fetchUser
-        PropfindJob
-        |
+  +-> in parallel:
+        JsonApiJob (cloud/capabilities)
+        +-> slotCapabilitiesRecieved
+        JsonApiJob (ocs/v1.php/config)
+        +-> ocsConfigReceived
+        JsonApiJob (cloud/user)
         +-> slotUserFetched
-              AvatarJob
-              |
-              +-> slotAvatarImage --> reportResult()
+              AvatarJob (not waited for)
+  all needed replies received
+  |
+  +-> reportResult()
 
     \endcode
  */
@@ -122,12 +127,19 @@ protected slots:
 
     void slotCapabilitiesRecieved(const QJsonDocument &);
     void slotUserFetched(const QJsonDocument &);
-#ifndef TOKEN_AUTH_ONLY
-    void slotAvatarImage(const QImage &img);
-#endif
 
 private:
+    enum PendingReply {
+        AuthReply = 1,
+        CapabilitiesReply = 2,
+        UserReply = 4
+    };
+
     void reportResult(Status status);
+    /// Reports Connected once all replies that are waited for are in
+    void checkDone();
+    /// Logs how long the startup took until this step
+    void logStep(const char *step);
     void checkServerCapabilities();
     void fetchUser();
     static void ocsConfigReceived(const QJsonDocument &json, AccountPtr account);
@@ -141,6 +153,13 @@ private:
     QStringList _errors;
     AccountPtr _account;
     bool _isCheckingServerAndAuth;
+
+    int _pendingReplies = 0;
+    bool _resultReported = false;
+    Status _reportedStatus = Undefined;
+    // The capabilities are known from the last run
+    bool _haveCachedCapabilities = false;
+    QElapsedTimer _duration;
 };
 }
 
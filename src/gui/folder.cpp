@@ -38,6 +38,7 @@
 #include <QUrl>
 #include <QDir>
 #include <QSettings>
+#include <QtConcurrent>
 
 #include <QMessageBox>
 #include <QPushButton>
@@ -48,6 +49,19 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcFolder, "gui.folder", QtInfoMsg)
 
+static std::chrono::milliseconds fullLocalDiscoveryInterval()
+{
+    static std::chrono::milliseconds interval = []() {
+        auto interval = ConfigFile().fullLocalDiscoveryInterval();
+        QByteArray env = qgetenv("OWNCLOUD_FULL_LOCAL_DISCOVERY_INTERVAL");
+        if (!env.isEmpty()) {
+            interval = std::chrono::milliseconds(env.toLongLong());
+        }
+        return interval;
+    }();
+    return interval;
+}
+
 Folder::Folder(const FolderDefinition &definition,
     AccountState *accountState,
     QObject *parent)
@@ -56,11 +70,17 @@ Folder::Folder(const FolderDefinition &definition,
     , _definition(definition)
     , _csyncUnavail(false)
     , _lastSyncDuration(0)
+    , _lastFullLocalDiscoveryTime(0)
+    , _fullLocalDiscoveryAgeAtStart(0)
+    , _watcherReadyAtSyncStart(false)
     , _consecutiveFailingSyncs(0)
     , _consecutiveFollowUpSyncs(0)
     , _journal(_definition.absoluteJournalPath())
     , _fileLog(new SyncRunFileLog)
+    , _progressPending(false)
+    , _lastEmittedProgressStatus(ProgressInfo::Done)
     , _saveBackwardsCompatible(false)
+    , _abortLocalChangesSweep(false)
 {
     _timeSinceLastSyncStart.start();
     _timeSinceLastSyncDone.start();
@@ -111,6 +131,11 @@ Folder::Folder(const FolderDefinition &definition,
     connect(&_scheduleSelfTimer, &QTimer::timeout,
         this, &Folder::slotScheduleThisFolder);
 
+    _progressTimer.setSingleShot(true);
+    _progressTimer.setInterval(ConfigFile().progressUpdateInterval().count());
+    connect(&_progressTimer, &QTimer::timeout,
+        this, &Folder::slotEmitPendingProgress);
+
     connect(ProgressDispatcher::instance(), &ProgressDispatcher::folderConflicts,
         this, &Folder::slotFolderConflicts);
 
@@ -119,10 +144,16 @@ Folder::Folder(const FolderDefinition &definition,
         _localDiscoveryTracker.data(), &LocalDiscoveryTracker::slotSyncFinished);
     connect(_engine.data(), &SyncEngine::itemCompleted,
         _localDiscoveryTracker.data(), &LocalDiscoveryTracker::slotItemCompleted);
+    connect(&_localChangesSweep, &QFutureWatcherBase::finished,
+        this, &Folder::slotLocalChangesSweepFinished);
 }
 
 Folder::~Folder()
 {
+    // The sweep uses the journal and members of the Folder
+    _abortLocalChangesSweep = true;
+    _localChangesSweep.waitForFinished();
+
     // Reset then engine first as it will abort and try to access members of the Folder
     _engine.reset();
 }
@@ -639,6 +670,7 @@ void Folder::wipe()
     QFile::remove(stateDbFile + ".ctmp");
     QFile::remove(stateDbFile + "-shm");
     QFile::remove(stateDbFile + "-wal");
+    QFile::remove(stateDbFile + "-remotetree");
     QFile::remove(stateDbFile + "-journal");
 
     if (canSync())
@@ -678,19 +710,12 @@ void Folder::startSync(const QStringList &pathList)
     setDirtyNetworkLimits();
     setSyncOptions();
 
-    static std::chrono::milliseconds fullLocalDiscoveryInterval = []() {
-        auto interval = ConfigFile().fullLocalDiscoveryInterval();
-        QByteArray env = qgetenv("OWNCLOUD_FULL_LOCAL_DISCOVERY_INTERVAL");
-        if (!env.isEmpty()) {
-            interval = std::chrono::milliseconds(env.toLongLong());
-        }
-        return interval;
-    }();
     bool hasDoneFullLocalDiscovery = _timeSinceLastFullLocalDiscovery.isValid();
+    const auto fullInterval = fullLocalDiscoveryInterval();
     bool periodicFullLocalDiscoveryNow =
-        fullLocalDiscoveryInterval.count() >= 0 // negative means we don't require periodic full runs
-        && _timeSinceLastFullLocalDiscovery.hasExpired(fullLocalDiscoveryInterval.count());
-    if (_folderWatcher && _folderWatcher->isReliable()
+        fullInterval.count() >= 0 // negative means we don't require periodic full runs
+        && _timeSinceLastFullLocalDiscovery.elapsed() + _fullLocalDiscoveryAgeAtStart > fullInterval.count();
+    if (_folderWatcher && _folderWatcher->isReliable() && _folderWatcher->isReady()
         && hasDoneFullLocalDiscovery
         && !periodicFullLocalDiscoveryNow) {
         qCInfo(lcFolder) << "Allowing local discovery to read from the database";
@@ -703,6 +728,9 @@ void Folder::startSync(const QStringList &pathList)
         _engine->setLocalDiscoveryOptions(LocalDiscoveryStyle::FilesystemOnly);
         _localDiscoveryTracker->startSyncFullDiscovery();
     }
+    // Changes in directories that aren't watched yet could be missed by
+    // this discovery and by the watcher
+    _watcherReadyAtSyncStart = _folderWatcher && _folderWatcher->isReady();
 
     _engine->setIgnoreHiddenFiles(_definition.ignoreHiddenFiles);
 
@@ -720,6 +748,9 @@ void Folder::setSyncOptions()
     opt._newBigFolderSizeLimit = newFolderLimit.first ? newFolderLimit.second * 1000LL * 1000LL : -1; // convert from MB to B
     opt._confirmExternalStorage = cfgFile.confirmExternalStorage();
     opt._moveFilesToTrash = cfgFile.moveToTrash();
+    opt._remoteTreeSnapshot = cfgFile.remoteTreeSnapshot();
+    opt._parallelReconcile = cfgFile.parallelReconcile();
+    opt._serverSideCopyMinSize = cfgFile.serverSideCopyMinSize();
     opt._newFilesAreVirtual = _definition.useVirtualFiles;
     opt._virtualFileSuffix = QStringLiteral(APPLICATION_DOTVIRTUALFILE_SUFFIX);
 
@@ -848,8 +879,11 @@ void Folder::slotSyncFinished(bool success)
     if ((_syncResult.status() == SyncResult::Success
             || _syncResult.status() == SyncResult::Problem)
         && success) {
-        if (_engine->lastLocalDiscoveryStyle() == LocalDiscoveryStyle::FilesystemOnly) {
+        if (_engine->lastLocalDiscoveryStyle() == LocalDiscoveryStyle::FilesystemOnly
+            && _watcherReadyAtSyncStart) {
             _timeSinceLastFullLocalDiscovery.start();
+            _fullLocalDiscoveryAgeAtStart = 0;
+            _lastFullLocalDiscoveryTime = QDateTime::currentMSecsSinceEpoch();
         }
     }
 
@@ -903,8 +937,32 @@ void Folder::slotEmitFinishedDelayed()
 
 // the progress comes without a folder and the valid path set. Add that here
 // and hand the result over to the progress dispatcher.
+//
+// The ProgressInfo always holds the exact totals, only the notifications are
+// rate limited: status changes are forwarded immediately, byte progress and
+// completed items at most once per _progressTimer interval. The completed
+// items themselves reach the GUI through ProgressDispatcher::itemCompleted(),
+// see slotItemCompleted(), so none are lost by coalescing.
 void Folder::slotTransmissionProgress(const ProgressInfo &pi)
 {
+    _progressPending = true;
+
+    if (pi.status() != _lastEmittedProgressStatus || _progressTimer.interval() <= 0) {
+        slotEmitPendingProgress();
+    } else if (!_progressTimer.isActive()) {
+        _progressTimer.start();
+    }
+}
+
+void Folder::slotEmitPendingProgress()
+{
+    _progressTimer.stop();
+    if (!_progressPending)
+        return;
+
+    const ProgressInfo &pi = _engine->progressInfo();
+    _progressPending = false;
+    _lastEmittedProgressStatus = pi.status();
     emit progressInfo(pi);
     ProgressDispatcher::instance()->setProgressInfo(alias(), pi);
 }
@@ -982,6 +1040,8 @@ void Folder::slotScheduleThisFolder()
 void Folder::slotNextSyncFullLocalDiscovery()
 {
     _timeSinceLastFullLocalDiscovery.invalidate();
+    // A running sweep would otherwise allow a partial discovery again
+    _abortLocalChangesSweep = true;
 }
 
 void Folder::slotFolderConflicts(const QString &folder, const QStringList &conflictPaths)
@@ -1060,14 +1120,115 @@ void Folder::registerFolderWatcher()
     if (!QDir(path()).exists())
         return;
 
-    _folderWatcher.reset(new FolderWatcher(this));
+    _folderWatcher.reset(new FolderWatcher(this, [this](const QString &path) {
+#ifndef OWNCLOUD_TEST
+        return isFileExcludedAbsolute(path);
+#else
+        Q_UNUSED(path);
+        return false;
+#endif
+    }));
     connect(_folderWatcher.data(), &FolderWatcher::pathChanged,
         this, &Folder::slotWatchedPathChanged);
     connect(_folderWatcher.data(), &FolderWatcher::lostChanges,
         this, &Folder::slotNextSyncFullLocalDiscovery);
     connect(_folderWatcher.data(), &FolderWatcher::becameUnreliable,
         this, &Folder::slotWatcherUnreliable);
+    connect(_folderWatcher.data(), &FolderWatcher::ready,
+        this, &Folder::slotWatcherReady);
     _folderWatcher->init(path());
+
+    restoreLocalDiscoveryState();
+}
+
+void Folder::saveLocalDiscoveryState()
+{
+    if (!_folderWatcher || !_folderWatcher->isReliable()
+        || !_timeSinceLastFullLocalDiscovery.isValid()
+        || isBusy() || isRestoringLocalDiscoveryState()) {
+        qCInfo(lcFolder) << "Not saving local discovery state for" << alias();
+        return;
+    }
+
+    SyncJournalDb::LocalDiscoveryState state;
+    state._shutdownTime = QDateTime::currentMSecsSinceEpoch();
+    state._lastFullDiscoveryTime = _lastFullLocalDiscoveryTime;
+    state._paths = _localDiscoveryTracker->localDiscoveryPaths();
+    _journal.setLocalDiscoveryState(state);
+}
+
+void Folder::restoreLocalDiscoveryState()
+{
+    // Always consumed, a crash later on must not reuse it
+    auto state = _journal.takeLocalDiscoveryState();
+    if (!state.isValid())
+        return;
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const auto fullInterval = fullLocalDiscoveryInterval();
+    if (state._shutdownTime > now
+        || state._lastFullDiscoveryTime > state._shutdownTime
+        || (fullInterval.count() >= 0 && now - state._lastFullDiscoveryTime > fullInterval.count())) {
+        qCInfo(lcFolder) << "Not using the saved local discovery state, the next sync does a full local discovery";
+        return;
+    }
+
+    _restoredLocalDiscoveryState = std::move(state);
+    if (_folderWatcher->isReady())
+        startLocalChangesSweep();
+}
+
+void Folder::slotWatcherReady()
+{
+    if (_restoredLocalDiscoveryState.isValid())
+        startLocalChangesSweep();
+}
+
+void Folder::startLocalChangesSweep()
+{
+    if (!_folderWatcher->isReliable()) {
+        qCInfo(lcFolder) << "Not using the saved local discovery state, the folder watcher is unreliable";
+        _restoredLocalDiscoveryState = SyncJournalDb::LocalDiscoveryState();
+        slotScheduleThisFolder();
+        return;
+    }
+
+    // Changes from now on are seen by the watcher, look for the ones before
+    const QString localPath = path();
+    const qint64 since = _restoredLocalDiscoveryState._shutdownTime;
+    qCInfo(lcFolder) << "Looking for local changes since" << QDateTime::fromMSecsSinceEpoch(since);
+    _sweptPaths.clear();
+    _localChangesSweep.setFuture(QtConcurrent::run([this, localPath, since]() {
+        return LocalDiscoveryTracker::findChangedDirectories(localPath, since,
+            &_journal, &_sweptPaths, &_abortLocalChangesSweep);
+    }));
+}
+
+void Folder::slotLocalChangesSweepFinished()
+{
+    auto state = std::move(_restoredLocalDiscoveryState);
+    _restoredLocalDiscoveryState = SyncJournalDb::LocalDiscoveryState();
+
+    if (_localChangesSweep.result()) {
+        for (const auto &path : state._paths)
+            _localDiscoveryTracker->addTouchedPath(path);
+        for (const auto &path : _sweptPaths)
+            _localDiscoveryTracker->addTouchedPath(path);
+        qCInfo(lcFolder) << "Restored local discovery state with"
+                         << _localDiscoveryTracker->localDiscoveryPaths().size() << "paths to rediscover";
+
+        // The full discovery was done before the restart: keep its age, else
+        // in-place edits made while the client wasn't running are found late
+        _lastFullLocalDiscoveryTime = state._lastFullDiscoveryTime;
+        _fullLocalDiscoveryAgeAtStart = qMax<qint64>(0, QDateTime::currentMSecsSinceEpoch() - state._lastFullDiscoveryTime);
+        _timeSinceLastFullLocalDiscovery.start();
+    } else {
+        qCWarning(lcFolder) << "Could not look for local changes, the next sync does a full local discovery";
+    }
+    _sweptPaths.clear();
+
+    // Syncs were held back until now
+    slotScheduleThisFolder();
 }
 
 void Folder::slotAboutToRemoveAllFiles(SyncFileItem::Direction dir, bool *cancel)
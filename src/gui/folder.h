@@ -27,8 +27,10 @@
 #include <QObject>
 #include <QStringList>
 #include <QUuid>
+#include <QFutureWatcher>
 #include <set>
 #include <chrono>
+#include <atomic>
 
 class QThread;
 class QSettings;
@@ -242,6 +244,21 @@ public:
      */
     void registerFolderWatcher();
 
+    /**
+     * Saves the dirty local paths to the journal on a clean shutdown.
+     *
+     * Only done if the folder watcher is reliable and no sync is running,
+     * otherwise the next start does a full local discovery.
+     */
+    void saveLocalDiscoveryState();
+
+    /**
+     * True while the changes done while the client wasn't running are
+     * being looked for, or while the folder watcher isn't ready for that
+     * yet. The folder is scheduled again when that's done.
+     */
+    bool isRestoringLocalDiscoveryState() const { return _restoredLocalDiscoveryState.isValid(); }
+
     /** new files are downloaded as virtual files */
     bool useVirtualFiles() { return _definition.useVirtualFiles; }
 
@@ -308,6 +325,9 @@ private slots:
     void slotCsyncUnavailable();
 
     void slotTransmissionProgress(const ProgressInfo &pi);
+
+    /** Forwards the engine's progress if it changed since the last call */
+    void slotEmitPendingProgress();
     void slotItemCompleted(const SyncFileItemPtr &);
 
     void slotRunEtagJob();
@@ -341,6 +361,12 @@ private slots:
     /** Warn users about an unreliable folder watcher */
     void slotWatcherUnreliable(const QString &message);
 
+    /** Starts a pending local changes sweep, see restoreLocalDiscoveryState() */
+    void slotWatcherReady();
+
+    /** Feeds the result of the sweep started in restoreLocalDiscoveryState() to the tracker */
+    void slotLocalChangesSweepFinished();
+
 private:
     bool reloadExcludes();
 
@@ -350,6 +376,16 @@ private:
 
     void setSyncOptions();
 
+    /**
+     * Uses the state saved by saveLocalDiscoveryState() to avoid a full
+     * local discovery after a restart.
+     *
+     * Once the folder watcher is ready, a sweep looks for directories
+     * changed in the meantime, see LocalDiscoveryTracker::findChangedDirectories().
+     */
+    void restoreLocalDiscoveryState();
+    void startLocalChangesSweep();
+
     enum LogStatus {
         LogStatusRemove,
         LogStatusRename,
@@ -376,6 +412,9 @@ private:
     QElapsedTimer _timeSinceLastSyncStart;
     QElapsedTimer _timeSinceLastFullLocalDiscovery;
     std::chrono::milliseconds _lastSyncDuration;
+    qint64 _lastFullLocalDiscoveryTime; // msecs since epoch, saved with the local discovery state
+    qint64 _fullLocalDiscoveryAgeAtStart; // msecs, age of a restored full discovery when _timeSinceLastFullLocalDiscovery started
+    bool _watcherReadyAtSyncStart;
 
     /// The number of syncs that failed in a row.
     /// Reset when a sync is successful.
@@ -391,6 +430,15 @@ private:
 
     QTimer _scheduleSelfTimer;
 
+    /**
+     * The engine reports progress for every chunk and every completed item.
+     * These are coalesced into at most one progressInfo() per interval of this
+     * timer, see slotTransmissionProgress().
+     */
+    QTimer _progressTimer;
+    bool _progressPending; // the engine's progress changed since the last progressInfo()
+    ProgressInfo::Status _lastEmittedProgressStatus;
+
     /**
      * When the same local path is synced to multiple accounts, only one
      * of them can be stored in the settings in a way that's compatible
@@ -412,6 +460,17 @@ private:
      * Keeps track of locally dirty files so we can skip local discovery sometimes.
      */
     QScopedPointer<LocalDiscoveryTracker> _localDiscoveryTracker;
+
+    /**
+     * The sweep started by restoreLocalDiscoveryState().
+     *
+     * _sweptPaths are written by the sweep thread and only read once
+     * the sweep is done.
+     */
+    QFutureWatcher<bool> _localChangesSweep;
+    std::set<QByteArray> _sweptPaths;
+    std::atomic<bool> _abortLocalChangesSweep;
+    SyncJournalDb::LocalDiscoveryState _restoredLocalDiscoveryState;
 };
 }
 
@@ -110,6 +110,7 @@ void FolderMan::unloadFolder(Folder *f)
     _socketApi->slotUnregisterPath(f->alias());
 
     _folderMap.remove(f->alias());
+    _folderPathIndexDirty = true;
 
     disconnect(f, &Folder::syncStarted,
         this, &FolderMan::slotFolderSyncStarted);
@@ -134,6 +135,7 @@ int FolderMan::unloadAndDeleteAllFolders()
     while (i.hasNext()) {
         i.next();
         Folder *f = i.value();
+        f->saveLocalDiscoveryState();
         unloadFolder(f);
         delete f;
         cnt++;
@@ -758,6 +760,11 @@ void FolderMan::slotStartScheduledFolderSync()
     Folder *folder = 0;
     while (!_scheduledFolders.isEmpty()) {
         Folder *g = _scheduledFolders.dequeue();
+        if (g->isRestoringLocalDiscoveryState()) {
+            // The folder schedules itself again once that's done
+            qCInfo(lcFolderMan) << "Folder" << g->alias() << "is still looking for local changes";
+            continue;
+        }
         if (g->canSync()) {
             folder = g;
             break;
@@ -973,6 +980,7 @@ Folder *FolderMan::addFolderInternal(FolderDefinition folderDefinition,
 
     qCInfo(lcFolderMan) << "Adding folder to Folder Map " << folder << folder->alias();
     _folderMap[folder->alias()] = folder;
+    _folderPathIndexDirty = true;
     if (folder->syncPaused()) {
         _disabledFolders.insert(folder);
     }
@@ -993,25 +1001,69 @@ Folder *FolderMan::addFolderInternal(FolderDefinition folderDefinition,
     return folder;
 }
 
-Folder *FolderMan::folderForPath(const QString &path, QString *relativePath)
+QString FolderMan::folderPathIndexKey(const QString &component)
 {
-    QString absolutePath = QDir::cleanPath(path) + QLatin1Char('/');
+    // Same as the case insensitive comparison folderForPath() used to do
+    if (Utility::isWindows() || Utility::isMac())
+        return component.toCaseFolded();
+    return component;
+}
 
-    foreach (Folder *folder, this->map().values()) {
-        const QString folderPath = folder->cleanPath() + QLatin1Char('/');
+void FolderMan::rebuildFolderPathIndex()
+{
+    _folderPathIndex.children.clear();
+    _folderPathIndex.folder = nullptr;
+
+    foreach (Folder *folder, _folderMap) {
+        FolderPathNode *node = &_folderPathIndex;
+        foreach (const QString &component, folder->cleanPath().split(QLatin1Char('/'), QString::SkipEmptyParts)) {
+            auto &child = node->children[folderPathIndexKey(component)];
+            if (!child)
+                child.reset(new FolderPathNode);
+            node = child.get();
+        }
+        node->folder = folder;
+    }
+    _folderPathIndexDirty = false;
+}
 
-        if (absolutePath.startsWith(folderPath, (Utility::isWindows() || Utility::isMac()) ? Qt::CaseInsensitive : Qt::CaseSensitive)) {
-            if (relativePath) {
-                *relativePath = absolutePath.mid(folderPath.length());
-                relativePath->chop(1); // we added a '/' above
+Folder *FolderMan::folderForPath(const QString &path, QString *relativePath)
+{
+    if (_folderPathIndexDirty)
+        rebuildFolderPathIndex();
+
+    const QString absolutePath = QDir::cleanPath(path);
+
+    // Walk down the index, the deepest folder on the way wins
+    Folder *folder = nullptr;
+    int folderPathEnd = 0;
+    const FolderPathNode *node = &_folderPathIndex;
+    int start = 0;
+    while (start <= absolutePath.size()) {
+        int end = absolutePath.indexOf(QLatin1Char('/'), start);
+        if (end == -1)
+            end = absolutePath.size();
+        if (end > start) {
+            auto it = node->children.find(folderPathIndexKey(absolutePath.mid(start, end - start)));
+            if (it == node->children.end())
+                break;
+            node = it->second.get();
+            if (node->folder) {
+                folder = node->folder;
+                folderPathEnd = end;
             }
-            return folder;
         }
+        start = end + 1;
     }
 
-    if (relativePath)
-        relativePath->clear();
-    return 0;
+    if (relativePath) {
+        if (folder) {
+            *relativePath = absolutePath.mid(folderPathEnd + 1);
+        } else {
+            relativePath->clear();
+        }
+    }
+    return folder;
 }
 
 QStringList FolderMan::findFileInLocalFolders(const QString &relPath, const AccountPtr acc)
@@ -20,6 +20,9 @@
 #include <QQueue>
 #include <QList>
 
+#include <map>
+#include <memory>
+
 #include "folder.h"
 #include "folderwatcher.h"
 #include "navigationpanehelper.h"
@@ -304,8 +307,22 @@ private:
 
     void setupFoldersHelper(QSettings &settings, AccountStatePtr account, bool backwardsCompatible, const QStringList &ignoreKeys);
 
+    /**
+     * Index used by folderForPath(): one node per path component, a node
+     * has the folder whose path ends with that component.
+     */
+    struct FolderPathNode
+    {
+        std::map<QString, std::unique_ptr<FolderPathNode>> children;
+        Folder *folder = nullptr;
+    };
+    static QString folderPathIndexKey(const QString &component);
+    void rebuildFolderPathIndex();
+
     QSet<Folder *> _disabledFolders;
     Folder::Map _folderMap;
+    FolderPathNode _folderPathIndex;
+    bool _folderPathIndexDirty = true;
     QString _folderConfigPath;
     Folder *_currentSyncFolder;
     QPointer<Folder> _lastSyncFolder;
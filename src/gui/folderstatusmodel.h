@@ -16,6 +16,7 @@
 #define FOLDERSTATUSMODEL_H
 
 #include <accountfwd.h>
+#include "syncfileitem.h"
 #include <QAbstractItemModel>
 #include <QLoggingCategory>
 #include <QVector>
@@ -136,6 +137,7 @@ public slots:
     void slotSyncAllPendingBigFolders();
     void slotSyncNoPendingBigFolders();
     void slotSetProgress(const ProgressInfo &progress);
+    void slotItemCompleted(const QString &folder, const SyncFileItemPtr &item);
 
 private slots:
     void slotUpdateDirectories(const QStringList &);
@@ -32,15 +32,13 @@
 #include "folderwatcher_linux.h"
 #endif
 
-#include "folder.h"
-
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcFolderWatcher, "gui.folderwatcher", QtInfoMsg)
 
-FolderWatcher::FolderWatcher(Folder *folder)
-    : QObject(folder)
-    , _folder(folder)
+FolderWatcher::FolderWatcher(QObject *parent, const ExcludePredicate &isExcluded)
+    : QObject(parent)
+    , _isExcluded(isExcluded)
 {
 }
 
@@ -58,15 +56,13 @@ bool FolderWatcher::pathIsIgnored(const QString &path)
 {
     if (path.isEmpty())
         return true;
-    if (!_folder)
+    if (!_isExcluded)
         return false;
 
-#ifndef OWNCLOUD_TEST
-    if (_folder->isFileExcludedAbsolute(path)) {
+    if (_isExcluded(path)) {
         qCDebug(lcFolderWatcher) << "* Ignoring file" << path;
         return true;
     }
-#endif
     return false;
 }
 
@@ -75,6 +71,11 @@ bool FolderWatcher::isReliable() const
     return _isReliable;
 }
 
+bool FolderWatcher::isReady() const
+{
+    return _isReady;
+}
+
 void FolderWatcher::changeDetected(const QString &path)
 {
     QStringList paths(path);
@@ -27,6 +27,8 @@
 #include <QScopedPointer>
 #include <QSet>
 
+#include <functional>
+
 class QTimer;
 
 namespace OCC {
@@ -34,7 +36,6 @@ namespace OCC {
 Q_DECLARE_LOGGING_CATEGORY(lcFolderWatcher)
 
 class FolderWatcherPrivate;
-class Folder;
 
 /**
  * @brief Monitors a directory recursively for changes
@@ -55,8 +56,11 @@ class FolderWatcher : public QObject
 {
     Q_OBJECT
 public:
+    /** Decides whether changes to an absolute path are ignored */
+    using ExcludePredicate = std::function<bool(const QString &path)>;
+
     // Construct, connect signals, call init()
-    explicit FolderWatcher(Folder *folder = 0L);
+    explicit FolderWatcher(QObject *parent = 0L, const ExcludePredicate &isExcluded = ExcludePredicate());
     virtual ~FolderWatcher();
 
     /**
@@ -84,6 +88,15 @@ public:
      */
     bool isReliable() const;
 
+    /**
+     * Returns false while the watches for the folder are still being set up.
+     *
+     * Changes in directories that aren't watched yet are not noticed.
+     * ready() is emitted once this becomes true. Only the linux backend
+     * needs time for this, see FolderWatcherPrivate.
+     */
+    bool isReady() const;
+
 signals:
     /** Emitted when one of the watched directories or one
      *  of the contained files is changed. */
@@ -105,6 +118,12 @@ signals:
      */
     void becameUnreliable(const QString &message);
 
+    /** Emitted once all watches for the folder were set up, see isReady() */
+    void ready();
+
+    /** Emitted while watches are set up, with the number of watched directories */
+    void registrationProgress(int watchedDirectories);
+
 protected slots:
     // called from the implementations to indicate a change in path
     void changeDetected(const QString &path);
@@ -117,8 +136,9 @@ private:
     QScopedPointer<FolderWatcherPrivate> _d;
     QTime _timer;
     QSet<QString> _lastPaths;
-    Folder *_folder;
+    ExcludePredicate _isExcluded;
     bool _isReliable = true;
+    bool _isReady = true;
 
     friend class FolderWatcherPrivate;
 };
@@ -16,16 +16,32 @@
 
 #include <sys/inotify.h>
 
-#include "folder.h"
 #include "folderwatcher_linux.h"
 
 #include <cerrno>
+#include <deque>
 #include <QStringList>
 #include <QObject>
 #include <QVarLengthArray>
+#include <QDirIterator>
+#include <QFile>
+#include <QtConcurrent>
 
 namespace OCC {
 
+/// Number of directories the walk finds before they get registered
+static const int walkBatchSize = 500;
+
+static int readMaxUserWatches()
+{
+    QFile file(QStringLiteral("/proc/sys/fs/inotify/max_user_watches"));
+    if (!file.open(QIODevice::ReadOnly))
+        return -1;
+    bool ok = false;
+    int value = file.readAll().trimmed().toInt(&ok);
+    return ok ? value : -1;
+}
+
 FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path)
     : QObject()
     , _parent(p)
@@ -38,37 +54,18 @@ FolderWatcherPrivate::FolderWatcherPrivate(FolderWatcher *p, const QString &path
     } else {
         qCWarning(lcFolderWatcher) << "notify_init() failed: " << strerror(errno);
     }
+    _maxUserWatches = readMaxUserWatches();
+
+    connect(&_walk, &QFutureWatcherBase::finished, this, &FolderWatcherPrivate::slotWalkFinished);
 
+    _parent->_isReady = false;
     QMetaObject::invokeMethod(this, "slotAddFolderRecursive", Q_ARG(QString, path));
 }
 
 FolderWatcherPrivate::~FolderWatcherPrivate()
 {
-}
-
-// attention: result list passed by reference!
-bool FolderWatcherPrivate::findFoldersBelow(const QDir &dir, QStringList &fullList)
-{
-    bool ok = true;
-    if (!(dir.exists() && dir.isReadable())) {
-        qCDebug(lcFolderWatcher) << "Non existing path coming in: " << dir.absolutePath();
-        ok = false;
-    } else {
-        QStringList nameFilter;
-        nameFilter << QLatin1String("*");
-        QDir::Filters filter = QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden;
-        const QStringList pathes = dir.entryList(nameFilter, filter);
-
-        QStringList::const_iterator constIterator;
-        for (constIterator = pathes.constBegin(); constIterator != pathes.constEnd();
-             ++constIterator) {
-            const QString fullPath(dir.path() + QLatin1String("/") + (*constIterator));
-            fullList.append(fullPath);
-            ok = findFoldersBelow(QDir(fullPath), fullList);
-        }
-    }
-
-    return ok;
+    _abortWalk = true;
+    _walk.waitForFinished();
 }
 
 void FolderWatcherPrivate::inotifyRegisterPath(const QString &path)
@@ -80,10 +77,11 @@ void FolderWatcherPrivate::inotifyRegisterPath(const QString &path)
             _watches.insert(wd, path);
         } else {
             // If we're running out of memory or inotify watches, become
-            // unreliable.
+            // unreliable. The watches of other processes count towards
+            // max_user_watches too, so ENOSPC can come before the pre-check
+            // in slotFoldersFound() triggers.
             if (_parent->_isReliable && (errno == ENOMEM || errno == ENOSPC)) {
-                _parent->_isReliable = false;
-                emit _parent->becameUnreliable(
+                becomeUnreliable(
                     tr("This problem usually happens when the inotify watches are exhausted. "
                        "Check the FAQ for details."));
             }
@@ -91,38 +89,114 @@ void FolderWatcherPrivate::inotifyRegisterPath(const QString &path)
     }
 }
 
+void FolderWatcherPrivate::becomeUnreliable(const QString &message)
+{
+    _parent->_isReliable = false;
+    emit _parent->becameUnreliable(message);
+
+    // Adding more watches is pointless now
+    _abortWalk = true;
+    _pendingWalks.clear();
+}
+
 void FolderWatcherPrivate::slotAddFolderRecursive(const QString &path)
 {
-    int subdirs = 0;
     qCDebug(lcFolderWatcher) << "(+) Watcher:" << path;
 
-    QDir inPath(path);
-    inotifyRegisterPath(inPath.absolutePath());
+    // The directory itself is watched right away, the ones below
+    // once the walk finds them
+    const QString absolutePath = QDir(path).absolutePath();
+    inotifyRegisterPath(absolutePath);
+    if (!_parent->_isReliable)
+        return;
 
-    const QStringList watchedFolders = _watches.values();
+    _pendingWalks.append(absolutePath);
+    if (_walk.isFinished())
+        startWalk();
+}
 
-    QStringList allSubfolders;
-    if (!findFoldersBelow(QDir(path), allSubfolders)) {
-        qCWarning(lcFolderWatcher) << "Could not traverse all sub folders";
-    }
-    QStringListIterator subfoldersIt(allSubfolders);
-    while (subfoldersIt.hasNext()) {
-        QString subfolder = subfoldersIt.next();
-        QDir folder(subfolder);
-        if (folder.exists() && !watchedFolders.contains(folder.absolutePath())) {
-            subdirs++;
-            if (_parent->pathIsIgnored(subfolder)) {
-                qCDebug(lcFolderWatcher) << "* Not adding" << folder.path();
-                continue;
-            }
-            inotifyRegisterPath(folder.absolutePath());
-        } else {
-            qCDebug(lcFolderWatcher) << "    `-> discarded:" << folder.path();
+void FolderWatcherPrivate::startWalk()
+{
+    QStringList roots;
+    roots.swap(_pendingWalks);
+    _abortWalk = false;
+    _walk.setFuture(QtConcurrent::run([this, roots]() {
+        walkFolders(roots, [this](const QStringList &batch) {
+            QMetaObject::invokeMethod(this, "slotFoldersFound", Qt::QueuedConnection, Q_ARG(QStringList, batch));
+        });
+    }));
+}
+
+void FolderWatcherPrivate::walkFolders(const QStringList &roots,
+    const std::function<void(const QStringList &)> &foundBatch)
+{
+    // Breadth first, so the directories closest to the roots are watched first
+    std::deque<QString> queue(roots.begin(), roots.end());
+    QStringList batch;
+    const QDir::Filters filter = QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden;
+    while (!queue.empty() && !_abortWalk) {
+        QDirIterator it(queue.front(), filter);
+        queue.pop_front();
+        while (it.hasNext()) {
+            const QString path = it.next();
+            batch.append(path);
+            queue.push_back(path);
+        }
+        if (batch.size() >= walkBatchSize) {
+            foundBatch(batch);
+            batch.clear();
         }
     }
+    if (!batch.isEmpty() && !_abortWalk) {
+        foundBatch(batch);
+    }
+}
+
+void FolderWatcherPrivate::slotFoldersFound(const QStringList &folders)
+{
+    if (!_parent->_isReliable)
+        return;
+
+    QStringList watched;
+    watched.reserve(folders.size());
+    for (const auto &folder : folders) {
+        if (!_parent->pathIsIgnored(folder))
+            watched.append(folder);
+    }
+
+    // Other processes share the limit, so this only catches the hopeless
+    // cases early. ENOSPC from inotify_add_watch() catches the others.
+    if (_maxUserWatches > 0 && _watches.size() + watched.size() > _maxUserWatches) {
+        qCWarning(lcFolderWatcher) << "More than" << _maxUserWatches << "folders below" << _folder;
+        becomeUnreliable(
+            tr("This problem usually happens when the inotify watches are exhausted. "
+               "Check the FAQ for details."));
+        return;
+    }
+
+    for (const auto &folder : watched) {
+        // Registering a path twice yields the same watch
+        inotifyRegisterPath(folder);
+        if (!_parent->_isReliable)
+            return;
+    }
+
+    qCDebug(lcFolderWatcher) << "    `-> and" << watched.size() << "subdirectories," << folders.size() - watched.size() << "ignored";
+    emit _parent->registrationProgress(_watches.size());
+}
+
+void FolderWatcherPrivate::slotWalkFinished()
+{
+    if (!_pendingWalks.isEmpty()) {
+        startWalk();
+        return;
+    }
 
-    if (subdirs > 0) {
-        qCDebug(lcFolderWatcher) << "    `-> and" << subdirs << "subdirectories";
+    if (!_initialWalkDone) {
+        _initialWalkDone = true;
+        qCInfo(lcFolderWatcher) << "Watching" << _watches.size() << "folders below" << _folder;
+        _parent->_isReady = true;
+        emit _parent->ready();
     }
 }
 
@@ -20,6 +20,10 @@
 #include <QSocketNotifier>
 #include <QHash>
 #include <QDir>
+#include <QFutureWatcher>
+
+#include <atomic>
+#include <functional>
 
 #include "folderwatcher.h"
 
@@ -27,6 +31,13 @@ namespace OCC {
 
 /**
  * @brief Linux (inotify) API implementation of FolderWatcher
+ *
+ * inotify isn't recursive, every directory needs its own watch. Finding
+ * the directories can take minutes for big trees, so that's done in a
+ * background thread that walks the tree top-down and hands over batches
+ * of directories to register. The watcher becomes ready once the
+ * initial walk is done.
+ *
  * @ingroup gui
  */
 class FolderWatcherPrivate : public QObject
@@ -40,21 +51,46 @@ public:
     void addPath(const QString &path);
     void removePath(const QString &);
 
+    /// The number of directories that are watched
+    int watchCount() const { return _watches.size(); }
+
 protected slots:
     void slotReceivedNotification(int fd);
     void slotAddFolderRecursive(const QString &path);
+    void slotFoldersFound(const QStringList &folders);
+    void slotWalkFinished();
 
 protected:
-    bool findFoldersBelow(const QDir &dir, QStringList &fullList);
     void inotifyRegisterPath(const QString &path);
 
+    /**
+     * Lists all directories below the roots, top-down.
+     *
+     * Runs in a background thread and passes batches of found directories
+     * to foundBatch, which hands them to slotFoldersFound(). Returns early
+     * if _abortWalk is set.
+     */
+    void walkFolders(const QStringList &roots, const std::function<void(const QStringList &)> &foundBatch);
+
 private:
+    void startWalk();
+    void becomeUnreliable(const QString &message);
+
     FolderWatcher *_parent;
 
     QString _folder;
     QHash<int, QString> _watches;
     QScopedPointer<QSocketNotifier> _socket;
     int _fd;
+
+    /// /proc/sys/fs/inotify/max_user_watches, -1 if unknown
+    int _maxUserWatches = -1;
+
+    /// Roots that still need to be walked, and the walk in progress
+    QStringList _pendingWalks;
+    QFutureWatcher<void> _walk;
+    std::atomic<bool> _abortWalk{ false };
+    bool _initialWalkDone = false;
 };
 }
 
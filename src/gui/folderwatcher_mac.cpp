@@ -13,7 +13,6 @@
  */
 #include "config.h"
 
-#include "folder.h"
 #include "folderwatcher.h"
 #include "folderwatcher_mac.h"
 
@@ -46,16 +46,20 @@ namespace OCC {
  */
 static const int maxIssueCount = 50000;
 
-static QPair<QString, QString> pathsWithIssuesKey(const ProtocolItem::ExtraData &data)
+static QPair<QString, QString> pathsWithIssuesKey(const ProtocolItem &item)
 {
-    return qMakePair(data.folderName, data.path);
+    return qMakePair(item.folderName, item.path);
 }
 
 IssuesWidget::IssuesWidget(QWidget *parent)
     : QWidget(parent)
+    , _model(new ProtocolItemModel(maxIssueCount, this))
+    , _sortModel(new ProtocolSortFilterProxyModel(_model, this))
     , _ui(new Ui::IssuesWidget)
 {
     _ui->setupUi(this);
+    _ui->_treeWidget->setModel(_sortModel);
+    connect(_sortModel, &QAbstractItemModel::rowsInserted, this, &IssuesWidget::slotRowsInserted);
 
     connect(ProgressDispatcher::instance(), &ProgressDispatcher::progressInfo,
         this, &IssuesWidget::slotProgressInfo);
@@ -64,11 +68,11 @@ IssuesWidget::IssuesWidget(QWidget *parent)
     connect(ProgressDispatcher::instance(), &ProgressDispatcher::syncError,
         this, &IssuesWidget::addError);
 
-    connect(_ui->_treeWidget, &QTreeWidget::itemActivated, this, &IssuesWidget::slotOpenFile);
+    connect(_ui->_treeWidget, &QTreeView::activated, this, &IssuesWidget::slotOpenFile);
     connect(_ui->copyIssuesButton, &QAbstractButton::clicked, this, &IssuesWidget::copyToClipboard);
 
     _ui->_treeWidget->setContextMenuPolicy(Qt::CustomContextMenu);
-    connect(_ui->_treeWidget, &QTreeWidget::customContextMenuRequested, this, &IssuesWidget::slotItemContextMenu);
+    connect(_ui->_treeWidget, &QTreeView::customContextMenuRequested, this, &IssuesWidget::slotItemContextMenu);
 
     connect(_ui->showIgnores, &QAbstractButton::toggled, this, &IssuesWidget::slotRefreshIssues);
     connect(_ui->showWarnings, &QAbstractButton::toggled, this, &IssuesWidget::slotRefreshIssues);
@@ -98,14 +102,13 @@ IssuesWidget::IssuesWidget(QWidget *parent)
     timestampColumnExtra = 20; // font metrics are broken on Windows, see #4721
 #endif
 
-    _ui->_treeWidget->setHeaderLabels(header);
+    _model->setHeaderLabels(header);
     int timestampColumnWidth =
         ActivityItemDelegate::rowHeight() // icon
         + _ui->_treeWidget->fontMetrics().width(ProtocolItem::timeString(QDateTime::currentDateTime()))
         + timestampColumnExtra;
     _ui->_treeWidget->setColumnWidth(0, timestampColumnWidth);
     _ui->_treeWidget->setColumnWidth(1, 180);
-    _ui->_treeWidget->setColumnCount(4);
     _ui->_treeWidget->setRootIsDecorated(false);
     _ui->_treeWidget->setTextElideMode(Qt::ElideMiddle);
     _ui->_treeWidget->header()->setObjectName("ActivityErrorListHeader");
@@ -113,9 +116,7 @@ IssuesWidget::IssuesWidget(QWidget *parent)
     _ui->_treeWidget->setMinimumWidth(400);
 #endif
 
-    _reenableSorting.setInterval(5000);
-    connect(&_reenableSorting, &QTimer::timeout, this,
-        [this]() { _ui->_treeWidget->setSortingEnabled(true); });
+    slotRefreshIssues();
 
     _ui->_tooManyIssuesWarning->hide();
     connect(this, &IssuesWidget::issueCountUpdated, this,
@@ -156,80 +157,52 @@ void IssuesWidget::hideEvent(QHideEvent *ev)
     QWidget::hideEvent(ev);
 }
 
-static bool persistsUntilLocalDiscovery(QTreeWidgetItem *item)
+static bool persistsUntilLocalDiscovery(const ProtocolItem &item)
 {
-    const auto data = ProtocolItem::extraData(item);
-    return data.status == SyncFileItem::Conflict
-        || (data.status == SyncFileItem::FileIgnored && data.direction == SyncFileItem::Up);
+    return item.status == SyncFileItem::Conflict
+        || (item.status == SyncFileItem::FileIgnored && item.direction == SyncFileItem::Up);
 }
 
-void IssuesWidget::cleanItems(const std::function<bool(QTreeWidgetItem *)> &shouldDelete)
+void IssuesWidget::cleanItems(const std::function<bool(const ProtocolItem &)> &shouldDelete)
 {
-    _ui->_treeWidget->setSortingEnabled(false);
-
     // The issue list is a state, clear it and let the next sync fill it
     // with ignored files and propagation errors.
-    int itemCnt = _ui->_treeWidget->topLevelItemCount();
-    for (int cnt = itemCnt - 1; cnt >= 0; cnt--) {
-        QTreeWidgetItem *item = _ui->_treeWidget->topLevelItem(cnt);
-        if (shouldDelete(item)) {
-            _pathsWithIssues.remove(pathsWithIssuesKey(ProtocolItem::extraData(item)));
-            delete item;
-        }
-    }
-
-    _ui->_treeWidget->setSortingEnabled(true);
+    _model->removeItems([&](const ProtocolItem &item) {
+        if (!shouldDelete(item))
+            return false;
+        _pathsWithIssues.remove(pathsWithIssuesKey(item));
+        return true;
+    });
 
     // update the tabtext
-    emit(issueCountUpdated(_ui->_treeWidget->topLevelItemCount()));
+    emit(issueCountUpdated(_model->itemCount()));
 }
 
-void IssuesWidget::addItem(QTreeWidgetItem *item)
+void IssuesWidget::addItem(const ProtocolItem &item)
 {
-    if (!item)
+    if (!item.isValid())
         return;
 
-    int count = _ui->_treeWidget->topLevelItemCount();
-    if (count >= maxIssueCount)
+    if (_model->itemCount() >= maxIssueCount)
         return;
 
-    _ui->_treeWidget->setSortingEnabled(false);
-    _reenableSorting.start();
-
-    // Insert item specific errors behind the others
-    int insertLoc = 0;
-    if (!item->text(1).isEmpty()) {
-        for (int i = 0; i < count; ++i) {
-            if (_ui->_treeWidget->topLevelItem(i)->text(1).isEmpty()) {
-                insertLoc = i + 1;
-            } else {
-                break;
-            }
-        }
-    }
-
     // Wipe any existing message for the same folder and path
-    auto newData = ProtocolItem::extraData(item);
-    if (_pathsWithIssues.contains(pathsWithIssuesKey(newData))) {
-        for (int i = 0; i < count; ++i) {
-            auto otherItem = _ui->_treeWidget->topLevelItem(i);
-            auto otherData = ProtocolItem::extraData(otherItem);
-            if (otherData.path == newData.path && otherData.folderName == newData.folderName) {
-                delete otherItem;
-                break;
-            }
-        }
+    auto key = pathsWithIssuesKey(item);
+    if (_pathsWithIssues.contains(key)) {
+        _model->removeItems([&](const ProtocolItem &other) {
+            return pathsWithIssuesKey(other) == key;
+        });
     }
 
-    _ui->_treeWidget->insertTopLevelItem(insertLoc, item);
-    _pathsWithIssues.insert(pathsWithIssuesKey(newData));
-    item->setHidden(!shouldBeVisible(item, currentAccountFilter(), currentFolderFilter()));
-    emit issueCountUpdated(_ui->_treeWidget->topLevelItemCount());
+    _model->addItem(item);
+    _pathsWithIssues.insert(key);
+    emit issueCountUpdated(_model->itemCount());
 }
 
-void IssuesWidget::slotOpenFile(QTreeWidgetItem *item, int)
+void IssuesWidget::slotOpenFile(const QModelIndex &index)
 {
-    QString fileName = item->text(1);
+    const auto &item = _sortModel->item(index);
+    QString fileName = item.fileName;
     if (Folder *folder = ProtocolItem::folder(item)) {
         // folder->path() always comes back with trailing path
         QString fullPath = folder->path() + fileName;
@@ -249,8 +222,8 @@ void IssuesWidget::slotProgressInfo(const QString &folder, const ProgressInfo &p
             return;
         const auto &engine = f->syncEngine();
         const auto style = engine.lastLocalDiscoveryStyle();
-        cleanItems([&](QTreeWidgetItem *item) {
-            if (ProtocolItem::extraData(item).folderName != folder)
+        cleanItems([&](const ProtocolItem &item) {
+            if (item.folderName != folder)
                 return false;
             if (style == LocalDiscoveryStyle::FilesystemOnly)
                 return true;
@@ -258,10 +231,10 @@ void IssuesWidget::slotProgressInfo(const QString &folder, const ProgressInfo &p
                 return true;
 
             // Definitely wipe the entry if the file no longer exists
-            if (!QFileInfo(f->path() + ProtocolItem::extraData(item).path).exists())
+            if (!QFileInfo(f->path() + item.path).exists())
                 return true;
 
-            auto path = QFileInfo(ProtocolItem::extraData(item).path).dir().path().toUtf8();
+            auto path = QFileInfo(item.path).dir().path().toUtf8();
             if (path == ".")
                 path.clear();
 
@@ -272,13 +245,12 @@ void IssuesWidget::slotProgressInfo(const QString &folder, const ProgressInfo &p
         // We keep track very well of pending conflicts.
         // Inform other components about them.
         QStringList conflicts;
-        auto tree = _ui->_treeWidget;
-        for (int i = 0; i < tree->topLevelItemCount(); ++i) {
-            auto item = tree->topLevelItem(i);
-            auto data = ProtocolItem::extraData(item);
-            if (data.folderName == folder
-                && data.status == SyncFileItem::Conflict) {
-                conflicts.append(data.path);
+        _model->flushPendingItems();
+        for (int i = 0; i < _model->rowCount(); ++i) {
+            const auto &item = _model->item(i);
+            if (item.folderName == folder
+                && item.status == SyncFileItem::Conflict) {
+                conflicts.append(item.path);
             }
         }
         emit ProgressDispatcher::instance()->folderConflicts(folder, conflicts);
@@ -291,22 +263,19 @@ void IssuesWidget::slotItemCompleted(const QString &folder, const SyncFileItemPt
 {
     if (!item->showInIssuesTab())
         return;
-    QTreeWidgetItem *line = ProtocolItem::create(folder, *item);
-    if (!line)
-        return;
-    addItem(line);
+    addItem(ProtocolItem::create(folder, *item));
 }
 
 void IssuesWidget::slotRefreshIssues()
 {
-    auto tree = _ui->_treeWidget;
     auto filterFolderAlias = currentFolderFilter();
     auto filterAccount = currentAccountFilter();
+    bool showIgnores = _ui->showIgnores->isChecked();
+    bool showWarnings = _ui->showWarnings->isChecked();
 
-    for (int i = 0; i < tree->topLevelItemCount(); ++i) {
-        auto item = tree->topLevelItem(i);
-        item->setHidden(!shouldBeVisible(item, filterAccount, filterFolderAlias));
-    }
+    _sortModel->setFilter([=](const ProtocolItem &item) {
+        return shouldBeVisible(item, filterAccount, filterFolderAlias, showIgnores, showWarnings);
+    });
 
     _ui->_treeWidget->setColumnHidden(2, !filterFolderAlias.isEmpty());
 }
@@ -328,11 +297,23 @@ void IssuesWidget::slotAccountRemoved(AccountState *account)
 
 void IssuesWidget::slotItemContextMenu(const QPoint &pos)
 {
-    auto item = _ui->_treeWidget->itemAt(pos);
-    if (!item)
+    auto index = _ui->_treeWidget->indexAt(pos);
+    if (!index.isValid())
         return;
     auto globalPos = _ui->_treeWidget->viewport()->mapToGlobal(pos);
-    ProtocolItem::openContextMenu(globalPos, item, this);
+    ProtocolItem::openContextMenu(globalPos, _sortModel->item(index), this);
+}
+
+void IssuesWidget::slotRowsInserted(const QModelIndex &parent, int first, int last)
+{
+    // Rows also get inserted into the proxy when the filter changes,
+    // so this covers items that were hidden when they were added.
+    for (int row = first; row <= last; ++row) {
+        auto index = _sortModel->index(row, ProtocolItemModel::ActionColumn, parent);
+        const auto &item = _sortModel->item(index);
+        if (item.category != ErrorCategory::Normal && !_ui->_treeWidget->indexWidget(index))
+            addErrorWidget(index, item);
+    }
 }
 
 void IssuesWidget::updateAccountChoiceVisibility()
@@ -353,18 +334,17 @@ QString IssuesWidget::currentFolderFilter() const
     return _ui->filterFolder->currentData().toString();
 }
 
-bool IssuesWidget::shouldBeVisible(QTreeWidgetItem *item, AccountState *filterAccount,
-    const QString &filterFolderAlias) const
+bool IssuesWidget::shouldBeVisible(const ProtocolItem &item, AccountState *filterAccount,
+    const QString &filterFolderAlias, bool showIgnores, bool showWarnings) const
 {
     bool visible = true;
-    auto data = ProtocolItem::extraData(item);
-    auto status = data.status;
-    visible &= (_ui->showIgnores->isChecked() || status != SyncFileItem::FileIgnored);
-    visible &= (_ui->showWarnings->isChecked()
+    auto status = item.status;
+    visible &= (showIgnores || status != SyncFileItem::FileIgnored);
+    visible &= (showWarnings
         || (status != SyncFileItem::SoftError
                && status != SyncFileItem::Restoration));
 
-    const auto &folderalias = data.folderName;
+    const auto &folderalias = item.folderName;
     if (filterAccount) {
         auto folder = FolderMan::instance()->folder(folderalias);
         visible &= folder && folder->accountState() == filterAccount;
@@ -420,34 +400,34 @@ void IssuesWidget::slotUpdateFolderFilters()
 
 void IssuesWidget::storeSyncIssues(QTextStream &ts)
 {
-    int topLevelItems = _ui->_treeWidget->topLevelItemCount();
+    // Only the visible items are in _sortModel
+    _model->flushPendingItems();
+    int rows = _sortModel->rowCount();
 
-    for (int i = 0; i < topLevelItems; i++) {
-        QTreeWidgetItem *child = _ui->_treeWidget->topLevelItem(i);
-        if (child->isHidden())
-            continue;
+    for (int i = 0; i < rows; i++) {
+        auto text = [&](int column) { return _sortModel->index(i, column).data().toString(); };
         ts << right
            // time stamp
            << qSetFieldWidth(20)
-           << child->data(0, Qt::DisplayRole).toString()
+           << text(0)
            // separator
            << qSetFieldWidth(0) << ","
 
            // file name
            << qSetFieldWidth(64)
-           << child->data(1, Qt::DisplayRole).toString()
+           << text(1)
            // separator
            << qSetFieldWidth(0) << ","
 
            // folder
            << qSetFieldWidth(30)
-           << child->data(2, Qt::DisplayRole).toString()
+           << text(2)
            // separator
            << qSetFieldWidth(0) << ","
 
            // action
            << qSetFieldWidth(15)
-           << child->data(3, Qt::DisplayRole).toString()
+           << text(3)
            << qSetFieldWidth(0)
            << endl;
     }
@@ -474,57 +454,39 @@ void IssuesWidget::addError(const QString &folderAlias, const QString &message,
     if (!folder)
         return;
 
-    QStringList columns;
-    QDateTime timestamp = QDateTime::currentDateTime();
-    const QString timeStr = ProtocolItem::timeString(timestamp);
-    const QString longTimeStr = ProtocolItem::timeString(timestamp, QLocale::LongFormat);
-
-    columns << timeStr;
-    columns << ""; // no "File" entry
-    columns << folder->shortGuiLocalPath();
-    columns << message;
-
-    QIcon icon = Theme::instance()->syncStateIcon(SyncResult::Error);
-
-    QTreeWidgetItem *twitem = new ProtocolItem(columns);
-    twitem->setData(0, Qt::SizeHintRole, QSize(0, ActivityItemDelegate::rowHeight()));
-    twitem->setIcon(0, icon);
-    twitem->setToolTip(0, longTimeStr);
-    twitem->setToolTip(3, message);
-    ProtocolItem::ExtraData data;
-    data.timestamp = timestamp;
-    data.folderName = folderAlias;
-    data.status = SyncFileItem::NormalError;
-    ProtocolItem::setExtraData(twitem, data);
-
-    addItem(twitem);
-    addErrorWidget(twitem, message, category);
+    ProtocolItem item;
+    item.timestamp = QDateTime::currentDateTime();
+    item.folderName = folderAlias;
+    item.folderDisplayName = folder->shortGuiLocalPath();
+    item.message = message;
+    item.category = category;
+    item.status = SyncFileItem::NormalError;
+
+    addItem(item);
 }
 
-void IssuesWidget::addErrorWidget(QTreeWidgetItem *item, const QString &message, ErrorCategory category)
+void IssuesWidget::addErrorWidget(const QModelIndex &index, const ProtocolItem &item)
 {
     QWidget *widget = 0;
-    if (category == ErrorCategory::InsufficientRemoteStorage) {
+    if (item.category == ErrorCategory::InsufficientRemoteStorage) {
         widget = new QWidget;
         auto layout = new QHBoxLayout;
         widget->setLayout(layout);
 
-        auto label = new ElidedLabel(message, widget);
+        auto label = new ElidedLabel(item.message, widget);
         label->setElideMode(Qt::ElideMiddle);
         layout->addWidget(label);
 
         auto button = new QPushButton("Retry all uploads", widget);
         button->setSizePolicy(QSizePolicy::Maximum, QSizePolicy::Expanding);
-        auto folderAlias = ProtocolItem::extraData(item).folderName;
+        auto folderAlias = item.folderName;
         connect(button, &QPushButton::clicked,
             this, [this, folderAlias]() { retryInsufficentRemoteStorageErrors(folderAlias); });
         layout->addWidget(button);
     }
 
-    if (widget) {
-        item->setText(3, QString());
-    }
-    _ui->_treeWidget->setItemWidget(item, 3, widget);
+    if (widget)
+        _ui->_treeWidget->setIndexWidget(index, widget);
 }
 
 void IssuesWidget::retryInsufficentRemoteStorageErrors(const QString &folderAlias)
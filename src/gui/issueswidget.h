@@ -18,10 +18,10 @@
 #include <QDialog>
 #include <QDateTime>
 #include <QLocale>
-#include <QTimer>
 
 #include "progressdispatcher.h"
 #include "owncloudgui.h"
+#include "protocolitemmodel.h"
 
 #include "ui_issueswidget.h"
 
@@ -54,7 +54,7 @@ public slots:
     void addError(const QString &folderAlias, const QString &message, ErrorCategory category);
     void slotProgressInfo(const QString &folder, const ProgressInfo &progress);
     void slotItemCompleted(const QString &folder, const SyncFileItemPtr &item);
-    void slotOpenFile(QTreeWidgetItem *item, int);
+    void slotOpenFile(const QModelIndex &index);
 
 protected:
     void showEvent(QShowEvent *);
@@ -70,28 +70,28 @@ private slots:
     void slotAccountAdded(AccountState *account);
     void slotAccountRemoved(AccountState *account);
     void slotItemContextMenu(const QPoint &pos);
+    void slotRowsInserted(const QModelIndex &parent, int first, int last);
 
 private:
     void updateAccountChoiceVisibility();
     AccountState *currentAccountFilter() const;
     QString currentFolderFilter() const;
-    bool shouldBeVisible(QTreeWidgetItem *item, AccountState *filterAccount,
-        const QString &filterFolderAlias) const;
-    void cleanItems(const std::function<bool(QTreeWidgetItem *)> &shouldDelete);
-    void addItem(QTreeWidgetItem *item);
+    bool shouldBeVisible(const ProtocolItem &item, AccountState *filterAccount,
+        const QString &filterFolderAlias, bool showIgnores, bool showWarnings) const;
+    void cleanItems(const std::function<bool(const ProtocolItem &)> &shouldDelete);
+    void addItem(const ProtocolItem &item);
 
     /// Add the special error widget for the category, if any
-    void addErrorWidget(QTreeWidgetItem *item, const QString &message, ErrorCategory category);
+    void addErrorWidget(const QModelIndex &index, const ProtocolItem &item);
 
     /// Wipes all insufficient remote storgage blacklist entries
     void retryInsufficentRemoteStorageErrors(const QString &folderAlias);
 
-    /// Each insert disables sorting, this timer reenables it
-    QTimer _reenableSorting;
-
     /// Optimization: keep track of all folder/paths pairs that have an associated issue
     QSet<QPair<QString, QString>> _pathsWithIssues;
 
+    ProtocolItemModel *_model;
+    ProtocolSortFilterProxyModel *_sortModel;
     Ui::IssuesWidget *_ui;
 };
 }
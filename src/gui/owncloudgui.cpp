@@ -78,6 +78,8 @@ ownCloudGui::ownCloudGui(Application *parent)
     ProgressDispatcher *pd = ProgressDispatcher::instance();
     connect(pd, &ProgressDispatcher::progressInfo, this,
         &ownCloudGui::slotUpdateProgress);
+    connect(pd, &ProgressDispatcher::itemCompleted, this,
+        &ownCloudGui::slotAddRecentItem);
 
     FolderMan *folderMan = FolderMan::instance();
     connect(folderMan, &FolderMan::folderSyncStateChange,
@@ -878,39 +880,43 @@ void ownCloudGui::slotUpdateProgress(const QString &folder, const ProgressInfo &
     }
 
     _actionRecent->setIcon(QIcon()); // Fixme: Set a "in-progress"-item eventually.
+}
 
-    if (!progress._lastCompletedItem.isEmpty()
-        && shouldShowInRecentsMenu(progress._lastCompletedItem)) {
-        if (Progress::isWarningKind(progress._lastCompletedItem._status)) {
-            // display a warn icon if warnings happened.
-            QIcon warnIcon(":/client/resources/warning");
-            _actionRecent->setIcon(warnIcon);
-        }
+// The completed items come one by one, the progress notifications are coalesced
+void ownCloudGui::slotAddRecentItem(const QString &folder, const SyncFileItemPtr &item)
+{
+    if (!ProgressInfo::shouldCountProgress(*item) || !shouldShowInRecentsMenu(*item))
+        return;
 
-        QString kindStr = Progress::asResultString(progress._lastCompletedItem);
-        QString timeStr = QTime::currentTime().toString("hh:mm");
-        QString actionText = tr("%1 (%2, %3)").arg(progress._lastCompletedItem._file, kindStr, timeStr);
-        QAction *action = new QAction(actionText, this);
-        Folder *f = FolderMan::instance()->folder(folder);
-        if (f) {
-            QString fullPath = f->path() + '/' + progress._lastCompletedItem._file;
-            if (QFile(fullPath).exists()) {
-                connect(action, &QAction::triggered, this, [this, fullPath] { this->slotOpenPath(fullPath); });
-            } else {
-                action->setEnabled(false);
-            }
-        }
-        if (_recentItemsActions.length() > 5) {
-            _recentItemsActions.takeFirst()->deleteLater();
-        }
-        _recentItemsActions.append(action);
+    if (Progress::isWarningKind(item->_status)) {
+        // display a warn icon if warnings happened.
+        QIcon warnIcon(":/client/resources/warning");
+        _actionRecent->setIcon(warnIcon);
+    }
 
-        // Update the "Recent" menu if the context menu is being shown,
-        // otherwise it'll be updated later, when the context menu is opened.
-        if (updateWhileVisible() && contextMenuVisible()) {
-            slotRebuildRecentMenus();
+    QString kindStr = Progress::asResultString(*item);
+    QString timeStr = QTime::currentTime().toString("hh:mm");
+    QString actionText = tr("%1 (%2, %3)").arg(item->_file, kindStr, timeStr);
+    QAction *action = new QAction(actionText, this);
+    Folder *f = FolderMan::instance()->folder(folder);
+    if (f) {
+        QString fullPath = f->path() + '/' + item->_file;
+        if (QFile(fullPath).exists()) {
+            connect(action, &QAction::triggered, this, [this, fullPath] { this->slotOpenPath(fullPath); });
+        } else {
+            action->setEnabled(false);
         }
     }
+    if (_recentItemsActions.length() > 5) {
+        _recentItemsActions.takeFirst()->deleteLater();
+    }
+    _recentItemsActions.append(action);
+
+    // Update the "Recent" menu if the context menu is being shown,
+    // otherwise it'll be updated later, when the context menu is opened.
+    if (updateWhileVisible() && contextMenuVisible()) {
+        slotRebuildRecentMenus();
+    }
 }
 
 void ownCloudGui::slotLogin()
@@ -76,6 +76,7 @@ public slots:
     void slotFolderOpenAction(const QString &alias);
     void slotRebuildRecentMenus();
     void slotUpdateProgress(const QString &folder, const ProgressInfo &progress);
+    void slotAddRecentItem(const QString &folder, const SyncFileItemPtr &item);
     void slotShowGuiMessage(const QString &title, const QString &message);
     void slotFoldersChanged();
     void slotShowSettings();
@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include <QtWidgets>
+
+#include "protocolitemmodel.h"
+#include "protocolwidget.h"
+#include "syncresult.h"
+#include "theme.h"
+#include "folderman.h"
+#include "folder.h"
+#include "activityitemdelegate.h"
+#include "guiutility.h"
+#include "accountstate.h"
+#include "common/utility.h"
+
+#include <tuple>
+
+namespace OCC {
+
+QString ProtocolItem::timeString(QDateTime dt, QLocale::FormatType format)
+{
+    const QLocale loc = QLocale::system();
+    QString dtFormat = loc.dateTimeFormat(format);
+    static const QRegExp re("(HH|H|hh|h):mm(?!:s)");
+    dtFormat.replace(re, "\\1:mm:ss");
+    return loc.toString(dt, dtFormat);
+}
+
+ProtocolItem ProtocolItem::create(const QString &folder, const SyncFileItem &item)
+{
+    ProtocolItem result;
+    auto f = FolderMan::instance()->folder(folder);
+    if (!f) {
+        return result;
+    }
+
+    result.timestamp = QDateTime::currentDateTime();
+    result.path = item._file;
+    result.fileName = Utility::fileNameForGuiUse(item._originalFile);
+    result.folderName = folder;
+    result.folderDisplayName = f->shortGuiLocalPath();
+
+    // If the error string is set, it's prefered because it is a useful user message.
+    result.message = item._errorString;
+    if (result.message.isEmpty()) {
+        result.message = Progress::asResultString(item);
+    }
+
+    result.status = item._status;
+    result.direction = item._direction;
+    result.size = item._size;
+    result.showSize = ProgressInfo::isSizeDependent(item);
+    return result;
+}
+
+SyncJournalFileRecord ProtocolItem::syncJournalRecord(const ProtocolItem &item)
+{
+    SyncJournalFileRecord rec;
+    auto f = folder(item);
+    if (!f)
+        return rec;
+    f->journalDb()->getFileRecord(item.path, &rec);
+    return rec;
+}
+
+Folder *ProtocolItem::folder(const ProtocolItem &item)
+{
+    return FolderMan::instance()->folder(item.folderName);
+}
+
+void ProtocolItem::openContextMenu(QPoint globalPos, const ProtocolItem &item, QWidget *parent)
+{
+    auto f = folder(item);
+    if (!f)
+        return;
+    AccountPtr account = f->accountState()->account();
+    auto rec = syncJournalRecord(item);
+    // rec might not be valid
+
+    auto menu = new QMenu(parent);
+
+    if (rec.isValid()) {
+        // "Open in Browser" action
+        auto openInBrowser = menu->addAction(ProtocolWidget::tr("Open in browser"));
+        QObject::connect(openInBrowser, &QAction::triggered, parent, [parent, account, rec]() {
+            fetchPrivateLinkUrl(account, rec._path, rec.numericFileId(), parent,
+                [parent](const QString &url) {
+                    Utility::openBrowser(url, parent);
+                });
+        });
+    }
+
+    // More actions will be conditionally added to the context menu here later
+
+    if (menu->actions().isEmpty()) {
+        delete menu;
+        return;
+    }
+
+    menu->setAttribute(Qt::WA_DeleteOnClose);
+    menu->popup(globalPos);
+}
+
+ProtocolItemModel::ProtocolItemModel(int maxItems, QObject *parent)
+    : QAbstractTableModel(parent)
+    , _maxItems(maxItems)
+{
+    _flushTimer.setSingleShot(true);
+    _flushTimer.setInterval(0);
+    connect(&_flushTimer, &QTimer::timeout, this, &ProtocolItemModel::flushPendingItems);
+}
+
+void ProtocolItemModel::setHeaderLabels(const QStringList &labels)
+{
+    beginResetModel();
+    _headerLabels = labels;
+    endResetModel();
+}
+
+void ProtocolItemModel::addItem(const ProtocolItem &item)
+{
+    _pendingItems.append(item);
+    if (!_flushTimer.isActive())
+        _flushTimer.start();
+}
+
+void ProtocolItemModel::flushPendingItems()
+{
+    _flushTimer.stop();
+    if (_pendingItems.isEmpty())
+        return;
+
+    // Only the newest _maxItems can survive anyway
+    if (_pendingItems.size() > _maxItems) {
+        _pendingItems.erase(_pendingItems.begin(), _pendingItems.end() - _maxItems);
+    }
+
+    int overflow = int(_items.size()) + _pendingItems.size() - _maxItems;
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        _items.erase(_items.begin(), _items.begin() + overflow);
+        endRemoveRows();
+    }
+
+    int first = int(_items.size());
+    beginInsertRows(QModelIndex(), first, first + _pendingItems.size() - 1);
+    _items.insert(_items.end(), _pendingItems.constBegin(), _pendingItems.constEnd());
+    endInsertRows();
+    _pendingItems.clear();
+}
+
+void ProtocolItemModel::removeItems(const std::function<bool(const ProtocolItem &)> &shouldRemove)
+{
+    flushPendingItems();
+
+    // Remove contiguous ranges, starting at the end so the rows before stay valid
+    int last = -1;
+    for (int row = int(_items.size()) - 1; row >= -1; --row) {
+        bool remove = row >= 0 && shouldRemove(_items[row]);
+        if (remove && last == -1) {
+            last = row;
+        } else if (!remove && last != -1) {
+            beginRemoveRows(QModelIndex(), row + 1, last);
+            _items.erase(_items.begin() + row + 1, _items.begin() + last + 1);
+            endRemoveRows();
+            last = -1;
+        }
+    }
+}
+
+int ProtocolItemModel::itemCount() const
+{
+    return int(_items.size()) + _pendingItems.size();
+}
+
+const ProtocolItem &ProtocolItemModel::item(int row) const
+{
+    return _items[row];
+}
+
+int ProtocolItemModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return int(_items.size());
+}
+
+int ProtocolItemModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return _headerLabels.size();
+}
+
+QIcon ProtocolItemModel::statusIcon(SyncFileItem::Status status) const
+{
+    if (status == SyncFileItem::NormalError
+        || status == SyncFileItem::FatalError
+        || status == SyncFileItem::DetailError
+        || status == SyncFileItem::BlacklistedError) {
+        if (_errorIcon.isNull())
+            _errorIcon = Theme::instance()->syncStateIcon(SyncResult::Error);
+        return _errorIcon;
+    } else if (Progress::isWarningKind(status)) {
+        if (_warningIcon.isNull())
+            _warningIcon = Theme::instance()->syncStateIcon(SyncResult::Problem);
+        return _warningIcon;
+    }
+    return QIcon();
+}
+
+QVariant ProtocolItemModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount())
+        return QVariant();
+
+    // Warning: The data and tooltips on the columns define an implicit
+    // interface and can only be changed with care.
+    const ProtocolItem &item = _items[index.row()];
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case TimeColumn:
+            return ProtocolItem::timeString(item.timestamp);
+        case FileColumn:
+            return item.fileName;
+        case FolderColumn:
+            return item.folderDisplayName;
+        case ActionColumn:
+            // Special categories get a widget that shows the message
+            if (item.category != ErrorCategory::Normal)
+                return QString();
+            return item.message;
+        case SizeColumn:
+            if (item.showSize)
+                return Utility::octetsToString(item.size);
+            return QString();
+        }
+        break;
+    case Qt::DecorationRole:
+        if (index.column() == TimeColumn)
+            return statusIcon(item.status);
+        break;
+    case Qt::ToolTipRole:
+        switch (index.column()) {
+        case TimeColumn:
+            return ProtocolItem::timeString(item.timestamp, QLocale::LongFormat);
+        case FileColumn:
+            return item.path;
+        case ActionColumn:
+            return item.message;
+        }
+        break;
+    case Qt::SizeHintRole:
+        if (index.column() == TimeColumn)
+            return QSize(0, ActivityItemDelegate::rowHeight());
+        break;
+    }
+    return QVariant();
+}
+
+QVariant ProtocolItemModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole)
+        return _headerLabels.value(section);
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+ProtocolSortFilterProxyModel::ProtocolSortFilterProxyModel(ProtocolItemModel *source, QObject *parent)
+    : QSortFilterProxyModel(parent)
+    , _source(source)
+{
+    setSourceModel(source);
+    setDynamicSortFilter(true);
+}
+
+void ProtocolSortFilterProxyModel::setFilter(const Filter &filter)
+{
+    _filter = filter;
+    invalidateFilter();
+}
+
+const ProtocolItem &ProtocolSortFilterProxyModel::item(const QModelIndex &proxyIndex) const
+{
+    return _source->item(mapToSource(proxyIndex).row());
+}
+
+bool ProtocolSortFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &) const
+{
+    return !_filter || _filter(_source->item(sourceRow));
+}
+
+bool ProtocolSortFilterProxyModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
+{
+    const auto &leftItem = _source->item(left.row());
+    const auto &rightItem = _source->item(right.row());
+
+    if (left.column() == ProtocolItemModel::TimeColumn) {
+        // Items with empty "File" column are larger than others,
+        // otherwise sort by time (this uses lexicographic ordering)
+        return std::forward_as_tuple(leftItem.fileName.isEmpty(), leftItem.timestamp)
+            < std::forward_as_tuple(rightItem.fileName.isEmpty(), rightItem.timestamp);
+    } else if (left.column() == ProtocolItemModel::SizeColumn) {
+        return leftItem.size < rightItem.size;
+    }
+
+    return QSortFilterProxyModel::lessThan(left, right);
+}
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef PROTOCOLITEMMODEL_H
+#define PROTOCOLITEMMODEL_H
+
+#include <QAbstractTableModel>
+#include <QSortFilterProxyModel>
+#include <QDateTime>
+#include <QIcon>
+#include <QLocale>
+#include <QPoint>
+#include <QTimer>
+
+#include <deque>
+#include <functional>
+
+#include "progressdispatcher.h"
+#include "syncfileitem.h"
+#include "common/syncjournalfilerecord.h"
+
+class QWidget;
+
+namespace OCC {
+
+class Folder;
+
+/**
+ * One line in the protocol and issue lists.
+ *
+ * This is a plain value: the views get everything they display through
+ * ProtocolItemModel.
+ */
+class ProtocolItem
+{
+public:
+    ProtocolItem()
+        : status(SyncFileItem::NoStatus)
+        , direction(SyncFileItem::None)
+    {
+    }
+
+    // Shared with IssueWidget
+    static ProtocolItem create(const QString &folder, const SyncFileItem &item);
+    static QString timeString(QDateTime dt, QLocale::FormatType format = QLocale::NarrowFormat);
+
+    static SyncJournalFileRecord syncJournalRecord(const ProtocolItem &item);
+    static Folder *folder(const ProtocolItem &item);
+
+    static void openContextMenu(QPoint globalPos, const ProtocolItem &item, QWidget *parent);
+
+    /** False if the item was created for an unknown folder */
+    bool isValid() const { return !folderName.isEmpty(); }
+
+    QDateTime timestamp;
+    QString path; // relative to the folder, as in the journal
+    QString fileName; // for display, empty for folder-wide errors
+    QString folderName; // the folder alias
+    QString folderDisplayName;
+    QString message;
+    quint64 size = 0;
+    bool showSize = false;
+    ErrorCategory category = ErrorCategory::Normal;
+    SyncFileItem::Status status BITFIELD(4);
+    SyncFileItem::Direction direction BITFIELD(3);
+};
+
+/**
+ * @brief Bounded table model backing the protocol and issue views
+ * @ingroup gui
+ *
+ * Items are kept in insertion order. Once maxItems is reached the oldest
+ * items are dropped, so memory stays bounded no matter how many items a
+ * sync produces. Every completed item is still written to disk by
+ * SyncRunFileLog.
+ *
+ * New items are queued and inserted in one batch per event loop iteration
+ * to avoid one row insertion (and view update) per completed item.
+ */
+class ProtocolItemModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column {
+        TimeColumn = 0,
+        FileColumn,
+        FolderColumn,
+        ActionColumn,
+        SizeColumn
+    };
+
+    explicit ProtocolItemModel(int maxItems, QObject *parent = 0);
+
+    /// Also defines the number of columns
+    void setHeaderLabels(const QStringList &labels);
+
+    /** Queue an item, it will be inserted in the next event loop iteration */
+    void addItem(const ProtocolItem &item);
+
+    /** Insert all queued items immediately */
+    void flushPendingItems();
+
+    /** Removes all matching items, including queued ones */
+    void removeItems(const std::function<bool(const ProtocolItem &)> &shouldRemove);
+
+    /** Number of items, including the queued ones */
+    int itemCount() const;
+
+    const ProtocolItem &item(int row) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+
+private:
+    QIcon statusIcon(SyncFileItem::Status status) const;
+
+    std::deque<ProtocolItem> _items;
+    QVector<ProtocolItem> _pendingItems;
+    QTimer _flushTimer;
+    int _maxItems;
+    QStringList _headerLabels;
+
+    mutable QIcon _errorIcon;
+    mutable QIcon _warningIcon;
+};
+
+/**
+ * @brief Sorting and filtering on top of ProtocolItemModel
+ * @ingroup gui
+ *
+ * Changing the filter only updates the proxy mapping, the views and the
+ * underlying items are kept.
+ */
+class ProtocolSortFilterProxyModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+public:
+    using Filter = std::function<bool(const ProtocolItem &)>;
+
+    explicit ProtocolSortFilterProxyModel(ProtocolItemModel *source, QObject *parent = 0);
+
+    /** Only items for which filter returns true are shown, an empty filter shows all */
+    void setFilter(const Filter &filter);
+
+    const ProtocolItem &item(const QModelIndex &proxyIndex) const;
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+    bool lessThan(const QModelIndex &left, const QModelIndex &right) const override;
+
+private:
+    ProtocolItemModel *_source;
+    Filter _filter;
+};
+}
+
+#endif // PROTOCOLITEMMODEL_H
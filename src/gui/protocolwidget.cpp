@@ -32,161 +32,29 @@
 
 #include <climits>
 
-Q_DECLARE_METATYPE(OCC::ProtocolItem::ExtraData)
-
 namespace OCC {
 
-QString ProtocolItem::timeString(QDateTime dt, QLocale::FormatType format)
-{
-    const QLocale loc = QLocale::system();
-    QString dtFormat = loc.dateTimeFormat(format);
-    static const QRegExp re("(HH|H|hh|h):mm(?!:s)");
-    dtFormat.replace(re, "\\1:mm:ss");
-    return loc.toString(dt, dtFormat);
-}
-
-ProtocolItem::ExtraData ProtocolItem::extraData(const QTreeWidgetItem *item)
-{
-    return item->data(0, Qt::UserRole).value<ExtraData>();
-}
-
-void ProtocolItem::setExtraData(QTreeWidgetItem *item, const ExtraData &data)
-{
-    item->setData(0, Qt::UserRole, QVariant::fromValue(data));
-}
-
-ProtocolItem *ProtocolItem::create(const QString &folder, const SyncFileItem &item)
-{
-    auto f = FolderMan::instance()->folder(folder);
-    if (!f) {
-        return 0;
-    }
-
-    QStringList columns;
-    QDateTime timestamp = QDateTime::currentDateTime();
-    const QString timeStr = timeString(timestamp);
-    const QString longTimeStr = timeString(timestamp, QLocale::LongFormat);
-
-    columns << timeStr;
-    columns << Utility::fileNameForGuiUse(item._originalFile);
-    columns << f->shortGuiLocalPath();
-
-    // If the error string is set, it's prefered because it is a useful user message.
-    QString message = item._errorString;
-    if (message.isEmpty()) {
-        message = Progress::asResultString(item);
-    }
-    columns << message;
-
-    QIcon icon;
-    if (item._status == SyncFileItem::NormalError
-        || item._status == SyncFileItem::FatalError
-        || item._status == SyncFileItem::DetailError
-        || item._status == SyncFileItem::BlacklistedError) {
-        icon = Theme::instance()->syncStateIcon(SyncResult::Error);
-    } else if (Progress::isWarningKind(item._status)) {
-        icon = Theme::instance()->syncStateIcon(SyncResult::Problem);
-    }
-
-    if (ProgressInfo::isSizeDependent(item)) {
-        columns << Utility::octetsToString(item._size);
-    }
-
-    ProtocolItem *twitem = new ProtocolItem(columns);
-    // Warning: The data and tooltips on the columns define an implicit
-    // interface and can only be changed with care.
-    twitem->setData(0, Qt::SizeHintRole, QSize(0, ActivityItemDelegate::rowHeight()));
-    twitem->setIcon(0, icon);
-    twitem->setToolTip(0, longTimeStr);
-    twitem->setToolTip(1, item._file);
-    twitem->setToolTip(3, message);
-    ProtocolItem::ExtraData data;
-    data.timestamp = timestamp;
-    data.path = item._file;
-    data.folderName = folder;
-    data.status = item._status;
-    data.size = item._size;
-    data.direction = item._direction;
-    ProtocolItem::setExtraData(twitem, data);
-    return twitem;
-}
-
-SyncJournalFileRecord ProtocolItem::syncJournalRecord(QTreeWidgetItem *item)
-{
-    SyncJournalFileRecord rec;
-    auto f = folder(item);
-    if (!f)
-        return rec;
-    f->journalDb()->getFileRecord(extraData(item).path, &rec);
-    return rec;
-}
-
-Folder *ProtocolItem::folder(QTreeWidgetItem *item)
-{
-    return FolderMan::instance()->folder(extraData(item).folderName);
-}
-
-void ProtocolItem::openContextMenu(QPoint globalPos, QTreeWidgetItem *item, QWidget *parent)
-{
-    auto f = folder(item);
-    if (!f)
-        return;
-    AccountPtr account = f->accountState()->account();
-    auto rec = syncJournalRecord(item);
-    // rec might not be valid
-
-    auto menu = new QMenu(parent);
-
-    if (rec.isValid()) {
-        // "Open in Browser" action
-        auto openInBrowser = menu->addAction(ProtocolWidget::tr("Open in browser"));
-        QObject::connect(openInBrowser, &QAction::triggered, parent, [parent, account, rec]() {
-            fetchPrivateLinkUrl(account, rec._path, rec.numericFileId(), parent,
-                [parent](const QString &url) {
-                    Utility::openBrowser(url, parent);
-                });
-        });
-    }
-
-    // More actions will be conditionally added to the context menu here later
-
-    if (menu->actions().isEmpty()) {
-        delete menu;
-        return;
-    }
-
-    menu->setAttribute(Qt::WA_DeleteOnClose);
-    menu->popup(globalPos);
-}
-
-bool ProtocolItem::operator<(const QTreeWidgetItem &other) const
-{
-    int column = treeWidget()->sortColumn();
-    if (column == 0) {
-        // Items with empty "File" column are larger than others,
-        // otherwise sort by time (this uses lexicographic ordering)
-        return std::forward_as_tuple(text(1).isEmpty(), extraData(this).timestamp)
-            < std::forward_as_tuple(other.text(1).isEmpty(), extraData(&other).timestamp);
-    } else if (column == 4) {
-        return extraData(this).size < extraData(&other).size;
-    }
-
-    return QTreeWidgetItem::operator<(other);
-}
+/**
+ * The protocol only shows the most recent items, older ones are dropped.
+ */
+static const int maxProtocolItemCount = 2000;
 
 ProtocolWidget::ProtocolWidget(QWidget *parent)
     : QWidget(parent)
+    , _model(new ProtocolItemModel(maxProtocolItemCount, this))
+    , _sortModel(new ProtocolSortFilterProxyModel(_model, this))
     , _ui(new Ui::ProtocolWidget)
 {
     _ui->setupUi(this);
+    _ui->_treeWidget->setModel(_sortModel);
 
     connect(ProgressDispatcher::instance(), &ProgressDispatcher::itemCompleted,
         this, &ProtocolWidget::slotItemCompleted);
 
-    connect(_ui->_treeWidget, &QTreeWidget::itemActivated, this, &ProtocolWidget::slotOpenFile);
+    connect(_ui->_treeWidget, &QTreeView::activated, this, &ProtocolWidget::slotOpenFile);
 
     _ui->_treeWidget->setContextMenuPolicy(Qt::CustomContextMenu);
-    connect(_ui->_treeWidget, &QTreeWidget::customContextMenuRequested, this, &ProtocolWidget::slotItemContextMenu);
+    connect(_ui->_treeWidget, &QTreeView::customContextMenuRequested, this, &ProtocolWidget::slotItemContextMenu);
 
     // Adjust copyToClipboard() when making changes here!
     QStringList header;
@@ -201,13 +69,12 @@ ProtocolWidget::ProtocolWidget(QWidget *parent)
     timestampColumnExtra = 20; // font metrics are broken on Windows, see #4721
 #endif
 
-    _ui->_treeWidget->setHeaderLabels(header);
+    _model->setHeaderLabels(header);
     int timestampColumnWidth =
         _ui->_treeWidget->fontMetrics().width(ProtocolItem::timeString(QDateTime::currentDateTime()))
         + timestampColumnExtra;
     _ui->_treeWidget->setColumnWidth(0, timestampColumnWidth);
     _ui->_treeWidget->setColumnWidth(1, 180);
-    _ui->_treeWidget->setColumnCount(5);
     _ui->_treeWidget->setRootIsDecorated(false);
     _ui->_treeWidget->setTextElideMode(Qt::ElideMiddle);
     _ui->_treeWidget->header()->setObjectName("ActivityListHeader");
@@ -253,16 +120,17 @@ void ProtocolWidget::hideEvent(QHideEvent *ev)
 
 void ProtocolWidget::slotItemContextMenu(const QPoint &pos)
 {
-    auto item = _ui->_treeWidget->itemAt(pos);
-    if (!item)
+    auto index = _ui->_treeWidget->indexAt(pos);
+    if (!index.isValid())
         return;
     auto globalPos = _ui->_treeWidget->viewport()->mapToGlobal(pos);
-    ProtocolItem::openContextMenu(globalPos, item, this);
+    ProtocolItem::openContextMenu(globalPos, _sortModel->item(index), this);
 }
 
-void ProtocolWidget::slotOpenFile(QTreeWidgetItem *item, int)
+void ProtocolWidget::slotOpenFile(const QModelIndex &index)
 {
-    QString fileName = item->text(1);
+    const auto &item = _sortModel->item(index);
+    QString fileName = item.fileName;
     if (Folder *folder = ProtocolItem::folder(item)) {
         // folder->path() always comes back with trailing path
         QString fullPath = folder->path() + fileName;
@@ -276,52 +144,46 @@ void ProtocolWidget::slotItemCompleted(const QString &folder, const SyncFileItem
 {
     if (!item->showInProtocolTab())
         return;
-    QTreeWidgetItem *line = ProtocolItem::create(folder, *item);
-    if (line) {
-        // Limit the number of items
-        int itemCnt = _ui->_treeWidget->topLevelItemCount();
-        while (itemCnt > 2000) {
-            delete _ui->_treeWidget->takeTopLevelItem(itemCnt - 1);
-            itemCnt--;
-        }
-        _ui->_treeWidget->insertTopLevelItem(0, line);
-    }
+    auto line = ProtocolItem::create(folder, *item);
+    if (line.isValid())
+        _model->addItem(line);
 }
 
 void ProtocolWidget::storeSyncActivity(QTextStream &ts)
 {
-    int topLevelItems = _ui->_treeWidget->topLevelItemCount();
+    _model->flushPendingItems();
+    int rows = _sortModel->rowCount();
 
-    for (int i = 0; i < topLevelItems; i++) {
-        QTreeWidgetItem *child = _ui->_treeWidget->topLevelItem(i);
+    for (int i = 0; i < rows; i++) {
+        auto text = [&](int column) { return _sortModel->index(i, column).data().toString(); };
         ts << right
            // time stamp
            << qSetFieldWidth(20)
-           << child->data(0, Qt::DisplayRole).toString()
+           << text(0)
            // separator
            << qSetFieldWidth(0) << ","
 
            // file name
            << qSetFieldWidth(64)
-           << child->data(1, Qt::DisplayRole).toString()
+           << text(1)
            // separator
            << qSetFieldWidth(0) << ","
 
            // folder
            << qSetFieldWidth(30)
-           << child->data(2, Qt::DisplayRole).toString()
+           << text(2)
            // separator
            << qSetFieldWidth(0) << ","
 
            // action
            << qSetFieldWidth(15)
-           << child->data(3, Qt::DisplayRole).toString()
+           << text(3)
            // separator
            << qSetFieldWidth(0) << ","
 
            // size
            << qSetFieldWidth(10)
-           << child->data(4, Qt::DisplayRole).toString()
+           << text(4)
            << qSetFieldWidth(0)
            << endl;
     }
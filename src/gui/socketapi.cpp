@@ -58,7 +58,13 @@
 // This is the version that is returned when the client asks for the VERSION.
 // The first number should be changed if there is an incompatible change that breaks old clients.
 // The second number should be changed when there are new features.
-#define MIRALL_SOCKET_API_VERSION "1.1"
+#define MIRALL_SOCKET_API_VERSION "1.2"
+
+// Status pushes are collected for this long before being sent out in one batch.
+static const int statusPushCoalescingIntervalMs = 100;
+
+// Flush the pending status pushes early once this many distinct paths are queued.
+static const int statusPushMaxPending = 1000;
 
 static inline QString removeTrailingSlash(QString path)
 {
@@ -128,6 +134,40 @@ public:
     void sendMessage(const QString &message, bool doWait = false) const
     {
         qCInfo(lcSocketApi) << "Sending SocketAPI message -->" << message << "to" << socket;
+        writeMessage(message, doWait);
+    }
+
+    /** Sends several messages, with as few writes as the transport allows.
+     *
+     * Only a summary is logged, these batches can contain thousands of lines.
+     */
+    void sendMessages(const QStringList &messages) const
+    {
+        if (messages.isEmpty())
+            return;
+        qCDebug(lcSocketApi) << "Sending" << messages.size() << "SocketAPI messages to" << socket;
+#ifdef Q_OS_MAC
+        // The FinderSync extension expects exactly one line per IPC message
+        for (const auto &message : messages)
+            writeMessage(message, false);
+#else
+        writeMessage(messages.join(QLatin1Char('\n')), false);
+#endif
+    }
+
+    bool isDirectoryMonitored(uint systemDirectoryHash) const
+    {
+        return _monitoredDirectoriesBloomFilter.isHashMaybeStored(systemDirectoryHash);
+    }
+
+    void registerMonitoredDirectory(uint systemDirectoryHash)
+    {
+        _monitoredDirectoriesBloomFilter.storeHash(systemDirectoryHash);
+    }
+
+private:
+    void writeMessage(const QString &message, bool doWait) const
+    {
         QString localMessage = message;
         if (!localMessage.endsWith(QLatin1Char('\n'))) {
             localMessage.append(QLatin1Char('\n'));
@@ -143,21 +183,40 @@ public:
         }
     }
 
-    void sendMessageIfDirectoryMonitored(const QString &message, uint systemDirectoryHash) const
-    {
-        if (_monitoredDirectoriesBloomFilter.isHashMaybeStored(systemDirectoryHash))
-            sendMessage(message, false);
-    }
-
-    void registerMonitoredDirectory(uint systemDirectoryHash)
-    {
-        _monitoredDirectoriesBloomFilter.storeHash(systemDirectoryHash);
-    }
-
-private:
     BloomFilter _monitoredDirectoriesBloomFilter;
 };
 
+/** Maps a socket command name to the index of its command_ method.
+ *
+ * Built once from the meta object instead of assembling and looking up the
+ * method signature for every received line.
+ */
+static const QHash<QByteArray, int> &commandMethodIndexes()
+{
+    static const QHash<QByteArray, int> indexes = [] {
+        QHash<QByteArray, int> result;
+        const QMetaObject &metaObject = SocketApi::staticMetaObject;
+        const QByteArray prefix = QByteArrayLiteral("command_");
+        const QByteArray arguments = QByteArrayLiteral("(QString,SocketListener*)");
+        for (int i = metaObject.methodOffset(); i < metaObject.methodCount(); ++i) {
+            QByteArray signature = metaObject.method(i).methodSignature();
+            if (signature.startsWith(prefix) && signature.endsWith(arguments)) {
+                result.insert(signature.mid(prefix.size(), signature.size() - prefix.size() - arguments.size()), i);
+            }
+        }
+        return result;
+    }();
+    return indexes;
+}
+
+/** Status queries arrive once per visible file, don't log each of them at info level */
+static bool isStatusCommand(const QByteArray &command)
+{
+    return command == "RETRIEVE_FILE_STATUS"
+        || command == "RETRIEVE_FOLDER_STATUS"
+        || command == "RETRIEVE_FILES_STATUS";
+}
+
 struct ListenerHasSocketPred
 {
     QIODevice *socket;
@@ -216,6 +275,10 @@ SocketApi::SocketApi(QObject *parent)
 
     connect(&_localServer, &SocketApiServer::newConnection, this, &SocketApi::slotNewConnection);
 
+    _statusPushTimer.setSingleShot(true);
+    _statusPushTimer.setInterval(statusPushCoalescingIntervalMs);
+    connect(&_statusPushTimer, &QTimer::timeout, this, &SocketApi::slotFlushStatusPushMessages);
+
     // folder watcher
     connect(FolderMan::instance(), &FolderMan::folderSyncStateChange, this, &SocketApi::slotUpdateFolderView);
 }
@@ -283,10 +346,13 @@ void SocketApi::slotReadSocket()
         // make sure that the path will match, especially on OS X.
         QString line = QString::fromUtf8(socket->readLine()).normalized(QString::NormalizationForm_C);
         line.chop(1); // remove the '\n'
-        qCInfo(lcSocketApi) << "Received SocketAPI message <--" << line << "from" << socket;
-        QByteArray command = line.split(":").value(0).toLatin1();
-        QByteArray functionWithArguments = "command_" + command + "(QString,SocketListener*)";
-        int indexOfMethod = staticMetaObject.indexOfMethod(functionWithArguments);
+        QByteArray command = line.left(line.indexOf(QLatin1Char(':'))).toLatin1();
+        if (isStatusCommand(command)) {
+            qCDebug(lcSocketApi) << "Received SocketAPI message <--" << line << "from" << socket;
+        } else {
+            qCInfo(lcSocketApi) << "Received SocketAPI message <--" << line << "from" << socket;
+        }
+        int indexOfMethod = commandMethodIndexes().value(command, -1);
 
         QString argument = line.remove(0, command.length() + 1);
         if (indexOfMethod != -1) {
@@ -352,6 +418,9 @@ void SocketApi::slotUpdateFolderView(Folder *f)
 
 void SocketApi::broadcastMessage(const QString &msg, bool doWait)
 {
+    // Keep the order: pushes that were queued earlier must not arrive after e.g. UPDATE_VIEW
+    slotFlushStatusPushMessages();
+
     foreach (auto &listener, _listeners) {
         listener.sendMessage(msg, doWait);
     }
@@ -400,11 +469,43 @@ void SocketApi::processShareRequest(const QString &localFile, SocketListener *li
 
 void SocketApi::broadcastStatusPushMessage(const QString &systemPath, SyncFileStatus fileStatus)
 {
-    QString msg = buildMessage(QLatin1String("STATUS"), systemPath, fileStatus.toSocketAPIString());
     Q_ASSERT(!systemPath.endsWith('/'));
-    uint directoryHash = qHash(systemPath.left(systemPath.lastIndexOf('/')));
-    foreach (auto &listener, _listeners) {
-        listener.sendMessageIfDirectoryMonitored(msg, directoryHash);
+    if (_listeners.isEmpty())
+        return;
+
+    // Only the latest status of a path is interesting, earlier ones are replaced.
+    _pendingStatusPushes.insert(systemPath, fileStatus);
+    if (_pendingStatusPushes.size() >= statusPushMaxPending) {
+        slotFlushStatusPushMessages();
+    } else if (!_statusPushTimer.isActive()) {
+        _statusPushTimer.start();
+    }
+}
+
+void SocketApi::slotFlushStatusPushMessages()
+{
+    _statusPushTimer.stop();
+    if (_pendingStatusPushes.isEmpty())
+        return;
+
+    auto pending = std::move(_pendingStatusPushes);
+    _pendingStatusPushes.clear();
+
+    QVector<QStringList> messagesPerListener(_listeners.size());
+    for (auto it = pending.constBegin(); it != pending.constEnd(); ++it) {
+        const QString &systemPath = it.key();
+        uint directoryHash = qHash(systemPath.left(systemPath.lastIndexOf('/')));
+        QString msg;
+        for (int i = 0; i < _listeners.size(); ++i) {
+            if (!_listeners.at(i).isDirectoryMonitored(directoryHash))
+                continue;
+            if (msg.isEmpty())
+                msg = buildMessage(QLatin1String("STATUS"), systemPath, it.value().toSocketAPIString());
+            messagesPerListener[i].append(msg);
+        }
+    }
+    for (int i = 0; i < _listeners.size(); ++i) {
+        _listeners.at(i).sendMessages(messagesPerListener.at(i));
     }
 }
 
@@ -414,7 +515,7 @@ void SocketApi::command_RETRIEVE_FOLDER_STATUS(const QString &argument, SocketLi
     command_RETRIEVE_FILE_STATUS(argument, listener);
 }
 
-void SocketApi::command_RETRIEVE_FILE_STATUS(const QString &argument, SocketListener *listener)
+QString SocketApi::retrieveFileStatusMessage(const QString &argument, SocketListener *listener)
 {
     QString statusString;
 
@@ -432,8 +533,26 @@ void SocketApi::command_RETRIEVE_FILE_STATUS(const QString &argument, SocketList
         statusString = fileStatus.toSocketAPIString();
     }
 
-    const QString message = QLatin1String("STATUS:") % statusString % QLatin1Char(':') % QDir::toNativeSeparators(argument);
-    listener->sendMessage(message);
+    return QLatin1String("STATUS:") % statusString % QLatin1Char(':') % QDir::toNativeSeparators(argument);
+}
+
+void SocketApi::command_RETRIEVE_FILE_STATUS(const QString &argument, SocketListener *listener)
+{
+    listener->sendMessage(retrieveFileStatusMessage(argument, listener));
+}
+
+void SocketApi::command_RETRIEVE_FILES_STATUS(const QString &argument, SocketListener *listener)
+{
+    QStringList files = argument.split(QLatin1Char('\x1e'), QString::SkipEmptyParts); // Record Separator
+
+    QStringList messages;
+    messages.reserve(files.size() + 2);
+    messages.append(QStringLiteral("RETRIEVE_FILES_STATUS:BEGIN"));
+    for (const auto &file : files) {
+        messages.append(retrieveFileStatusMessage(file, listener));
+    }
+    messages.append(QStringLiteral("RETRIEVE_FILES_STATUS:END"));
+    listener->sendMessages(messages);
 }
 
 void SocketApi::command_SHARE(const QString &localFile, SocketListener *listener)
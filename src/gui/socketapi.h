@@ -21,6 +21,8 @@
 #include "sharedialog.h" // for the ShareDialogStartPage
 #include "common/syncjournalfilerecord.h"
 
+#include <QTimer>
+
 #if defined(Q_OS_MAC)
 #include "socketapisocket_mac.h"
 #else
@@ -64,6 +66,7 @@ private slots:
     void onLostConnection();
     void slotSocketDestroyed(QObject *obj);
     void slotReadSocket();
+    void slotFlushStatusPushMessages();
 
     static void copyUrlToClipboard(const QString &link);
     static void emailPrivateLink(const QString &link);
@@ -96,6 +99,14 @@ private:
     Q_INVOKABLE void command_RETRIEVE_FOLDER_STATUS(const QString &argument, SocketListener *listener);
     Q_INVOKABLE void command_RETRIEVE_FILE_STATUS(const QString &argument, SocketListener *listener);
 
+    /** Batched status query. (added in version 1.2)
+     * argument is a list of files, separated by '\x1e'
+     * Reply with RETRIEVE_FILES_STATUS:BEGIN
+     * followed by one STATUS:[status]:[path] line per file
+     * and ends with RETRIEVE_FILES_STATUS:END
+     */
+    Q_INVOKABLE void command_RETRIEVE_FILES_STATUS(const QString &argument, SocketListener *listener);
+
     Q_INVOKABLE void command_VERSION(const QString &argument, SocketListener *listener);
 
     Q_INVOKABLE void command_SHARE_MENU_TITLE(const QString &argument, SocketListener *listener);
@@ -129,9 +140,16 @@ private:
 
     QString buildRegisterPathMessage(const QString &path);
 
+    // Computes the STATUS reply for one file and marks its directory as monitored by listener
+    QString retrieveFileStatusMessage(const QString &argument, SocketListener *listener);
+
     QSet<QString> _registeredAliases;
     QList<SocketListener> _listeners;
     SocketApiServer _localServer;
+
+    // Status pushes waiting for _statusPushTimer, keyed by system path
+    QHash<QString, SyncFileStatus> _pendingStatusPushes;
+    QTimer _statusPushTimer;
 };
 }
 #endif // SOCKETAPI_H
@@ -114,6 +114,16 @@ void AbstractNetworkJob::setupConnections(QNetworkReply *reply)
     connect(reply, &QNetworkReply::metaDataChanged, this, &AbstractNetworkJob::networkActivity);
     connect(reply, &QNetworkReply::downloadProgress, this, &AbstractNetworkJob::networkActivity);
     connect(reply, &QNetworkReply::uploadProgress, this, &AbstractNetworkJob::networkActivity);
+
+    // encrypted() is only emitted when the request had to open a new connection
+    _requestTimer.start();
+    _handshakeMsec = -1;
+    _firstByteMsec = -1;
+    connect(reply, &QNetworkReply::encrypted, this, [this]() { _handshakeMsec = _requestTimer.elapsed(); });
+    connect(reply, &QNetworkReply::metaDataChanged, this, [this]() {
+        if (_firstByteMsec < 0)
+            _firstByteMsec = _requestTimer.elapsed();
+    });
 }
 
 QNetworkReply *AbstractNetworkJob::addTimer(QNetworkReply *reply)
@@ -156,6 +166,15 @@ void AbstractNetworkJob::slotFinished()
 {
     _timer.stop();
 
+    if (_handshakeMsec >= 0) {
+        qCInfo(lcNetworkJob) << "New connection to" << _reply->url().host() << "- TLS handshake after"
+                             << _handshakeMsec << "ms, first byte after" << _firstByteMsec << "ms, finished after"
+                             << _requestTimer.elapsed() << "ms";
+    } else {
+        qCDebug(lcNetworkJob) << "First byte after" << _firstByteMsec << "ms, finished after"
+                              << _requestTimer.elapsed() << "ms";
+    }
+
     if (_reply->error() == QNetworkReply::SslHandshakeFailedError) {
         qCWarning(lcNetworkJob) << "SslHandshakeFailedError: " << errorString() << " : can be caused by a webserver wanting SSL client certificates";
     }
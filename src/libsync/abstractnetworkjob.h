@@ -192,6 +192,11 @@ private:
     QTimer _timer;
     int _redirectCount;
 
+    // Connection timings of the current reply, -1 if not reached
+    QElapsedTimer _requestTimer;
+    qint64 _handshakeMsec = -1;
+    qint64 _firstByteMsec = -1;
+
     // Set by the xyzRequest() functions and needed to be able to redirect
     // requests, should it be required.
     //
@@ -33,6 +33,8 @@
 #include <QSslKey>
 #include <QAuthenticator>
 #include <QStandardPaths>
+#include <QDataStream>
+#include <QDateTime>
 
 namespace OCC {
 
@@ -209,6 +211,83 @@ QString Account::cookieJarPath()
     return QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation) + "/cookies" + id() + ".db";
 }
 
+QString Account::sslSessionPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation) + "/sslsession" + id() + ".db";
+}
+
+namespace {
+    const quint32 sslSessionVersion = 1;
+    // Servers usually don't accept older sessions anyway
+    const qint64 sslSessionMaxAgeSecs = 24 * 60 * 60;
+}
+
+void Account::saveSslSession()
+{
+    const QString fileName = sslSessionPath();
+    if (_sessionTicket.isEmpty() || url().scheme() != QLatin1String("https")) {
+        QFile::remove(fileName);
+        return;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(lcAccount) << "Could not save the TLS session to" << fileName << file.errorString();
+        return;
+    }
+    file.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+    QDataStream stream(&file);
+    stream << sslSessionVersion << url().host() << QDateTime::currentDateTimeUtc()
+           << qint32(_sessionTicketLifeTimeHint) << _sessionTicket;
+}
+
+void Account::restoreSslSession()
+{
+    QFile file(sslSessionPath());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    QDataStream stream(&file);
+    quint32 version = 0;
+    QString host;
+    QDateTime savedAt;
+    qint32 lifeTimeHint = -1;
+    QByteArray ticket;
+    stream >> version;
+    if (version != sslSessionVersion)
+        return;
+    stream >> host >> savedAt >> lifeTimeHint >> ticket;
+    if (stream.status() != QDataStream::Ok || host != url().host() || !savedAt.isValid())
+        return;
+
+    const qint64 age = savedAt.secsTo(QDateTime::currentDateTimeUtc());
+    if (age < 0 || age > sslSessionMaxAgeSecs || (lifeTimeHint > 0 && age > lifeTimeHint)) {
+        qCInfo(lcAccount) << "The saved TLS session expired" << age << "s ago";
+        return;
+    }
+    qCInfo(lcAccount) << "Restored TLS session for" << host << "from" << age << "s ago";
+    _sessionTicket = ticket;
+    // Saving it again must not extend its life
+    _sessionTicketLifeTimeHint = lifeTimeHint > 0 ? int(qMax<qint64>(1, lifeTimeHint - age)) : lifeTimeHint;
+}
+
+void Account::warmUpConnections(int count)
+{
+    if (!_am || isHttp2Supported())
+        return;
+
+    // Qt does not open more connections to one host
+    count = qMin(count, 6);
+    const QUrl serverUrl = url();
+    qCInfo(lcAccount) << "Opening" << count << "connections to" << serverUrl.host();
+    for (int i = 0; i < count; ++i) {
+        if (serverUrl.scheme() == QLatin1String("https")) {
+            _am->connectToHostEncrypted(serverUrl.host(), serverUrl.port(443), getOrCreateSslConfig());
+        } else {
+            _am->connectToHost(serverUrl.host(), serverUrl.port(80));
+        }
+    }
+}
+
 void Account::resetNetworkAccessManager()
 {
     if (!_credentials || !_am) {
@@ -286,6 +365,10 @@ QSslConfiguration Account::getOrCreateSslConfig()
     sslConfig.setSslOption(QSsl::SslOptionDisableSessionSharing, false);
     sslConfig.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
 
+    // Resume the last session, after a restart or a network change
+    if (!_sessionTicket.isEmpty())
+        sslConfig.setSessionTicket(_sessionTicket);
+
     return sslConfig;
 }
 
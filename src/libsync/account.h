@@ -157,6 +157,8 @@ public:
     // Because of bugs in Qt, we use this to store info needed for the SSL Button
     QSslCipher _sessionCipher;
     QByteArray _sessionTicket;
+    // Lifetime hint of _sessionTicket in seconds, from the reply that brought it
+    int _sessionTicketLifeTimeHint = -1;
     QList<QSslCertificate> _peerCertificateChain;
 
 
@@ -226,6 +228,29 @@ public:
     void lendCookieJarTo(QNetworkAccessManager *guest);
     QString cookieJarPath();
 
+    /** Where the TLS session is kept between runs, next to the cookie jar */
+    QString sslSessionPath();
+
+    /**
+     * Saves _sessionTicket, so the next start can resume the TLS session
+     * instead of doing a full handshake.
+     *
+     * The file gives access to the session keys, like the cookie jar it is
+     * only readable by the user.
+     */
+    void saveSslSession();
+
+    /** Restores the session saved by saveSslSession() if it can still be used */
+    void restoreSslSession();
+
+    /**
+     * Opens up to count connections to the server ahead of the first
+     * requests, so parallel jobs don't each wait for a TCP and TLS handshake.
+     *
+     * Nothing is done for HTTP2, all requests share one connection there.
+     */
+    void warmUpConnections(int count);
+
     void resetNetworkAccessManager();
     QNetworkAccessManager *networkAccessManager();
     QSharedPointer<QNetworkAccessManager> sharedNetworkAccessManager();
@@ -126,6 +126,16 @@ bool Capabilities::chunkingNg() const
     return _capabilities["dav"].toMap()["chunking"].toByteArray() >= "1.0";
 }
 
+bool Capabilities::bulkUpload() const
+{
+    static const auto bulkUpload = qgetenv("OWNCLOUD_BULK_UPLOAD");
+    if (bulkUpload == "0")
+        return false;
+    if (bulkUpload == "1")
+        return true;
+    return _capabilities["dav"].toMap()["bulkupload"].toByteArray() >= "1.0";
+}
+
 bool Capabilities::chunkingParallelUploadDisabled() const
 {
     return _capabilities["dav"].toMap()["chunkingParallelUploadDisabled"].toBool();
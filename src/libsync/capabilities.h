@@ -44,6 +44,16 @@ public:
     bool shareResharing() const;
     bool chunkingNg() const;
 
+    /**
+     * Whether the server accepts several small files in one multipart
+     * request to the bulk upload endpoint.
+     *
+     * Path: dav/bulkupload
+     * Default: empty, meaning not supported
+     * Can be overridden with the OWNCLOUD_BULK_UPLOAD environment variable.
+     */
+    bool bulkUpload() const;
+
     /// disable parallel upload in chunking
     bool chunkingParallelUploadDisabled() const;
 
@@ -121,6 +131,9 @@ public:
      */
     bool uploadConflictFiles() const;
 
+    /// The capabilities as received from the server, empty if unknown
+    QVariantMap raw() const { return _capabilities; }
+
 private:
     QVariantMap _capabilities;
 };
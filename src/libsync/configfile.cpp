@@ -35,6 +35,7 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QLoggingCategory>
+#include <QMutex>
 #include <QSettings>
 #include <QNetworkProxy>
 #include <QStandardPaths>
@@ -67,6 +68,7 @@ static const char chunkSizeC[] = "chunkSize";
 static const char minChunkSizeC[] = "minChunkSize";
 static const char maxChunkSizeC[] = "maxChunkSize";
 static const char targetChunkUploadDurationC[] = "targetChunkUploadDuration";
+static const char progressUpdateIntervalC[] = "progressUpdateInterval";
 static const char automaticLogDirC[] = "logToTemporaryLogDir";
 static const char showExperimentalOptionsC[] = "showExperimentalOptions";
 static const char clientVersionC[] = "clientVersion";
@@ -87,6 +89,9 @@ static const char newBigFolderSizeLimitC[] = "newBigFolderSizeLimit";
 static const char useNewBigFolderSizeLimitC[] = "useNewBigFolderSizeLimit";
 static const char confirmExternalStorageC[] = "confirmExternalStorage";
 static const char moveToTrashC[] = "moveToTrash";
+static const char remoteTreeSnapshotC[] = "remoteTreeSnapshot";
+static const char parallelReconcileC[] = "parallelReconcile";
+static const char serverSideCopyMinSizeC[] = "serverSideCopyMinSize";
 
 static const char maxLogLinesC[] = "Logging/maxLogLines";
 
@@ -95,10 +100,109 @@ const char certPasswd[] = "http_certificatePasswd";
 QString ConfigFile::_confDir = QString();
 bool ConfigFile::_askedUser = false;
 
-static chrono::milliseconds millisecondsValue(const QSettings &setting, const char *key,
-    chrono::milliseconds defaultValue)
+static chrono::milliseconds millisecondsValue(const QVariant &value, chrono::milliseconds defaultValue)
 {
-    return chrono::milliseconds(setting.value(QLatin1String(key), qlonglong(defaultValue.count())).toLongLong());
+    return value.isNull() ? defaultValue : chrono::milliseconds(value.toLongLong());
+}
+
+// The key of a value in a group, as ConfigSnapshot stores it
+static QString groupKey(const QString &group, const QString &key)
+{
+    return group.isEmpty() ? key : QString(group + QLatin1Char('/') + key);
+}
+
+// QSettings matches keys case-insensitively on Windows, the snapshot must too
+static QString snapshotKey(const QString &key)
+{
+#ifdef Q_OS_WIN
+    return key.toLower();
+#else
+    return key;
+#endif
+}
+
+static QHash<QString, QVariant> readAllValues(const QString &fileName, QSettings::Format format)
+{
+    QHash<QString, QVariant> values;
+    QSettings settings(fileName, format);
+    foreach (const QString &key, settings.allKeys())
+        values.insert(snapshotKey(key), settings.value(key));
+    return values;
+}
+
+namespace {
+    struct SnapshotCache
+    {
+        QMutex mutex;
+        QHash<QString, ConfigSnapshot::Ptr> snapshots;
+        quint64 generation = 0; // incremented by invalidate()
+    };
+}
+
+Q_GLOBAL_STATIC(SnapshotCache, g_snapshotCache)
+
+ConfigSnapshot::Ptr ConfigSnapshot::current(const QString &fileName, QSettings::Format format)
+{
+    // Stat before reading, a write in between is seen on the next call
+    const QFileInfo info(fileName);
+    const bool exists = info.exists();
+    const QDateTime lastModified = exists ? info.lastModified() : QDateTime();
+    const qint64 size = exists ? info.size() : -1;
+
+    auto cache = g_snapshotCache();
+    if (!cache) {
+        // After the cache was destroyed on exit
+        QSharedPointer<ConfigSnapshot> snapshot(new ConfigSnapshot);
+        snapshot->_values = readAllValues(fileName, format);
+        return snapshot;
+    }
+    Ptr previous;
+    QSharedPointer<ConfigSnapshot> snapshot;
+    {
+        QMutexLocker lock(&cache->mutex);
+        previous = cache->snapshots.value(fileName);
+        if (previous && previous->_generation == cache->generation && previous->_exists == exists
+            && previous->_lastModified == lastModified && previous->_size == size) {
+            return previous;
+        }
+
+        snapshot.reset(new ConfigSnapshot);
+        snapshot->_exists = exists;
+        snapshot->_lastModified = lastModified;
+        snapshot->_size = size;
+        snapshot->_generation = cache->generation;
+        snapshot->_values = readAllValues(fileName, format);
+        cache->snapshots.insert(fileName, snapshot);
+    }
+
+    if (previous && previous->_values != snapshot->_values) {
+        qCInfo(lcConfigFile) << "Reloaded changed settings from" << fileName;
+        emit ConfigFileNotifier::instance()->configChanged(fileName);
+    }
+    return snapshot;
+}
+
+void ConfigSnapshot::invalidate()
+{
+    auto cache = g_snapshotCache();
+    QMutexLocker lock(&cache->mutex);
+    ++cache->generation;
+}
+
+QVariant ConfigSnapshot::value(const QString &key, const QVariant &defaultValue) const
+{
+    return _values.value(snapshotKey(key), defaultValue);
+}
+
+bool ConfigSnapshot::contains(const QString &key) const
+{
+    return _values.contains(snapshotKey(key));
+}
+
+ConfigFileNotifier *ConfigFileNotifier::instance()
+{
+    static ConfigFileNotifier notifier;
+    return &notifier;
 }
 
 ConfigFile::ConfigFile()
@@ -107,12 +211,6 @@ ConfigFile::ConfigFile()
     qApp->setApplicationName(Theme::instance()->appNameGUI());
 
     QSettings::setDefaultFormat(QSettings::IniFormat);
-
-    const QString config = configFile();
-
-
-    QSettings settings(config, QSettings::IniFormat);
-    settings.beginGroup(defaultConnection());
 }
 
 bool ConfigFile::setConfDir(const QString &value)
@@ -137,8 +235,7 @@ bool ConfigFile::setConfDir(const QString &value)
 
 bool ConfigFile::optionalDesktopNotifications() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(optionalDesktopNoficationsC), true).toBool();
+    return userValue(QLatin1String(optionalDesktopNoficationsC), true).toBool();
 }
 
 bool ConfigFile::showInExplorerNavigationPane() const
@@ -150,62 +247,54 @@ bool ConfigFile::showInExplorerNavigationPane() const
         false
 #endif
         ;
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(showInExplorerNavigationPaneC), defaultValue).toBool();
+    return userValue(QLatin1String(showInExplorerNavigationPaneC), defaultValue).toBool();
 }
 
 void ConfigFile::setShowInExplorerNavigationPane(bool show)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(showInExplorerNavigationPaneC), show);
-    settings.sync();
+    setValue(QLatin1String(showInExplorerNavigationPaneC), show);
 }
 
 int ConfigFile::timeout() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(timeoutC), 300).toInt(); // default to 5 min
+    return userValue(QLatin1String(timeoutC), 300).toInt(); // default to 5 min
 }
 
 quint64 ConfigFile::chunkSize() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(chunkSizeC), 10 * 1000 * 1000).toLongLong(); // default to 10 MB
+    return userValue(QLatin1String(chunkSizeC), 10 * 1000 * 1000).toLongLong(); // default to 10 MB
 }
 
 quint64 ConfigFile::maxChunkSize() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(maxChunkSizeC), 100 * 1000 * 1000).toLongLong(); // default to 100 MB
+    return userValue(QLatin1String(maxChunkSizeC), 100 * 1000 * 1000).toLongLong(); // default to 100 MB
 }
 
 quint64 ConfigFile::minChunkSize() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(minChunkSizeC), 1000 * 1000).toLongLong(); // default to 1 MB
+    return userValue(QLatin1String(minChunkSizeC), 1000 * 1000).toLongLong(); // default to 1 MB
 }
 
 chrono::milliseconds ConfigFile::targetChunkUploadDuration() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return millisecondsValue(settings, targetChunkUploadDurationC, chrono::minutes(1));
+    return millisecondsValue(userValue(QLatin1String(targetChunkUploadDurationC)), chrono::minutes(1));
+}
+
+chrono::milliseconds ConfigFile::progressUpdateInterval() const
+{
+    return millisecondsValue(userValue(QLatin1String(progressUpdateIntervalC)), chrono::milliseconds(100));
 }
 
 void ConfigFile::setOptionalDesktopNotifications(bool show)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(optionalDesktopNoficationsC), show);
-    settings.sync();
+    setValue(QLatin1String(optionalDesktopNoficationsC), show);
 }
 
 void ConfigFile::saveGeometry(QWidget *w)
 {
 #ifndef TOKEN_AUTH_ONLY
     ASSERT(!w->objectName().isNull());
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(w->objectName());
-    settings.setValue(QLatin1String(geometryC), w->saveGeometry());
-    settings.sync();
+    setValue(groupKey(w->objectName(), QLatin1String(geometryC)), w->saveGeometry());
 #endif
 }
 
@@ -223,10 +312,7 @@ void ConfigFile::saveGeometryHeader(QHeaderView *header)
         return;
     ASSERT(!header->objectName().isEmpty());
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(header->objectName());
-    settings.setValue(QLatin1String(geometryC), header->saveState());
-    settings.sync();
+    setValue(groupKey(header->objectName(), QLatin1String(geometryC)), header->saveState());
 #endif
 }
 
@@ -237,9 +323,7 @@ void ConfigFile::restoreGeometryHeader(QHeaderView *header)
         return;
     ASSERT(!header->objectName().isNull());
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(header->objectName());
-    header->restoreState(settings.value(geometryC).toByteArray());
+    header->restoreState(userValue(groupKey(header->objectName(), QLatin1String(geometryC))).toByteArray());
 #endif
 }
 
@@ -386,38 +470,30 @@ QString ConfigFile::defaultConnection() const
 void ConfigFile::storeData(const QString &group, const QString &key, const QVariant &value)
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    QSettings settings(configFile(), QSettings::IniFormat);
-
-    settings.beginGroup(con);
-    settings.setValue(key, value);
-    settings.sync();
+    setValue(groupKey(con, key), value);
 }
 
 QVariant ConfigFile::retrieveData(const QString &group, const QString &key) const
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    QSettings settings(configFile(), QSettings::IniFormat);
-
-    settings.beginGroup(con);
-    return settings.value(key);
+    return userValue(groupKey(con, key));
 }
 
 void ConfigFile::removeData(const QString &group, const QString &key)
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    QSettings settings(configFile(), QSettings::IniFormat);
-
-    settings.beginGroup(con);
-    settings.remove(key);
+    {
+        QSettings settings(configFile(), QSettings::IniFormat);
+        settings.beginGroup(con);
+        settings.remove(key);
+    }
+    ConfigSnapshot::invalidate();
 }
 
 bool ConfigFile::dataExists(const QString &group, const QString &key) const
 {
     const QString con(group.isEmpty() ? defaultConnection() : group);
-    QSettings settings(configFile(), QSettings::IniFormat);
-
-    settings.beginGroup(con);
-    return settings.contains(key);
+    return ConfigSnapshot::current(configFile())->contains(groupKey(con, key));
 }
 
 chrono::milliseconds ConfigFile::remotePollInterval(const QString &connection) const
@@ -426,11 +502,8 @@ chrono::milliseconds ConfigFile::remotePollInterval(const QString &connection) c
     if (connection.isEmpty())
         con = defaultConnection();
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(con);
-
     auto defaultPollInterval = chrono::milliseconds(DEFAULT_REMOTE_POLL_INTERVAL);
-    auto remoteInterval = millisecondsValue(settings, remotePollIntervalC, defaultPollInterval);
+    auto remoteInterval = millisecondsValue(userValue(groupKey(con, QLatin1String(remotePollIntervalC))), defaultPollInterval);
     if (remoteInterval < chrono::seconds(5)) {
         qCWarning(lcConfigFile) << "Remote Interval is less than 5 seconds, reverting to" << DEFAULT_REMOTE_POLL_INTERVAL;
         remoteInterval = defaultPollInterval;
@@ -448,10 +521,7 @@ void ConfigFile::setRemotePollInterval(chrono::milliseconds interval, const QStr
         qCWarning(lcConfigFile) << "Remote Poll interval of " << interval.count() << " is below five seconds.";
         return;
     }
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(con);
-    settings.setValue(QLatin1String(remotePollIntervalC), qlonglong(interval.count()));
-    settings.sync();
+    setValue(groupKey(con, QLatin1String(remotePollIntervalC)), qlonglong(interval.count()));
 }
 
 chrono::milliseconds ConfigFile::forceSyncInterval(const QString &connection) const
@@ -461,11 +531,9 @@ chrono::milliseconds ConfigFile::forceSyncInterval(const QString &connection) co
     QString con(connection);
     if (connection.isEmpty())
         con = defaultConnection();
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(con);
 
     auto defaultInterval = chrono::hours(2);
-    auto interval = millisecondsValue(settings, forceSyncIntervalC, defaultInterval);
+    auto interval = millisecondsValue(userValue(groupKey(con, QLatin1String(forceSyncIntervalC))), defaultInterval);
     if (interval < pollInterval) {
         qCWarning(lcConfigFile) << "Force sync interval is less than the remote poll inteval, reverting to" << pollInterval.count();
         interval = pollInterval;
@@ -475,9 +543,7 @@ chrono::milliseconds ConfigFile::forceSyncInterval(const QString &connection) co
 
 chrono::milliseconds OCC::ConfigFile::fullLocalDiscoveryInterval() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(defaultConnection());
-    return millisecondsValue(settings, fullLocalDiscoveryIntervalC, chrono::hours(1));
+    return millisecondsValue(userValue(groupKey(defaultConnection(), QLatin1String(fullLocalDiscoveryIntervalC))), chrono::hours(1));
 }
 
 chrono::milliseconds ConfigFile::notificationRefreshInterval(const QString &connection) const
@@ -485,11 +551,9 @@ chrono::milliseconds ConfigFile::notificationRefreshInterval(const QString &conn
     QString con(connection);
     if (connection.isEmpty())
         con = defaultConnection();
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(con);
 
     auto defaultInterval = chrono::minutes(5);
-    auto interval = millisecondsValue(settings, notificationRefreshIntervalC, defaultInterval);
+    auto interval = millisecondsValue(userValue(groupKey(con, QLatin1String(notificationRefreshIntervalC))), defaultInterval);
     if (interval < chrono::minutes(1)) {
         qCWarning(lcConfigFile) << "Notification refresh interval smaller than one minute, setting to one minute";
         interval = chrono::minutes(1);
@@ -502,11 +566,9 @@ chrono::milliseconds ConfigFile::updateCheckInterval(const QString &connection)
     QString con(connection);
     if (connection.isEmpty())
         con = defaultConnection();
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(con);
 
     auto defaultInterval = chrono::hours(10);
-    auto interval = millisecondsValue(settings, updateCheckIntervalC, defaultInterval);
+    auto interval = millisecondsValue(userValue(groupKey(con, QLatin1String(updateCheckIntervalC))), defaultInterval);
 
     auto minInterval = chrono::minutes(5);
     if (interval < minInterval) {
@@ -535,11 +597,7 @@ void ConfigFile::setSkipUpdateCheck(bool skip, const QString &connection)
     if (connection.isEmpty())
         con = defaultConnection();
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.beginGroup(con);
-
-    settings.setValue(QLatin1String(skipUpdateCheckC), QVariant(skip));
-    settings.sync();
+    setValue(groupKey(con, QLatin1String(skipUpdateCheckC)), QVariant(skip));
 }
 
 QString ConfigFile::updateChannel() const
@@ -554,27 +612,22 @@ QString ConfigFile::updateChannel() const
         defaultUpdateChannel = QStringLiteral("beta");
     }
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(updateChannelC), defaultUpdateChannel).toString();
+    return userValue(QLatin1String(updateChannelC), defaultUpdateChannel).toString();
 }
 
 void ConfigFile::setUpdateChannel(const QString &channel)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(updateChannelC), channel);
+    setValue(QLatin1String(updateChannelC), channel);
 }
 
 int ConfigFile::maxLogLines() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(maxLogLinesC), DEFAULT_MAX_LOG_LINES).toInt();
+    return userValue(QLatin1String(maxLogLinesC), DEFAULT_MAX_LOG_LINES).toInt();
 }
 
 void ConfigFile::setMaxLogLines(int lines)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(maxLogLinesC), lines);
-    settings.sync();
+    setValue(QLatin1String(maxLogLinesC), lines);
 }
 
 void ConfigFile::setProxyType(int proxyType,
@@ -583,58 +636,54 @@ void ConfigFile::setProxyType(int proxyType,
     const QString &user,
     const QString &pass)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
+    {
+        QSettings settings(configFile(), QSettings::IniFormat);
 
-    settings.setValue(QLatin1String(proxyTypeC), proxyType);
+        settings.setValue(QLatin1String(proxyTypeC), proxyType);
 
-    if (proxyType == QNetworkProxy::HttpProxy || proxyType == QNetworkProxy::Socks5Proxy) {
-        settings.setValue(QLatin1String(proxyHostC), host);
-        settings.setValue(QLatin1String(proxyPortC), port);
-        settings.setValue(QLatin1String(proxyNeedsAuthC), needsAuth);
-        settings.setValue(QLatin1String(proxyUserC), user);
-        settings.setValue(QLatin1String(proxyPassC), pass.toUtf8().toBase64());
+        if (proxyType == QNetworkProxy::HttpProxy || proxyType == QNetworkProxy::Socks5Proxy) {
+            settings.setValue(QLatin1String(proxyHostC), host);
+            settings.setValue(QLatin1String(proxyPortC), port);
+            settings.setValue(QLatin1String(proxyNeedsAuthC), needsAuth);
+            settings.setValue(QLatin1String(proxyUserC), user);
+            settings.setValue(QLatin1String(proxyPassC), pass.toUtf8().toBase64());
+        }
+        settings.sync();
     }
-    settings.sync();
+    ConfigSnapshot::invalidate();
 }
 
 QVariant ConfigFile::getValue(const QString &param, const QString &group,
     const QVariant &defaultValue) const
 {
-    QVariant systemSetting;
+    QString systemSettingsFile;
     if (Utility::isMac()) {
-        QSettings systemSettings(QLatin1String("/Library/Preferences/" APPLICATION_REV_DOMAIN ".plist"), QSettings::NativeFormat);
-        if (!group.isEmpty()) {
-            systemSettings.beginGroup(group);
-        }
-        systemSetting = systemSettings.value(param, defaultValue);
+        systemSettingsFile = QLatin1String("/Library/Preferences/" APPLICATION_REV_DOMAIN ".plist");
     } else if (Utility::isUnix()) {
-        QSettings systemSettings(QString(SYSCONFDIR "/%1/%1.conf").arg(Theme::instance()->appName()), QSettings::NativeFormat);
-        if (!group.isEmpty()) {
-            systemSettings.beginGroup(group);
-        }
-        systemSetting = systemSettings.value(param, defaultValue);
-    } else { // Windows
-        QSettings systemSettings(QString::fromLatin1("HKEY_LOCAL_MACHINE\\Software\\%1\\%2")
-                                     .arg(APPLICATION_VENDOR, Theme::instance()->appName()),
-            QSettings::NativeFormat);
-        if (!group.isEmpty()) {
-            systemSettings.beginGroup(group);
-        }
-        systemSetting = systemSettings.value(param, defaultValue);
+        systemSettingsFile = QString(SYSCONFDIR "/%1/%1.conf").arg(Theme::instance()->appName());
+    } else { // Windows, the registry is only read again after ConfigSnapshot::invalidate()
+        systemSettingsFile = QString::fromLatin1("HKEY_LOCAL_MACHINE\\Software\\%1\\%2")
+                                 .arg(APPLICATION_VENDOR, Theme::instance()->appName());
     }
 
-    QSettings settings(configFile(), QSettings::IniFormat);
-    if (!group.isEmpty())
-        settings.beginGroup(group);
+    const QString key = groupKey(group, param);
+    const QVariant systemSetting = ConfigSnapshot::current(systemSettingsFile, QSettings::NativeFormat)->value(key, defaultValue);
+    return userValue(key, systemSetting);
+}
 
-    return settings.value(param, systemSetting);
+QVariant ConfigFile::userValue(const QString &key, const QVariant &defaultValue) const
+{
+    return ConfigSnapshot::current(configFile())->value(key, defaultValue);
 }
 
 void ConfigFile::setValue(const QString &key, const QVariant &value)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-
-    settings.setValue(key, value);
+    {
+        QSettings settings(configFile(), QSettings::IniFormat);
+        settings.setValue(key, value);
+        settings.sync();
+    }
+    ConfigSnapshot::invalidate();
 }
 
 int ConfigFile::proxyType() const
@@ -745,63 +794,69 @@ void ConfigFile::setMoveToTrash(bool isChecked)
     setValue(moveToTrashC, isChecked);
 }
 
+bool ConfigFile::remoteTreeSnapshot() const
+{
+    return getValue(remoteTreeSnapshotC, QString(), false).toBool();
+}
+
+bool ConfigFile::parallelReconcile() const
+{
+    return getValue(parallelReconcileC, QString(), false).toBool();
+}
+
+qint64 ConfigFile::serverSideCopyMinSize() const
+{
+    return getValue(serverSideCopyMinSizeC, QString(), -1).toLongLong();
+}
+
 bool ConfigFile::promptDeleteFiles() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(promptDeleteC), true).toBool();
+    return userValue(QLatin1String(promptDeleteC), true).toBool();
 }
 
 void ConfigFile::setPromptDeleteFiles(bool promptDeleteFiles)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(promptDeleteC), promptDeleteFiles);
+    setValue(QLatin1String(promptDeleteC), promptDeleteFiles);
 }
 
 bool ConfigFile::monoIcons() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
     bool monoDefault = false; // On Mac we want bw by default
 #ifdef Q_OS_MAC
     // OEM themes are not obliged to ship mono icons
     monoDefault = (0 == (strcmp("ownCloud", APPLICATION_NAME)));
 #endif
-    return settings.value(QLatin1String(monoIconsC), monoDefault).toBool();
+    return userValue(QLatin1String(monoIconsC), monoDefault).toBool();
 }
 
 void ConfigFile::setMonoIcons(bool useMonoIcons)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(monoIconsC), useMonoIcons);
+    setValue(QLatin1String(monoIconsC), useMonoIcons);
 }
 
 bool ConfigFile::crashReporter() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(crashReporterC), true).toBool();
+    return userValue(QLatin1String(crashReporterC), true).toBool();
 }
 
 void ConfigFile::setCrashReporter(bool enabled)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(crashReporterC), enabled);
+    setValue(QLatin1String(crashReporterC), enabled);
 }
 
 bool ConfigFile::automaticLogDir() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(automaticLogDirC), false).toBool();
+    return userValue(QLatin1String(automaticLogDirC), false).toBool();
 }
 
 void ConfigFile::setAutomaticLogDir(bool enabled)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(automaticLogDirC), enabled);
+    setValue(QLatin1String(automaticLogDirC), enabled);
 }
 
 bool ConfigFile::showExperimentalOptions() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(showExperimentalOptionsC), false).toBool();
+    return userValue(QLatin1String(showExperimentalOptionsC), false).toBool();
 }
 
 QString ConfigFile::certificatePath() const
@@ -811,9 +866,7 @@ QString ConfigFile::certificatePath() const
 
 void ConfigFile::setCertificatePath(const QString &cPath)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(certPath), cPath);
-    settings.sync();
+    setValue(QLatin1String(certPath), cPath);
 }
 
 QString ConfigFile::certificatePasswd() const
@@ -823,21 +876,17 @@ QString ConfigFile::certificatePasswd() const
 
 void ConfigFile::setCertificatePasswd(const QString &cPasswd)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(certPasswd), cPasswd);
-    settings.sync();
+    setValue(QLatin1String(certPasswd), cPasswd);
 }
 
 QString ConfigFile::clientVersionString() const
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    return settings.value(QLatin1String(clientVersionC), QString()).toString();
+    return userValue(QLatin1String(clientVersionC), QString()).toString();
 }
 
 void ConfigFile::setClientVersionString(const QString &version)
 {
-    QSettings settings(configFile(), QSettings::IniFormat);
-    settings.setValue(QLatin1String(clientVersionC), version);
+    setValue(QLatin1String(clientVersionC), version);
 }
 
 Q_GLOBAL_STATIC(QString, g_configFileName)
@@ -17,6 +17,9 @@
 
 #include "owncloudlib.h"
 #include <memory>
+#include <QDateTime>
+#include <QHash>
+#include <QObject>
 #include <QSharedPointer>
 #include <QSettings>
 #include <QString>
@@ -31,6 +34,59 @@ namespace OCC {
 
 class AbstractCredentials;
 
+/**
+ * @brief An immutable copy of all values of a settings file
+ * @ingroup libsync
+ *
+ * ConfigFile reads its values from snapshots instead of parsing the file
+ * with a new QSettings every time. current() only stats the file and
+ * reloads it when it was modified or written through ConfigFile.
+ *
+ * Snapshots are shared by all threads.
+ */
+class OWNCLOUDSYNC_EXPORT ConfigSnapshot
+{
+public:
+    typedef QSharedPointer<const ConfigSnapshot> Ptr;
+
+    /// The snapshot of the current contents of the file
+    static Ptr current(const QString &fileName, QSettings::Format format = QSettings::IniFormat);
+
+    /// Makes the next current() reload, called after writing a file
+    static void invalidate();
+
+    /// Values in groups have keys like "group/key", as in QSettings::allKeys().
+    /// Like QSettings, keys are case insensitive on Windows.
+    QVariant value(const QString &key, const QVariant &defaultValue = QVariant()) const;
+    bool contains(const QString &key) const;
+
+private:
+    ConfigSnapshot() {}
+
+    QHash<QString, QVariant> _values;
+    bool _exists = false;
+    QDateTime _lastModified;
+    qint64 _size = -1;
+    quint64 _generation = 0;
+};
+
+/**
+ * @brief Notifies about changed settings
+ * @ingroup libsync
+ *
+ * configChanged() is emitted when a reload of a ConfigSnapshot found other
+ * values than before, from the thread that read the settings.
+ */
+class OWNCLOUDSYNC_EXPORT ConfigFileNotifier : public QObject
+{
+    Q_OBJECT
+public:
+    static ConfigFileNotifier *instance();
+
+signals:
+    void configChanged(const QString &fileName);
+};
+
 /**
  * @brief The ConfigFile class
  * @ingroup libsync
@@ -136,6 +192,15 @@ public:
     bool moveToTrash() const;
     void setMoveToTrash(bool);
 
+    /** If unchanged remote folders are read from the remote tree snapshot */
+    bool remoteTreeSnapshot() const;
+
+    /** If reconcile may run on several threads */
+    bool parallelReconcile() const;
+
+    /** Minimum size of new files that may be copied on the server instead of uploaded, -1 (default) to disable */
+    qint64 serverSideCopyMinSize() const;
+
     static bool setConfDir(const QString &value);
 
     bool optionalDesktopNotifications() const;
@@ -150,6 +215,9 @@ public:
     quint64 minChunkSize() const;
     std::chrono::milliseconds targetChunkUploadDuration() const;
 
+    /** Minimum time between two progress notifications sent to the GUI */
+    std::chrono::milliseconds progressUpdateInterval() const;
+
     void saveGeometry(QWidget *w);
     void restoreGeometry(QWidget *w);
 
@@ -192,6 +260,8 @@ protected:
 private:
     QVariant getValue(const QString &param, const QString &group = QString(),
         const QVariant &defaultValue = QVariant()) const;
+    // Only from the user's config file, without the system settings
+    QVariant userValue(const QString &key, const QVariant &defaultValue = QVariant()) const;
     void setValue(const QString &key, const QVariant &value);
 
 private:
@@ -17,6 +17,7 @@
 #include "account.h"
 #include "common/asserts.h"
 #include "common/checksums.h"
+#include "common/synctrace.h"
 
 #include <csync_private.h>
 #include <csync_rename.h>
@@ -94,7 +95,7 @@ bool DiscoveryJob::checkSelectiveSyncNewFolder(const QString &path, RemotePermis
         && remotePerm.hasPermission(RemotePermissions::IsMounted)) {
         // external storage.
 
-        /* Note: DiscoverySingleDirectoryJob::directoryListingIteratedSlot make sure that only the
+        /* Note: DiscoverySingleDirectoryJob::directoryListingEntrySlot make sure that only the
          * root of a mounted storage has 'M', all sub entries have 'm' */
 
         // Only allow it if the white list contains exactly this path (not parents)
@@ -118,10 +119,11 @@ bool DiscoveryJob::checkSelectiveSyncNewFolder(const QString &path, RemotePermis
         return false;
     }
 
-    // Go in the main thread to do a PROPFIND to know the size of this folder
-    qint64 result = -1;
+    // The size usually came with the listing of the parent folder
+    qint64 result = _remoteFolderSizes.value(path, -1);
 
-    {
+    if (result < 0) {
+        // Go in the main thread to do a PROPFIND to know the size of this folder
         QMutexLocker locker(&_vioMutex);
         emit doGetSizeSignal(path, &result);
         _vioWaitCondition.wait(&_vioMutex);
@@ -277,6 +279,8 @@ void DiscoverySingleDirectoryJob::start()
           << "http://owncloud.org/ns:checksums";
     if (_isRootPath)
         props << "http://owncloud.org/ns:data-fingerprint";
+    if (_requestFolderSizes)
+        props << "http://owncloud.org/ns:size";
     if (_account->serverVersionInt() >= Account::makeServerVersion(10, 0, 0)) {
         // Server older than 10.0 have performances issue if we ask for the share-types on every PROPFIND
         props << "http://owncloud.org/ns:share-types";
@@ -284,10 +288,11 @@ void DiscoverySingleDirectoryJob::start()
 
     lsColJob->setProperties(props);
 
-    QObject::connect(lsColJob, &LsColJob::directoryListingIterated,
-        this, &DiscoverySingleDirectoryJob::directoryListingIteratedSlot);
+    QObject::connect(lsColJob, &LsColJob::directoryListingEntry,
+        this, &DiscoverySingleDirectoryJob::directoryListingEntrySlot);
     QObject::connect(lsColJob, &LsColJob::finishedWithError, this, &DiscoverySingleDirectoryJob::lsJobFinishedWithErrorSlot);
     QObject::connect(lsColJob, &LsColJob::finishedWithoutError, this, &DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot);
+    _traceStart = SyncTrace::now();
     lsColJob->start();
 
     _lsColJob = lsColJob;
@@ -300,70 +305,50 @@ void DiscoverySingleDirectoryJob::abort()
     }
 }
 
-static void propertyMapToFileStat(const QMap<QString, QString> &map, csync_file_stat_t *file_stat)
+static void lsColEntryToFileStat(const LsColEntry &entry, csync_file_stat_t *file_stat)
 {
-    for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
-        QString property = it.key();
-        QString value = it.value();
-        if (property == "resourcetype") {
-            if (value.contains("collection")) {
-                file_stat->type = ItemTypeDirectory;
-            } else {
-                file_stat->type = ItemTypeFile;
-            }
-        } else if (property == "getlastmodified") {
-            file_stat->modtime = oc_httpdate_parse(value.toUtf8());
-        } else if (property == "getcontentlength") {
-            // See #4573, sometimes negative size values are returned
-            bool ok = false;
-            qlonglong ll = value.toLongLong(&ok);
-            if (ok && ll >= 0) {
-                file_stat->size = ll;
-            } else {
-                file_stat->size = 0;
-            }
-        } else if (property == "getetag") {
-            file_stat->etag = Utility::normalizeEtag(value.toUtf8());
-        } else if (property == "id") {
-            file_stat->file_id = value.toUtf8();
-        } else if (property == "downloadURL") {
-            file_stat->directDownloadUrl = value.toUtf8();
-        } else if (property == "dDC") {
-            file_stat->directDownloadCookies = value.toUtf8();
-        } else if (property == "permissions") {
-            file_stat->remotePerm = RemotePermissions(value);
-        } else if (property == "checksums") {
-            file_stat->checksumHeader = findBestChecksum(value.toUtf8());
-        } else if (property == "share-types" && !value.isEmpty()) {
-            // Since QMap is sorted, "share-types" is always after "permissions".
-            if (file_stat->remotePerm.isNull()) {
-                qWarning() << "Server returned a share type, but no permissions?";
-            } else {
-                // S means shared with me.
-                // But for our purpose, we want to know if the file is shared. It does not matter
-                // if we are the owner or not.
-                // Piggy back on the persmission field
-                file_stat->remotePerm.setPermission(RemotePermissions::IsShared);
-            }
+    if (entry.hasResourceType) {
+        file_stat->type = entry.isCollection ? ItemTypeDirectory : ItemTypeFile;
+    }
+    if (entry.modtime)
+        file_stat->modtime = entry.modtime;
+    file_stat->size = entry.contentLength;
+    if (!entry.etag.isEmpty())
+        file_stat->etag = Utility::normalizeEtag(entry.etag);
+    file_stat->file_id = entry.fileId;
+    file_stat->directDownloadUrl = entry.directDownloadUrl;
+    file_stat->directDownloadCookies = entry.directDownloadCookies;
+    file_stat->remotePerm = entry.remotePerm;
+    if (!entry.checksums.isEmpty())
+        file_stat->checksumHeader = findBestChecksum(entry.checksums);
+    if (entry.isShared) {
+        if (file_stat->remotePerm.isNull()) {
+            qWarning() << "Server returned a share type, but no permissions?";
+        } else {
+            // S means shared with me.
+            // But for our purpose, we want to know if the file is shared. It does not matter
+            // if we are the owner or not.
+            // Piggy back on the persmission field
+            file_stat->remotePerm.setPermission(RemotePermissions::IsShared);
         }
     }
 }
 
-void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(QString file, const QMap<QString, QString> &map)
+void DiscoverySingleDirectoryJob::directoryListingEntrySlot(const LsColEntry &entry)
 {
     if (!_ignoredFirst) {
         // The first entry is for the folder itself, we should process it differently.
         _ignoredFirst = true;
-        if (map.contains("permissions")) {
-            RemotePermissions perm(map.value("permissions"));
-            emit firstDirectoryPermissions(perm);
-            _isExternalStorage = perm.hasPermission(RemotePermissions::IsMounted);
+        if (!entry.remotePerm.isNull()) {
+            emit firstDirectoryPermissions(entry.remotePerm);
+            _isExternalStorage = entry.remotePerm.hasPermission(RemotePermissions::IsMounted);
         }
-        if (map.contains("data-fingerprint")) {
-            _dataFingerprint = map.value("data-fingerprint").toUtf8();
+        if (!entry.dataFingerprint.isEmpty()) {
+            _dataFingerprint = entry.dataFingerprint;
         }
     } else {
         // Remove <webDAV-Url>/folder/ from <webDAV-Url>/folder/subfile.txt
+        QString file = entry.href;
         file.remove(0, _lsColJob->reply()->request().url().path().length());
         // remove trailing slash
         while (file.endsWith('/')) {
@@ -376,8 +361,7 @@ void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(QString file, con
 
         std::unique_ptr<csync_file_stat_t> file_stat(new csync_file_stat_t);
         file_stat->path = file.toUtf8();
-        file_stat->size = -1;
-        propertyMapToFileStat(map, file_stat.get());
+        lsColEntryToFileStat(entry, file_stat.get());
         if (file_stat->type == ItemTypeDirectory)
             file_stat->size = 0;
         if (file_stat->type == ItemTypeSkip
@@ -400,28 +384,29 @@ void DiscoverySingleDirectoryJob::directoryListingIteratedSlot(QString file, con
             file_stat->remotePerm.setPermission(RemotePermissions::IsMountedSub);
         }
 
-        QStringRef fileRef(&file);
-        int slashPos = file.lastIndexOf(QLatin1Char('/'));
-        if (slashPos > -1) {
-            fileRef = file.midRef(slashPos + 1);
+        if (_requestFolderSizes && file_stat->type == ItemTypeDirectory && entry.size >= 0) {
+            _folderSizes.insert(file, entry.size);
         }
+
         _results.push_back(std::move(file_stat));
     }
 
     //This works in concerto with the RequestEtagJob and the Folder object to check if the remote folder changed.
-    if (map.contains("getetag")) {
-        _etagConcatenation += map.value("getetag");
+    if (!entry.etag.isEmpty()) {
+        const auto etag = QString::fromUtf8(entry.etag);
+        _etagConcatenation += etag;
 
         if (_firstEtag.isEmpty()) {
-            _firstEtag = map.value("getetag"); // for directory itself
+            _firstEtag = etag; // for directory itself
         }
     }
 }
 
 void DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot()
 {
+    SyncTrace::addSpan("discovery", "PROPFIND", _traceStart, _subPath, true);
     if (!_ignoredFirst) {
-        // This is a sanity check, if we haven't _ignoredFirst then it means we never received any directoryListingIteratedSlot
+        // This is a sanity check, if we haven't _ignoredFirst then it means we never received any directoryListingEntrySlot
         // which means somehow the server XML was bogus
         emit finishedWithError(ERRNO_WRONG_CONTENT, QLatin1String("Server error: PROPFIND reply is not XML formatted!"));
         deleteLater();
@@ -439,6 +424,7 @@ void DiscoverySingleDirectoryJob::lsJobFinishedWithoutErrorSlot()
 
 void DiscoverySingleDirectoryJob::lsJobFinishedWithErrorSlot(QNetworkReply *r)
 {
+    SyncTrace::addSpan("discovery", "PROPFIND", _traceStart, _subPath, true);
     QString contentType = r->header(QNetworkRequest::ContentTypeHeader).toString();
     int httpCode = r->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
     QString httpReason = r->attribute(QNetworkRequest::HttpReasonPhraseAttribute).toString();
@@ -508,6 +494,10 @@ void DiscoveryMainThread::doOpendirSlot(const QString &subPath, DiscoveryDirecto
     if (!_firstFolderProcessed) {
         _singleDirJob->setIsRootPath();
     }
+    // Should be thread safe since the sync thread is blocked
+    if (_discoveryJob->_syncOptions._newBigFolderSizeLimit >= 0) {
+        _singleDirJob->setRequestFolderSizes();
+    }
 
     _singleDirJob->start();
 }
@@ -520,6 +510,7 @@ void DiscoveryMainThread::singleDirectoryJobResultSlot()
     }
 
     _currentDiscoveryDirectoryResult->list = _singleDirJob->takeResults();
+    _currentDiscoveryDirectoryResult->folderSizes = _singleDirJob->takeFolderSizes();
     _currentDiscoveryDirectoryResult->code = 0;
 
     qCDebug(lcDiscovery) << "Have" << _currentDiscoveryDirectoryResult->list.size() << "results for " << _currentDiscoveryDirectoryResult->path;
@@ -665,6 +656,16 @@ csync_vio_handle_t *DiscoveryJob::remote_vio_opendir_hook(const char *url,
             return NULL;
         }
 
+        if (!directoryResult->folderSizes.isEmpty()) {
+            QHash<QString, qint64> folderSizes;
+            for (auto it = directoryResult->folderSizes.constBegin(); it != directoryResult->folderSizes.constEnd(); ++it) {
+                QString path = qurl.isEmpty() ? it.key() : qurl + QLatin1Char('/') + it.key();
+                folderSizes.insert(path, it.value());
+                discoveryJob->_remoteFolderSizes.insert(path, it.value());
+            }
+            directoryResult->folderSizes = std::move(folderSizes);
+        }
+
         return directoryResult.take();
     }
     return NULL;
@@ -693,6 +694,10 @@ void DiscoveryJob::remote_vio_closedir_hook(csync_vio_handle_t *dhandle, void *u
         DiscoveryDirectoryResult *directoryResult = static_cast<DiscoveryDirectoryResult *>(dhandle);
         QString path = directoryResult->path;
         qCDebug(lcDiscovery) << discoveryJob << path;
+        // The subfolders have all been checked by now
+        for (auto it = directoryResult->folderSizes.constBegin(); it != directoryResult->folderSizes.constEnd(); ++it) {
+            discoveryJob->_remoteFolderSizes.remove(it.key());
+        }
         // just deletes the struct and the iterator, the data itself is owned by the SyncEngine/DiscoveryMainThread
         delete directoryResult;
     }
@@ -42,6 +42,9 @@ struct DiscoveryDirectoryResult
     QString msg;
     int code;
     std::deque<std::unique_ptr<csync_file_stat_t>> list;
+    // Sizes of the subfolders, if they were requested. Keyed by name
+    // first, the sync thread changes the keys to the path of the subfolder.
+    QHash<QString, qint64> folderSizes;
     DiscoveryDirectoryResult()
         : code(EIO)
     {
@@ -62,9 +65,12 @@ public:
     explicit DiscoverySingleDirectoryJob(const AccountPtr &account, const QString &path, QObject *parent = 0);
     // Specify thgat this is the root and we need to check the data-fingerprint
     void setIsRootPath() { _isRootPath = true; }
+    // Also ask for the sizes of the subfolders, for the new big folder check
+    void setRequestFolderSizes() { _requestFolderSizes = true; }
     void start();
     void abort();
     std::deque<std::unique_ptr<csync_file_stat_t>> &&takeResults() { return std::move(_results); }
+    QHash<QString, qint64> &&takeFolderSizes() { return std::move(_folderSizes); }
 
     // This is not actually a network job, it is just a job
 signals:
@@ -74,12 +80,13 @@ signals:
     void finishedWithResult();
     void finishedWithError(int csyncErrnoCode, const QString &msg);
 private slots:
-    void directoryListingIteratedSlot(QString, const QMap<QString, QString> &);
+    void directoryListingEntrySlot(const LsColEntry &entry);
     void lsJobFinishedWithoutErrorSlot();
     void lsJobFinishedWithErrorSlot(QNetworkReply *);
 
 private:
     std::deque<std::unique_ptr<csync_file_stat_t>> _results;
+    QHash<QString, qint64> _folderSizes;
     QString _subPath;
     QString _etagConcatenation;
     QString _firstEtag;
@@ -89,11 +96,14 @@ private:
     bool _ignoredFirst;
     // Set to true if this is the root path and we need to check the data-fingerprint
     bool _isRootPath;
+    // Set to true if the sizes of the subfolders are needed
+    bool _requestFolderSizes = false;
     // If this directory is an external storage (The first item has 'M' in its permission)
     bool _isExternalStorage;
     // If set, the discovery will finish with an error
     QString _error;
     QPointer<LsColJob> _lsColJob;
+    qint64 _traceStart = -1;
 
 public:
     QByteArray _dataFingerprint;
@@ -185,6 +195,10 @@ class DiscoveryJob : public QObject
     QMutex _vioMutex;
     QWaitCondition _vioWaitCondition;
 
+    // Sizes of the subfolders of the currently open remote directories,
+    // so checkSelectiveSyncNewFolder() does not need a PROPFIND for them
+    QHash<QString, qint64> _remoteFolderSizes;
+
 
 public:
     explicit DiscoveryJob(CSYNC *ctx, QObject *parent = 0)
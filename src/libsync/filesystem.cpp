@@ -18,6 +18,13 @@
 #include <QFile>
 #include <QFileInfo>
 
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 // We use some internals of csync:
 extern "C" int c_utimes(const char *, const struct timeval *);
 
@@ -113,6 +120,69 @@ bool FileSystem::verifyFileUnchanged(const QString &fileName,
     return true;
 }
 
+bool FileSystem::cloneFile(const QString &source, const QString &destination, QString *errorString)
+{
+    QFile in(source);
+    QFile out(destination);
+    if (!in.open(QIODevice::ReadOnly)) {
+        *errorString = in.errorString();
+        return false;
+    }
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *errorString = out.errorString();
+        return false;
+    }
+
+#ifdef Q_OS_LINUX
+#ifdef FICLONE
+    if (ioctl(out.handle(), FICLONE, in.handle()) == 0) {
+        qCDebug(lcFileSystem) << "Cloned" << source << "to" << destination;
+        return true;
+    }
+#endif
+#ifdef SYS_copy_file_range
+    // With explicit offsets, the file positions are untouched for the fallback
+    const qint64 size = in.size();
+    loff_t inOffset = 0;
+    loff_t outOffset = 0;
+    while (outOffset < size) {
+        const auto copied = syscall(SYS_copy_file_range, in.handle(), &inOffset,
+            out.handle(), &outOffset, size_t(qMin<qint64>(size - outOffset, 1 << 30)), 0u);
+        if (copied <= 0)
+            break;
+    }
+    if (outOffset == size) {
+        qCDebug(lcFileSystem) << "Copied" << source << "to" << destination << "with copy_file_range";
+        return true;
+    }
+    if (outOffset > 0 && !out.resize(0)) {
+        *errorString = out.errorString();
+        return false;
+    }
+#endif
+#endif
+
+    QByteArray buffer(256 * 1024, Qt::Uninitialized);
+    while (true) {
+        const qint64 read = in.read(buffer.data(), buffer.size());
+        if (read < 0) {
+            *errorString = in.errorString();
+            return false;
+        }
+        if (read == 0)
+            break;
+        if (out.write(buffer.constData(), read) != read) {
+            *errorString = out.errorString();
+            return false;
+        }
+    }
+    if (!out.flush()) {
+        *errorString = out.errorString();
+        return false;
+    }
+    return true;
+}
+
 #ifdef Q_OS_WIN
 static qint64 getSizeWithCsync(const QString &filename)
 {
@@ -77,6 +77,16 @@ namespace FileSystem {
     bool verifyFileUnchanged(const QString &fileName,
         qint64 previousSize,
         time_t previousMtime);
+
+    /**
+ * @brief Replaces the content of \a destination with the one of \a source
+ *
+ * Where the file system supports it, the data is shared with a reflink
+ * (FICLONE) or copied in the kernel with copy_file_range. Otherwise the
+ * data is copied through a buffer.
+ */
+    bool OWNCLOUDSYNC_EXPORT cloneFile(const QString &source, const QString &destination,
+        QString *errorString);
 }
 
 /** @} */
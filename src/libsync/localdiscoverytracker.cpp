@@ -15,7 +15,11 @@
 #include "localdiscoverytracker.h"
 
 #include "syncfileitem.h"
+#include "common/syncjournaldb.h"
 
+#include <QDateTime>
+#include <QDirIterator>
+#include <QFileInfo>
 #include <QLoggingCategory>
 
 using namespace OCC;
@@ -57,6 +61,46 @@ const std::set<QByteArray> &LocalDiscoveryTracker::localDiscoveryPaths() const
     return _localDiscoveryPaths;
 }
 
+bool LocalDiscoveryTracker::findChangedDirectories(const QString &localPath, qint64 sinceMSecs,
+    SyncJournalDb *journal, std::set<QByteArray> *paths, const std::atomic<bool> *abort)
+{
+    // Some file systems only store mtimes with a resolution of two seconds
+    const qint64 since = sinceMSecs - 2000;
+
+    QFileInfo root(localPath);
+    if (!root.isDir() || !root.isReadable())
+        return false;
+    if (root.lastModified().toMSecsSinceEpoch() >= since)
+        paths->insert(QByteArray());
+
+    QString basePath = root.absoluteFilePath();
+    if (!basePath.endsWith(QLatin1Char('/')))
+        basePath.append(QLatin1Char('/'));
+
+    QDirIterator it(basePath,
+        QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::NoSymLinks,
+        QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        if (abort && *abort)
+            return false;
+        it.next();
+        const QByteArray relativePath = it.filePath().mid(basePath.size()).toUtf8();
+
+        if (it.fileInfo().lastModified().toMSecsSinceEpoch() >= since) {
+            paths->insert(relativePath);
+            continue;
+        }
+
+        SyncJournalFileRecord record;
+        if (!journal->getFileRecord(relativePath, &record))
+            return false;
+        if (!record.isValid() || record._type != ItemTypeDirectory)
+            paths->insert(relativePath);
+    }
+    qCInfo(lcLocalDiscoveryTracker) << "found" << paths->size() << "directories changed since" << sinceMSecs;
+    return true;
+}
+
 void LocalDiscoveryTracker::slotItemCompleted(const SyncFileItemPtr &item)
 {
     // For successes, we want to wipe the file from the list to ensure we don't
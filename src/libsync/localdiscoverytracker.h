@@ -20,10 +20,12 @@
 #include <QObject>
 #include <QByteArray>
 #include <QSharedPointer>
+#include <atomic>
 
 namespace OCC {
 
 class SyncFileItem;
+class SyncJournalDb;
 typedef QSharedPointer<SyncFileItem> SyncFileItemPtr;
 
 /**
@@ -68,6 +70,24 @@ public:
     /** Access list of files that shall be locally rediscovered. */
     const std::set<QByteArray> &localDiscoveryPaths() const;
 
+    /**
+     * Finds directories that may have changed since a point in time.
+     *
+     * Used after a restart to catch up with the changes that happened while
+     * nobody was watching. A directory below localPath is added to paths if
+     * its mtime is not older than sinceMSecs or if the journal doesn't know
+     * it as a directory (created, moved in or renamed in the meantime).
+     *
+     * Files that were modified in place don't change the mtime of their
+     * parent directory and can't be found that way.
+     *
+     * This only reads directories and may be called from any thread.
+     * Returns false if the walk failed or was aborted.
+     */
+    static bool findChangedDirectories(const QString &localPath, qint64 sinceMSecs,
+        SyncJournalDb *journal, std::set<QByteArray> *paths,
+        const std::atomic<bool> *abort = nullptr);
+
 public slots:
     /**
      * Success and failure of sync items adjust what the next sync is
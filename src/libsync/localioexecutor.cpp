@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "localioexecutor.h"
+
+#include <QFutureWatcher>
+#include <QLoggingCategory>
+#include <QThread>
+#include <qtconcurrentrun.h>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcLocalIo, "sync.propagator.localio", QtInfoMsg)
+
+LocalIoExecutor::LocalIoExecutor(QObject *parent)
+    : QObject(parent)
+{
+    // More threads don't help much with a single disk
+    int threads = qBound(2, QThread::idealThreadCount(), 4);
+    bool ok = false;
+    int envThreads = qEnvironmentVariableIntValue("OWNCLOUD_LOCAL_IO_THREADS", &ok);
+    if (ok && envThreads >= 0)
+        threads = envThreads;
+    _synchronous = threads == 0;
+    _pool.setMaxThreadCount(qMax(1, threads));
+}
+
+LocalIoExecutor::~LocalIoExecutor()
+{
+    _queues.clear();
+    _pool.waitForDone();
+}
+
+void LocalIoExecutor::submit(const QString &key, const std::function<void()> &work,
+    QObject *context, const std::function<void()> &done)
+{
+    if (_synchronous) {
+        work();
+        if (context)
+            done();
+        return;
+    }
+
+    ++_queueDepth;
+    if (_queueDepth > _maxQueueDepth) {
+        _maxQueueDepth = _queueDepth;
+        if (_maxQueueDepth % 100 == 0)
+            qCInfo(lcLocalIo) << "Local I/O queue depth" << _maxQueueDepth;
+    }
+
+    auto &queue = _queues[key];
+    queue.push_back(Task{ work, context, done });
+    if (queue.size() == 1)
+        startNext(key);
+}
+
+void LocalIoExecutor::startNext(const QString &key)
+{
+    const Task &task = _queues[key].front();
+    auto watcher = new QFutureWatcher<void>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, key]() {
+        watcher->deleteLater();
+        taskFinished(key);
+    });
+    watcher->setFuture(QtConcurrent::run(&_pool, task.work));
+}
+
+void LocalIoExecutor::taskFinished(const QString &key)
+{
+    auto it = _queues.find(key);
+    if (it == _queues.end())
+        return;
+    const Task task = it->front();
+    it->pop_front();
+    --_queueDepth;
+    if (it->empty()) {
+        _queues.erase(it);
+    } else {
+        startNext(key);
+    }
+
+    if (task.context)
+        task.done();
+}
+}
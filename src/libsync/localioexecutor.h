@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef LOCALIOEXECUTOR_H
+#define LOCALIOEXECUTOR_H
+
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QThreadPool>
+
+#include <deque>
+#include <functional>
+
+#include "owncloudlib.h"
+
+namespace OCC {
+
+/**
+ * @brief Runs blocking local file system work of the propagation jobs off the main thread
+ * @ingroup libsync
+ *
+ * Deleting a big directory or renaming files on a slow disk would otherwise
+ * block the network jobs and the GUI.
+ *
+ * Work submitted with the same key, usually the parent directory of the
+ * item, runs in submission order. Work for different keys runs in parallel.
+ * The work function runs in a worker thread and must not touch the journal
+ * or the propagator; the done function is called in the thread of the
+ * executor afterwards, unless the context object was deleted in between.
+ *
+ * With OWNCLOUD_LOCAL_IO_THREADS=0 everything runs synchronously in submit().
+ */
+class OWNCLOUDSYNC_EXPORT LocalIoExecutor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LocalIoExecutor(QObject *parent = 0);
+    /// Waits for the running work, queued work is dropped
+    ~LocalIoExecutor();
+
+    void submit(const QString &key, const std::function<void()> &work,
+        QObject *context, const std::function<void()> &done);
+
+    /// The key for work on a path: its parent directory
+    static QString keyForPath(const QString &relativePath)
+    {
+        return relativePath.left(qMax(0, relativePath.lastIndexOf(QLatin1Char('/'))));
+    }
+
+    /// Number of submitted tasks that did not finish yet
+    int queueDepth() const { return _queueDepth; }
+    int maxQueueDepth() const { return _maxQueueDepth; }
+
+private:
+    struct Task
+    {
+        std::function<void()> work;
+        QPointer<QObject> context;
+        std::function<void()> done;
+    };
+
+    void startNext(const QString &key);
+    void taskFinished(const QString &key);
+
+    QThreadPool _pool;
+    bool _synchronous = false;
+    QHash<QString, std::deque<Task>> _queues;
+    int _queueDepth = 0;
+    int _maxQueueDepth = 0;
+};
+}
+
+#endif // LOCALIOEXECUTOR_H
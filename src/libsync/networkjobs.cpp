@@ -24,6 +24,7 @@
 #include <QXmlStreamReader>
 #include <QStringList>
 #include <QStack>
+#include <QMetaMethod>
 #include <QTimer>
 #include <QMutex>
 #include <QCoreApplication>
@@ -34,6 +35,7 @@
 #include "networkjobs.h"
 #include "account.h"
 #include "owncloudpropagator.h"
+#include "csync.h"
 
 #include "creds/abstractcredentials.h"
 #include "creds/httpcredentials.h"
@@ -46,6 +48,7 @@ Q_LOGGING_CATEGORY(lcCheckServerJob, "sync.networkjob.checkserver", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcPropfindJob, "sync.networkjob.propfind", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcAvatarJob, "sync.networkjob.avatar", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcMkColJob, "sync.networkjob.mkcol", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcCopyJob, "sync.networkjob.copy", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcProppatchJob, "sync.networkjob.proppatch", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcJsonApiJob, "sync.networkjob.jsonapi", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcDetermineAuthTypeJob, "sync.networkjob.determineauthtype", QtInfoMsg)
@@ -113,6 +116,36 @@ bool RequestEtagJob::finished()
 
 /*********************************************************************************************/
 
+CopyJob::CopyJob(AccountPtr account, const QString &path, const QString &destination,
+    const QMap<QByteArray, QByteArray> &extraHeaders, QObject *parent)
+    : AbstractNetworkJob(account, path, parent)
+    , _destination(destination)
+    , _extraHeaders(extraHeaders)
+{
+}
+
+void CopyJob::start()
+{
+    QNetworkRequest req;
+    req.setRawHeader("Destination", QUrl::toPercentEncoding(_destination, "/"));
+    for (auto it = _extraHeaders.constBegin(); it != _extraHeaders.constEnd(); ++it) {
+        req.setRawHeader(it.key(), it.value());
+    }
+    sendRequest("COPY", makeDavUrl(path()), req);
+    AbstractNetworkJob::start();
+}
+
+bool CopyJob::finished()
+{
+    qCInfo(lcCopyJob) << "COPY of" << reply()->request().url() << "FINISHED WITH STATUS"
+                      << replyStatusString();
+
+    emit finishedSignal();
+    return true;
+}
+
+/*********************************************************************************************/
+
 MkColJob::MkColJob(AccountPtr account, const QString &path, QObject *parent)
     : AbstractNetworkJob(account, path, parent)
 {
@@ -154,136 +187,300 @@ bool MkColJob::finished()
 }
 
 /*********************************************************************************************/
-// supposed to read <D:collection> when pointing to <D:resourcetype><D:collection></D:resourcetype>..
-static QString readContentsAsString(QXmlStreamReader &reader)
-{
-    QString result;
-    int level = 0;
-    do {
-        QXmlStreamReader::TokenType type = reader.readNext();
-        if (type == QXmlStreamReader::StartElement) {
-            level++;
-            result += "<" + reader.name().toString() + ">";
-        } else if (type == QXmlStreamReader::Characters) {
-            result += reader.text();
-        } else if (type == QXmlStreamReader::EndElement) {
-            level--;
-            if (level < 0) {
-                break;
-            }
-            result += "</" + reader.name().toString() + ">";
-        }
 
-    } while (!reader.atEnd());
-    return result;
+void LsColEntry::clear()
+{
+    *this = LsColEntry();
 }
 
-
 LsColXMLParser::LsColXMLParser()
 {
 }
 
 bool LsColXMLParser::parse(const QByteArray &xml, QHash<QString, qint64> *sizes, const QString &expectedPath)
 {
-    // Parse DAV response
-    QXmlStreamReader reader(xml);
-    reader.addExtraNamespaceDeclaration(QXmlStreamNamespaceDeclaration("d", "DAV:"));
-
-    QStringList folders;
-    QString currentHref;
-    QMap<QString, QString> currentTmpProperties;
-    QMap<QString, QString> currentHttp200Properties;
-    bool currentPropsHaveHttp200 = false;
-    bool insidePropstat = false;
-    bool insideProp = false;
-    bool insideMultiStatus = false;
-
-    while (!reader.atEnd()) {
-        QXmlStreamReader::TokenType type = reader.readNext();
-        QString name = reader.name().toString();
-        // Start elements with DAV:
-        if (type == QXmlStreamReader::StartElement && reader.namespaceUri() == QLatin1String("DAV:")) {
-            if (name == QLatin1String("href")) {
-                // We don't use URL encoding in our request URL (which is the expected path) (QNAM will do it for us)
-                // but the result will have URL encoding..
-                QString hrefString = QString::fromUtf8(QByteArray::fromPercentEncoding(reader.readElementText().toUtf8()));
-                if (!hrefString.startsWith(expectedPath)) {
-                    qCWarning(lcLsColJob) << "Invalid href" << hrefString << "expected starting with" << expectedPath;
-                    return false;
-                }
-                currentHref = hrefString;
-            } else if (name == QLatin1String("response")) {
-            } else if (name == QLatin1String("propstat")) {
-                insidePropstat = true;
-            } else if (name == QLatin1String("status") && insidePropstat) {
-                QString httpStatus = reader.readElementText();
-                if (httpStatus.startsWith("HTTP/1.1 200")) {
-                    currentPropsHaveHttp200 = true;
-                } else {
-                    currentPropsHaveHttp200 = false;
-                }
-            } else if (name == QLatin1String("prop")) {
-                insideProp = true;
-                continue;
-            } else if (name == QLatin1String("multistatus")) {
-                insideMultiStatus = true;
-                continue;
-            }
-        }
+    start(sizes, expectedPath);
+    return addData(xml) && finish();
+}
 
-        if (type == QXmlStreamReader::StartElement && insidePropstat && insideProp) {
-            // All those elements are properties
-            QString propertyContent = readContentsAsString(reader);
-            if (name == QLatin1String("resourcetype") && propertyContent.contains("collection")) {
-                folders.append(currentHref);
-            } else if (name == QLatin1String("size")) {
-                bool ok = false;
-                auto s = propertyContent.toLongLong(&ok);
-                if (ok && sizes) {
-                    sizes->insert(currentHref, s);
-                }
-            }
-            currentTmpProperties.insert(reader.name().toString(), propertyContent);
-        }
+void LsColXMLParser::start(QHash<QString, qint64> *sizes, const QString &expectedPath)
+{
+    _reader.clear();
+    _reader.addExtraNamespaceDeclaration(QXmlStreamNamespaceDeclaration("d", "DAV:"));
+    _sizes = sizes;
+    _expectedPath = expectedPath;
+    _failed = false;
+    _buildPropertyMap = isSignalConnected(QMetaMethod::fromSignal(&LsColXMLParser::directoryListingIterated));
+
+    _insideMultiStatus = false;
+    _insidePropstat = false;
+    _insideProp = false;
+    _propstatIsHttp200 = false;
+    _textTarget = NoText;
+    _propertyDepth = 0;
+    _currentHref.clear();
+    _propstatProperties.clear();
+    _entry.clear();
+    _propertyMap.clear();
+    _folders.clear();
+}
 
-        // End elements with DAV:
-        if (type == QXmlStreamReader::EndElement) {
-            if (reader.namespaceUri() == QLatin1String("DAV:")) {
-                if (reader.name() == "response") {
-                    if (currentHref.endsWith('/')) {
-                        currentHref.chop(1);
-                    }
-                    emit directoryListingIterated(currentHref, currentHttp200Properties);
-                    currentHref.clear();
-                    currentHttp200Properties.clear();
-                } else if (reader.name() == "propstat") {
-                    insidePropstat = false;
-                    if (currentPropsHaveHttp200) {
-                        currentHttp200Properties = QMap<QString, QString>(currentTmpProperties);
-                    }
-                    currentTmpProperties.clear();
-                    currentPropsHaveHttp200 = false;
-                } else if (reader.name() == "prop") {
-                    insideProp = false;
-                }
-            }
+bool LsColXMLParser::addData(const QByteArray &data)
+{
+    if (_failed)
+        return false;
+    _reader.addData(data);
+    if (!parseAvailable()) {
+        _failed = true;
+        return false;
+    }
+    return true;
+}
+
+bool LsColXMLParser::finish()
+{
+    if (_failed)
+        return false;
+
+    if (_reader.hasError()) {
+        // With all data there, a premature end is an error too
+        qCWarning(lcLsColJob) << "ERROR" << _reader.errorString();
+        return false;
+    } else if (!_insideMultiStatus) {
+        qCWarning(lcLsColJob) << "ERROR no WebDAV response?";
+        return false;
+    }
+    emit directoryListingSubfolders(_folders);
+    emit finishedWithoutError();
+    return true;
+}
+
+bool LsColXMLParser::parseAvailable()
+{
+    while (!_reader.atEnd()) {
+        switch (_reader.readNext()) {
+        case QXmlStreamReader::StartElement:
+            if (!startElement())
+                return false;
+            break;
+        case QXmlStreamReader::EndElement:
+            if (!endElement())
+                return false;
+            break;
+        case QXmlStreamReader::Characters:
+            if (_textTarget != NoText)
+                _text += _reader.text();
+            break;
+        default:
+            break;
         }
     }
 
-    if (reader.hasError()) {
+    if (_reader.hasError() && _reader.error() != QXmlStreamReader::PrematureEndOfDocumentError) {
         // XML Parser error? Whatever had been emitted before will come as directoryListingIterated
-        qCWarning(lcLsColJob) << "ERROR" << reader.errorString() << xml;
-        return false;
-    } else if (!insideMultiStatus) {
-        qCWarning(lcLsColJob) << "ERROR no WebDAV response?" << xml;
+        qCWarning(lcLsColJob) << "ERROR" << _reader.errorString();
         return false;
-    } else {
-        emit directoryListingSubfolders(folders);
-        emit finishedWithoutError();
     }
     return true;
 }
 
+bool LsColXMLParser::startElement()
+{
+    const QStringRef name = _reader.name();
+
+    if (_propertyDepth > 0) {
+        // Nested elements are kept as text, like "<collection></collection>"
+        ++_propertyDepth;
+        _text.append(QLatin1Char('<')).append(name).append(QLatin1Char('>'));
+        return true;
+    }
+
+    if (_insidePropstat && _insideProp) {
+        // All those elements are properties
+        _propertyDepth = 1;
+        _propertyId = UnknownProperty;
+        if (name == QLatin1String("resourcetype")) {
+            _propertyId = ResourceTypeProperty;
+        } else if (name == QLatin1String("getlastmodified")) {
+            _propertyId = GetLastModifiedProperty;
+        } else if (name == QLatin1String("getcontentlength")) {
+            _propertyId = GetContentLengthProperty;
+        } else if (name == QLatin1String("getetag")) {
+            _propertyId = GetEtagProperty;
+        } else if (name == QLatin1String("id")) {
+            _propertyId = IdProperty;
+        } else if (name == QLatin1String("downloadURL")) {
+            _propertyId = DownloadUrlProperty;
+        } else if (name == QLatin1String("dDC")) {
+            _propertyId = DDCProperty;
+        } else if (name == QLatin1String("permissions")) {
+            _propertyId = PermissionsProperty;
+        } else if (name == QLatin1String("checksums")) {
+            _propertyId = ChecksumsProperty;
+        } else if (name == QLatin1String("share-types")) {
+            _propertyId = ShareTypesProperty;
+        } else if (name == QLatin1String("data-fingerprint")) {
+            _propertyId = DataFingerprintProperty;
+        } else if (name == QLatin1String("size")) {
+            _propertyId = SizeProperty;
+        }
+        if (_buildPropertyMap)
+            _propertyName = name.toString();
+        _textTarget = PropertyText;
+        _text.clear();
+        return true;
+    }
+
+    if (_reader.namespaceUri() != QLatin1String("DAV:"))
+        return true;
+
+    if (name == QLatin1String("href")) {
+        _textTarget = HrefText;
+        _text.clear();
+    } else if (name == QLatin1String("propstat")) {
+        _insidePropstat = true;
+    } else if (name == QLatin1String("status") && _insidePropstat) {
+        _textTarget = StatusText;
+        _text.clear();
+    } else if (name == QLatin1String("prop")) {
+        _insideProp = true;
+    } else if (name == QLatin1String("multistatus")) {
+        _insideMultiStatus = true;
+    }
+    return true;
+}
+
+bool LsColXMLParser::endElement()
+{
+    if (_propertyDepth > 0) {
+        if (--_propertyDepth > 0) {
+            _text.append(QLatin1String("</")).append(_reader.name()).append(QLatin1Char('>'));
+        } else {
+            endProperty();
+            _textTarget = NoText;
+        }
+        return true;
+    }
+
+    if (_textTarget == HrefText) {
+        _textTarget = NoText;
+        // We don't use URL encoding in our request URL (which is the expected path) (QNAM will do it for us)
+        // but the result will have URL encoding..
+        QString hrefString = QString::fromUtf8(QByteArray::fromPercentEncoding(_text.toUtf8()));
+        if (!hrefString.startsWith(_expectedPath)) {
+            qCWarning(lcLsColJob) << "Invalid href" << hrefString << "expected starting with" << _expectedPath;
+            return false;
+        }
+        _currentHref = hrefString;
+    } else if (_textTarget == StatusText) {
+        _textTarget = NoText;
+        _propstatIsHttp200 = _text.startsWith(QLatin1String("HTTP/1.1 200"));
+    }
+
+    if (_reader.namespaceUri() != QLatin1String("DAV:"))
+        return true;
+
+    const QStringRef name = _reader.name();
+    if (name == QLatin1String("response")) {
+        if (_currentHref.endsWith(QLatin1Char('/'))) {
+            _currentHref.chop(1);
+        }
+        _entry.href = _currentHref;
+        emit directoryListingEntry(_entry);
+        if (_buildPropertyMap) {
+            emit directoryListingIterated(_currentHref, _propertyMap);
+            _propertyMap.clear();
+        }
+        _currentHref.clear();
+        _entry.clear();
+    } else if (name == QLatin1String("propstat")) {
+        _insidePropstat = false;
+        if (_propstatIsHttp200) {
+            for (const auto &property : _propstatProperties)
+                applyProperty(property);
+        }
+        _propstatProperties.clear();
+        _propstatIsHttp200 = false;
+    } else if (name == QLatin1String("prop")) {
+        _insideProp = false;
+    }
+    return true;
+}
+
+void LsColXMLParser::endProperty()
+{
+    if (_propertyId == ResourceTypeProperty && _text.contains(QLatin1String("collection"))) {
+        _folders.append(_currentHref);
+    } else if (_propertyId == SizeProperty) {
+        bool ok = false;
+        auto s = _text.toLongLong(&ok);
+        if (ok && _sizes) {
+            _sizes->insert(_currentHref, s);
+        }
+    }
+
+    // Only known properties are needed unless the map is built
+    if (_propertyId == UnknownProperty && !_buildPropertyMap)
+        return;
+    _propstatProperties.push_back({ _propertyId, _propertyName, _text });
+}
+
+void LsColXMLParser::applyProperty(const PendingProperty &property)
+{
+    if (_buildPropertyMap)
+        _propertyMap.insert(property.name, property.value);
+
+    const QString &value = property.value;
+    bool ok = false;
+    switch (property.id) {
+    case UnknownProperty:
+        break;
+    case ResourceTypeProperty:
+        _entry.hasResourceType = true;
+        _entry.isCollection = value.contains(QLatin1String("collection"));
+        break;
+    case GetLastModifiedProperty:
+        _entry.modtime = oc_httpdate_parse(value.toUtf8().constData());
+        break;
+    case GetContentLengthProperty: {
+        // See #4573, sometimes negative size values are returned
+        qint64 length = value.toLongLong(&ok);
+        _entry.contentLength = ok && length >= 0 ? length : 0;
+        break;
+    }
+    case GetEtagProperty:
+        _entry.etag = value.toUtf8();
+        break;
+    case IdProperty:
+        _entry.fileId = value.toUtf8();
+        break;
+    case DownloadUrlProperty:
+        _entry.directDownloadUrl = value.toUtf8();
+        break;
+    case DDCProperty:
+        _entry.directDownloadCookies = value.toUtf8();
+        break;
+    case PermissionsProperty:
+        _entry.remotePerm = RemotePermissions(value);
+        break;
+    case ChecksumsProperty:
+        _entry.checksums = value.toUtf8();
+        break;
+    case ShareTypesProperty:
+        _entry.isShared = !value.isEmpty();
+        break;
+    case DataFingerprintProperty:
+        _entry.dataFingerprint = value.toUtf8();
+        break;
+    case SizeProperty: {
+        qint64 size = value.toLongLong(&ok);
+        if (ok)
+            _entry.size = size;
+        break;
+    }
+    }
+}
+
 /*********************************************************************************************/
 
 LsColJob::LsColJob(AccountPtr account, const QString &path, QObject *parent)
@@ -347,29 +544,56 @@ void LsColJob::start()
     AbstractNetworkJob::start();
 }
 
-// TODO: Instead of doing all in this slot, we should iteratively parse in readyRead(). This
-// would allow us to be more asynchronous in processing while data is coming from the network,
-// not all in one big blob at the end.
+void LsColJob::newReplyHook(QNetworkReply *reply)
+{
+    // Redirects get a new reply and start over
+    _parser.reset(new LsColXMLParser);
+    _parseFailed = false;
+    connect(_parser.data(), &LsColXMLParser::directoryListingSubfolders,
+        this, &LsColJob::directoryListingSubfolders);
+    connect(_parser.data(), &LsColXMLParser::directoryListingEntry,
+        this, &LsColJob::directoryListingEntry);
+    if (isSignalConnected(QMetaMethod::fromSignal(&LsColJob::directoryListingIterated))) {
+        connect(_parser.data(), &LsColXMLParser::directoryListingIterated,
+            this, &LsColJob::directoryListingIterated);
+    }
+    connect(_parser.data(), &LsColXMLParser::finishedWithError,
+        this, &LsColJob::finishedWithError);
+    connect(_parser.data(), &LsColXMLParser::finishedWithoutError,
+        this, &LsColJob::finishedWithoutError);
+
+    QString expectedPath = reply->request().url().path(); // something like "/owncloud/remote.php/webdav/folder"
+    _parser->start(&_sizes, expectedPath);
+
+    connect(reply, &QIODevice::readyRead, this, &LsColJob::slotReadyRead);
+}
+
+bool LsColJob::isMultiStatusReply() const
+{
+    QString contentType = reply()->header(QNetworkRequest::ContentTypeHeader).toString();
+    int httpCode = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    return httpCode == 207 && contentType.contains("application/xml; charset=utf-8");
+}
+
+void LsColJob::slotReadyRead()
+{
+    // Parse while the data comes in instead of holding the whole reply
+    if (!reply() || _parseFailed || !isMultiStatusReply())
+        return;
+    if (!_parser->addData(reply()->readAll()))
+        _parseFailed = true;
+}
+
 bool LsColJob::finished()
 {
     qCInfo(lcLsColJob) << "LSCOL of" << reply()->request().url() << "FINISHED WITH STATUS"
                        << replyStatusString();
 
-    QString contentType = reply()->header(QNetworkRequest::ContentTypeHeader).toString();
     int httpCode = reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-    if (httpCode == 207 && contentType.contains("application/xml; charset=utf-8")) {
-        LsColXMLParser parser;
-        connect(&parser, &LsColXMLParser::directoryListingSubfolders,
-            this, &LsColJob::directoryListingSubfolders);
-        connect(&parser, &LsColXMLParser::directoryListingIterated,
-            this, &LsColJob::directoryListingIterated);
-        connect(&parser, &LsColXMLParser::finishedWithError,
-            this, &LsColJob::finishedWithError);
-        connect(&parser, &LsColXMLParser::finishedWithoutError,
-            this, &LsColJob::finishedWithoutError);
-
-        QString expectedPath = reply()->request().url().path(); // something like "/owncloud/remote.php/webdav/folder"
-        if (!parser.parse(reply()->readAll(), &_sizes, expectedPath)) {
+    if (isMultiStatusReply()) {
+        if (_parseFailed
+            || !_parser->addData(reply()->readAll())
+            || !_parser->finish()) {
             // XML parse error
             emit finishedWithError(reply());
         }
@@ -446,6 +670,7 @@ static void mergeSslConfigurationForSslButton(const QSslConfiguration &config, A
     }
     if (config.sessionTicket().length() > 0) {
         account->_sessionTicket = config.sessionTicket();
+        account->_sessionTicketLifeTimeHint = config.sessionTicketLifeTimeHint();
     }
 }
 
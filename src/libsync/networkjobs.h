@@ -17,8 +17,13 @@
 #define NETWORKJOBS_H
 
 #include "abstractnetworkjob.h"
+#include "common/remotepermissions.h"
 #include <QUrlQuery>
+#include <QXmlStreamReader>
+#include <QScopedPointer>
+#include <ctime>
 #include <functional>
+#include <vector>
 
 class QUrl;
 class QJsonObject;
@@ -44,7 +49,41 @@ private slots:
 };
 
 /**
- * @brief The LsColJob class
+ * @brief One entry of a PROPFIND reply
+ *
+ * Holds the properties of the HTTP 200 propstat that the sync engine
+ * uses, already converted. Sizes are -1 if the property was missing, the
+ * modification time is 0 then, like for an unparsable date.
+ *
+ * @ingroup libsync
+ */
+struct OWNCLOUDSYNC_EXPORT LsColEntry
+{
+    void clear();
+
+    QString href; // percent-decoded, without trailing slash
+    bool hasResourceType = false;
+    bool isCollection = false;
+    time_t modtime = 0; // 0 if missing or invalid
+    qint64 contentLength = -1; // 0 for invalid values, see #4573
+    qint64 size = -1; // oc:size
+    QByteArray etag; // as sent by the server, not normalized
+    QByteArray fileId;
+    QByteArray directDownloadUrl;
+    QByteArray directDownloadCookies;
+    QByteArray checksums;
+    QByteArray dataFingerprint;
+    RemotePermissions remotePerm;
+    bool isShared = false; // share-types not empty
+};
+
+/**
+ * @brief Parser for PROPFIND replies
+ *
+ * Can parse a complete reply with parse(), or incrementally: call
+ * start(), then addData() whenever data arrives and finish() at the end.
+ * Entries are emitted as soon as their <response> element is complete.
+ *
  * @ingroup libsync
  */
 class OWNCLOUDSYNC_EXPORT LsColXMLParser : public QObject
@@ -55,11 +94,81 @@ public:
 
     bool parse(const QByteArray &xml, QHash<QString, qint64> *sizes, const QString &expectedPath);
 
+    void start(QHash<QString, qint64> *sizes, const QString &expectedPath);
+    /** Returns false on error, the remaining data is ignored then */
+    bool addData(const QByteArray &data);
+    /** Returns false if the document was invalid or incomplete */
+    bool finish();
+
 signals:
     void directoryListingSubfolders(const QStringList &items);
+    void directoryListingEntry(const LsColEntry &entry);
+    /**
+     * Like directoryListingEntry, with all properties as strings.
+     *
+     * The map is only built if this signal is connected when start() is called.
+     */
     void directoryListingIterated(const QString &name, const QMap<QString, QString> &properties);
     void finishedWithError(QNetworkReply *reply);
     void finishedWithoutError();
+
+private:
+    enum Property {
+        UnknownProperty,
+        ResourceTypeProperty,
+        GetLastModifiedProperty,
+        GetContentLengthProperty,
+        GetEtagProperty,
+        IdProperty,
+        DownloadUrlProperty,
+        DDCProperty,
+        PermissionsProperty,
+        ChecksumsProperty,
+        ShareTypesProperty,
+        DataFingerprintProperty,
+        SizeProperty
+    };
+    struct PendingProperty
+    {
+        Property id;
+        QString name; // only set if the map is built
+        QString value;
+    };
+
+    bool parseAvailable();
+    bool startElement();
+    bool endElement();
+    void endProperty();
+    void applyProperty(const PendingProperty &property);
+
+    QXmlStreamReader _reader;
+    QHash<QString, qint64> *_sizes = nullptr;
+    QString _expectedPath;
+    bool _failed = false;
+    bool _buildPropertyMap = false;
+
+    bool _insideMultiStatus = false;
+    bool _insidePropstat = false;
+    bool _insideProp = false;
+    bool _propstatIsHttp200 = false;
+
+    enum TextTarget {
+        NoText,
+        HrefText,
+        StatusText,
+        PropertyText
+    };
+    TextTarget _textTarget = NoText;
+    QString _text;
+    int _propertyDepth = 0; // nesting level inside the current property
+    Property _propertyId = UnknownProperty;
+    QString _propertyName;
+
+    QString _currentHref;
+    std::vector<PendingProperty> _propstatProperties;
+    LsColEntry _entry;
+    QMap<QString, QString> _propertyMap;
+    QStringList _folders;
 };
 
 class OWNCLOUDSYNC_EXPORT LsColJob : public AbstractNetworkJob
@@ -84,16 +193,27 @@ public:
 
 signals:
     void directoryListingSubfolders(const QStringList &items);
+    void directoryListingEntry(const LsColEntry &entry);
     void directoryListingIterated(const QString &name, const QMap<QString, QString> &properties);
     void finishedWithError(QNetworkReply *reply);
     void finishedWithoutError();
 
 private slots:
     virtual bool finished() Q_DECL_OVERRIDE;
+    void slotReadyRead();
+
+protected:
+    void newReplyHook(QNetworkReply *reply) Q_DECL_OVERRIDE;
 
 private:
+    bool isMultiStatusReply() const;
+
     QList<QByteArray> _properties;
     QUrl _url; // Used instead of path() if the url is specified in the constructor
+
+    /// Parses the reply as it arrives, set up in newReplyHook()
+    QScopedPointer<LsColXMLParser> _parser;
+    bool _parseFailed = false;
 };
 
 /**
@@ -211,6 +331,32 @@ private:
     QMap<QByteArray, QByteArray> _properties;
 };
 
+/**
+ * @brief Server side WebDAV COPY of a file
+ *
+ * destination is the path part of the target url. Preconditions like
+ * If-Match in extraHeaders apply to the source.
+ *
+ * @ingroup libsync
+ */
+class OWNCLOUDSYNC_EXPORT CopyJob : public AbstractNetworkJob
+{
+    Q_OBJECT
+    const QString _destination;
+    QMap<QByteArray, QByteArray> _extraHeaders;
+
+public:
+    explicit CopyJob(AccountPtr account, const QString &path, const QString &destination,
+        const QMap<QByteArray, QByteArray> &extraHeaders, QObject *parent = 0);
+    void start() Q_DECL_OVERRIDE;
+
+signals:
+    void finishedSignal();
+
+private slots:
+    virtual bool finished() Q_DECL_OVERRIDE;
+};
+
 /**
  * @brief The MkColJob class
  * @ingroup libsync
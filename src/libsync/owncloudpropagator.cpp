@@ -94,10 +94,15 @@ int OwncloudPropagator::hardMaximumActiveJob()
 {
     if (!_syncOptions._parallelNetworkJobs)
         return 1;
+    return hardMaximumActiveJob(_account);
+}
+
+int OwncloudPropagator::hardMaximumActiveJob(const AccountPtr &account)
+{
     static int max = qgetenv("OWNCLOUD_MAX_PARALLEL").toUInt();
     if (max)
         return max;
-    if (_account->isHttp2Supported())
+    if (account->isHttp2Supported())
         return 20;
     return 6; // (Qt cannot do more anyway)
 }
@@ -112,6 +117,29 @@ PropagateItemJob::~PropagateItemJob()
     }
 }
 
+void PropagateItemJob::runLocalIo(const std::function<void()> &work, const std::function<void()> &done)
+{
+    _localIoRunning = true;
+    propagator()->_localIo.submit(LocalIoExecutor::keyForPath(_item->_file), work, this, [this, done]() {
+        _localIoRunning = false;
+        done();
+        if (_abortAfterLocalIo) {
+            _abortAfterLocalIo = false;
+            emit abortFinished();
+        }
+    });
+}
+
+void PropagateItemJob::abort(PropagatorJob::AbortType abortType)
+{
+    if (_localIoRunning) {
+        if (abortType == AbortType::Asynchronous)
+            _abortAfterLocalIo = true;
+        return;
+    }
+    PropagatorJob::abort(abortType);
+}
+
 static qint64 getMinBlacklistTime()
 {
     return qMax(qEnvironmentVariableIntValue("OWNCLOUD_BLACKLIST_TIME_MIN"),
@@ -227,6 +255,8 @@ void PropagateItemJob::done(SyncFileItem::Status statusArg, const QString &error
     _item->_status = statusArg;
 
     _state = Finished;
+    if (_traceStart >= 0)
+        SyncTrace::addSpan("propagator", metaObject()->className(), _traceStart, _item->_file, true);
     if (_item->_isRestoration) {
         if (_item->_status == SyncFileItem::Success
             || _item->_status == SyncFileItem::Conflict) {
@@ -375,12 +405,15 @@ void OwncloudPropagator::start(const SyncFileItemVector &items)
      * In order to do that we loop over the items. (which are sorted by destination)
      * When we enter a directory, we can create the directory job and push it on the stack. */
 
-    _rootJob.reset(new PropagateDirectory(this));
+    _rootJob.reset(new PropagateRootDirectory(this));
     QStack<QPair<QString /* directory name */, PropagateDirectory * /* job */>> directories;
     directories.push(qMakePair(QString(), _rootJob.data()));
     QVector<PropagatorJob *> directoriesToRemove;
     QString removedDirectory;
     QString maybeConflictDirectory;
+    // Small new files, by directory, that can be uploaded with PropagateUploadBulk
+    QVector<QPair<PropagateDirectory *, SyncFileItemVector>> bulkUploads;
+    QHash<PropagateDirectory *, int> bulkUploadIndex;
     foreach (const SyncFileItemPtr &item, items) {
         if (!removedDirectory.isEmpty() && item->_file.startsWith(removedDirectory)) {
             // this is an item in a directory which is going to be removed.
@@ -474,6 +507,14 @@ void OwncloudPropagator::start(const SyncFileItemVector &items)
                 // will delete directories, so defer execution
                 directoriesToRemove.prepend(createJob(item));
                 removedDirectory = item->_file + "/";
+            } else if (PropagateUploadBulk::canUpload(this, *item)) {
+                PropagateDirectory *dir = directories.top().second;
+                auto it = bulkUploadIndex.find(dir);
+                if (it == bulkUploadIndex.end()) {
+                    it = bulkUploadIndex.insert(dir, bulkUploads.size());
+                    bulkUploads.append(qMakePair(dir, SyncFileItemVector()));
+                }
+                bulkUploads[it.value()].second.append(item);
             } else {
                 directories.top().second->appendTask(item);
             }
@@ -486,8 +527,21 @@ void OwncloudPropagator::start(const SyncFileItemVector &items)
         }
     }
 
+    for (const auto &bulkUpload : bulkUploads) {
+        PropagateDirectory *dir = bulkUpload.first;
+        const SyncFileItemVector &dirItems = bulkUpload.second;
+        if (dirItems.size() < 2) {
+            for (const auto &item : dirItems)
+                dir->appendTask(item);
+            continue;
+        }
+        for (int i = 0; i < dirItems.size(); i += PropagateUploadBulk::maxFilesPerRequest) {
+            dir->appendJob(new PropagateUploadBulk(this, dirItems.mid(i, PropagateUploadBulk::maxFilesPerRequest)));
+        }
+    }
+
     foreach (PropagatorJob *it, directoriesToRemove) {
-        _rootJob->appendJob(it);
+        _rootJob->_dirDeletionJobs.appendJob(it);
     }
 
     connect(_rootJob.data(), &PropagatorJob::finished, this, &OwncloudPropagator::emitFinished);
@@ -986,6 +1040,62 @@ void PropagateDirectory::slotSubJobsFinished(SyncFileItem::Status status)
 
 // ================================================================================
 
+PropagateRootDirectory::PropagateRootDirectory(OwncloudPropagator *propagator)
+    : PropagateDirectory(propagator)
+    , _dirDeletionJobs(propagator)
+{
+    connect(&_dirDeletionJobs, &PropagatorJob::finished, this, &PropagateRootDirectory::slotDirDeletionJobsFinished);
+}
+
+bool PropagateRootDirectory::scheduleSelfOrChild()
+{
+    if (PropagateDirectory::scheduleSelfOrChild())
+        return true;
+
+    // The removals wait until all the other jobs are finished
+    if (_state == Finished || _subJobs._state != Finished)
+        return false;
+
+    return _dirDeletionJobs.scheduleSelfOrChild();
+}
+
+void PropagateRootDirectory::abort(PropagatorJob::AbortType abortType)
+{
+    if (_subJobs._state != Finished) {
+        PropagateDirectory::abort(abortType);
+        return;
+    }
+
+    if (abortType == AbortType::Asynchronous) {
+        connect(&_dirDeletionJobs, &PropagatorCompositeJob::abortFinished, this, &PropagateRootDirectory::abortFinished);
+    }
+    _dirDeletionJobs.abort(abortType);
+}
+
+void PropagateRootDirectory::slotSubJobsFinished(SyncFileItem::Status status)
+{
+    // Only a fatal error, which aborts the sync anyway, skips the removals
+    _subJobsStatus = status;
+    if (status == SyncFileItem::FatalError) {
+        _state = Finished;
+        emit finished(status);
+        return;
+    }
+
+    propagator()->scheduleNextJob();
+}
+
+void PropagateRootDirectory::slotDirDeletionJobsFinished(SyncFileItem::Status status)
+{
+    // An error of the other jobs must not get lost
+    if (status == SyncFileItem::Success)
+        status = _subJobsStatus;
+    _state = Finished;
+    emit finished(status);
+}
+
+// ================================================================================
+
 CleanupPollsJob::~CleanupPollsJob()
 {
 }
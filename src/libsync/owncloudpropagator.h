@@ -28,7 +28,9 @@
 #include "csync_util.h"
 #include "syncfileitem.h"
 #include "common/syncjournaldb.h"
+#include "common/synctrace.h"
 #include "bandwidthmanager.h"
+#include "localioexecutor.h"
 #include "accountfwd.h"
 #include "syncoptions.h"
 
@@ -172,11 +174,22 @@ protected:
         _item->_errorString = msg;
     }
 
+    /**
+     * Runs work in the propagator's LocalIoExecutor, then done in the main thread.
+     *
+     * The file system work can't be interrupted: while it runs, an
+     * asynchronous abort only finishes after done was called.
+     */
+    void runLocalIo(const std::function<void()> &work, const std::function<void()> &done);
+
 protected slots:
     void slotRestoreJobFinished(SyncFileItem::Status status);
 
 private:
     QScopedPointer<PropagateItemJob> _restoreJob;
+    bool _localIoRunning = false;
+    bool _abortAfterLocalIo = false;
+    qint64 _traceStart = -1;
 
 public:
     PropagateItemJob(OwncloudPropagator *propagator, const SyncFileItemPtr &item)
@@ -195,6 +208,7 @@ public:
         qCInfo(lcPropagator) << "Starting" << instruction_str << "propagation of" << _item->_file << "by" << this;
 
         _state = Running;
+        _traceStart = SyncTrace::now();
         QMetaObject::invokeMethod(this, "start"); // We could be in a different thread (neon jobs)
         return true;
     }
@@ -203,6 +217,7 @@ public:
 
 public slots:
     virtual void start() = 0;
+    void abort(PropagatorJob::AbortType abortType) Q_DECL_OVERRIDE;
 };
 
 /**
@@ -333,8 +348,41 @@ public:
 private slots:
 
     void slotFirstJobFinished(SyncFileItem::Status status);
-    void slotSubJobsFinished(SyncFileItem::Status status);
+    virtual void slotSubJobsFinished(SyncFileItem::Status status);
+
+};
+
+/**
+ * @brief Propagate the root directory, the removals of directories last
+ * @ingroup libsync
+ *
+ * Files may be moved out of a directory that is removed in the same sync.
+ * The moves run in the LocalIoExecutor and their job only finishes once
+ * the file is in place, so the directory removals in _dirDeletionJobs only
+ * start after all the other jobs finished.
+ */
+class OWNCLOUDSYNC_EXPORT PropagateRootDirectory : public PropagateDirectory
+{
+    Q_OBJECT
+public:
+    PropagatorCompositeJob _dirDeletionJobs;
+
+    explicit PropagateRootDirectory(OwncloudPropagator *propagator);
+
+    bool scheduleSelfOrChild() Q_DECL_OVERRIDE;
+    void abort(PropagatorJob::AbortType abortType) Q_DECL_OVERRIDE;
+
+    qint64 committedDiskSpace() const Q_DECL_OVERRIDE
+    {
+        return _subJobs.committedDiskSpace() + _dirDeletionJobs.committedDiskSpace();
+    }
 
+private slots:
+    void slotSubJobsFinished(SyncFileItem::Status status) Q_DECL_OVERRIDE;
+    void slotDirDeletionJobsFinished(SyncFileItem::Status status);
+
+private:
+    SyncFileItem::Status _subJobsStatus = SyncFileItem::NoStatus;
 };
 
 
@@ -375,6 +423,7 @@ public:
         , _journal(progressDb)
         , _finishedEmited(false)
         , _bandwidthManager(this)
+        , _localIo(this)
         , _anotherSyncNeeded(false)
         , _chunkSize(10 * 1000 * 1000) // 10 MB, overridden in setSyncOptions
         , _account(account)
@@ -393,6 +442,9 @@ public:
     QAtomicInt _uploadLimit;
     BandwidthManager _bandwidthManager;
 
+    /** Local file system work of the jobs runs here, see LocalIoExecutor */
+    LocalIoExecutor _localIo;
+
     QAtomicInt _abortRequested; // boolean set by the main thread to abort.
 
     /** The list of currently active jobs.
@@ -401,7 +453,7 @@ public:
         Jobs add themself to the list when they do an assynchronous operation.
         Jobs can be several time on the list (example, when several chunks are uploaded in parallel)
      */
-    QList<PropagateItemJob *> _activeJobList;
+    QList<PropagatorJob *> _activeJobList;
 
     /** We detected that another sync is required after this one */
     bool _anotherSyncNeeded;
@@ -434,6 +486,10 @@ public:
     /* The maximum number of active jobs in parallel  */
     int hardMaximumActiveJob();
 
+    /* The maximum number of active jobs in parallel for a sync with the account,
+     * when the sync options don't disable parallel jobs */
+    static int hardMaximumActiveJob(const AccountPtr &account);
+
     /** Check whether a download would clash with an existing file
      * in filesystems that are only case-preserving.
      */
@@ -518,8 +574,10 @@ private slots:
     /** Emit the finished signal and make sure it is only emitted once */
     void emitFinished(SyncFileItem::Status status)
     {
-        if (!_finishedEmited)
+        if (!_finishedEmited) {
+            qCInfo(lcPropagator) << "Maximum local I/O queue depth:" << _localIo.maxQueueDepth();
             emit finished(status == SyncFileItem::Success);
+        }
         _finishedEmited = true;
     }
 
@@ -546,7 +604,7 @@ signals:
 
 private:
     AccountPtr _account;
-    QScopedPointer<PropagateDirectory> _rootJob;
+    QScopedPointer<PropagateRootDirectory> _rootJob;
     SyncOptions _syncOptions;
 };
 
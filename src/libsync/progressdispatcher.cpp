@@ -169,7 +169,7 @@ bool ProgressInfo::isUpdatingEstimates() const
     return _updateEstimatesTimer.isActive();
 }
 
-static bool shouldCountProgress(const SyncFileItem &item)
+bool ProgressInfo::shouldCountProgress(const SyncFileItem &item)
 {
     const auto instruction = item._instruction;
 
@@ -100,6 +100,9 @@ public:
     /** Number of a file that is currently in progress. */
     quint64 currentFile() const;
 
+    /** Return true if the item counts towards the file totals and the completed items */
+    static bool shouldCountProgress(const SyncFileItem &item);
+
     /** Return true if the size needs to be taken in account in the total amount of time */
     static inline bool isSizeDependent(const SyncFileItem &item)
     {
@@ -29,6 +29,7 @@
 #include <QNetworkAccessManager>
 #include <QFileInfo>
 #include <QDir>
+#include <QSharedPointer>
 #include <cmath>
 
 #ifdef Q_OS_UNIX
@@ -495,6 +496,88 @@ void PropagateDownloadFile::startDownload()
         propagator()->_journal->commit("download file start");
     }
 
+    if (_resumeStart == 0 && startLocalCopy())
+        return;
+
+    startGetJob(expectedEtagForResume);
+}
+
+bool PropagateDownloadFile::startLocalCopy()
+{
+    // Only a collision safe checksum identifies the content
+    if (_item->_checksumHeader.isEmpty() || !csync_is_collision_safe_hash(_item->_checksumHeader))
+        return false;
+
+    struct Candidate
+    {
+        QString path;
+        qint64 size;
+        time_t modtime;
+    };
+    QVector<Candidate> candidates;
+    const QByteArray fileName = _item->_file.toUtf8();
+    propagator()->_journal->getFileRecordsByChecksum(_item->_checksumHeader, [&](const SyncJournalFileRecord &record) {
+        if (candidates.size() < 3 && record._type == ItemTypeFile && record._path != fileName
+            && record._fileSize == qint64(_item->_size)) {
+            candidates.append({ propagator()->getFilePath(QString::fromUtf8(record._path)), record._fileSize, time_t(record._modtime) });
+        }
+    });
+    if (candidates.isEmpty())
+        return false;
+
+    qCInfo(lcPropagateDownload) << _item->_file << "may be copied from" << candidates.first().path;
+    _tmpFile.close();
+
+    // The file system work runs in a worker thread, it must not touch this job
+    const QString tmpFileName = _tmpFile.fileName();
+    const QByteArray checksumHeader = _item->_checksumHeader;
+    auto source = QSharedPointer<QString>::create();
+    auto work = [candidates, tmpFileName, checksumHeader, source]() {
+        const QByteArray checksumType = parseChecksumHeaderType(checksumHeader);
+        for (const auto &candidate : candidates) {
+            if (!FileSystem::verifyFileUnchanged(candidate.path, candidate.size, candidate.modtime))
+                continue;
+            QString error;
+            if (!FileSystem::cloneFile(candidate.path, tmpFileName, &error)) {
+                qCWarning(lcPropagateDownload) << "Could not copy" << candidate.path << error;
+                continue;
+            }
+            // The source could have changed meanwhile, check what was copied
+            if (makeChecksumHeader(checksumType, ComputeChecksum::computeNow(tmpFileName, checksumType)) == checksumHeader) {
+                *source = candidate.path;
+                return;
+            }
+        }
+        // Leave an empty temporary file for the download
+        QFile::resize(tmpFileName, 0);
+    };
+    runLocalIo(work, [this, source]() {
+        localCopyFinished(*source);
+    });
+    return true;
+}
+
+void PropagateDownloadFile::localCopyFinished(const QString &source)
+{
+    if (!source.isEmpty()) {
+        qCInfo(lcPropagateDownload) << "Copied" << source << "instead of downloading" << _item->_file;
+        propagator()->reportProgress(*_item, _item->_size);
+        downloadFinished();
+        return;
+    }
+
+    if (propagator()->_abortRequested.fetchAndAddRelaxed(0))
+        return;
+
+    if (!_tmpFile.open(QIODevice::Append | QIODevice::Unbuffered)) {
+        done(SyncFileItem::NormalError, _tmpFile.errorString());
+        return;
+    }
+    startGetJob(QByteArray());
+}
+
+void PropagateDownloadFile::startGetJob(const QByteArray &expectedEtagForResume)
+{
     QMap<QByteArray, QByteArray> headers;
 
     if (_item->_directDownloadUrl.isEmpty()) {
@@ -841,41 +924,72 @@ void PropagateDownloadFile::downloadFinished()
         }
     }
 
-    FileSystem::setModTime(_tmpFile.fileName(), _item->_modtime);
-    // We need to fetch the time again because some file systems such as FAT have worse than a second
-    // Accuracy, and we really need the time from the file system. (#3103)
-    _item->_modtime = FileSystem::getModTime(_tmpFile.fileName());
-
-    if (FileSystem::fileExists(fn)) {
-        // Preserve the existing file permissions.
-        QFileInfo existingFile(fn);
-        if (existingFile.permissions() != _tmpFile.permissions()) {
-            _tmpFile.setPermissions(existingFile.permissions());
+    // The file system work runs in a worker thread, it must not touch this job
+    const QString tmpFileName = _tmpFile.fileName();
+    const time_t modtime = _item->_modtime;
+    const qint64 expectedSize = _item->_previousSize;
+    const time_t expectedMtime = _item->_previousModtime;
+    const bool readOnly = !_item->_remotePerm.isNull() && !_item->_remotePerm.hasPermission(RemotePermissions::CanWrite);
+    auto result = QSharedPointer<FinalizeResult>::create();
+    auto work = [fn, tmpFileName, modtime, expectedSize, expectedMtime, readOnly, result]() {
+        FileSystem::setModTime(tmpFileName, modtime);
+        // We need to fetch the time again because some file systems such as FAT have worse than a second
+        // Accuracy, and we really need the time from the file system. (#3103)
+        result->modtime = FileSystem::getModTime(tmpFileName);
+
+        if (FileSystem::fileExists(fn)) {
+            // Preserve the existing file permissions.
+            QFileInfo existingFile(fn);
+            if (existingFile.permissions() != QFile::permissions(tmpFileName)) {
+                QFile::setPermissions(tmpFileName, existingFile.permissions());
+            }
+            preserveGroupOwnership(tmpFileName, existingFile);
+
+            // Check whether the existing file has changed since the discovery
+            // phase by comparing size and mtime to the previous values. This
+            // is necessary to avoid overwriting user changes that happened between
+            // the discovery phase and now.
+            if (!FileSystem::verifyFileUnchanged(fn, expectedSize, expectedMtime)) {
+                result->changedSinceDiscovery = true;
+                return;
+            }
         }
-        preserveGroupOwnership(_tmpFile.fileName(), existingFile);
 
-        // Check whether the existing file has changed since the discovery
-        // phase by comparing size and mtime to the previous values. This
-        // is necessary to avoid overwriting user changes that happened between
-        // the discovery phase and now.
-        const qint64 expectedSize = _item->_previousSize;
-        const time_t expectedMtime = _item->_previousModtime;
-        if (!FileSystem::verifyFileUnchanged(fn, expectedSize, expectedMtime)) {
-            propagator()->_anotherSyncNeeded = true;
-            done(SyncFileItem::SoftError, tr("File has changed since discovery"));
+        // Apply the remote permissions
+        FileSystem::setFileReadOnlyWeak(tmpFileName, readOnly);
+
+        // The fileChanged() check is done above to generate better error messages.
+        if (!FileSystem::uncheckedRenameReplace(tmpFileName, fn, &result->error)) {
+            qCWarning(lcPropagateDownload) << QString("Rename failed: %1 => %2").arg(tmpFileName).arg(fn);
+            result->fileLocked = FileSystem::isFileLocked(fn);
             return;
         }
-    }
+        result->renamed = true;
+        FileSystem::setFileHidden(fn, false);
 
-    // Apply the remote permissions
-    FileSystem::setFileReadOnlyWeak(_tmpFile.fileName(), !_item->_remotePerm.isNull() && !_item->_remotePerm.hasPermission(RemotePermissions::CanWrite));
+        // Maybe we downloaded a newer version of the file than we thought we would...
+        // Get up to date information for the journal.
+        result->size = FileSystem::getSize(fn);
+    };
 
-    QString error;
     emit propagator()->touchedFile(fn);
-    // The fileChanged() check is done above to generate better error messages.
-    if (!FileSystem::uncheckedRenameReplace(_tmpFile.fileName(), fn, &error)) {
-        qCWarning(lcPropagateDownload) << QString("Rename failed: %1 => %2").arg(_tmpFile.fileName()).arg(fn);
+    runLocalIo(work, [this, isConflict, result]() {
+        tmpFileMoved(isConflict, *result);
+    });
+}
+
+void PropagateDownloadFile::tmpFileMoved(bool isConflict, const FinalizeResult &result)
+{
+    QString fn = propagator()->getFilePath(_item->_file);
+    _item->_modtime = result.modtime;
+
+    if (result.changedSinceDiscovery) {
+        propagator()->_anotherSyncNeeded = true;
+        done(SyncFileItem::SoftError, tr("File has changed since discovery"));
+        return;
+    }
 
+    if (!result.renamed) {
         // If we moved away the original file due to a conflict but can't
         // put the downloaded file in its place, we are in a bad spot:
         // If we do nothing the next sync run will assume the user deleted
@@ -890,20 +1004,17 @@ void PropagateDownloadFile::downloadFinished()
 
         // If the file is locked, we want to retry this sync when it
         // becomes available again, otherwise try again directly
-        if (FileSystem::isFileLocked(fn)) {
+        if (result.fileLocked) {
             emit propagator()->seenLockedFile(fn);
         } else {
             propagator()->_anotherSyncNeeded = true;
         }
 
-        done(SyncFileItem::SoftError, error);
+        done(SyncFileItem::SoftError, result.error);
         return;
     }
-    FileSystem::setFileHidden(fn, false);
 
-    // Maybe we downloaded a newer version of the file than we thought we would...
-    // Get up to date information for the journal.
-    _item->_size = FileSystem::getSize(fn);
+    _item->_size = result.size;
 
     // Maybe what we downloaded was a conflict file? If so, set a conflict record.
     // (the data was prepared in slotGetFinished above)
@@ -963,8 +1074,7 @@ void PropagateDownloadFile::abort(PropagatorJob::AbortType abortType)
     if (_job && _job->reply())
         _job->reply()->abort();
 
-    if (abortType == AbortType::Asynchronous) {
-        emit abortFinished();
-    }
+    // Waits for moving the file in place, if that is running
+    PropagateItemJob::abort(abortType);
 }
 }
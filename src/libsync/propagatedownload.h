@@ -126,7 +126,14 @@ private slots:
     |                         checksum differs?    |
     +-> startDownload() <--------------------------+
           |                                        |
-          +-> run a GETFileJob                     | checksum identical?
+          +-> startLocalCopy() if a synced file    |
+          |   has the same checksum                |
+          |                                        |
+          |   done?-> localCopyFinished()          |
+          |             | copied? -> downloadFinished()
+          |             |                          |
+          +-------------+-> startGetJob()          | checksum identical?
+                             runs a GETFileJob     |
                                                    |
       done?-> slotGetFinished()                    |
                 |                                  |
@@ -180,6 +187,8 @@ private slots:
     void conflictChecksumComputed(const QByteArray &checksumType, const QByteArray &checksum);
     /// Called to start downloading the remote file
     void startDownload();
+    /// Called when the copy of a local file with the same content is done
+    void localCopyFinished(const QString &source);
     /// Called when the GETFileJob finishes
     void slotGetFinished();
     /// Called when the download's checksum header was validated
@@ -197,6 +206,28 @@ private slots:
 private:
     void deleteExistingFolder();
 
+    /**
+     * Copies a synced local file with the remote checksum into the
+     * temporary file instead of downloading it. The copy is verified
+     * against the checksum, the file is downloaded if that fails.
+     *
+     * Returns false if there is no such file.
+     */
+    bool startLocalCopy();
+    void startGetJob(const QByteArray &expectedEtagForResume);
+
+    /// Outcome of moving the temporary file in place, see downloadFinished()
+    struct FinalizeResult
+    {
+        time_t modtime = 0;
+        bool changedSinceDiscovery = false;
+        bool renamed = false;
+        bool fileLocked = false;
+        QString error;
+        qint64 size = 0;
+    };
+    void tmpFileMoved(bool isConflict, const FinalizeResult &result);
+
     quint64 _resumeStart;
     qint64 _downloadProgress;
     QPointer<GETFileJob> _job;
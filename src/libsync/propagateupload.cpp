@@ -50,7 +50,7 @@ Q_LOGGING_CATEGORY(lcPropagateUpload, "sync.propagator.upload", QtInfoMsg)
  * manager. If that delay between file-change notification and sync
  * has passed, we should accept the file for upload here.
  */
-static bool fileIsStillChanging(const SyncFileItem &item)
+bool fileIsStillChanging(const SyncFileItem &item)
 {
     const QDateTime modtime = Utility::qDateTimeFromTime_t(item._modtime);
     const qint64 msSinceMod = modtime.msecsTo(QDateTime::currentDateTimeUtc());
@@ -306,6 +306,145 @@ void PropagateUploadFileCommon::slotStartUpload(const QByteArray &transmissionCh
         return;
     }
 
+    if (startServerSideCopy())
+        return;
+
+    doStartUpload();
+}
+
+bool PropagateUploadFileCommon::startServerSideCopy()
+{
+    const qint64 minSize = propagator()->syncOptions()._serverSideCopyMinSize;
+    if (minSize < 0 || qint64(_item->_size) < minSize
+        || _item->_instruction != CSYNC_INSTRUCTION_NEW || _deleteExisting
+        || _item->_checksumHeader.isEmpty()) {
+        return false;
+    }
+
+    const QByteArray fileName = _item->_file.toUtf8();
+    _copySource = SyncJournalFileRecord();
+    propagator()->_journal->getFileRecordsByChecksum(_item->_checksumHeader, [&](const SyncJournalFileRecord &record) {
+        if (!_copySource.isValid() && record._type == ItemTypeFile && record._path != fileName
+            && record._fileSize == qint64(_item->_size) && !record._etag.isEmpty()) {
+            _copySource = record;
+        }
+    });
+    if (!_copySource.isValid())
+        return false;
+
+    qCInfo(lcPropagateUpload) << "Copying" << _copySource._path << "on the server instead of uploading" << _item->_file;
+
+    QMap<QByteArray, QByteArray> headers;
+    // The journal only knows the checksum of this version of the source
+    headers["If-Match"] = '"' + _copySource._etag + '"';
+    headers["Overwrite"] = "F";
+    QString destination = QDir::cleanPath(propagator()->account()->url().path() + QLatin1Char('/')
+        + propagator()->account()->davPath() + propagator()->_remoteFolder + _item->_file);
+    auto job = new CopyJob(propagator()->account(),
+        propagator()->_remoteFolder + QString::fromUtf8(_copySource._path),
+        destination, headers, this);
+    _jobs.append(job);
+    connect(job, &CopyJob::finishedSignal, this, &PropagateUploadFileCommon::slotCopyFinished);
+    connect(job, &QObject::destroyed, this, &PropagateUploadFileCommon::slotJobDestroyed);
+    propagator()->_activeJobList.append(this);
+    job->start();
+    return true;
+}
+
+void PropagateUploadFileCommon::slotCopyFinished()
+{
+    auto job = qobject_cast<CopyJob *>(sender());
+    ASSERT(job);
+    slotJobDestroyed(job); // remove it from the _jobs list
+    if (propagator()->_abortRequested.fetchAndAddRelaxed(0))
+        return;
+
+    const int httpCode = job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (job->reply()->error() != QNetworkReply::NoError || httpCode != 201) {
+        qCInfo(lcPropagateUpload) << "Server side copy of" << _item->_file << "failed:" << httpCode << job->errorString();
+        slotCopyFailed();
+        return;
+    }
+
+    if (_copySource._modtime == qint64(_item->_modtime)) {
+        verifyServerSideCopy();
+        return;
+    }
+
+    // The copy has the modification time of the source
+    auto proppatch = new ProppatchJob(propagator()->account(), propagator()->_remoteFolder + _item->_file, this);
+    QMap<QByteArray, QByteArray> properties;
+    properties["DAV::lastmodified"] = QByteArray::number(qint64(_item->_modtime));
+    proppatch->setProperties(properties);
+    _jobs.append(proppatch);
+    connect(proppatch, &ProppatchJob::success, this, &PropagateUploadFileCommon::verifyServerSideCopy);
+    connect(proppatch, &ProppatchJob::finishedWithError, this, &PropagateUploadFileCommon::slotCopyFailed);
+    connect(proppatch, &QObject::destroyed, this, &PropagateUploadFileCommon::slotJobDestroyed);
+    proppatch->start();
+}
+
+void PropagateUploadFileCommon::verifyServerSideCopy()
+{
+    slotJobDestroyed(sender()); // the finished COPY or PROPPATCH
+    if (propagator()->_abortRequested.fetchAndAddRelaxed(0))
+        return;
+
+    _copyEntry.clear();
+    auto job = new LsColJob(propagator()->account(), propagator()->_remoteFolder + _item->_file, this);
+    job->setProperties(QList<QByteArray>() << "getetag"
+                                           << "getcontentlength"
+                                           << "http://owncloud.org/ns:id"
+                                           << "http://owncloud.org/ns:permissions"
+                                           << "http://owncloud.org/ns:checksums");
+    _jobs.append(job);
+    connect(job, &LsColJob::directoryListingEntry, this, &PropagateUploadFileCommon::slotCopyEntry);
+    connect(job, &LsColJob::finishedWithoutError, this, &PropagateUploadFileCommon::slotCopyVerified);
+    connect(job, &LsColJob::finishedWithError, this, &PropagateUploadFileCommon::slotCopyFailed);
+    connect(job, &QObject::destroyed, this, &PropagateUploadFileCommon::slotJobDestroyed);
+    job->start();
+}
+
+void PropagateUploadFileCommon::slotCopyEntry(const LsColEntry &entry)
+{
+    // Depth 1 on a file only lists the file
+    if (_copyEntry.href.isEmpty())
+        _copyEntry = entry;
+}
+
+void PropagateUploadFileCommon::slotCopyVerified()
+{
+    slotJobDestroyed(sender());
+    if (propagator()->_abortRequested.fetchAndAddRelaxed(0))
+        return;
+
+    bool checksumOk = _copyEntry.checksums.isEmpty();
+    for (const auto &checksum : _copyEntry.checksums.split(' ')) {
+        if (checksum.toUpper() == _item->_checksumHeader.toUpper())
+            checksumOk = true;
+    }
+    if (_copyEntry.etag.isEmpty() || _copyEntry.contentLength != qint64(_item->_size) || !checksumOk) {
+        qCWarning(lcPropagateUpload) << "Server side copy of" << _item->_file << "does not match:"
+                                     << _copyEntry.contentLength << _copyEntry.checksums;
+        slotCopyFailed();
+        return;
+    }
+
+    _item->_etag = Utility::normalizeEtag(_copyEntry.etag);
+    _item->_fileId = _copyEntry.fileId;
+    if (!_copyEntry.remotePerm.isNull())
+        _item->_remotePerm = _copyEntry.remotePerm;
+    propagator()->_activeJobList.removeOne(this);
+    finalize();
+}
+
+void PropagateUploadFileCommon::slotCopyFailed()
+{
+    slotJobDestroyed(sender());
+    if (propagator()->_abortRequested.fetchAndAddRelaxed(0))
+        return;
+
+    // An incomplete copy is overwritten by the upload
+    propagator()->_activeJobList.removeOne(this);
     doStartUpload();
 }
 
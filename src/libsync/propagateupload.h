@@ -19,6 +19,7 @@
 #include <QBuffer>
 #include <QFile>
 #include <QElapsedTimer>
+#include <QFutureWatcher>
 
 
 namespace OCC {
@@ -28,6 +29,9 @@ Q_DECLARE_LOGGING_CATEGORY(lcPropagateUpload)
 
 class BandwidthManager;
 
+/** Whether the modification time of the item is too recent to upload it */
+bool fileIsStillChanging(const SyncFileItem &item);
+
 /**
  * @brief The UploadDevice class
  * @ingroup libsync
@@ -149,6 +153,50 @@ signals:
 
 };
 
+/**
+ * @brief Uploads several files with one multipart/related POST
+ * @ingroup libsync
+ *
+ * The request goes to the bulk upload endpoint of the server. Each part
+ * has the target path, relative to the user's root, in its X-File-Path
+ * header. The server replies with a JSON object that has the result of
+ * each part, keyed by that path.
+ */
+class BulkUploadJob : public AbstractNetworkJob
+{
+    Q_OBJECT
+public:
+    struct Part
+    {
+        QString path;
+        QMap<QByteArray, QByteArray> headers;
+        QByteArray data;
+    };
+
+    struct PartResult
+    {
+        bool error = true;
+        QString message;
+        QByteArray etag;
+        QByteArray fileId;
+    };
+
+    explicit BulkUploadJob(AccountPtr account, const QVector<Part> &parts, QObject *parent = 0);
+
+    void start() Q_DECL_OVERRIDE;
+    bool finished() Q_DECL_OVERRIDE;
+
+    /** The results by X-File-Path, parts without one failed */
+    const QHash<QString, PartResult> &results() const { return _results; }
+
+signals:
+    void finishedSignal();
+
+private:
+    QVector<Part> _parts;
+    QHash<QString, PartResult> _results;
+};
+
 /**
  * @brief This job implements the asynchronous PUT
  *
@@ -196,7 +244,13 @@ signals:
  *         |
  *         v
  *    slotStartUpload()  -> doStartUpload()
- *                                  .
+ *         |                        .
+ *         v                        .
+ *    startServerSideCopy() ---+    .
+ *       (COPY, PROPPATCH,     |    .
+ *        PROPFIND)      on failure .
+ *         |                   +--> doStartUpload()
+ *         |                        .
  *                                  .
  *                                  v
  *        finalize() or abortWithError()  or startPollJob()
@@ -211,6 +265,10 @@ protected:
     bool _deleteExisting BITFIELD(1);
     QByteArray _transmissionChecksumHeader;
 
+    // A synced file with the same content, see startServerSideCopy()
+    SyncJournalFileRecord _copySource;
+    LsColEntry _copyEntry;
+
 public:
     PropagateUploadFileCommon(OwncloudPropagator *propagator, const SyncFileItemPtr &item)
         : PropagateItemJob(propagator, item)
@@ -238,6 +296,24 @@ private slots:
     // transmission checksum computed, prepare the upload
     void slotStartUpload(const QByteArray &transmissionChecksumType, const QByteArray &transmissionChecksum);
 
+    void slotCopyFinished();
+    void slotCopyEntry(const LsColEntry &entry);
+    void slotCopyVerified();
+    // The copy can't be used, upload the file after all
+    void slotCopyFailed();
+
+private:
+    /**
+     * Copies a synced file with the same content checksum on the server
+     * instead of uploading the data, for new files of at least
+     * SyncOptions::_serverSideCopyMinSize bytes.
+     *
+     * Returns false if there is no such file. Otherwise the copy is verified
+     * and the upload started if anything goes wrong.
+     */
+    bool startServerSideCopy();
+    void verifyServerSideCopy();
+
 public:
     virtual void doStartUpload() = 0;
 
@@ -390,4 +466,60 @@ private slots:
     void slotMoveJobFinished();
     void slotUploadProgress(qint64, qint64);
 };
+
+/**
+ * @ingroup libsync
+ *
+ * Propagation job uploading several small new files of one directory
+ * with a single BulkUploadJob.
+ *
+ * Files that can't be sent this way, or for which the server reports an
+ * error, are handed back to the directory job as regular tasks: they are
+ * then uploaded, and their errors handled, one by one.
+ */
+class PropagateUploadBulk : public PropagatorJob
+{
+    Q_OBJECT
+public:
+    /** Upper limit for the number of files in one request */
+    static const int maxFilesPerRequest = 100;
+
+    PropagateUploadBulk(OwncloudPropagator *propagator, const SyncFileItemVector &items);
+    ~PropagateUploadBulk();
+
+    /** Whether item can be uploaded by this job */
+    static bool canUpload(OwncloudPropagator *propagator, const SyncFileItem &item);
+
+    bool scheduleSelfOrChild() Q_DECL_OVERRIDE;
+    qint64 committedDiskSpace() const Q_DECL_OVERRIDE { return 0; }
+
+public slots:
+    void abort(PropagatorJob::AbortType abortType) Q_DECL_OVERRIDE;
+
+private slots:
+    void start();
+    void slotFilesRead();
+    void slotBulkUploadFinished();
+
+private:
+    struct File
+    {
+        SyncFileItemPtr item;
+        QString path; // absolute local path
+        QByteArray data;
+        time_t modtime = 0;
+        QByteArray contentChecksum;
+        QByteArray transmissionChecksumHeader;
+        bool ok = false;
+    };
+    static void readFile(File &file, const QByteArray &contentChecksumType, const QByteArray &transmissionChecksumType);
+
+    void uploadIndividually(const SyncFileItemPtr &item);
+    void finish(SyncFileItem::Status status);
+
+    SyncFileItemVector _items;
+    QVector<File> _files;
+    QFutureWatcher<void> _readWatcher;
+    QPointer<BulkUploadJob> _job;
+};
 }
@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) by ownCloud GmbH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "config.h"
+#include "propagateupload.h"
+#include "owncloudpropagator_p.h"
+#include "account.h"
+#include "common/syncjournaldb.h"
+#include "common/syncjournalfilerecord.h"
+#include "common/utility.h"
+#include "common/checksums.h"
+#include "common/asserts.h"
+#include "filesystem.h"
+#include "propagatorjobs.h"
+
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QUuid>
+#include <qtconcurrentrun.h>
+
+#include <limits>
+
+namespace OCC {
+
+Q_LOGGING_CATEGORY(lcBulkUploadJob, "sync.networkjob.bulkupload", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcPropagateUploadBulk, "sync.propagator.upload.bulk", QtInfoMsg)
+
+BulkUploadJob::BulkUploadJob(AccountPtr account, const QVector<Part> &parts, QObject *parent)
+    : AbstractNetworkJob(account, QString(), parent)
+    , _parts(parts)
+{
+}
+
+void BulkUploadJob::start()
+{
+    const QByteArray boundary = "boundary_" + QUuid::createUuid().toByteArray().mid(1, 36);
+
+    QByteArray body;
+    for (const auto &part : _parts) {
+        body += "--" + boundary + "\r\n";
+        for (auto it = part.headers.constBegin(); it != part.headers.constEnd(); ++it)
+            body += it.key() + ": " + it.value() + "\r\n";
+        body += "X-File-Path: " + part.path.toUtf8() + "\r\n";
+        body += "Content-Length: " + QByteArray::number(part.data.size()) + "\r\n\r\n";
+        body += part.data;
+        body += "\r\n";
+    }
+    body += "--" + boundary + "--\r\n";
+    // The data is in the body now
+    _parts.clear();
+
+    auto device = new QBuffer(this);
+    device->setData(body);
+    device->open(QIODevice::ReadOnly);
+
+    QNetworkRequest req;
+    req.setHeader(QNetworkRequest::ContentTypeHeader, QByteArray("multipart/related; boundary=" + boundary));
+    req.setPriority(QNetworkRequest::LowPriority); // Long uploads must not block non-propagation jobs.
+
+    sendRequest("POST", Utility::concatUrlPath(account()->url(), QLatin1String("remote.php/dav/bulk")), req, device);
+    connect(this, &AbstractNetworkJob::networkActivity, account().data(), &Account::propagatorNetworkActivity);
+    AbstractNetworkJob::start();
+}
+
+bool BulkUploadJob::finished()
+{
+    qCInfo(lcBulkUploadJob) << "POST of" << reply()->request().url().toString() << "FINISHED WITH STATUS"
+                            << replyStatusString()
+                            << reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute)
+                            << reply()->attribute(QNetworkRequest::HttpReasonPhraseAttribute);
+
+    if (reply()->error() == QNetworkReply::NoError) {
+        QJsonParseError error;
+        const auto json = QJsonDocument::fromJson(reply()->readAll(), &error);
+        if (error.error != QJsonParseError::NoError)
+            qCWarning(lcBulkUploadJob) << "Could not parse the reply:" << error.errorString();
+
+        const auto object = json.object();
+        for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+            const auto value = it.value().toObject();
+            PartResult result;
+            result.error = value.value(QLatin1String("error")).toBool(true);
+            result.message = value.value(QLatin1String("message")).toString();
+            result.etag = parseEtag(value.value(QLatin1String("etag")).toString().toUtf8().constData());
+            result.fileId = value.value(QLatin1String("fileid")).toString().toUtf8();
+            // Without an etag the file is not known to be on the server
+            if (result.etag.isEmpty())
+                result.error = true;
+            _results.insert(it.key(), result);
+        }
+    }
+
+    emit finishedSignal();
+    return true;
+}
+
+PropagateUploadBulk::PropagateUploadBulk(OwncloudPropagator *propagator, const SyncFileItemVector &items)
+    : PropagatorJob(propagator)
+    , _items(items)
+{
+}
+
+PropagateUploadBulk::~PropagateUploadBulk()
+{
+    // The files are read into _files
+    _readWatcher.waitForFinished();
+    if (auto p = propagator())
+        p->_activeJobList.removeAll(this);
+}
+
+bool PropagateUploadBulk::canUpload(OwncloudPropagator *propagator, const SyncFileItem &item)
+{
+    return item._instruction == CSYNC_INSTRUCTION_NEW
+        && item._direction == SyncFileItem::Up
+        && item._type == ItemTypeFile
+        && item._size < propagator->smallFileSize()
+        // Needs the OC-Tag header, see PropagateUploadFileCommon::headers()
+        && !item._file.contains(".sys.admin#recall#")
+        // The request body is not bandwidth limited
+        && propagator->_uploadLimit.fetchAndAddAcquire(0) == 0
+        && propagator->account()->capabilities().bulkUpload();
+}
+
+bool PropagateUploadBulk::scheduleSelfOrChild()
+{
+    if (_state != NotYetStarted) {
+        return false;
+    }
+    qCInfo(lcPropagateUploadBulk) << "Starting bulk upload of" << _items.size() << "files by" << this;
+
+    _state = Running;
+    QMetaObject::invokeMethod(this, "start");
+    return true;
+}
+
+void PropagateUploadBulk::start()
+{
+    if (propagator()->_abortRequested.fetchAndAddRelaxed(0)) {
+        return;
+    }
+
+    // Anything that needs special care is left to the regular upload jobs
+    foreach (const SyncFileItemPtr &item, _items) {
+        const quint64 quotaGuess = propagator()->_folderQuota.value(
+            QFileInfo(item->_file).path(), std::numeric_limits<quint64>::max());
+        if (propagator()->hasCaseClashAccessibilityProblem(item->_file)
+            || item->_size > quotaGuess
+            || propagator()->_journal->conflictRecord(item->_file.toUtf8()).isValid()) {
+            uploadIndividually(item);
+            continue;
+        }
+
+        File file;
+        file.item = item;
+        file.path = propagator()->getFilePath(item->_file);
+        _files.append(file);
+    }
+    _items.clear();
+
+    if (_files.size() < 2) {
+        for (const auto &file : _files)
+            uploadIndividually(file.item);
+        finish(SyncFileItem::Success);
+        return;
+    }
+
+    // Reuse the content checksum as the transmission checksum if possible
+    const QByteArray theContentChecksumType = contentChecksumType();
+    QByteArray transmissionChecksumType;
+    if (propagator()->account()->capabilities().supportedChecksumTypes().contains(theContentChecksumType)) {
+        transmissionChecksumType = theContentChecksumType;
+    } else if (uploadChecksumEnabled()) {
+        transmissionChecksumType = propagator()->account()->capabilities().uploadChecksumType();
+    }
+
+    propagator()->_activeJobList.append(this);
+
+    // Read and checksum the files in a thread, _files is not touched until it finished
+    connect(&_readWatcher, &QFutureWatcherBase::finished, this, &PropagateUploadBulk::slotFilesRead);
+    auto files = &_files;
+    _readWatcher.setFuture(QtConcurrent::run([files, theContentChecksumType, transmissionChecksumType]() {
+        for (auto &file : *files)
+            readFile(file, theContentChecksumType, transmissionChecksumType);
+    }));
+}
+
+void PropagateUploadBulk::readFile(File &file, const QByteArray &contentChecksumType, const QByteArray &transmissionChecksumType)
+{
+    file.modtime = FileSystem::getModTime(file.path);
+
+    QFile f(file.path);
+    QString error;
+    if (!FileSystem::openAndSeekFileSharedRead(&f, &error, 0))
+        return;
+    file.data = f.readAll();
+    if (f.error() != QFile::NoError || FileSystem::getModTime(file.path) != file.modtime)
+        return;
+
+    const QByteArray contentChecksum = ComputeChecksum::computeNowOnData(file.data, contentChecksumType);
+    file.contentChecksum = makeChecksumHeader(contentChecksumType, contentChecksum);
+    if (transmissionChecksumType == contentChecksumType) {
+        file.transmissionChecksumHeader = file.contentChecksum;
+    } else {
+        file.transmissionChecksumHeader = makeChecksumHeader(transmissionChecksumType,
+            ComputeChecksum::computeNowOnData(file.data, transmissionChecksumType));
+    }
+    file.ok = true;
+}
+
+void PropagateUploadBulk::slotFilesRead()
+{
+    if (propagator()->_abortRequested.fetchAndAddRelaxed(0)) {
+        propagator()->_activeJobList.removeOne(this);
+        return;
+    }
+
+    QVector<BulkUploadJob::Part> parts;
+    QVector<File> files;
+    for (auto &file : _files) {
+        const SyncFileItemPtr &item = file.item;
+        if (!file.ok || file.modtime != item->_modtime) {
+            // Removed, unreadable or changed since the discovery
+            uploadIndividually(item);
+            continue;
+        }
+        item->_size = file.data.size();
+        if (fileIsStillChanging(*item)) {
+            uploadIndividually(item);
+            continue;
+        }
+        // If no content checksum could be computed, reuse the transmission checksum
+        item->_checksumHeader = file.contentChecksum.isEmpty() ? file.transmissionChecksumHeader : file.contentChecksum;
+
+        BulkUploadJob::Part part;
+        part.path = propagator()->_remoteFolder + item->_file;
+        part.headers["X-File-MD5"] = QCryptographicHash::hash(file.data, QCryptographicHash::Md5).toHex();
+        part.headers["X-File-Mtime"] = QByteArray::number(qint64(item->_modtime));
+        if (!file.transmissionChecksumHeader.isEmpty())
+            part.headers[checkSumHeaderC] = file.transmissionChecksumHeader;
+        part.data = file.data;
+        parts.append(part);
+
+        file.data.clear();
+        files.append(file);
+    }
+    _files = files;
+
+    if (_files.size() < 2) {
+        for (const auto &file : _files)
+            uploadIndividually(file.item);
+        propagator()->_activeJobList.removeOne(this);
+        finish(SyncFileItem::Success);
+        return;
+    }
+
+    qCInfo(lcPropagateUploadBulk) << "Sending" << parts.size() << "files in one request";
+    _job = new BulkUploadJob(propagator()->account(), parts, this);
+    connect(_job.data(), &BulkUploadJob::finishedSignal, this, &PropagateUploadBulk::slotBulkUploadFinished);
+    _job->start();
+}
+
+void PropagateUploadBulk::slotBulkUploadFinished()
+{
+    auto job = qobject_cast<BulkUploadJob *>(sender());
+    ASSERT(job);
+
+    propagator()->_activeJobList.removeOne(this);
+
+    if (propagator()->_abortRequested.fetchAndAddRelaxed(0)) {
+        finish(SyncFileItem::SoftError);
+        return;
+    }
+
+    QNetworkReply::NetworkError err = job->reply()->error();
+    if (err != QNetworkReply::NoError) {
+        qCWarning(lcPropagateUploadBulk) << "Bulk upload failed:" << job->errorString()
+                                         << "- uploading the files one by one";
+        for (const auto &file : _files)
+            uploadIndividually(file.item);
+        finish(SyncFileItem::Success);
+        return;
+    }
+
+    const int httpCode = job->reply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    for (const auto &file : _files) {
+        const SyncFileItemPtr &item = file.item;
+        const auto result = job->results().value(propagator()->_remoteFolder + item->_file);
+        if (result.error) {
+            qCInfo(lcPropagateUploadBulk) << "Bulk upload of" << item->_file << "failed:" << result.message
+                                          << "- uploading it on its own";
+            uploadIndividually(item);
+            continue;
+        }
+
+        item->_httpErrorCode = httpCode;
+        item->_responseTimeStamp = job->responseTimestamp();
+        item->_requestId = job->requestId();
+        item->_etag = result.etag;
+        if (!result.fileId.isEmpty())
+            item->_fileId = result.fileId;
+
+        // The file is on the server now, a change will be picked up by the next sync
+        if (!FileSystem::verifyFileUnchanged(file.path, item->_size, item->_modtime))
+            propagator()->_anotherSyncNeeded = true;
+
+        // Update the quota, if known
+        auto quotaIt = propagator()->_folderQuota.find(QFileInfo(item->_file).path());
+        if (quotaIt != propagator()->_folderQuota.end())
+            quotaIt.value() -= item->_size;
+
+        item->_status = SyncFileItem::Success;
+        if (!propagator()->_journal->setFileRecord(item->toSyncJournalFileRecordWithInode(file.path))) {
+            item->_status = SyncFileItem::FatalError;
+            item->_errorString = tr("Error writing metadata to the database");
+            qCWarning(lcPropagator) << "Could not complete propagation of" << item->destination() << "by" << this
+                                    << "with status" << item->_status << "and error:" << item->_errorString;
+            emit propagator()->itemCompleted(item);
+            propagator()->_journal->commit("bulk upload");
+            finish(SyncFileItem::FatalError);
+            propagator()->abort();
+            return;
+        }
+        if (item->_hasBlacklistEntry)
+            propagator()->_journal->wipeErrorBlacklistEntry(item->_file);
+
+        qCInfo(lcPropagator) << "Completed propagation of" << item->destination() << "by" << this << "with status" << item->_status;
+        emit propagator()->itemCompleted(item);
+    }
+    propagator()->_journal->commit("bulk upload");
+
+    finish(SyncFileItem::Success);
+}
+
+void PropagateUploadBulk::abort(PropagatorJob::AbortType abortType)
+{
+    if (_job && _job->reply() && _job->reply()->isRunning()) {
+        if (abortType == AbortType::Asynchronous) {
+            connect(_job->reply(), &QNetworkReply::finished, this, [this]() { emit abortFinished(); });
+        }
+        _job->reply()->abort();
+        return;
+    }
+    if (abortType == AbortType::Asynchronous)
+        emit abortFinished();
+}
+
+void PropagateUploadBulk::uploadIndividually(const SyncFileItemPtr &item)
+{
+    ASSERT(_associatedComposite);
+    _associatedComposite->appendTask(item);
+}
+
+void PropagateUploadBulk::finish(SyncFileItem::Status status)
+{
+    _state = Finished;
+    emit finished(status);
+}
+}
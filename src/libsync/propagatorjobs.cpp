@@ -29,6 +29,7 @@
 #include <QDateTime>
 #include <qstack.h>
 #include <QCoreApplication>
+#include <QSharedPointer>
 
 #include <time.h>
 
@@ -44,19 +45,31 @@ QByteArray localFileIdFromFullId(const QByteArray &id)
     return id.left(8);
 }
 
+namespace {
+    /// Outcome of work done by LocalIoExecutor
+    struct LocalIoResult
+    {
+        bool ok = true;
+        QString error;
+        /// Entries removed by PropagateLocalRemove before an error, with their type
+        QVector<QPair<QString, bool>> deletedOnError;
+    };
+}
+
 /**
  * Code inspired from Qt5's QDir::removeRecursively
- * The code will update the database in case of error.
+ * This runs in a worker thread and does not touch the database.
  * If everything goes well (no error, returns true), the caller is responsible for removing the entries
- * in the database.  But in case of error, we need to remove the entries from the database of the files
- * that were deleted.
+ * in the database.  But in case of error, the caller also needs to remove the entries of the files
+ * that were deleted: these are added to \a deletedOnError.
  *
- * \a path is relative to propagator()->_localDir + _item->_file and should start with a slash
+ * \a path is relative to \a root and should start with a slash
  */
-bool PropagateLocalRemove::removeRecursively(const QString &path)
+static bool removeRecursively(const QString &root, const QString &path, QString *error,
+    QVector<QPair<QString, bool>> *deletedOnError)
 {
     bool success = true;
-    QString absolute = propagator()->_localDir + _item->_file + path;
+    QString absolute = root + path;
     QDirIterator di(absolute, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
 
     QVector<QPair<QString, bool>> deleted;
@@ -64,42 +77,39 @@ bool PropagateLocalRemove::removeRecursively(const QString &path)
     while (di.hasNext()) {
         di.next();
         const QFileInfo &fi = di.fileInfo();
+        const QString entryPath = path + QLatin1Char('/') + di.fileName();
         bool ok;
         // The use of isSymLink here is okay:
         // we never want to go into this branch for .lnk files
         bool isDir = fi.isDir() && !fi.isSymLink() && !FileSystem::isJunction(fi.absoluteFilePath());
         if (isDir) {
-            ok = removeRecursively(path + QLatin1Char('/') + di.fileName()); // recursive
+            ok = removeRecursively(root, entryPath, error, deletedOnError); // recursive
         } else {
             QString removeError;
             ok = FileSystem::remove(di.filePath(), &removeError);
             if (!ok) {
-                _error += PropagateLocalRemove::tr("Error removing '%1': %2;").arg(QDir::toNativeSeparators(di.filePath()), removeError) + " ";
+                *error += PropagateLocalRemove::tr("Error removing '%1': %2;").arg(QDir::toNativeSeparators(di.filePath()), removeError) + " ";
                 qCWarning(lcPropagateLocalRemove) << "Error removing " << di.filePath() << ':' << removeError;
             }
         }
         if (success && !ok) {
-            // We need to delete the entries from the database now from the deleted vector
-            foreach (const auto &it, deleted) {
-                propagator()->_journal->deleteFileRecord(_item->_originalFile + path + QLatin1Char('/') + it.first,
-                    it.second);
-            }
+            // The entries deleted so far need to be removed from the database now
+            *deletedOnError += deleted;
             success = false;
             deleted.clear();
         }
         if (success) {
-            deleted.append(qMakePair(di.fileName(), isDir));
+            deleted.append(qMakePair(entryPath, isDir));
         }
         if (!success && ok) {
-            // This succeeded, so we need to delete it from the database now because the caller won't
-            propagator()->_journal->deleteFileRecord(_item->_originalFile + path + QLatin1Char('/') + di.fileName(),
-                isDir);
+            // This succeeded, so it needs to be removed from the database now because the caller won't
+            deletedOnError->append(qMakePair(entryPath, isDir));
         }
     }
     if (success) {
         success = QDir().rmdir(absolute);
         if (!success) {
-            _error += PropagateLocalRemove::tr("Could not remove folder '%1'")
+            *error += PropagateLocalRemove::tr("Could not remove folder '%1'")
                           .arg(QDir::toNativeSeparators(absolute))
                 + " ";
             qCWarning(lcPropagateLocalRemove) << "Error removing folder" << absolute;
@@ -110,7 +120,7 @@ bool PropagateLocalRemove::removeRecursively(const QString &path)
 
 void PropagateLocalRemove::start()
 {
-    _moveToTrash = propagator()->syncOptions()._moveFilesToTrash;
+    const bool moveToTrash = propagator()->syncOptions()._moveFilesToTrash;
 
     if (propagator()->_abortRequested.fetchAndAddRelaxed(0))
         return;
@@ -123,31 +133,39 @@ void PropagateLocalRemove::start()
         return;
     }
 
-    QString removeError;
-    if (_moveToTrash) {
-        if ((QDir(filename).exists() || FileSystem::fileExists(filename))
-            && !FileSystem::moveToTrash(filename, &removeError)) {
-            done(SyncFileItem::NormalError, removeError);
-            return;
-        }
-    } else {
-        if (_item->isDirectory()) {
-            if (QDir(filename).exists() && !removeRecursively(QString())) {
-                done(SyncFileItem::NormalError, _error);
-                return;
+    const bool isDirectory = _item->isDirectory();
+    auto result = QSharedPointer<LocalIoResult>::create();
+    auto work = [filename, moveToTrash, isDirectory, result]() {
+        if (moveToTrash) {
+            if ((QDir(filename).exists() || FileSystem::fileExists(filename))
+                && !FileSystem::moveToTrash(filename, &result->error)) {
+                result->ok = false;
+            }
+        } else if (isDirectory) {
+            if (QDir(filename).exists()
+                && !removeRecursively(filename, QString(), &result->error, &result->deletedOnError)) {
+                result->ok = false;
             }
         } else {
             if (FileSystem::fileExists(filename)
-                && !FileSystem::remove(filename, &removeError)) {
-                done(SyncFileItem::NormalError, removeError);
-                return;
+                && !FileSystem::remove(filename, &result->error)) {
+                result->ok = false;
             }
         }
-    }
-    propagator()->reportProgress(*_item, 0);
-    propagator()->_journal->deleteFileRecord(_item->_originalFile, _item->isDirectory());
-    propagator()->_journal->commit("Local remove");
-    done(SyncFileItem::Success);
+    };
+    runLocalIo(work, [this, result]() {
+        foreach (const auto &it, result->deletedOnError) {
+            propagator()->_journal->deleteFileRecord(_item->_originalFile + it.first, it.second);
+        }
+        if (!result->ok) {
+            done(SyncFileItem::NormalError, result->error);
+            return;
+        }
+        propagator()->reportProgress(*_item, 0);
+        propagator()->_journal->deleteFileRecord(_item->_originalFile, _item->isDirectory());
+        propagator()->_journal->commit("Local remove");
+        done(SyncFileItem::Success);
+    });
 }
 
 void PropagateLocalMkdir::start()
@@ -161,15 +179,10 @@ void PropagateLocalMkdir::start()
     // When turning something that used to be a file into a directory
     // we need to delete the file first.
     QFileInfo fi(newDirStr);
+    bool deleteExistingFile = false;
     if (fi.exists() && fi.isFile()) {
         if (_deleteExistingFile) {
-            QString removeError;
-            if (!FileSystem::remove(newDirStr, &removeError)) {
-                done(SyncFileItem::NormalError,
-                    tr("could not delete file %1, error: %2")
-                        .arg(newDirStr, removeError));
-                return;
-            }
+            deleteExistingFile = true;
         } else if (_item->_instruction == CSYNC_INSTRUCTION_CONFLICT) {
             QString error;
             if (!propagator()->createConflict(_item, _associatedComposite, &error)) {
@@ -185,12 +198,31 @@ void PropagateLocalMkdir::start()
         return;
     }
     emit propagator()->touchedFile(newDirStr);
-    QDir localDir(propagator()->_localDir);
-    if (!localDir.mkpath(_item->_file)) {
-        done(SyncFileItem::NormalError, tr("could not create folder %1").arg(newDirStr));
-        return;
-    }
 
+    const QString localDir = propagator()->_localDir;
+    const QString file = _item->_file;
+    auto result = QSharedPointer<LocalIoResult>::create();
+    auto work = [newDirStr, deleteExistingFile, localDir, file, result]() {
+        QString removeError;
+        if (deleteExistingFile && !FileSystem::remove(newDirStr, &removeError)) {
+            result->ok = false;
+            result->error = tr("could not delete file %1, error: %2").arg(newDirStr, removeError);
+        } else if (!QDir(localDir).mkpath(file)) {
+            result->ok = false;
+            result->error = tr("could not create folder %1").arg(newDirStr);
+        }
+    };
+    runLocalIo(work, [this, newDirStr, result]() {
+        if (!result->ok) {
+            done(SyncFileItem::NormalError, result->error);
+            return;
+        }
+        finalize(newDirStr);
+    });
+}
+
+void PropagateLocalMkdir::finalize(const QString &newDirStr)
+{
     // Insert the directory into the database. The correct etag will be set later,
     // once all contents have been propagated, because should_update_metadata is true.
     // Adding an entry with a dummy etag to the database still makes sense here
@@ -245,13 +277,25 @@ void PropagateLocalRename::start()
 
         emit propagator()->touchedFile(existingFile);
         emit propagator()->touchedFile(targetFile);
-        QString renameError;
-        if (!FileSystem::rename(existingFile, targetFile, &renameError)) {
-            done(SyncFileItem::NormalError, renameError);
-            return;
-        }
+        auto result = QSharedPointer<LocalIoResult>::create();
+        auto work = [existingFile, targetFile, result]() {
+            result->ok = FileSystem::rename(existingFile, targetFile, &result->error);
+        };
+        runLocalIo(work, [this, targetFile, result]() {
+            if (!result->ok) {
+                done(SyncFileItem::NormalError, result->error);
+                return;
+            }
+            finalize(targetFile);
+        });
+        return;
     }
 
+    finalize(targetFile);
+}
+
+void PropagateLocalRename::finalize(const QString &targetFile)
+{
     SyncJournalFileRecord oldRecord;
     propagator()->_journal->getFileRecord(_item->_originalFile, &oldRecord);
     propagator()->_journal->deleteFileRecord(_item->_originalFile);
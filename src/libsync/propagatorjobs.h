@@ -40,11 +40,6 @@ public:
     {
     }
     void start() Q_DECL_OVERRIDE;
-
-private:
-    bool removeRecursively(const QString &path);
-    QString _error;
-    bool _moveToTrash;
 };
 
 /**
@@ -71,6 +66,9 @@ public:
     void setDeleteExistingFile(bool enabled);
 
 private:
+    /// Writes the new directory to the journal once it was created
+    void finalize(const QString &newDirStr);
+
     bool _deleteExistingFile;
 };
 
@@ -88,5 +86,9 @@ public:
     }
     void start() Q_DECL_OVERRIDE;
     JobParallelism parallelism() Q_DECL_OVERRIDE { return _item->isDirectory() ? WaitForFinished : FullParallelism; }
+
+private:
+    /// Updates the journal once the file was moved
+    void finalize(const QString &targetFile);
 };
 }
@@ -26,6 +26,7 @@
 #include "propagateremotedelete.h"
 #include "propagatedownload.h"
 #include "common/asserts.h"
+#include "common/synctrace.h"
 
 #ifdef Q_OS_WIN
 #include <windows.h>
@@ -50,13 +51,13 @@
 #include <QProcess>
 #include <QElapsedTimer>
 #include <qtextcodec.h>
+#include <qtconcurrentrun.h>
 
 namespace OCC {
 
 Q_LOGGING_CATEGORY(lcEngine, "sync.engine", QtInfoMsg)
 
 static const int s_touchedFilesMaxAgeMs = 15 * 1000;
-bool SyncEngine::s_anySyncRunning = false;
 
 qint64 SyncEngine::minimumFileAgeForUpload = 2000;
 
@@ -106,6 +107,7 @@ SyncEngine::~SyncEngine()
     abort();
     _thread.quit();
     _thread.wait();
+    _remoteTreeSnapshotWriter.waitForFinished();
     _excludedFiles.reset();
 }
 
@@ -767,14 +769,16 @@ void SyncEngine::startSync()
         }
     }
 
-    if (s_anySyncRunning || _syncRunning) {
+    // Engines of different folders may sync at the same time, see owncloudcmd --folders
+    if (_syncRunning) {
         ASSERT(false);
         return;
     }
 
-    s_anySyncRunning = true;
     _syncRunning = true;
     _anotherSyncNeeded = NoFollowUpSync;
+    // rootEtag() is emitted for every sync, not just for the first one
+    _remoteRootEtag.clear();
     _clearTouchedFilesTimer.stop();
 
     _progressInfo->reset();
@@ -842,10 +846,25 @@ void SyncEngine::startSync()
     _journal->clearEtagStorageFilter();
 
     _csync_ctx->upload_conflict_files = _account->capabilities().uploadConflictFiles();
+    _csync_ctx->parallel_reconcile = _syncOptions._parallelReconcile;
     _excludedFiles->setExcludeConflictFiles(!_account->capabilities().uploadConflictFiles());
 
     _csync_ctx->read_remote_from_db = true;
 
+    // Don't wait for the writer of the previous sync, this sync just reads from the db
+    if (_syncOptions._remoteTreeSnapshot && _remoteTreeSnapshotWriter.isRunning()) {
+        qCInfo(lcEngine) << "The remote tree snapshot is still being written, not using it for this sync";
+    } else if (_syncOptions._remoteTreeSnapshot) {
+        _remoteTreeSnapshot.reset(new RemoteTreeSnapshot);
+        if (_remoteTreeSnapshot->open(_journal->remoteTreeSnapshotFilePath())
+            && _remoteTreeSnapshot->generation() == _journal->remoteTreeSnapshotGeneration()) {
+            qCInfo(lcEngine) << "Using the remote tree snapshot with" << _remoteTreeSnapshot->entryCount() << "entries";
+            _csync_ctx->remote.snapshot = _remoteTreeSnapshot.data();
+        } else {
+            _remoteTreeSnapshot.reset();
+        }
+    }
+
     _lastLocalDiscoveryStyle = _localDiscoveryStyle;
     _csync_ctx->should_discover_locally_fn = [this](const QByteArray &path) {
         return shouldDiscoverLocally(path);
@@ -877,6 +896,7 @@ void SyncEngine::startSync()
     _csync_ctx->callbacks.checksum_userdata = &_checksum_hook;
 
     _stopWatch.start();
+    _traceStart = SyncTrace::now();
     _progressInfo->_status = ProgressInfo::Starting;
     emit transmissionProgress(*_progressInfo);
 
@@ -983,9 +1003,12 @@ void SyncEngine::slotDiscoveryJobFinished(int discoveryResult)
     _progressInfo->_status = ProgressInfo::Reconcile;
     emit transmissionProgress(*_progressInfo);
 
-    if (csync_reconcile(_csync_ctx.data()) < 0) {
-        handleSyncError(_csync_ctx.data(), "csync_reconcile");
-        return;
+    {
+        SyncTraceScope trace("engine", "reconcile");
+        if (csync_reconcile(_csync_ctx.data()) < 0) {
+            handleSyncError(_csync_ctx.data(), "csync_reconcile");
+            return;
+        }
     }
 
     qCInfo(lcEngine) << "#### Reconcile end #################################################### " << _stopWatch.addLapTime(QLatin1String("Reconcile Finished")) << "ms";
@@ -997,14 +1020,25 @@ void SyncEngine::slotDiscoveryJobFinished(int discoveryResult)
     bool walkOk = true;
     _seenFiles.clear();
     _temporarilyUnavailablePaths.clear();
+    _cleanSubtrees.clear();
     _renamedFolders.clear();
 
-    if (csync_walk_local_tree(_csync_ctx.data(), [this](csync_file_stat_t *f, csync_file_stat_t *o) { return treewalkFile(f, o, false); } ) < 0) {
-        qCWarning(lcEngine) << "Error in local treewalk.";
-        walkOk = false;
+    {
+        SyncTraceScope trace("engine", "treewalk");
+        if (csync_walk_local_tree(_csync_ctx.data(), [this](csync_file_stat_t *f, csync_file_stat_t *o) { return treewalkFile(f, o, false); } ) < 0) {
+            qCWarning(lcEngine) << "Error in local treewalk.";
+            walkOk = false;
+        }
+        if (walkOk && csync_walk_remote_tree(_csync_ctx.data(), [this](csync_file_stat_t *f, csync_file_stat_t *o) { return treewalkFile(f, o, true); } ) < 0) {
+            qCWarning(lcEngine) << "Error in remote treewalk.";
+        }
     }
-    if (walkOk && csync_walk_remote_tree(_csync_ctx.data(), [this](csync_file_stat_t *f, csync_file_stat_t *o) { return treewalkFile(f, o, true); } ) < 0) {
-        qCWarning(lcEngine) << "Error in remote treewalk.";
+
+    // The treewalk did not visit the unchanged files below these
+    for (const auto &subtree : _csync_ctx->clean_subtrees) {
+        _cleanSubtrees.insert(QString::fromUtf8(subtree.path));
+        if (subtree.has_files)
+            _hasNoneFiles = true;
     }
 
     qCInfo(lcEngine) << "Permissions of the root folder: " << _csync_ctx->remote.root_perms.toString();
@@ -1079,7 +1113,10 @@ void SyncEngine::slotDiscoveryJobFinished(int discoveryResult)
     std::sort(syncItems.begin(), syncItems.end());
 
     // make sure everything is allowed
-    checkForPermission(syncItems);
+    {
+        SyncTraceScope trace("engine", "checkForPermission");
+        checkForPermission(syncItems);
+    }
 
     // Re-init the csync context to free memory
     _csync_ctx->reinitialize();
@@ -1134,7 +1171,11 @@ void SyncEngine::slotDiscoveryJobFinished(int discoveryResult)
     if (_needsUpdate)
         emit(started());
 
-    _propagator->start(syncItems);
+    {
+        // Builds the job tree and schedules the first jobs
+        SyncTraceScope trace("engine", "build job tree");
+        _propagator->start(syncItems);
+    }
 
     qCInfo(lcEngine) << "#### Post-Reconcile end #################################################### " << _stopWatch.addLapTime(QLatin1String("Post-Reconcile Finished")) << "ms";
 }
@@ -1186,7 +1227,7 @@ void SyncEngine::slotFinished(bool success)
         _journal->setDataFingerprint(_discoveryMainThread->_dataFingerprint);
     }
 
-    if (!_journal->postSyncCleanup(_seenFiles, _temporarilyUnavailablePaths)) {
+    if (!_journal->postSyncCleanup(_seenFiles, _temporarilyUnavailablePaths, _cleanSubtrees)) {
         qCDebug(lcEngine) << "Cleaning of synced ";
     }
 
@@ -1210,12 +1251,29 @@ void SyncEngine::finalize(bool success)
     _thread.wait();
 
     _csync_ctx->reinitialize();
+    _remoteTreeSnapshot.reset();
+
+    // A generation of 0 means the file records changed since the last snapshot.
+    // A writer that is still running is left alone, the next sync writes it again.
+    bool writeSnapshot = success && _syncOptions._remoteTreeSnapshot
+        && !_remoteTreeSnapshotWriter.isRunning()
+        && _journal->remoteTreeSnapshotGeneration() == 0;
     _journal->close();
+    if (writeSnapshot) {
+        _remoteTreeSnapshotWriter = QtConcurrent::run(&RemoteTreeSnapshot::write, _journal);
+    }
 
     qCInfo(lcEngine) << "CSync run took " << _stopWatch.addLapTime(QLatin1String("Sync Finished")) << "ms";
     _stopWatch.stop();
 
-    s_anySyncRunning = false;
+    if (_traceStart >= 0) {
+        SyncTrace::addSpan("engine", "sync", _traceStart, _localPath, true);
+        _traceStart = -1;
+        const QString traceFile = SyncTrace::fileFromEnvironment();
+        if (!traceFile.isEmpty())
+            SyncTrace::writeChromeTrace(traceFile);
+    }
+
     _syncRunning = false;
     emit finished(success);
 
@@ -1223,6 +1281,7 @@ void SyncEngine::finalize(bool success)
     _propagator.clear();
     _seenFiles.clear();
     _temporarilyUnavailablePaths.clear();
+    _cleanSubtrees.clear();
     _renamedFolders.clear();
     _uniqueErrors.clear();
     _localDiscoveryPaths.clear();
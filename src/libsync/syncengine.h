@@ -25,6 +25,7 @@
 #include <QMap>
 #include <QStringList>
 #include <QSharedPointer>
+#include <QFuture>
 #include <set>
 
 #include <csync.h>
@@ -39,6 +40,7 @@
 #include "accountfwd.h"
 #include "discoveryphase.h"
 #include "common/checksums.h"
+#include "common/remotetreesnapshot.h"
 
 class QProcess;
 
@@ -70,6 +72,8 @@ public:
 
     Q_INVOKABLE void startSync();
     void setNetworkLimits(int upload, int download);
+    int uploadLimit() const { return _uploadLimit; }
+    int downloadLimit() const { return _downloadLimit; }
 
     /* Abort the sync.  Called from the main thread */
     void abort();
@@ -126,6 +130,9 @@ public:
     /** Access the last sync run's local discovery style */
     LocalDiscoveryStyle lastLocalDiscoveryStyle() const { return _lastLocalDiscoveryStyle; }
 
+    /** The progress of the current or last sync, as sent by transmissionProgress() */
+    const ProgressInfo &progressInfo() const { return *_progressInfo; }
+
 signals:
     void csyncUnavailable();
 
@@ -223,8 +230,6 @@ private:
     // cleanup and emit the finished signal
     void finalize(bool success);
 
-    static bool s_anySyncRunning; //true when one sync is running somewhere (for debugging)
-
     // Must only be acessed during update and reconcile
     QMap<QString, SyncFileItemPtr> _syncItemMap;
 
@@ -239,6 +244,11 @@ private:
     QPointer<DiscoveryMainThread> _discoveryMainThread;
     QSharedPointer<OwncloudPropagator> _propagator;
 
+    /// Only set during the discovery if _syncOptions._remoteTreeSnapshot is enabled
+    QScopedPointer<RemoteTreeSnapshot> _remoteTreeSnapshot;
+    /// Writes a new snapshot after a sync that changed the file records
+    QFuture<bool> _remoteTreeSnapshotWriter;
+
     // After a sync, only the syncdb entries whose filenames appear in this
     // set will be kept. See _temporarilyUnavailablePaths.
     QSet<QString> _seenFiles;
@@ -253,6 +263,11 @@ private:
     // while the remote says storage not available.
     QSet<QString> _temporarilyUnavailablePaths;
 
+    // The treewalk skips the contents of directories that are unchanged on
+    // both sides, see csync_s::clean_subtrees. All syncdb entries below
+    // these directories are kept.
+    QSet<QString> _cleanSubtrees;
+
     QThread _thread;
 
     QScopedPointer<ProgressInfo> _progressInfo;
@@ -260,6 +275,7 @@ private:
     QScopedPointer<ExcludedFiles> _excludedFiles;
     QScopedPointer<SyncFileStatusTracker> _syncFileStatusTracker;
     Utility::StopWatch _stopWatch;
+    qint64 _traceStart = -1; // of the whole sync, for SyncTrace
 
     // maps the origin and the target of the folders that have been renamed
     QHash<QString, QString> _renamedFolders;
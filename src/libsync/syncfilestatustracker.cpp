@@ -25,6 +25,9 @@ namespace OCC {
 
 Q_LOGGING_CATEGORY(lcStatusTracker, "sync.statustracker", QtInfoMsg)
 
+// Bounds the memory of the journal cache: a few MB
+static const int journalCacheMaxEntries = 20000;
+
 static int pathCompare( const QString& lhs, const QString& rhs )
 {
     // Should match Utility::fsCasePreserving, we want don't want to pay for the runtime check on every comparison.
@@ -111,6 +114,7 @@ static inline bool showWarningInSocketApi(const SyncFileItem &item)
 SyncFileStatusTracker::SyncFileStatusTracker(SyncEngine *syncEngine)
     : _syncEngine(syncEngine)
 {
+    _journalCache.setMaxCost(journalCacheMaxEntries);
     connect(syncEngine, &SyncEngine::aboutToPropagate,
         this, &SyncFileStatusTracker::slotAboutToPropagate);
     connect(syncEngine, &SyncEngine::itemCompleted,
@@ -145,9 +149,21 @@ SyncFileStatus SyncFileStatusTracker::fileStatus(const QString &relativePath)
         return SyncFileStatus::StatusSync;
 
     // First look it up in the database to know if it's shared
-    SyncJournalFileRecord rec;
-    if (_syncEngine->journal()->getFileRecord(relativePath, &rec) && rec.isValid()) {
-        return resolveSyncAndErrorStatus(relativePath, rec._remotePerm.hasPermission(RemotePermissions::IsShared) ? Shared : NotShared);
+    int lastSlashIndex = relativePath.lastIndexOf('/');
+    const QString directory = lastSlashIndex == -1 ? QString() : relativePath.left(lastSlashIndex);
+    if (_largeDirectories.contains(directory)) {
+        // Listing it again for every file would be quadratic
+        SyncJournalFileRecord rec;
+        if (_syncEngine->journal()->getFileRecord(relativePath, &rec) && rec.isValid()) {
+            return resolveSyncAndErrorStatus(relativePath,
+                rec._remotePerm.hasPermission(RemotePermissions::IsShared) ? Shared : NotShared);
+        }
+    } else {
+        const DirectoryEntries entries = journalEntriesOf(directory);
+        auto it = entries.constFind(relativePath.mid(lastSlashIndex + 1));
+        if (it != entries.constEnd()) {
+            return resolveSyncAndErrorStatus(relativePath, it.value());
+        }
     }
 
     // Must be a new file not yet in the database, check if it's syncing or has an error.
@@ -263,6 +279,11 @@ void SyncFileStatusTracker::slotItemCompleted(const SyncFileItemPtr &item)
 {
     qCDebug(lcStatusTracker) << "Item completed" << item->destination() << item->_status << item->_instruction;
 
+    // The journal entries of this item were just written
+    invalidateJournalCache(item->_file);
+    if (!item->_renameTarget.isEmpty())
+        invalidateJournalCache(item->_renameTarget);
+
     if (showErrorInSocketApi(*item)) {
         _syncProblems[item->_file] = SyncFileStatus::StatusError;
         invalidateParentPaths(item->destination());
@@ -295,6 +316,8 @@ void SyncFileStatusTracker::slotSyncFinished()
 
 void SyncFileStatusTracker::slotSyncEngineRunningChanged()
 {
+    _journalCache.clear();
+    _largeDirectories.clear();
     emit fileStatusChanged(getSystemDestination(QString()), resolveSyncAndErrorStatus(QString(), NotShared));
 }
 
@@ -321,6 +344,43 @@ SyncFileStatus SyncFileStatusTracker::resolveSyncAndErrorStatus(const QString &r
     return status;
 }
 
+SyncFileStatusTracker::DirectoryEntries SyncFileStatusTracker::journalEntriesOf(const QString &directory)
+{
+    if (auto cached = _journalCache.object(directory))
+        return *cached;
+
+    DirectoryEntries entries;
+    bool ok = _syncEngine->journal()->getFilesInDirectory(directory.toUtf8(), [&](const SyncJournalFileRecord &rec) {
+        const QString path = QString::fromUtf8(rec._path);
+        entries.insert(path.mid(path.lastIndexOf('/') + 1),
+            rec._remotePerm.hasPermission(RemotePermissions::IsShared) ? Shared : NotShared);
+    });
+    // Don't remember a failed lookup, the next request will try again.
+    // A directory that is larger than the whole cache isn't kept, its
+    // files are looked up one by one instead.
+    if (ok && entries.size() >= journalCacheMaxEntries)
+        _largeDirectories.insert(directory);
+    else if (ok)
+        _journalCache.insert(directory, new DirectoryEntries(entries), entries.size() + 1);
+    return entries;
+}
+
+void SyncFileStatusTracker::invalidateJournalCache(const QString &path)
+{
+    if (_journalCache.isEmpty())
+        return;
+
+    int lastSlashIndex = path.lastIndexOf('/');
+    _journalCache.remove(lastSlashIndex == -1 ? QString() : path.left(lastSlashIndex));
+
+    // Directories can be removed or renamed with everything below them
+    const QString prefix = path + QLatin1Char('/');
+    for (const auto &directory : _journalCache.keys()) {
+        if (directory == path || directory.startsWith(prefix))
+            _journalCache.remove(directory);
+    }
+}
+
 void SyncFileStatusTracker::invalidateParentPaths(const QString &path)
 {
     QStringList splitPath = path.split('/', QString::SkipEmptyParts);
@@ -20,6 +20,7 @@
 #include "syncfileitem.h"
 #include "syncfilestatus.h"
 #include <map>
+#include <QCache>
 #include <QSet>
 
 namespace OCC {
@@ -64,6 +65,11 @@ private:
         PathKnown };
     SyncFileStatus resolveSyncAndErrorStatus(const QString &relativePath, SharedFlag sharedState, PathKnownFlag isPathKnown = PathKnown);
 
+    // Journal state of the entries of one directory, keyed by file name
+    typedef QHash<QString, SharedFlag> DirectoryEntries;
+    DirectoryEntries journalEntriesOf(const QString &directory);
+    void invalidateJournalCache(const QString &path);
+
     void invalidateParentPaths(const QString &path);
     QString getSystemDestination(const QString &relativePath);
     void incSyncCountAndEmitStatusChanged(const QString &relativePath, SharedFlag sharedState);
@@ -77,6 +83,16 @@ private:
     // We'll show a file/directory as SYNC as long as its sync count is > 0.
     // A directory that starts/ends propagation will in turn increase/decrease its own parent by 1.
     QHash<QString, int> _syncCount;
+
+    // Directories whose entries were read from the journal, so fileStatus()
+    // doesn't need to query it for every single path a shell asks about.
+    // Entries are dropped when an item below them completes and the whole
+    // cache is cleared when a sync starts or finishes. The cost of a
+    // directory is its number of entries, the least recently used
+    // directories are evicted first.
+    QCache<QString, DirectoryEntries> _journalCache;
+    // Directories with too many entries for the cache
+    QSet<QString> _largeDirectories;
 };
 }
 
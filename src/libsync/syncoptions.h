@@ -63,6 +63,20 @@ struct SyncOptions
 
     /** Whether parallel network jobs are allowed. */
     bool _parallelNetworkJobs = true;
+
+    /** Read unchanged remote subtrees from a memory mapped copy of the
+     * journal records instead of from the database. See RemoteTreeSnapshot.
+     */
+    bool _remoteTreeSnapshot = false;
+
+    /** Whether reconcile and the treewalk may use the global thread pool */
+    bool _parallelReconcile = false;
+
+    /** New files of at least this size (in Bytes) that have the content checksum
+     * of an already synced file are copied on the server instead of uploaded.
+     * -1 disables it.
+     */
+    qint64 _serverSideCopyMinSize = -1;
 };
 
 
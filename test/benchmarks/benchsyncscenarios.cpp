@@ -0,0 +1,250 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+/*
+ * Runs named sync scenarios against FakeFolder with a simulated network
+ * and prints the results as JSON, one object per scenario:
+ *
+ *   SyncScenariosBench [--scenario name]... [--latency ms] [--bandwidth bytes/s]
+ *                      [--connections n] [--scale n] [--output file]
+ *
+ * The peak RSS is the one of the whole process; run one scenario per
+ * process to compare it between scenarios.
+ */
+
+#include "syncenginetestutils.h"
+#include <syncengine.h>
+
+#include <QCommandLineParser>
+#include <QJsonArray>
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+using namespace OCC;
+
+namespace {
+
+struct Scenario
+{
+    QString name;
+    // in sync on both sides before the measurement
+    std::function<FileInfo()> initialState;
+    // the changes the measured sync has to propagate
+    std::function<void(FakeFolder &)> change;
+};
+
+int scale = 1;
+
+qint64 peakRss()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#ifdef Q_OS_MAC
+    return usage.ru_maxrss;
+#else
+    return qint64(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return -1;
+#endif
+}
+
+void addTree(FileModifier &fi, const QString &path, int depth, int dirsPerDir, int filesPerDir)
+{
+    for (int fileNum = 1; fileNum <= filesPerDir; ++fileNum) {
+        QString name = QStringLiteral("file") + QString::number(fileNum);
+        fi.insert(path.isEmpty() ? name : path + "/" + name);
+    }
+    if (depth <= 0)
+        return;
+    for (int dirNum = 1; dirNum <= dirsPerDir; ++dirNum) {
+        QString name = QStringLiteral("dir") + QString::number(dirNum);
+        QString subPath = path.isEmpty() ? name : path + "/" + name;
+        fi.mkdir(subPath);
+        addTree(fi, subPath, depth - 1, dirsPerDir, filesPerDir);
+    }
+}
+
+// 21 directories with 20 * scale files each
+void addDefaultTree(FileModifier &fi)
+{
+    addTree(fi, QString(), 2, 4, 20 * scale);
+}
+
+FileInfo defaultTree()
+{
+    FileInfo fi;
+    addDefaultTree(fi);
+    return fi;
+}
+
+void collectFiles(const FileInfo &dir, const QString &path, QStringList &files)
+{
+    foreach (const FileInfo &child, dir.children) {
+        QString childPath = path.isEmpty() ? child.name : path + "/" + child.name;
+        if (child.isDir)
+            collectFiles(child, childPath, files);
+        else
+            files.append(childPath);
+    }
+}
+
+QStringList allFiles(FakeFolder &fakeFolder)
+{
+    QStringList files;
+    collectFiles(fakeFolder.currentLocalState(), QString(), files);
+    return files;
+}
+
+QVector<Scenario> scenarios()
+{
+    return {
+        { QStringLiteral("initial_upload"), [] { return FileInfo(); },
+            [](FakeFolder &fakeFolder) { addDefaultTree(fakeFolder.localModifier()); } },
+        { QStringLiteral("initial_download"), [] { return FileInfo(); },
+            [](FakeFolder &fakeFolder) { addDefaultTree(fakeFolder.remoteModifier()); } },
+        { QStringLiteral("no_change_resync"), &defaultTree,
+            [](FakeFolder &) {} },
+        { QStringLiteral("mass_rename"), &defaultTree,
+            [](FakeFolder &fakeFolder) {
+                for (const auto &file : allFiles(fakeFolder))
+                    fakeFolder.localModifier().rename(file, file + ".renamed");
+            } },
+        { QStringLiteral("mass_delete"), &defaultTree,
+            [](FakeFolder &fakeFolder) {
+                for (const auto &file : allFiles(fakeFolder))
+                    fakeFolder.localModifier().remove(file);
+            } },
+        { QStringLiteral("big_files"), [] { return FileInfo(); },
+            [](FakeFolder &fakeFolder) {
+                const qint64 size = 16 * 1000 * 1000;
+                for (int i = 1; i <= 2 * scale; ++i) {
+                    fakeFolder.localModifier().insert(QStringLiteral("upload%1.bin").arg(i), size);
+                    fakeFolder.remoteModifier().insert(QStringLiteral("download%1.bin").arg(i), size);
+                }
+            } },
+        { QStringLiteral("deep_tree"), [] { return FileInfo(); },
+            [](FakeFolder &fakeFolder) {
+                // One long chain of directories with a few files at every level
+                QString path;
+                for (int depth = 1; depth <= 30; ++depth) {
+                    path += (path.isEmpty() ? "" : "/") + QStringLiteral("level%1").arg(depth);
+                    fakeFolder.localModifier().mkdir(path);
+                    for (int i = 1; i <= 3 * scale; ++i)
+                        fakeFolder.localModifier().insert(path + QStringLiteral("/file%1").arg(i));
+                }
+            } },
+    };
+}
+
+QJsonObject run(const Scenario &scenario, const FakeQNAM::NetworkShape &shape, bool verbose)
+{
+    FakeFolder fakeFolder{ scenario.initialState() };
+    if (!verbose)
+        Logger::instance()->setLogFile(QString());
+    fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ { "chunking", "1.0" } } } });
+    scenario.change(fakeFolder);
+    fakeFolder.setNetworkShape(shape);
+
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = fakeFolder.syncOnce();
+    const qint64 wallTime = timer.elapsed();
+    ok = ok && fakeFolder.currentLocalState() == fakeFolder.currentRemoteState();
+
+    const auto &stats = fakeFolder.networkStats();
+    QJsonObject result;
+    result.insert("name", scenario.name);
+    result.insert("success", ok);
+    result.insert("wall_time_ms", wallTime);
+    result.insert("requests", stats.requests);
+    result.insert("bytes_sent", stats.bytesSent);
+    result.insert("bytes_received", stats.bytesReceived);
+    result.insert("peak_connections", stats.peakConnections);
+    result.insert("peak_rss_bytes", peakRss());
+    return result;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs sync scenarios against a simulated server and prints JSON results.");
+    parser.addHelpOption();
+    QCommandLineOption scenarioOption("scenario", "Only run this scenario, can be repeated.", "name");
+    QCommandLineOption listOption("list", "List the scenarios.");
+    QCommandLineOption latencyOption("latency", "Latency per request (default 20).", "ms", "20");
+    QCommandLineOption bandwidthOption("bandwidth", "Bandwidth per connection, 0 is unlimited (default 12500000).", "bytes/s", "12500000");
+    QCommandLineOption connectionsOption("connections", "Maximum parallel connections, 0 is unlimited (default 6).", "n", "6");
+    QCommandLineOption scaleOption("scale", "Multiplies the number of files (default 1).", "n", "1");
+    QCommandLineOption outputOption("output", "Write the JSON to this file instead of stdout.", "file");
+    QCommandLineOption verboseOption("verbose", "Keep the sync log on stdout.");
+    parser.addOptions({ scenarioOption, listOption, latencyOption, bandwidthOption, connectionsOption,
+        scaleOption, outputOption, verboseOption });
+    parser.process(app);
+
+    const auto allScenarios = scenarios();
+    if (parser.isSet(listOption)) {
+        for (const auto &scenario : allScenarios)
+            printf("%s\n", qPrintable(scenario.name));
+        return 0;
+    }
+
+    FakeQNAM::NetworkShape shape;
+    shape.latencyMs = parser.value(latencyOption).toInt();
+    shape.bytesPerSecond = parser.value(bandwidthOption).toLongLong();
+    shape.maxConnections = parser.value(connectionsOption).toInt();
+    scale = qMax(1, parser.value(scaleOption).toInt());
+
+    const QStringList selected = parser.values(scenarioOption);
+    for (const auto &name : selected) {
+        if (std::none_of(allScenarios.begin(), allScenarios.end(), [&](const Scenario &s) { return s.name == name; })) {
+            fprintf(stderr, "Unknown scenario %s\n", qPrintable(name));
+            return 2;
+        }
+    }
+
+    bool allOk = true;
+    QJsonArray results;
+    for (const auto &scenario : allScenarios) {
+        if (!selected.isEmpty() && !selected.contains(scenario.name))
+            continue;
+        auto result = run(scenario, shape, parser.isSet(verboseOption));
+        allOk = allOk && result.value("success").toBool();
+        results.append(result);
+    }
+
+    QJsonObject network;
+    network.insert("latency_ms", shape.latencyMs);
+    network.insert("bandwidth_bytes_per_second", shape.bytesPerSecond);
+    network.insert("max_connections", shape.maxConnections);
+    QJsonObject root;
+    root.insert("network", network);
+    root.insert("scale", scale);
+    root.insert("scenarios", results);
+    const QByteArray json = QJsonDocument(root).toJson();
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+            fprintf(stderr, "Could not write %s\n", qPrintable(file.fileName()));
+            return 2;
+        }
+    } else {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    }
+    return allOk ? 0 : 1;
+}
@@ -453,6 +453,51 @@ static void check_readdir_bigunicode(void **state)
     assert_int_equal(files_cnt, 0);
 }
 
+/* More entries than fit in one batch of the directory reading */
+static void check_readdir_many_files(void **state)
+{
+    statevar *sv = (statevar*) *state;
+    CSYNC *csync = sv->csync;
+    const int count = 1500;
+    char name[32];
+
+    create_dirs( "many/" );
+    for (int i = 0; i < count; ++i) {
+        snprintf(name, sizeof(name), "file%d", i);
+        create_file( "many/", name, name );
+    }
+#ifndef _WIN32
+    assert_int_equal(symlink("file0", "many/link"), 0);
+#endif
+
+    csync_vio_handle_t *dh = csync_vio_opendir(csync, CSYNC_TEST_DIR "/many");
+    assert_non_null(dh);
+
+    int files_cnt = 0;
+    int links_cnt = 0;
+    std::unique_ptr<csync_file_stat_t> dirent;
+    while( (dirent = csync_vio_readdir(csync, dh)) ) {
+        if (dirent->type == ItemTypeSoftLink) {
+            assert_string_equal(dirent->path.constData(), "link");
+            ++links_cnt;
+            continue;
+        }
+        assert_int_equal(dirent->type, ItemTypeFile);
+        assert_true(dirent->path.startsWith("file"));
+        /* create_file writes "we got: " and the content */
+        assert_int_equal(dirent->size, 8 + dirent->path.size());
+        assert_int_not_equal(dirent->inode, 0);
+        assert_int_not_equal(dirent->modtime, 0);
+        ++files_cnt;
+    }
+    assert_int_equal(csync_vio_closedir(csync, dh), 0);
+
+    assert_int_equal(files_cnt, count);
+#ifndef _WIN32
+    assert_int_equal(links_cnt, 1);
+#endif
+}
+
 int torture_run_tests(void)
 {
     const struct CMUnitTest tests[] = {
@@ -460,6 +505,7 @@ int torture_run_tests(void)
         cmocka_unit_test_setup_teardown(check_readdir_with_content, setup_testenv, teardown),
         cmocka_unit_test_setup_teardown(check_readdir_longtree, setup_testenv, teardown),
         cmocka_unit_test_setup_teardown(check_readdir_bigunicode, setup_testenv, teardown),
+        cmocka_unit_test_setup_teardown(check_readdir_many_files, setup_testenv, teardown),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
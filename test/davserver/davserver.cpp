@@ -0,0 +1,993 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "davserver.h"
+#include "filesystem.h"
+
+#include <QBuffer>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocale>
+#include <QLoggingCategory>
+#include <QTcpSocket>
+#include <QUrl>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+Q_LOGGING_CATEGORY(lcDavServer, "davserver", QtInfoMsg)
+
+namespace {
+const qint64 memoryBodyLimit = 1024 * 1024;
+const int maxHeaderSize = 64 * 1024;
+const int throttleIntervalMs = 100;
+const qint64 socketBufferLimit = 256 * 1024;
+const qint64 writeBlockSize = 64 * 1024;
+const QString davNamespace = QStringLiteral("DAV:");
+const QString ocNamespace = QStringLiteral("http://owncloud.org/ns");
+
+QByteArray reasonPhrase(int status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 204: return "No Content";
+    case 206: return "Partial Content";
+    case 207: return "Multi-Status";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 412: return "Precondition Failed";
+    case 416: return "Range Not Satisfiable";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    case 507: return "Insufficient Storage";
+    }
+    return "Unknown";
+}
+
+QString httpDate(const QDateTime &dateTime)
+{
+    return QLocale::c().toString(dateTime.toUTC(), QStringLiteral("ddd, dd MMM yyyy HH:mm:ss 'GMT'"));
+}
+
+DavResponse jsonResponse(const QJsonObject &object)
+{
+    DavResponse response;
+    response.setHeader("Content-Type", "application/json; charset=utf-8");
+    response.body = QJsonDocument(object).toJson(QJsonDocument::Compact);
+    return response;
+}
+
+// The OCS envelope of the capabilities and user info
+QJsonObject ocs(const QJsonObject &data)
+{
+    QJsonObject meta;
+    meta.insert("status", "ok");
+    meta.insert("statuscode", 100);
+    meta.insert("message", "OK");
+    QJsonObject content;
+    content.insert("meta", meta);
+    content.insert("data", data);
+    QJsonObject root;
+    root.insert("ocs", content);
+    return root;
+}
+
+qint64 treeSize(const QString &path)
+{
+    qint64 size = 0;
+    QDirIterator it(path, QDir::Files | QDir::Hidden | QDir::System, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        size += it.fileInfo().size();
+    }
+    return size;
+}
+
+bool removePath(const QString &path)
+{
+    if (QFileInfo(path).isDir())
+        return QDir(path).removeRecursively();
+    return QFile::remove(path);
+}
+
+// The target of MOVE, the client sends an encoded path but a URL is fine too
+QString destinationPath(const DavRequest &request)
+{
+    const QByteArray destination = request.header("Destination");
+    if (destination.startsWith("http://") || destination.startsWith("https://"))
+        return QUrl::fromEncoded(destination).path();
+    return QString::fromUtf8(QByteArray::fromPercentEncoding(destination));
+}
+
+// Puts the request body at target, replacing what is there
+bool storeBody(const DavRequest &request, const QString &target)
+{
+    if (QFileInfo::exists(target) && !QFile::remove(target))
+        return false;
+    if (request.bodyFile) {
+        request.bodyFile->close();
+        request.bodyFile->setAutoRemove(false);
+        // Copies if the spool directory is on another file system
+        if (QFile::rename(request.bodyFile->fileName(), target))
+            return true;
+        request.bodyFile->setAutoRemove(true);
+        return false;
+    }
+    QFile file(target);
+    return file.open(QIODevice::WriteOnly) && file.write(request.body) == request.body.size();
+}
+}
+
+DavServer::DavServer(const Options &options, QObject *parent)
+    : QTcpServer(parent)
+    , _options(options)
+{
+    _root = QDir::cleanPath(QDir(options.root).absolutePath());
+    _uploadRoot = options.uploadRoot.isEmpty()
+        ? _uploadTempDir.path()
+        : QDir::cleanPath(QDir(options.uploadRoot).absolutePath());
+    QDir().mkpath(_root);
+    QDir().mkpath(_uploadRoot);
+    _instanceTag = QByteArray::number(QDateTime::currentMSecsSinceEpoch(), 16);
+}
+
+void DavServer::incomingConnection(qintptr socketDescriptor)
+{
+    auto socket = new QTcpSocket(this);
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        delete socket;
+        return;
+    }
+    new DavConnection(this, socket);
+}
+
+DavResponse DavServer::handle(const DavRequest &request)
+{
+    const QString requestLine = QString::fromLatin1(request.method) + QLatin1Char(' ') + request.path;
+    for (const auto &failure : _options.failures) {
+        if (failure.first.match(requestLine).hasMatch())
+            return DavResponse(failure.second);
+    }
+    if (_options.errorRate > 0 && qrand() < _options.errorRate * RAND_MAX)
+        return DavResponse(503);
+
+    if (request.path.endsWith(QLatin1String("/status.php")))
+        return status();
+    if (!checkAuth(request)) {
+        DavResponse response(401);
+        response.setHeader("WWW-Authenticate", "Basic realm=\"davserver\"");
+        return response;
+    }
+    if (request.path.contains(QLatin1String("/ocs/v1.php/cloud/capabilities")))
+        return capabilities();
+    if (request.path.contains(QLatin1String("/ocs/v1.php/cloud/user")))
+        return userInfo();
+
+    QString localPath;
+    switch (area(request.path, &localPath)) {
+    case FilesArea:
+        return handleFiles(request, localPath);
+    case UploadsArea:
+        return handleUploads(request, localPath);
+    case NoArea:
+        break;
+    }
+    return DavResponse(404);
+}
+
+DavResponse DavServer::handleFiles(const DavRequest &request, const QString &localPath)
+{
+    const QByteArray &method = request.method;
+    if (method == "PROPFIND")
+        return propfind(request, localPath);
+    if (method == "GET" || method == "HEAD")
+        return get(request, localPath);
+    if (method == "PUT")
+        return put(request, localPath);
+    if (method == "MKCOL")
+        return mkcol(localPath);
+    if (method == "MOVE")
+        return move(request, localPath);
+    if (method == "COPY")
+        return copy(request, localPath);
+    if (method == "PROPPATCH")
+        return proppatch(request, localPath);
+    if (method == "DELETE")
+        return remove(localPath);
+    if (method == "OPTIONS") {
+        DavResponse response;
+        response.setHeader("DAV", "1");
+        response.setHeader("Allow", "OPTIONS, GET, HEAD, PUT, DELETE, PROPFIND, PROPPATCH, MKCOL, MOVE, COPY");
+        return response;
+    }
+    return DavResponse(405);
+}
+
+DavResponse DavServer::handleUploads(const DavRequest &request, const QString &localPath)
+{
+    const QByteArray &method = request.method;
+    if (method == "MKCOL")
+        return mkcol(localPath);
+    if (method == "PUT")
+        return put(request, localPath);
+    if (method == "PROPFIND")
+        return propfind(request, localPath);
+    if (method == "MOVE" && localPath.endsWith(QLatin1String("/.file")))
+        return assembleChunks(request, localPath.left(localPath.size() - 6));
+    if (method == "DELETE")
+        return remove(localPath);
+    return DavResponse(405);
+}
+
+DavResponse DavServer::propfind(const DavRequest &request, const QString &localPath)
+{
+    QFileInfo info(localPath);
+    if (!info.exists())
+        return DavResponse(404);
+
+    // oc:size walks the whole subtree, only do it when it is asked for
+    static const QRegularExpression sizeProperty(QStringLiteral("[<:]size[\\s/>]"));
+    const bool withSize = sizeProperty.match(QString::fromUtf8(request.body)).hasMatch();
+
+    QString href = request.path;
+    if (info.isDir() && !href.endsWith(QLatin1Char('/')))
+        href += QLatin1Char('/');
+
+    QByteArray body;
+    QXmlStreamWriter xml(&body);
+    xml.writeStartDocument();
+    xml.writeNamespace(davNamespace, QStringLiteral("d"));
+    xml.writeNamespace(ocNamespace, QStringLiteral("oc"));
+    xml.writeStartElement(davNamespace, QStringLiteral("multistatus"));
+    writeEntry(xml, href, info, withSize);
+    if (info.isDir() && request.header("Depth") != "0") {
+        const auto children = QDir(localPath).entryInfoList(
+            QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot, QDir::Name);
+        for (const auto &child : children) {
+            writeEntry(xml, href + child.fileName() + (child.isDir() ? QStringLiteral("/") : QString()),
+                child, withSize);
+        }
+    }
+    xml.writeEndElement();
+    xml.writeEndDocument();
+
+    DavResponse response(207);
+    response.setHeader("Content-Type", "application/xml; charset=utf-8");
+    response.body = body;
+    return response;
+}
+
+void DavServer::writeEntry(QXmlStreamWriter &xml, const QString &href, const QFileInfo &info, bool withSize)
+{
+    xml.writeStartElement(davNamespace, QStringLiteral("response"));
+    xml.writeTextElement(davNamespace, QStringLiteral("href"), QString::fromLatin1(QUrl::toPercentEncoding(href, "/")));
+    xml.writeStartElement(davNamespace, QStringLiteral("propstat"));
+    xml.writeStartElement(davNamespace, QStringLiteral("prop"));
+
+    xml.writeStartElement(davNamespace, QStringLiteral("resourcetype"));
+    if (info.isDir())
+        xml.writeEmptyElement(davNamespace, QStringLiteral("collection"));
+    xml.writeEndElement();
+    xml.writeTextElement(davNamespace, QStringLiteral("getlastmodified"), httpDate(info.lastModified()));
+    if (!info.isDir())
+        xml.writeTextElement(davNamespace, QStringLiteral("getcontentlength"), QString::number(info.size()));
+    xml.writeTextElement(davNamespace, QStringLiteral("getetag"), QLatin1Char('"') + QString::fromLatin1(etag(info)) + QLatin1Char('"'));
+    xml.writeTextElement(ocNamespace, QStringLiteral("id"), QString::fromLatin1(fileId(info.absoluteFilePath())));
+    xml.writeTextElement(ocNamespace, QStringLiteral("permissions"), info.isDir() ? QStringLiteral("RDNVCK") : QStringLiteral("RDNVW"));
+    if (withSize && info.isDir())
+        xml.writeTextElement(ocNamespace, QStringLiteral("size"), QString::number(treeSize(info.absoluteFilePath())));
+
+    xml.writeEndElement(); // prop
+    xml.writeTextElement(davNamespace, QStringLiteral("status"), QStringLiteral("HTTP/1.1 200 OK"));
+    xml.writeEndElement(); // propstat
+    xml.writeEndElement(); // response
+}
+
+DavResponse DavServer::get(const DavRequest &request, const QString &localPath)
+{
+    QFileInfo info(localPath);
+    if (!info.exists())
+        return DavResponse(404);
+    if (info.isDir())
+        return DavResponse(405);
+
+    const qint64 size = info.size();
+    qint64 first = 0;
+    qint64 last = size - 1;
+    DavResponse response;
+
+    // Single ranges are enough for resuming downloads
+    const QByteArray range = request.header("Range");
+    if (range.startsWith("bytes=") && !range.contains(',')) {
+        const QList<QByteArray> bounds = range.mid(6).split('-');
+        if (bounds.size() == 2) {
+            if (bounds[0].isEmpty()) {
+                first = qMax<qint64>(0, size - bounds[1].toLongLong());
+            } else {
+                first = bounds[0].toLongLong();
+                if (!bounds[1].isEmpty())
+                    last = qMin(last, bounds[1].toLongLong());
+            }
+            if (first >= size || first > last) {
+                DavResponse unsatisfiable(416);
+                unsatisfiable.setHeader("Content-Range", "bytes */" + QByteArray::number(size));
+                return unsatisfiable;
+            }
+            response.status = 206;
+            response.setHeader("Content-Range", "bytes " + QByteArray::number(first) + '-'
+                    + QByteArray::number(last) + '/' + QByteArray::number(size));
+        }
+    }
+
+    addFileHeaders(response, localPath);
+    response.setHeader("Content-Type", "application/octet-stream");
+    response.setHeader("Last-Modified", httpDate(info.lastModified()).toLatin1());
+    response.setHeader("Accept-Ranges", "bytes");
+    response.bodyFile = localPath;
+    response.bodyOffset = first;
+    response.bodyLength = last - first + 1;
+    response.headOnly = request.method == "HEAD";
+    return response;
+}
+
+DavResponse DavServer::put(const DavRequest &request, const QString &localPath)
+{
+    QFileInfo info(localPath);
+    if (info.isDir())
+        return DavResponse(405);
+    if (!QFileInfo(info.absolutePath()).isDir())
+        return DavResponse(409);
+    if (!checkIfMatch(request, localPath))
+        return DavResponse(412);
+
+    const bool existed = info.exists();
+    if (!storeBody(request, localPath))
+        return DavResponse(507);
+
+    DavResponse response(existed ? 204 : 201);
+    const QByteArray mtime = request.header("X-OC-Mtime");
+    if (!mtime.isEmpty()) {
+        OCC::FileSystem::setModTime(localPath, mtime.toLongLong());
+        response.setHeader("X-OC-MTime", "accepted");
+    }
+    changed(localPath);
+    addFileHeaders(response, localPath);
+    return response;
+}
+
+DavResponse DavServer::mkcol(const QString &localPath)
+{
+    QFileInfo info(localPath);
+    if (info.exists())
+        return DavResponse(405);
+    if (!QFileInfo(info.absolutePath()).isDir())
+        return DavResponse(409);
+    if (!QDir().mkdir(localPath))
+        return DavResponse(507);
+
+    changed(localPath);
+    DavResponse response(201);
+    response.setHeader("OC-FileId", fileId(localPath));
+    return response;
+}
+
+DavResponse DavServer::move(const DavRequest &request, const QString &localPath)
+{
+    if (!QFileInfo::exists(localPath))
+        return DavResponse(404);
+    if (localPath == _root)
+        return DavResponse(403);
+
+    QString destination;
+    if (area(destinationPath(request), &destination) != FilesArea)
+        return DavResponse(400);
+    if (destination == localPath || destination.startsWith(localPath + QLatin1Char('/')))
+        return DavResponse(403);
+    QFileInfo target(destination);
+    if (!QFileInfo(target.absolutePath()).isDir())
+        return DavResponse(409);
+
+    const bool existed = target.exists();
+    if (existed) {
+        if (request.header("Overwrite") == "F")
+            return DavResponse(412);
+        if (!removePath(destination))
+            return DavResponse(500);
+        forget(destination);
+    }
+    if (!QDir().rename(localPath, destination))
+        return DavResponse(500);
+
+    // The moved item keeps its etag and id, its old and new parents change
+    moved(localPath, destination);
+    changed(QFileInfo(localPath).absolutePath());
+    changed(target.absolutePath());
+
+    DavResponse response(existed ? 204 : 201);
+    addFileHeaders(response, destination);
+    return response;
+}
+
+DavResponse DavServer::copy(const DavRequest &request, const QString &localPath)
+{
+    QFileInfo info(localPath);
+    if (!info.exists())
+        return DavResponse(404);
+    if (info.isDir())
+        return DavResponse(501); // the client only copies files
+    // Conditions apply to the source
+    if (!checkIfMatch(request, localPath))
+        return DavResponse(412);
+
+    QString destination;
+    if (area(destinationPath(request), &destination) != FilesArea)
+        return DavResponse(400);
+    if (destination == localPath)
+        return DavResponse(403);
+    QFileInfo target(destination);
+    if (!QFileInfo(target.absolutePath()).isDir())
+        return DavResponse(409);
+
+    const bool existed = target.exists();
+    if (existed) {
+        if (request.header("Overwrite") == "F")
+            return DavResponse(412);
+        if (!removePath(destination))
+            return DavResponse(500);
+        forget(destination);
+    }
+    if (!QFile::copy(localPath, destination))
+        return DavResponse(500);
+    OCC::FileSystem::setModTime(destination, OCC::FileSystem::getModTime(localPath));
+    changed(destination);
+
+    DavResponse response(existed ? 204 : 201);
+    addFileHeaders(response, destination);
+    return response;
+}
+
+DavResponse DavServer::proppatch(const DavRequest &request, const QString &localPath)
+{
+    QFileInfo info(localPath);
+    if (!info.exists())
+        return DavResponse(404);
+
+    // Only d:lastmodified can be set, like the client does after a COPY
+    bool modTimeSet = false;
+    QXmlStreamReader reader(request.body);
+    while (!reader.atEnd()) {
+        if (reader.readNext() == QXmlStreamReader::StartElement
+            && reader.namespaceUri() == davNamespace && reader.name() == QLatin1String("lastmodified")) {
+            bool ok = false;
+            const qint64 modTime = reader.readElementText().toLongLong(&ok);
+            if (!ok || !OCC::FileSystem::setModTime(localPath, modTime))
+                return DavResponse(400);
+            modTimeSet = true;
+        }
+    }
+    if (reader.hasError())
+        return DavResponse(400);
+    if (modTimeSet)
+        changed(localPath);
+
+    QByteArray body;
+    QXmlStreamWriter xml(&body);
+    xml.writeStartDocument();
+    xml.writeNamespace(davNamespace, QStringLiteral("d"));
+    xml.writeStartElement(davNamespace, QStringLiteral("multistatus"));
+    xml.writeStartElement(davNamespace, QStringLiteral("response"));
+    xml.writeTextElement(davNamespace, QStringLiteral("href"), QString::fromLatin1(QUrl::toPercentEncoding(request.path, "/")));
+    xml.writeStartElement(davNamespace, QStringLiteral("propstat"));
+    xml.writeStartElement(davNamespace, QStringLiteral("prop"));
+    if (modTimeSet)
+        xml.writeEmptyElement(davNamespace, QStringLiteral("lastmodified"));
+    xml.writeEndElement(); // prop
+    xml.writeTextElement(davNamespace, QStringLiteral("status"), QStringLiteral("HTTP/1.1 200 OK"));
+    xml.writeEndElement(); // propstat
+    xml.writeEndElement(); // response
+    xml.writeEndElement(); // multistatus
+    xml.writeEndDocument();
+
+    DavResponse response(207);
+    response.setHeader("Content-Type", "application/xml; charset=utf-8");
+    response.body = body;
+    return response;
+}
+
+DavResponse DavServer::remove(const QString &localPath)
+{
+    QFileInfo info(localPath);
+    if (!info.exists())
+        return DavResponse(404);
+    if (localPath == _root || localPath == _uploadRoot)
+        return DavResponse(403);
+    if (!removePath(localPath))
+        return DavResponse(500);
+
+    forget(localPath);
+    changed(info.absolutePath());
+    return DavResponse(204);
+}
+
+DavResponse DavServer::assembleChunks(const DavRequest &request, const QString &uploadPath)
+{
+    QDir uploadDir(uploadPath);
+    if (!uploadDir.exists())
+        return DavResponse(404);
+
+    QString destination;
+    if (area(destinationPath(request), &destination) != FilesArea)
+        return DavResponse(400);
+    QFileInfo target(destination);
+    if (target.isDir())
+        return DavResponse(405);
+    if (!QFileInfo(target.absolutePath()).isDir())
+        return DavResponse(409);
+
+    // The client sends If: <destination> (["etag"]) instead of If-Match
+    static const QRegularExpression ifEtag(QStringLiteral("\\(\\[(\"[^\"]*\")\\]\\)"));
+    const auto match = ifEtag.match(QString::fromUtf8(request.header("If")));
+    if (match.hasMatch()
+        && (!target.exists() || match.captured(1).toLatin1() != QByteArray('"' + etag(target) + '"'))) {
+        return DavResponse(412);
+    }
+
+    // Chunks are named so that they sort in the right order
+    const QString assembled = destination + QLatin1String(".~davserver");
+    QFile out(assembled);
+    if (!out.open(QIODevice::WriteOnly))
+        return DavResponse(507);
+    for (const auto &chunk : uploadDir.entryList(QDir::Files, QDir::Name)) {
+        QFile in(uploadDir.filePath(chunk));
+        if (!in.open(QIODevice::ReadOnly)) {
+            out.remove();
+            return DavResponse(500);
+        }
+        while (!in.atEnd()) {
+            const QByteArray data = in.read(1024 * 1024);
+            if (out.write(data) != data.size()) {
+                out.remove();
+                return DavResponse(507);
+            }
+        }
+    }
+    out.close();
+
+    const QByteArray totalLength = request.header("OC-Total-Length");
+    if (!totalLength.isEmpty() && totalLength.toLongLong() != out.size()) {
+        out.remove();
+        return DavResponse(400);
+    }
+
+    const bool existed = target.exists();
+    if ((existed && !QFile::remove(destination)) || !QFile::rename(assembled, destination)) {
+        QFile::remove(assembled);
+        return DavResponse(500);
+    }
+    uploadDir.removeRecursively();
+    forget(uploadPath);
+
+    DavResponse response(existed ? 204 : 201);
+    const QByteArray mtime = request.header("X-OC-Mtime");
+    if (!mtime.isEmpty()) {
+        OCC::FileSystem::setModTime(destination, mtime.toLongLong());
+        response.setHeader("X-OC-MTime", "accepted");
+    }
+    changed(destination);
+    addFileHeaders(response, destination);
+    return response;
+}
+
+DavResponse DavServer::status() const
+{
+    QJsonObject status;
+    status.insert("installed", true);
+    status.insert("maintenance", false);
+    status.insert("needsDbUpgrade", false);
+    status.insert("version", "10.0.0.0");
+    status.insert("versionstring", "10.0.0");
+    status.insert("edition", "Community");
+    status.insert("productname", "ownCloud");
+    return jsonResponse(status);
+}
+
+DavResponse DavServer::capabilities() const
+{
+    QJsonObject core;
+    core.insert("pollinterval", 60);
+    core.insert("webdav-root", "remote.php/webdav");
+    QJsonObject dav;
+    dav.insert("chunking", "1.0");
+    QJsonObject capabilities;
+    capabilities.insert("core", core);
+    capabilities.insert("dav", dav);
+
+    QJsonObject version;
+    version.insert("major", 10);
+    version.insert("minor", 0);
+    version.insert("micro", 0);
+    version.insert("string", "10.0.0");
+    version.insert("edition", "Community");
+
+    QJsonObject data;
+    data.insert("version", version);
+    data.insert("capabilities", capabilities);
+    return jsonResponse(ocs(data));
+}
+
+DavResponse DavServer::userInfo() const
+{
+    const QString user = _options.user.isEmpty() ? QStringLiteral("admin") : _options.user;
+    QJsonObject data;
+    data.insert("id", user);
+    data.insert("display-name", user);
+    data.insert("email", QString());
+    return jsonResponse(ocs(data));
+}
+
+DavServer::Area DavServer::area(const QString &path, QString *localPath) const
+{
+    static const QString remotePhp = QStringLiteral("/remote.php/");
+    const int index = path.indexOf(remotePhp);
+    if (index < 0)
+        return NoArea;
+    const QString rest = path.mid(index + remotePhp.size());
+
+    Area result = NoArea;
+    QString base;
+    QString relative;
+    auto skipUser = [](const QString &s) {
+        const int slash = s.indexOf(QLatin1Char('/'));
+        return slash < 0 ? QString() : s.mid(slash);
+    };
+    if (rest == QLatin1String("webdav") || rest.startsWith(QLatin1String("webdav/"))) {
+        result = FilesArea;
+        base = _root;
+        relative = rest.mid(6);
+    } else if (rest.startsWith(QLatin1String("dav/files/"))) {
+        result = FilesArea;
+        base = _root;
+        relative = skipUser(rest.mid(10));
+    } else if (rest.startsWith(QLatin1String("dav/uploads/"))) {
+        result = UploadsArea;
+        base = _uploadRoot;
+        relative = skipUser(rest.mid(12));
+    } else {
+        return NoArea;
+    }
+
+    // No way out of the served directory
+    const QStringList parts = relative.split(QLatin1Char('/'), QString::SkipEmptyParts);
+    if (parts.contains(QStringLiteral("..")) || parts.contains(QStringLiteral(".")))
+        return NoArea;
+    *localPath = parts.isEmpty() ? base : base + QLatin1Char('/') + parts.join(QLatin1Char('/'));
+    return result;
+}
+
+bool DavServer::checkAuth(const DavRequest &request) const
+{
+    if (_options.user.isEmpty())
+        return true;
+    const QByteArray authorization = request.header("Authorization");
+    if (!authorization.startsWith("Basic "))
+        return false;
+    return QByteArray::fromBase64(authorization.mid(6)) == (_options.user + QLatin1Char(':') + _options.password).toUtf8();
+}
+
+bool DavServer::checkIfMatch(const DavRequest &request, const QString &localPath)
+{
+    const QByteArray ifMatch = request.header("If-Match");
+    if (ifMatch.isEmpty() || ifMatch == "*")
+        return true;
+    QFileInfo info(localPath);
+    return info.exists() && ifMatch == QByteArray('"' + etag(info) + '"');
+}
+
+void DavServer::addFileHeaders(DavResponse &response, const QString &localPath)
+{
+    const QByteArray quotedEtag = '"' + etag(QFileInfo(localPath)) + '"';
+    response.setHeader("ETag", quotedEtag);
+    response.setHeader("OC-ETag", quotedEtag);
+    response.setHeader("OC-FileId", fileId(localPath));
+}
+
+QByteArray DavServer::etag(const QFileInfo &info)
+{
+    const QString path = info.absoluteFilePath();
+    auto it = _etags.constFind(path);
+    if (info.isDir()) {
+        if (it == _etags.constEnd())
+            it = _etags.insert(path, newEtag());
+        return *it;
+    }
+    // Files also change etag when they are modified behind the server's back
+    QByteArray result = QByteArray::number(info.lastModified().toMSecsSinceEpoch(), 16)
+        + '-' + QByteArray::number(info.size(), 16);
+    if (it != _etags.constEnd())
+        result += '-' + *it;
+    return result;
+}
+
+QByteArray DavServer::fileId(const QString &localPath)
+{
+    auto it = _fileIds.constFind(localPath);
+    if (it == _fileIds.constEnd())
+        it = _fileIds.insert(localPath, _nextFileId++);
+    // Like the server: the numeric id, then the instance id
+    return QByteArray::number(*it).rightJustified(8, '0') + "ocdavsrv";
+}
+
+QByteArray DavServer::newEtag()
+{
+    return _instanceTag + QByteArray::number(++_changeCounter, 16);
+}
+
+void DavServer::changed(const QString &localPath)
+{
+    QString path = localPath;
+    while (true) {
+        _etags.insert(path, newEtag());
+        if (path == _root || path == _uploadRoot)
+            break;
+        const int slash = path.lastIndexOf(QLatin1Char('/'));
+        if (slash <= 0)
+            break;
+        path.truncate(slash);
+    }
+}
+
+void DavServer::moved(const QString &from, const QString &to)
+{
+    const QString prefix = from + QLatin1Char('/');
+    auto rename = [&](auto &hash) {
+        for (const auto &key : hash.keys()) {
+            if (key == from || key.startsWith(prefix))
+                hash.insert(to + key.mid(from.size()), hash.take(key));
+        }
+    };
+    rename(_etags);
+    rename(_fileIds);
+}
+
+void DavServer::forget(const QString &localPath)
+{
+    const QString prefix = localPath + QLatin1Char('/');
+    auto remove = [&](auto &hash) {
+        for (auto it = hash.begin(); it != hash.end();) {
+            if (it.key() == localPath || it.key().startsWith(prefix))
+                it = hash.erase(it);
+            else
+                ++it;
+        }
+    };
+    remove(_etags);
+    remove(_fileIds);
+}
+
+DavConnection::DavConnection(DavServer *server, QTcpSocket *socket)
+    : QObject(socket)
+    , _server(server)
+    , _socket(socket)
+{
+    connect(socket, &QTcpSocket::readyRead, this, &DavConnection::processInput);
+    connect(socket, &QTcpSocket::bytesWritten, this, &DavConnection::writeBody);
+    connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+
+    if (server->options().bytesPerSecond > 0) {
+        // What is not read stays in the kernel, so the client has to wait
+        socket->setReadBufferSize(64 * 1024);
+        _throttleTimer.setInterval(throttleIntervalMs);
+        connect(&_throttleTimer, &QTimer::timeout, this, &DavConnection::refillBudget);
+        _throttleTimer.start();
+        refillBudget();
+    }
+}
+
+void DavConnection::refillBudget()
+{
+    const qint64 slice = _server->options().bytesPerSecond * throttleIntervalMs / 1000;
+    _readBudget = slice;
+    _writeBudget = slice;
+    if (_state == ReadingHeaders || _state == ReadingBody)
+        processInput();
+    else if (_state == Writing)
+        writeBody();
+}
+
+void DavConnection::processInput()
+{
+    if (_state == ReadingHeaders) {
+        _input += _socket->readAll();
+        const int end = _input.indexOf("\r\n\r\n");
+        if (end < 0) {
+            if (_input.size() > maxHeaderSize) {
+                _closeAfterResponse = true;
+                send(DavResponse(431));
+            }
+            return;
+        }
+        const QByteArray headers = _input.left(end);
+        _input.remove(0, end + 4);
+        if (!parseHeaders(headers)) {
+            _closeAfterResponse = true;
+            send(DavResponse(400));
+            return;
+        }
+        _state = ReadingBody;
+    }
+    if (_state == ReadingBody)
+        readBody();
+}
+
+bool DavConnection::parseHeaders(const QByteArray &headers)
+{
+    _request = DavRequest();
+    _bodyError = false;
+
+    const QList<QByteArray> lines = headers.split('\n');
+    const QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+    if (requestLine.size() != 3)
+        return false;
+    _request.method = requestLine[0];
+    _request.target = requestLine[1];
+    _request.version = requestLine[2];
+    for (int i = 1; i < lines.size(); ++i) {
+        const QByteArray &line = lines[i];
+        const int colon = line.indexOf(':');
+        if (colon <= 0)
+            continue;
+        _request.headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+    }
+
+    QByteArray path = _request.target;
+    const int query = path.indexOf('?');
+    if (query >= 0)
+        path.truncate(query);
+    _request.path = QString::fromUtf8(QByteArray::fromPercentEncoding(path));
+    _closeAfterResponse = _request.version == "HTTP/1.0" || _request.header("Connection").toLower() == "close";
+
+    // QNAM always sends a Content-Length, chunked request bodies are not supported
+    if (!_request.header("Transfer-Encoding").isEmpty())
+        return false;
+    _bodyRemaining = _request.header("Content-Length").toLongLong();
+    _request.bodySize = _bodyRemaining;
+    if (_bodyRemaining > memoryBodyLimit) {
+        _request.bodyFile.reset(new QTemporaryFile(_server->spoolDir() + QLatin1String("/.spool-XXXXXX")));
+        if (!_request.bodyFile->open())
+            return false;
+    }
+    return true;
+}
+
+void DavConnection::readBody()
+{
+    while (_bodyRemaining > 0) {
+        QByteArray data;
+        if (!_input.isEmpty()) {
+            data = _input.left(_bodyRemaining);
+            _input.remove(0, data.size());
+        } else {
+            qint64 max = _bodyRemaining;
+            if (isThrottled())
+                max = qMin(max, _readBudget);
+            if (max <= 0)
+                return;
+            data = _socket->read(max);
+            if (data.isEmpty())
+                return;
+            if (isThrottled())
+                _readBudget -= data.size();
+        }
+        _bodyRemaining -= data.size();
+        if (_request.bodyFile) {
+            if (_request.bodyFile->write(data) != data.size())
+                _bodyError = true;
+        } else {
+            _request.body += data;
+        }
+    }
+
+    _state = Handling;
+    const int latency = _server->options().latencyMs;
+    if (latency > 0) {
+        QTimer::singleShot(latency, this, &DavConnection::dispatch);
+    } else {
+        dispatch();
+    }
+}
+
+void DavConnection::dispatch()
+{
+    const DavResponse response = _bodyError ? DavResponse(507) : _server->handle(_request);
+    qCDebug(lcDavServer) << _request.method << _request.path << response.status;
+    _request = DavRequest();
+    send(response);
+}
+
+void DavConnection::send(const DavResponse &response)
+{
+    qint64 length = 0;
+    if (!response.bodyFile.isEmpty()) {
+        QScopedPointer<QFile> file(new QFile(response.bodyFile));
+        if (!file->open(QIODevice::ReadOnly) || !file->seek(response.bodyOffset)) {
+            send(DavResponse(500));
+            return;
+        }
+        _responseBody.reset(file.take());
+        length = response.bodyLength;
+    } else {
+        auto buffer = new QBuffer;
+        buffer->setData(response.body);
+        buffer->open(QIODevice::ReadOnly);
+        _responseBody.reset(buffer);
+        length = response.body.size();
+    }
+
+    QByteArray head = "HTTP/1.1 " + QByteArray::number(response.status) + ' ' + reasonPhrase(response.status) + "\r\n";
+    for (const auto &header : response.headers)
+        head += header.first + ": " + header.second + "\r\n";
+    head += "Content-Length: " + QByteArray::number(length) + "\r\n";
+    if (_closeAfterResponse)
+        head += "Connection: close\r\n";
+    head += "\r\n";
+
+    _state = Writing;
+    _socket->write(head);
+    _responseRemaining = response.headOnly ? 0 : length;
+    writeBody();
+}
+
+void DavConnection::writeBody()
+{
+    if (_state != Writing)
+        return;
+    bool truncated = false;
+    while (_responseRemaining > 0 && _socket->bytesToWrite() < socketBufferLimit) {
+        qint64 max = qMin(_responseRemaining, writeBlockSize);
+        if (isThrottled())
+            max = qMin(max, _writeBudget);
+        if (max <= 0)
+            return;
+        const QByteArray data = _responseBody->read(max);
+        if (data.isEmpty()) {
+            // The file got shorter, the client will see a broken response
+            _closeAfterResponse = true;
+            truncated = true;
+            break;
+        }
+        _socket->write(data);
+        _responseRemaining -= data.size();
+        if (isThrottled())
+            _writeBudget -= data.size();
+    }
+    if (_responseRemaining <= 0 || truncated)
+        responseDone();
+}
+
+void DavConnection::responseDone()
+{
+    _responseBody.reset();
+    _responseRemaining = 0;
+    if (_closeAfterResponse) {
+        _state = Closing;
+        _socket->disconnectFromHost();
+        return;
+    }
+    _state = ReadingHeaders;
+    // The next request might already be buffered
+    QTimer::singleShot(0, this, &DavConnection::processInput);
+}
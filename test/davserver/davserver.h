@@ -0,0 +1,193 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#pragma once
+
+#include <QHash>
+#include <QIODevice>
+#include <QList>
+#include <QPair>
+#include <QRegularExpression>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QTcpServer>
+#include <QTemporaryDir>
+#include <QTemporaryFile>
+#include <QTimer>
+#include <QVector>
+
+class QFileInfo;
+class QTcpSocket;
+class QXmlStreamWriter;
+
+struct DavRequest
+{
+    QByteArray method;
+    QByteArray target; // as sent, percent encoded and with the query
+    QString path; // decoded, without the query
+    QByteArray version;
+    QHash<QByteArray, QByteArray> headers; // names in lower case
+
+    // Small bodies are kept in memory, bigger ones are spooled to disk
+    QByteArray body;
+    QSharedPointer<QTemporaryFile> bodyFile;
+    qint64 bodySize = 0;
+
+    QByteArray header(const QByteArray &name) const { return headers.value(name.toLower()); }
+};
+
+struct DavResponse
+{
+    DavResponse(int status = 200)
+        : status(status)
+    {
+    }
+
+    int status;
+    QList<QPair<QByteArray, QByteArray>> headers;
+    QByteArray body;
+    QString bodyFile; // streamed instead of body when set
+    qint64 bodyOffset = 0;
+    qint64 bodyLength = 0;
+    bool headOnly = false; // headers as for a GET but no body
+
+    void setHeader(const QByteArray &name, const QByteArray &value) { headers.append(qMakePair(name, value)); }
+};
+
+/**
+ * A WebDAV server that serves a local directory like an ownCloud server
+ * does for the client: PROPFIND with the oc: properties, GET with ranges,
+ * PUT, MKCOL, MOVE, COPY, DELETE, PROPPATCH of the modification time,
+ * chunked uploads (the "chunking 1.0" of remote.php/dav/uploads),
+ * status.php and the capabilities.
+ *
+ * Etags and file ids are kept in memory. Changes to the directory that do
+ * not go through the server are only noticed for files, through their
+ * modification time and size.
+ *
+ * It speaks HTTP/1.1 without TLS and is meant for local performance runs
+ * of owncloudcmd and the client, not for production use.
+ */
+class DavServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    struct Options
+    {
+        QString root;
+        QString uploadRoot; // a temporary directory if empty
+        QString user; // with password, the only accepted credentials. Any are accepted if empty.
+        QString password;
+        int latencyMs = 0; // before a request is handled
+        qint64 bytesPerSecond = 0; // per connection and direction, 0 is unlimited
+        double errorRate = 0; // share of the requests that fail with 503
+        // "METHOD /path" matching the expression fails with the status code
+        QVector<QPair<QRegularExpression, int>> failures;
+    };
+
+    explicit DavServer(const Options &options, QObject *parent = 0);
+
+    const Options &options() const { return _options; }
+    QString spoolDir() const { return _uploadRoot; }
+
+    DavResponse handle(const DavRequest &request);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) Q_DECL_OVERRIDE;
+
+private:
+    enum Area {
+        NoArea,
+        FilesArea,
+        UploadsArea
+    };
+
+    DavResponse handleFiles(const DavRequest &request, const QString &localPath);
+    DavResponse handleUploads(const DavRequest &request, const QString &localPath);
+    DavResponse propfind(const DavRequest &request, const QString &localPath);
+    DavResponse get(const DavRequest &request, const QString &localPath);
+    DavResponse put(const DavRequest &request, const QString &localPath);
+    DavResponse mkcol(const QString &localPath);
+    DavResponse move(const DavRequest &request, const QString &localPath);
+    DavResponse copy(const DavRequest &request, const QString &localPath);
+    DavResponse proppatch(const DavRequest &request, const QString &localPath);
+    DavResponse remove(const QString &localPath);
+    DavResponse assembleChunks(const DavRequest &request, const QString &uploadPath);
+
+    DavResponse status() const;
+    DavResponse capabilities() const;
+    DavResponse userInfo() const;
+
+    Area area(const QString &path, QString *localPath) const;
+    bool checkAuth(const DavRequest &request) const;
+    bool checkIfMatch(const DavRequest &request, const QString &localPath);
+    void writeEntry(QXmlStreamWriter &xml, const QString &href, const QFileInfo &info, bool withSize);
+    void addFileHeaders(DavResponse &response, const QString &localPath);
+
+    QByteArray etag(const QFileInfo &info);
+    QByteArray fileId(const QString &localPath);
+    QByteArray newEtag();
+    void changed(const QString &localPath); // new etags for the path and its parents
+    void moved(const QString &from, const QString &to);
+    void forget(const QString &localPath);
+
+    Options _options;
+    QString _root;
+    QString _uploadRoot;
+    QTemporaryDir _uploadTempDir;
+    QHash<QString, QByteArray> _etags;
+    QHash<QString, qint64> _fileIds;
+    qint64 _nextFileId = 1;
+    qint64 _changeCounter = 0;
+    QByteArray _instanceTag;
+};
+
+/**
+ * One client connection, handles its requests one after the other
+ */
+class DavConnection : public QObject
+{
+    Q_OBJECT
+public:
+    DavConnection(DavServer *server, QTcpSocket *socket);
+
+private:
+    enum State {
+        ReadingHeaders,
+        ReadingBody,
+        Handling,
+        Writing,
+        Closing
+    };
+
+    void processInput();
+    bool parseHeaders(const QByteArray &headers);
+    void readBody();
+    void dispatch();
+    void send(const DavResponse &response);
+    void writeBody();
+    void responseDone();
+    void refillBudget();
+    bool isThrottled() const { return _throttleTimer.isActive(); }
+
+    DavServer *_server;
+    QTcpSocket *_socket;
+    State _state = ReadingHeaders;
+    QByteArray _input;
+    DavRequest _request;
+    qint64 _bodyRemaining = 0;
+    bool _bodyError = false;
+    bool _closeAfterResponse = false;
+
+    QScopedPointer<QIODevice> _responseBody;
+    qint64 _responseRemaining = 0;
+
+    // Throughput cap, the budget is refilled ten times a second
+    QTimer _throttleTimer;
+    qint64 _readBudget = 0;
+    qint64 _writeBudget = 0;
+};
@@ -0,0 +1,76 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include "davserver.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QLoggingCategory>
+
+#include <cstdio>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("davserver");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Serves a local directory like an ownCloud server, for performance runs of the client.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("root", "The directory to serve.");
+    QCommandLineOption listenOption("listen", "Address to listen on (default 127.0.0.1).", "address", "127.0.0.1");
+    QCommandLineOption portOption("port", "Port to listen on (default 8080).", "port", "8080");
+    QCommandLineOption uploadsOption("uploads", "Directory for chunked uploads (default: a temporary one).", "dir");
+    QCommandLineOption userOption("user", "Only accept this user.", "user");
+    QCommandLineOption passwordOption("password", "Password of --user.", "password");
+    QCommandLineOption latencyOption("latency", "Delay before each request is handled.", "ms", "0");
+    QCommandLineOption bandwidthOption("bandwidth", "Throughput cap per connection and direction, 0 is unlimited.", "bytes/s", "0");
+    QCommandLineOption errorRateOption("error-rate", "Share of the requests that fail with 503, between 0 and 1.", "rate", "0");
+    QCommandLineOption failOption("fail", "Requests whose \"METHOD /path\" matches the expression fail with the status code, can be repeated.", "regexp=status");
+    QCommandLineOption verboseOption("verbose", "Log every request.");
+    parser.addOptions({ listenOption, portOption, uploadsOption, userOption, passwordOption, latencyOption,
+        bandwidthOption, errorRateOption, failOption, verboseOption });
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    DavServer::Options options;
+    options.root = parser.positionalArguments().first();
+    options.uploadRoot = parser.value(uploadsOption);
+    options.user = parser.value(userOption);
+    options.password = parser.value(passwordOption);
+    options.latencyMs = parser.value(latencyOption).toInt();
+    options.bytesPerSecond = parser.value(bandwidthOption).toLongLong();
+    options.errorRate = parser.value(errorRateOption).toDouble();
+    for (const auto &failure : parser.values(failOption)) {
+        const int separator = failure.lastIndexOf('=');
+        QRegularExpression expression(failure.left(separator));
+        bool ok = false;
+        const int status = failure.mid(separator + 1).toInt(&ok);
+        if (separator <= 0 || !ok || !expression.isValid()) {
+            fprintf(stderr, "Invalid --fail %s\n", qPrintable(failure));
+            return 1;
+        }
+        options.failures.append(qMakePair(expression, status));
+    }
+    if (parser.isSet(verboseOption))
+        QLoggingCategory::setFilterRules("davserver.debug=true");
+    qsrand(QDateTime::currentMSecsSinceEpoch());
+
+    DavServer server(options);
+    const QHostAddress address(parser.value(listenOption));
+    if (!server.listen(address, parser.value(portOption).toUShort())) {
+        fprintf(stderr, "Could not listen: %s\n", qPrintable(server.errorString()));
+        return 1;
+    }
+    printf("Serving %s on http://%s:%d/remote.php/webdav/\n", qPrintable(options.root),
+        qPrintable(server.serverAddress().toString()), server.serverPort());
+    fflush(stdout);
+    return app.exec();
+}
@@ -13,11 +13,17 @@
 #include "syncengine.h"
 #include "common/syncjournaldb.h"
 
+#include <QBuffer>
 #include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QNetworkReply>
 #include <QMap>
+#include <QPointer>
 #include <QtTest>
 
+#include <cstring>
+
 /*
  * TODO: In theory we should use QVERIFY instead of Q_ASSERT for testing, but this
  * only works when directly called from a QTest :-(
@@ -27,6 +33,7 @@
 static const QUrl sRootUrl("owncloud://somehost/owncloud/remote.php/webdav/");
 static const QUrl sRootUrl2("owncloud://somehost/owncloud/remote.php/dav/files/admin/");
 static const QUrl sUploadUrl("owncloud://somehost/owncloud/remote.php/dav/uploads/admin/");
+static const QUrl sBulkUploadUrl("owncloud://somehost/owncloud/remote.php/dav/bulk");
 
 inline QString getFilePathFromUrl(const QUrl &url) {
     QString path = url.path();
@@ -368,6 +375,8 @@ public:
                 : fileInfo.isShared ? QStringLiteral("SRDNVCKW") : QStringLiteral("RDNVCKW"));
             xml.writeTextElement(ocUri, QStringLiteral("id"), fileInfo.fileId);
             xml.writeTextElement(ocUri, QStringLiteral("checksums"), fileInfo.checksums);
+            if (fileInfo.isDir)
+                xml.writeTextElement(ocUri, QStringLiteral("size"), QString::number(treeSize(fileInfo)));
             buffer.write(fileInfo.extraDavProperties);
             xml.writeEndElement(); // prop
             xml.writeTextElement(davUri, QStringLiteral("status"), "HTTP/1.1 200 OK");
@@ -384,6 +393,13 @@ public:
         QMetaObject::invokeMethod(this, "respond", Qt::QueuedConnection);
     }
 
+    static qint64 treeSize(const FileInfo &fileInfo) {
+        qint64 size = fileInfo.isDir ? 0 : fileInfo.size;
+        for (const auto &child : fileInfo.children)
+            size += treeSize(child);
+        return size;
+    }
+
     Q_INVOKABLE void respond() {
         setHeader(QNetworkRequest::ContentLengthHeader, payload.size());
         setHeader(QNetworkRequest::ContentTypeHeader, "application/xml; charset=utf-8");
@@ -464,6 +480,101 @@ public:
     qint64 readData(char *, qint64) override { return 0; }
 };
 
+class FakeBulkUploadReply : public QNetworkReply
+{
+    Q_OBJECT
+public:
+    FakeBulkUploadReply(FileInfo &remoteRootFileInfo, const QHash<QString, int> &errorPaths, QNetworkAccessManager::Operation op,
+        const QNetworkRequest &request, const QByteArray &body, QObject *parent)
+        : QNetworkReply{ parent }
+    {
+        setRequest(request);
+        setUrl(request.url());
+        setOperation(op);
+        open(QIODevice::ReadOnly);
+
+        const QByteArray contentType = request.header(QNetworkRequest::ContentTypeHeader).toByteArray();
+        const int boundaryPos = contentType.indexOf("boundary=");
+        Q_ASSERT(boundaryPos != -1);
+        const QByteArray delimiter = "--" + contentType.mid(boundaryPos + 9) + "\r\n";
+
+        QJsonObject result;
+        int pos = body.indexOf(delimiter);
+        while (pos != -1) {
+            pos += delimiter.size();
+            QMap<QByteArray, QByteArray> headers;
+            while (true) {
+                const int end = body.indexOf("\r\n", pos);
+                Q_ASSERT(end != -1);
+                const QByteArray line = body.mid(pos, end - pos);
+                pos = end + 2;
+                if (line.isEmpty())
+                    break;
+                const int colon = line.indexOf(':');
+                headers[line.left(colon).toLower()] = line.mid(colon + 1).trimmed();
+            }
+            const QByteArray data = body.mid(pos, headers["content-length"].toInt());
+            pos += data.size() + 2;
+
+            const QString path = QString::fromUtf8(headers["x-file-path"]);
+            const QString fileName = path.mid(1);
+            QJsonObject fileResult;
+            if (errorPaths.contains(fileName)) {
+                fileResult[QStringLiteral("error")] = true;
+                fileResult[QStringLiteral("message")] = QStringLiteral("Fake error");
+            } else {
+                FileInfo *fileInfo = remoteRootFileInfo.find(fileName);
+                if (fileInfo) {
+                    fileInfo->size = data.size();
+                    fileInfo->contentChar = data.at(0);
+                } else {
+                    fileInfo = remoteRootFileInfo.create(fileName, data.size(), data.at(0));
+                }
+                fileInfo->lastModified = OCC::Utility::qDateTimeFromTime_t(headers["x-file-mtime"].toLongLong());
+                remoteRootFileInfo.find(fileName, /*invalidate_etags=*/true);
+                fileResult[QStringLiteral("error")] = false;
+                fileResult[QStringLiteral("etag")] = fileInfo->etag;
+                fileResult[QStringLiteral("fileid")] = QString::fromUtf8(fileInfo->fileId);
+            }
+            result[path] = fileResult;
+
+            // The last part is followed by the closing delimiter
+            if (body.mid(pos, delimiter.size()) != delimiter)
+                break;
+        }
+        _body = QJsonDocument(result).toJson();
+        QMetaObject::invokeMethod(this, "respond", Qt::QueuedConnection);
+    }
+
+    Q_INVOKABLE virtual void respond()
+    {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 200);
+        emit metaDataChanged();
+        emit readyRead();
+        setFinished(true);
+        emit finished();
+    }
+
+    void abort() override
+    {
+        setError(OperationCanceledError, "abort");
+        emit finished();
+    }
+    qint64 readData(char *buf, qint64 max) override
+    {
+        max = qMin<qint64>(max, _body.size());
+        memcpy(buf, _body.constData(), max);
+        _body = _body.mid(max);
+        return max;
+    }
+    qint64 bytesAvailable() const override
+    {
+        return _body.size() + QIODevice::bytesAvailable();
+    }
+
+    QByteArray _body;
+};
+
 class FakeMkcolReply : public QNetworkReply
 {
     Q_OBJECT
@@ -554,6 +665,83 @@ public:
     qint64 readData(char *, qint64) override { return 0; }
 };
 
+class FakeCopyReply : public QNetworkReply
+{
+    Q_OBJECT
+    int _status = 201;
+public:
+    FakeCopyReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QObject *parent)
+    : QNetworkReply{parent} {
+        setRequest(request);
+        setUrl(request.url());
+        setOperation(op);
+        open(QIODevice::ReadOnly);
+
+        QString fileName = getFilePathFromUrl(request.url());
+        Q_ASSERT(!fileName.isEmpty());
+        QString dest = getFilePathFromUrl(QUrl::fromEncoded(request.rawHeader("Destination")));
+        Q_ASSERT(!dest.isEmpty());
+        const FileInfo *source = remoteRootFileInfo.find(fileName);
+        const QByteArray ifMatch = request.rawHeader("If-Match");
+        if (!source || source->isDir) {
+            _status = 404;
+        } else if ((!ifMatch.isEmpty() && ifMatch != '"' + source->etag.toUtf8() + '"')
+            || (request.rawHeader("Overwrite") == "F" && remoteRootFileInfo.find(dest))) {
+            _status = 412;
+        } else {
+            FileInfo copy = *source;
+            FileInfo *file = remoteRootFileInfo.create(dest, copy.size, copy.contentChar);
+            file->lastModified = copy.lastModified;
+            file->checksums = copy.checksums;
+        }
+        QMetaObject::invokeMethod(this, "respond", Qt::QueuedConnection);
+    }
+
+    Q_INVOKABLE void respond() {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, _status);
+        if (_status >= 400)
+            setError(_status == 404 ? ContentNotFoundError : InternalServerError, "Copy failed");
+        emit metaDataChanged();
+        emit finished();
+    }
+
+    void abort() override { }
+    qint64 readData(char *, qint64) override { return 0; }
+};
+
+// Only supports setting d:lastmodified
+class FakeProppatchReply : public QNetworkReply
+{
+    Q_OBJECT
+public:
+    FakeProppatchReply(FileInfo &remoteRootFileInfo, QNetworkAccessManager::Operation op, const QNetworkRequest &request, const QByteArray &payload, QObject *parent)
+    : QNetworkReply{parent} {
+        setRequest(request);
+        setUrl(request.url());
+        setOperation(op);
+        open(QIODevice::ReadOnly);
+
+        QString fileName = getFilePathFromUrl(request.url());
+        QXmlStreamReader reader(payload);
+        while (!reader.atEnd()) {
+            if (reader.readNext() == QXmlStreamReader::StartElement && reader.name() == QLatin1String("lastmodified")) {
+                const auto modTime = reader.readElementText().toLongLong();
+                remoteRootFileInfo.setModTime(fileName, OCC::Utility::qDateTimeFromTime_t(modTime));
+            }
+        }
+        QMetaObject::invokeMethod(this, "respond", Qt::QueuedConnection);
+    }
+
+    Q_INVOKABLE void respond() {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 207);
+        emit metaDataChanged();
+        emit finished();
+    }
+
+    void abort() override { }
+    qint64 readData(char *, qint64) override { return 0; }
+};
+
 class FakeGetReply : public QNetworkReply
 {
     Q_OBJECT
@@ -806,11 +994,29 @@ public:
     }
 };
 
+class FakeShapedReply;
+
 class FakeQNAM : public QNetworkAccessManager
 {
 public:
     using Override = std::function<QNetworkReply *(Operation, const QNetworkRequest &, QIODevice *)>;
 
+    // Simulated network between the client and the fake server, see setNetworkShape()
+    struct NetworkShape
+    {
+        int latencyMs = 0; // before the server sees a request
+        qint64 bytesPerSecond = 0; // per connection and direction, 0 is unlimited
+        int maxConnections = 0; // further requests wait for a free connection, 0 is unlimited
+    };
+
+    struct NetworkStats
+    {
+        int requests = 0;
+        qint64 bytesSent = 0;
+        qint64 bytesReceived = 0;
+        int peakConnections = 0;
+    };
+
 private:
     FileInfo _remoteRootFileInfo;
     FileInfo _uploadFileInfo;
@@ -819,6 +1025,12 @@ private:
     // monitor requests and optionally provide custom replies
     Override _override;
 
+    bool _shaped = false;
+    NetworkShape _shape;
+    NetworkStats _stats;
+    int _activeConnections = 0;
+    QList<QPointer<FakeShapedReply>> _queuedReplies;
+
 public:
     FakeQNAM(FileInfo initialRoot) : _remoteRootFileInfo{std::move(initialRoot)} { }
     FileInfo &currentRemoteState() { return _remoteRootFileInfo; }
@@ -828,13 +1040,26 @@ public:
 
     void setOverride(const Override &override) { _override = override; }
 
-protected:
-    QNetworkReply *createRequest(Operation op, const QNetworkRequest &request,
-                                         QIODevice *outgoingData = 0) {
+    /**
+     * From now on, replies are delayed according to shape and counted in networkStats().
+     * Without a shape, the replies come in the next event loop iteration.
+     */
+    void setNetworkShape(const NetworkShape &shape) { _shape = shape; _shaped = true; }
+    const NetworkShape &networkShape() const { return _shape; }
+    NetworkStats &networkStats() { return _stats; }
+
+    // For FakeShapedReply
+    void queueShapedReply(FakeShapedReply *reply);
+    void releaseConnection();
+
+    QNetworkReply *createFakeReply(Operation op, const QNetworkRequest &request, QIODevice *outgoingData)
+    {
         if (_override) {
             if (auto reply = _override(op, request, outgoingData))
                 return reply;
         }
+        if (request.url().path() == sBulkUploadUrl.path())
+            return new FakeBulkUploadReply{ _remoteRootFileInfo, _errorPaths, op, request, outgoingData->readAll(), this };
         const QString fileName = getFilePathFromUrl(request.url());
         Q_ASSERT(!fileName.isNull());
         if (_errorPaths.contains(fileName))
@@ -859,13 +1084,195 @@ protected:
             return new FakeMoveReply{info, op, request, this};
         else if (verb == QLatin1String("MOVE") && isUpload)
             return new FakeChunkMoveReply{ info, _remoteRootFileInfo, op, request, this };
+        else if (verb == QLatin1String("COPY"))
+            return new FakeCopyReply{info, op, request, this};
+        else if (verb == QLatin1String("PROPPATCH"))
+            return new FakeProppatchReply{info, op, request, outgoingData->readAll(), this};
         else {
             qDebug() << verb << outgoingData;
             Q_UNREACHABLE();
         }
     }
+
+protected:
+    QNetworkReply *createRequest(Operation op, const QNetworkRequest &request,
+                                         QIODevice *outgoingData = 0);
+
+private:
+    void startQueuedReplies();
+};
+
+// Wraps a fake reply to simulate latency, bandwidth and a limited number of connections
+class FakeShapedReply : public QNetworkReply
+{
+    Q_OBJECT
+public:
+    enum State {
+        Queued, // waiting for a connection
+        Sending, // latency and request body
+        Processing, // the fake server reply runs
+        Receiving, // response body
+        Done
+    };
+
+    FakeShapedReply(FakeQNAM *qnam, QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *outgoingData)
+        : QNetworkReply{qnam}
+        , _qnam{qnam}
+    {
+        setRequest(request);
+        setUrl(request.url());
+        setOperation(op);
+        open(QIODevice::ReadOnly);
+
+        if (outgoingData) {
+            _outgoing = new QBuffer(this);
+            _outgoing->setData(outgoingData->readAll());
+            _outgoing->open(QIODevice::ReadOnly);
+            qnam->networkStats().bytesSent += _outgoing->size();
+        }
+
+        _timer.setSingleShot(true);
+        connect(&_timer, &QTimer::timeout, this, &FakeShapedReply::advance);
+        qnam->queueShapedReply(this);
+    }
+
+    ~FakeShapedReply()
+    {
+        if (_qnam && holdsConnection())
+            _qnam->releaseConnection();
+    }
+
+    State state() const { return _state; }
+
+    void start()
+    {
+        Q_ASSERT(_state == Queued);
+        _state = Sending;
+        _timer.start(_qnam->networkShape().latencyMs + transferTime(_outgoing ? _outgoing->size() : 0));
+    }
+
+    void abort() override
+    {
+        if (_state == Done)
+            return;
+        _timer.stop();
+        if (_inner) {
+            disconnect(_inner, nullptr, this, nullptr);
+            _inner->abort();
+        }
+        finish();
+        setError(OperationCanceledError, "Operation canceled");
+        emit error(OperationCanceledError);
+        setFinished(true);
+        emit finished();
+    }
+
+    qint64 bytesAvailable() const override { return _body.size() + QIODevice::bytesAvailable(); }
+    qint64 readData(char *data, qint64 maxlen) override
+    {
+        qint64 len = std::min(qint64{ _body.size() }, maxlen);
+        std::memcpy(data, _body.constData(), len);
+        _body.remove(0, len);
+        return len;
+    }
+
+private:
+    bool holdsConnection() const { return _state == Sending || _state == Processing || _state == Receiving; }
+
+    int transferTime(qint64 bytes) const
+    {
+        const qint64 bytesPerSecond = _qnam->networkShape().bytesPerSecond;
+        return bytesPerSecond > 0 ? int(bytes * 1000 / bytesPerSecond) : 0;
+    }
+
+    void advance()
+    {
+        if (_state == Sending) {
+            _state = Processing;
+            _inner = _qnam->createFakeReply(operation(), request(), _outgoing);
+            _inner->setParent(this);
+            connect(_inner, &QNetworkReply::finished, this, &FakeShapedReply::innerFinished);
+        } else if (_state == Receiving) {
+            finish();
+            emit metaDataChanged();
+            if (bytesAvailable())
+                emit readyRead();
+            if (error() != NoError)
+                emit error(error());
+            setFinished(true);
+            emit finished();
+        }
+    }
+
+    void innerFinished()
+    {
+        disconnect(_inner, nullptr, this, nullptr);
+        _body = _inner->readAll();
+        _qnam->networkStats().bytesReceived += _body.size();
+        for (const auto &header : _inner->rawHeaderPairs())
+            setRawHeader(header.first, header.second);
+        for (auto attribute : { QNetworkRequest::HttpStatusCodeAttribute,
+                 QNetworkRequest::HttpReasonPhraseAttribute,
+                 QNetworkRequest::RedirectionTargetAttribute }) {
+            setAttribute(attribute, _inner->attribute(attribute));
+        }
+        if (_inner->error() != NoError)
+            setError(_inner->error(), _inner->errorString());
+
+        _state = Receiving;
+        _timer.start(transferTime(_body.size()));
+    }
+
+    // Gives the connection back, before the owner of the reply gets to send the next request
+    void finish()
+    {
+        bool release = holdsConnection();
+        _state = Done;
+        if (release)
+            _qnam->releaseConnection();
+    }
+
+    QPointer<FakeQNAM> _qnam;
+    State _state = Queued;
+    QBuffer *_outgoing = nullptr;
+    QNetworkReply *_inner = nullptr;
+    QByteArray _body;
+    QTimer _timer;
 };
 
+inline QNetworkReply *FakeQNAM::createRequest(Operation op, const QNetworkRequest &request, QIODevice *outgoingData)
+{
+    if (!_shaped)
+        return createFakeReply(op, request, outgoingData);
+    _stats.requests++;
+    return new FakeShapedReply{ this, op, request, outgoingData };
+}
+
+inline void FakeQNAM::queueShapedReply(FakeShapedReply *reply)
+{
+    _queuedReplies.append(reply);
+    startQueuedReplies();
+}
+
+inline void FakeQNAM::releaseConnection()
+{
+    _activeConnections--;
+    startQueuedReplies();
+}
+
+inline void FakeQNAM::startQueuedReplies()
+{
+    while (!_queuedReplies.isEmpty()
+        && (_shape.maxConnections <= 0 || _activeConnections < _shape.maxConnections)) {
+        QPointer<FakeShapedReply> reply = _queuedReplies.takeFirst();
+        if (!reply || reply->state() != FakeShapedReply::Queued)
+            continue;
+        _activeConnections++;
+        _stats.peakConnections = qMax(_stats.peakConnections, _activeConnections);
+        reply->start();
+    }
+}
+
 class FakeCredentials : public OCC::AbstractCredentials
 {
     QNetworkAccessManager *_qnam;
@@ -944,6 +1351,8 @@ public:
     };
     ErrorList serverErrorPaths() { return {_fakeQnam}; }
     void setServerOverride(const FakeQNAM::Override &override) { _fakeQnam->setOverride(override); }
+    void setNetworkShape(const FakeQNAM::NetworkShape &shape) { _fakeQnam->setNetworkShape(shape); }
+    FakeQNAM::NetworkStats &networkStats() { return _fakeQnam->networkStats(); }
 
     QString localPath() const {
         // SyncEngine wants a trailing slash
@@ -0,0 +1,132 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "syncenginetestutils.h"
+#include <syncengine.h>
+
+using namespace OCC;
+
+static void enableBulkUpload(FakeFolder &fakeFolder)
+{
+    fakeFolder.syncEngine().account()->setCapabilities({ { "dav", QVariantMap{ { "bulkupload", "1.0" } } } });
+}
+
+class TestBulkUpload : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testSmallFilesInOneRequest()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        enableBulkUpload(fakeFolder);
+
+        int nPost = 0;
+        int nPut = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PostOperation)
+                ++nPost;
+            if (op == QNetworkAccessManager::PutOperation)
+                ++nPut;
+            return nullptr;
+        });
+
+        for (int i = 0; i < 10; ++i) {
+            fakeFolder.localModifier().insert(QString("A/new%1").arg(i), 100);
+            fakeFolder.localModifier().insert(QString("B/new%1").arg(i), 100);
+        }
+        fakeFolder.localModifier().mkdir("D");
+        fakeFolder.localModifier().insert("D/one", 100);
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        // One request per directory, a single file is uploaded on its own
+        QCOMPARE(nPost, 2);
+        QCOMPARE(nPut, 1);
+
+        // The etags from the bulk reply are in the journal, nothing left to do
+        nPost = nPut = 0;
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(nPost, 0);
+        QCOMPARE(nPut, 0);
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArray("A/new3"), &record));
+        QCOMPARE(record._etag, fakeFolder.currentRemoteState().find("A/new3")->etag.toUtf8());
+    }
+
+    void testPartErrorFallsBackToPut()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        enableBulkUpload(fakeFolder);
+
+        QStringList puts;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PutOperation)
+                puts.append(getFilePathFromUrl(request.url()));
+            return nullptr;
+        });
+
+        fakeFolder.localModifier().insert("A/new1", 100);
+        fakeFolder.localModifier().insert("A/new2", 100);
+        fakeFolder.localModifier().insert("A/new3", 100);
+        fakeFolder.serverErrorPaths().append("A/new2");
+
+        QVERIFY(!fakeFolder.syncOnce());
+        QCOMPARE(puts, QStringList{ "A/new2" });
+        QVERIFY(fakeFolder.currentRemoteState().find("A/new1"));
+        QVERIFY(fakeFolder.currentRemoteState().find("A/new3"));
+        QVERIFY(!fakeFolder.currentRemoteState().find("A/new2"));
+
+        fakeFolder.serverErrorPaths().clear();
+        fakeFolder.syncJournal().wipeErrorBlacklist();
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testWholeRequestFailure()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        enableBulkUpload(fakeFolder);
+
+        int nPut = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PostOperation)
+                return new FakeErrorReply(op, request, &fakeFolder.syncEngine(), 404);
+            if (op == QNetworkAccessManager::PutOperation)
+                ++nPut;
+            return nullptr;
+        });
+
+        fakeFolder.localModifier().insert("A/new1", 100);
+        fakeFolder.localModifier().insert("A/new2", 100);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(nPut, 2);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testNoCapability()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+
+        int nPost = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::PostOperation)
+                ++nPost;
+            return nullptr;
+        });
+
+        fakeFolder.localModifier().insert("A/new1", 100);
+        fakeFolder.localModifier().insert("A/new2", 100);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(nPost, 0);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestBulkUpload)
+#include "testbulkupload.moc"
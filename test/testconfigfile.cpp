@@ -0,0 +1,101 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include <future>
+
+#include "configfile.h"
+
+using namespace OCC;
+
+class TestConfigFile : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir _dir;
+
+private slots:
+    void initTestCase()
+    {
+        ConfigFile::setConfDir(_dir.path()); // we don't want to pollute the user's config file
+    }
+
+    void testSetters()
+    {
+        ConfigFile cfg;
+        QCOMPARE(cfg.maxLogLines(), 20000);
+        cfg.setMaxLogLines(42);
+        QCOMPARE(cfg.maxLogLines(), 42);
+        cfg.setMaxLogLines(43); // same size of the file
+        QCOMPARE(cfg.maxLogLines(), 43);
+        QCOMPARE(ConfigFile().maxLogLines(), 43);
+
+        cfg.setRemotePollInterval(std::chrono::seconds(42), "acc");
+        QVERIFY(cfg.remotePollInterval("acc") == std::chrono::seconds(42));
+        QVERIFY(cfg.remotePollInterval("other") == std::chrono::seconds(30));
+    }
+
+    void testSnapshotIsShared()
+    {
+        ConfigFile cfg;
+        cfg.setMaxLogLines(100);
+        auto snapshot = ConfigSnapshot::current(cfg.configFile());
+        QCOMPARE(snapshot->value("Logging/maxLogLines").toInt(), 100);
+        QVERIFY(ConfigSnapshot::current(cfg.configFile()) == snapshot);
+
+        // Reads from other threads get the same snapshot
+        auto other = std::async(std::launch::async, [&cfg] { return ConfigSnapshot::current(cfg.configFile()); }).get();
+        QVERIFY(other == snapshot);
+
+        ConfigSnapshot::invalidate();
+        QVERIFY(ConfigSnapshot::current(cfg.configFile()) != snapshot);
+    }
+
+    void testExternalChange()
+    {
+        ConfigFile cfg;
+        cfg.setMaxLogLines(100);
+        QCOMPARE(cfg.maxLogLines(), 100);
+
+        QSignalSpy spy(ConfigFileNotifier::instance(), &ConfigFileNotifier::configChanged);
+        {
+            QSettings settings(cfg.configFile(), QSettings::IniFormat);
+            settings.setValue("Logging/maxLogLines", 123456);
+        }
+        QCOMPARE(cfg.maxLogLines(), 123456);
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(spy.first().first().toString(), cfg.configFile());
+
+        // No notification without a change of the values
+        ConfigSnapshot::invalidate();
+        QCOMPARE(cfg.maxLogLines(), 123456);
+        QCOMPARE(spy.count(), 1);
+    }
+
+    // Keys are matched like QSettings does: case insensitive on Windows only
+    void testKeyCase()
+    {
+        ConfigFile cfg;
+        cfg.setMaxLogLines(77);
+        auto snapshot = ConfigSnapshot::current(cfg.configFile());
+        QSettings settings(cfg.configFile(), QSettings::IniFormat);
+        for (const QString key : { "Logging/maxLogLines", "logging/MAXLOGLINES", "LOGGING/maxloglines" }) {
+            QCOMPARE(snapshot->contains(key), settings.contains(key));
+            QCOMPARE(snapshot->value(key), settings.value(key));
+        }
+#ifdef Q_OS_WIN
+        QCOMPARE(snapshot->value("logging/MAXLOGLINES").toInt(), 77);
+#else
+        QVERIFY(!snapshot->contains("logging/MAXLOGLINES"));
+#endif
+    }
+};
+
+QTEST_GUILESS_MAIN(TestConfigFile)
+#include "testconfigfile.moc"
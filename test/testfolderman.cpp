@@ -74,6 +74,17 @@ private slots:
         QVERIFY(folderman->addFolder(newAccountState.data(), folderDefinition(dirPath + "/sub/ownCloud1")));
         QVERIFY(folderman->addFolder(newAccountState.data(), folderDefinition(dirPath + "/ownCloud2")));
 
+        // Lookup of the folder of a path
+        QString relativePath;
+        QCOMPARE(folderman->folderForPath(dirPath + "/sub/ownCloud1/folder/f", &relativePath), folderman->folder(dirPath + "/sub/ownCloud1"));
+        QCOMPARE(relativePath, QString("folder/f"));
+        QCOMPARE(folderman->folderForPath(dirPath + "/ownCloud2/", &relativePath), folderman->folder(dirPath + "/ownCloud2"));
+        QCOMPARE(relativePath, QString());
+        QVERIFY(!folderman->folderForPath(dirPath + "/ownCloud2-other/f", &relativePath));
+        QVERIFY(!folderman->folderForPath(dirPath + "/ownCloud", &relativePath));
+        QVERIFY(!folderman->folderForPath(dirPath + "/sub", &relativePath));
+        QCOMPARE(relativePath, QString());
+
 
         // those should be allowed
         // QString FolderMan::checkPathValidityForNewFolder(const QString& path, const QUrl &serverUrl, bool forNewDirectory)
@@ -119,6 +119,14 @@ public:
     }
 
 private slots:
+    void initTestCase()
+    {
+        // The watches may be set up in the background
+        QSignalSpy readySpy(_watcher.data(), &FolderWatcher::ready);
+        QVERIFY(_watcher->isReady() || readySpy.wait());
+        QVERIFY(_watcher->isReady());
+    }
+
     void init()
     {
         _pathChangedSpy->clear();
@@ -182,6 +190,25 @@ private slots:
         QVERIFY(waitForPathChanged(old_file));
         QVERIFY(waitForPathChanged(new_file));
     }
+
+    void testMoveInATree() {
+        QTemporaryDir outside;
+        QVERIFY(QDir(outside.path()).mkpath("t1/t2/t3"));
+        QString tree(_rootPath + "/a2/t1");
+        mv(outside.path() + "/t1", tree);
+        QVERIFY(waitForPathChanged(tree));
+
+        // Like Folder does for new directories
+        QSignalSpy progressSpy(_watcher.data(), &FolderWatcher::registrationProgress);
+        _watcher->addPath(tree);
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+        QVERIFY(progressSpy.wait());
+#endif
+
+        QString file(tree + "/t2/t3/deep.txt");
+        touch(file);
+        QVERIFY(waitForPathChanged(file));
+    }
 };
 
 #ifdef Q_OS_MAC
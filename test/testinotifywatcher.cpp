@@ -34,11 +34,15 @@ private slots:
 
     }
 
-    // Test the recursive path listing function findFoldersBelow
+    // Test the background directory walk that finds the folders to watch
     void testDirsBelowPath() {
         QStringList dirs;
+        int batches = 0;
 
-        bool ok = findFoldersBelow(QDir(_root), dirs);
+        walkFolders(QStringList{ _root }, [&](const QStringList &batch) {
+            dirs += batch;
+            ++batches;
+        });
         QVERIFY( dirs.indexOf(_root + "/a1")>-1);
         QVERIFY( dirs.indexOf(_root + "/a1/b1")>-1);
         QVERIFY( dirs.indexOf(_root + "/a1/b1/c1")>-1);
@@ -53,13 +57,15 @@ private slots:
         QVERIFY( dirs.indexOf(_root + "/a1/b3")>-1);
         QVERIFY( dirs.indexOf(_root + "/a1/b3/c3")>-1);
 
-        QVERIFY( dirs.indexOf(_root + "/a2"));
-        QVERIFY( dirs.indexOf(_root + "/a2/b3"));
-        QVERIFY( dirs.indexOf(_root + "/a2/b3/c3"));
+        QVERIFY( dirs.indexOf(_root + "/a2")>-1);
+        QVERIFY( dirs.indexOf(_root + "/a2/b3")>-1);
+        QVERIFY( dirs.indexOf(_root + "/a2/b3/c3")>-1);
 
         QVERIFY2(dirs.count() == 11, "Directory count wrong.");
+        QCOMPARE(batches, 1);
 
-        QVERIFY2(ok, "findFoldersBelow failed.");
+        // Breadth first: the top level comes before the levels below
+        QVERIFY(dirs.indexOf(_root + "/a2") < dirs.indexOf(_root + "/a1/b1"));
     }
 
     void cleanupTestCase() {
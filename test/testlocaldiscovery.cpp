@@ -9,6 +9,7 @@
 #include "syncenginetestutils.h"
 #include <syncengine.h>
 #include <localdiscoverytracker.h>
+#include <filesystem.h>
 
 using namespace OCC;
 
@@ -149,6 +150,75 @@ private slots:
         QVERIFY(fakeFolder.currentRemoteState().find("A/a4"));
         QVERIFY(tracker.localDiscoveryPaths().empty());
     }
+
+    // Check that the directories changed while the client wasn't running are found
+    void testFindChangedDirectories()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.localModifier().mkdir("A/X");
+        QVERIFY(fakeFolder.syncOnce());
+
+        // Pretend the client was shut down in the future, so only the
+        // mtimes set below are recent enough
+        const qint64 shutdownTime = QDateTime::currentMSecsSinceEpoch() + 3600 * 1000;
+        std::set<QByteArray> paths;
+        QVERIFY(LocalDiscoveryTracker::findChangedDirectories(
+            fakeFolder.localPath(), shutdownTime, &fakeFolder.syncJournal(), &paths));
+        QVERIFY(paths.empty());
+
+        fakeFolder.localModifier().mkdir("A/new");
+        fakeFolder.localModifier().mkdir("A/new/sub");
+        fakeFolder.localModifier().insert("A/new/sub/n1");
+        fakeFolder.localModifier().rename("B", "B2");
+        fakeFolder.localModifier().insert("C/c3");
+        QVERIFY(FileSystem::setModTime(fakeFolder.localPath() + "C", shutdownTime / 1000 + 10));
+
+        QVERIFY(LocalDiscoveryTracker::findChangedDirectories(
+            fakeFolder.localPath(), shutdownTime, &fakeFolder.syncJournal(), &paths));
+        QVERIFY(paths == (std::set<QByteArray>{ "A/new", "A/new/sub", "B2", "C" }));
+
+        // A partial discovery of these paths finds all changes
+        fakeFolder.syncEngine().setLocalDiscoveryOptions(LocalDiscoveryStyle::DatabaseAndFilesystem, paths);
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    // Directories that are unchanged on both sides are skipped by reconcile
+    // and the treewalk, but their journal entries must stay
+    void testCleanSubtrees()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.localModifier().mkdir("B/sub");
+        fakeFolder.localModifier().insert("B/sub/b3");
+        QVERIFY(fakeFolder.syncOnce());
+
+        auto hasRecord = [&](const char *path) {
+            SyncJournalFileRecord record;
+            fakeFolder.syncJournal().getFileRecord(QByteArray(path), &record);
+            return record.isValid();
+        };
+
+        fakeFolder.localModifier().insert("A/a3");
+        fakeFolder.remoteModifier().appendByte("C/c1");
+        fakeFolder.remoteModifier().rename("S/s1", "A/s1");
+        fakeFolder.syncEngine().setLocalDiscoveryOptions(LocalDiscoveryStyle::DatabaseAndFilesystem, { "A" });
+        QVERIFY(fakeFolder.syncOnce());
+
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(fakeFolder.currentRemoteState().find("A/a3"));
+        QVERIFY(fakeFolder.currentLocalState().find("A/s1"));
+        QVERIFY(hasRecord("B/b1"));
+        QVERIFY(hasRecord("B/sub"));
+        QVERIFY(hasRecord("B/sub/b3"));
+        QVERIFY(hasRecord("A/s1"));
+        QVERIFY(!hasRecord("S/s1"));
+
+        // Nothing was lost: a full sync has nothing to do
+        QSignalSpy completeSpy(&fakeFolder.syncEngine(), SIGNAL(itemCompleted(const SyncFileItemPtr &)));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(completeSpy.count(), 0);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
 };
 
 QTEST_GUILESS_MAIN(TestLocalDiscovery)
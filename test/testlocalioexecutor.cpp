@@ -0,0 +1,89 @@
+/*
+   This software is in the public domain, furnished "as is", without technical
+   support, and with no warranty, express or implied, as to its usefulness for
+   any purpose.
+*/
+
+#include <QtTest>
+#include <QMutex>
+#include <QThread>
+
+#include "localioexecutor.h"
+
+using namespace OCC;
+
+class TestLocalIoExecutor : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testOrderWithinKey()
+    {
+        LocalIoExecutor executor;
+        QMutex mutex;
+        QStringList workOrder;
+        QStringList doneOrder;
+        QObject context;
+
+        for (int i = 0; i < 20; ++i) {
+            const QString key = i % 2 ? "A" : "B";
+            const QString name = key + QString::number(i);
+            executor.submit(key, [&, name]() {
+                QThread::msleep(1);
+                QMutexLocker locker(&mutex);
+                workOrder.append(name);
+            }, &context, [&, name]() {
+                QCOMPARE(QThread::currentThread(), qApp->thread());
+                doneOrder.append(name);
+            });
+        }
+        QCOMPARE(executor.queueDepth(), 20);
+        QTRY_COMPARE(doneOrder.size(), 20);
+        QCOMPARE(executor.queueDepth(), 0);
+        QCOMPARE(executor.maxQueueDepth(), 20);
+
+        // Per key, the work and the callbacks happen in submission order
+        for (const QString key : { "A", "B" }) {
+            auto ofKey = [&key](const QStringList &list) {
+                QStringList result;
+                for (const auto &name : list) {
+                    if (name.startsWith(key))
+                        result.append(name);
+                }
+                return result;
+            };
+            QStringList expected;
+            for (int i = key == "A" ? 1 : 0; i < 20; i += 2)
+                expected.append(key + QString::number(i));
+            QCOMPARE(ofKey(workOrder), expected);
+            QCOMPARE(ofKey(doneOrder), expected);
+        }
+    }
+
+    void testDeletedContext()
+    {
+        LocalIoExecutor executor;
+        bool workDone = false;
+        bool called = false;
+        auto context = new QObject;
+        executor.submit("A", [&]() { workDone = true; }, context, [&]() { called = true; });
+        delete context;
+
+        QObject other;
+        bool otherCalled = false;
+        executor.submit("A", [] {}, &other, [&]() { otherCalled = true; });
+        QTRY_VERIFY(otherCalled);
+        QVERIFY(workDone);
+        QVERIFY(!called);
+    }
+
+    void testKeyForPath()
+    {
+        QCOMPARE(LocalIoExecutor::keyForPath("a"), QString());
+        QCOMPARE(LocalIoExecutor::keyForPath("a/b"), QString("a"));
+        QCOMPARE(LocalIoExecutor::keyForPath("a/b/c"), QString("a/b"));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestLocalIoExecutor)
+#include "testlocalioexecutor.moc"
@@ -0,0 +1,99 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "cmd/multifoldersync.h"
+#include "syncenginetestutils.h"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace OCC;
+
+class TestMultiFolderSync : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    // Several engines on the account of one FakeFolder, like owncloudcmd --folders
+    void testSharedAccount()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.remoteModifier().insert("A/new", 100);
+
+        // Two more folders download the whole tree. The local folder of the
+        // last one is missing, so each of its syncs fails and asks for another.
+        QTemporaryDir tempDir;
+        QVERIFY(QDir(tempDir.path()).mkdir("one"));
+        QVERIFY(QDir(tempDir.path()).mkdir("two"));
+        const QStringList names = { "folder", "one", "two", "missing" };
+        std::vector<std::unique_ptr<SyncJournalDb>> journals;
+        std::vector<std::unique_ptr<SyncEngine>> engines;
+        QVector<SyncEngine *> allEngines = { &fakeFolder.syncEngine() };
+        for (const auto &name : names.mid(1)) {
+            journals.emplace_back(new SyncJournalDb(tempDir.path() + "/._sync_" + name + ".db"));
+            engines.emplace_back(new SyncEngine(fakeFolder.syncEngine().account(),
+                tempDir.path() + '/' + name + '/', "", journals.back().get()));
+            allEngines.append(engines.back().get());
+        }
+
+        const int maxFollowUpSyncs = 2;
+        MultiFolderSync multiSync(2, 10000, 20000, maxFollowUpSyncs);
+        for (int i = 0; i < allEngines.size(); ++i)
+            multiSync.addFolder(names[i], allEngines[i]);
+
+        // No more than two engines run, and those share the limits
+        int maxRunning = 0;
+        bool limitsSplit = false;
+        bool limitsOk = true;
+        auto checkRunning = [&]() {
+            const int running = int(std::count_if(allEngines.begin(), allEngines.end(),
+                [](SyncEngine *engine) { return engine->isSyncRunning(); }));
+            maxRunning = qMax(maxRunning, running);
+            for (auto engine : allEngines) {
+                if (!engine->isSyncRunning())
+                    continue;
+                const bool split = engine->uploadLimit() == 5000 && engine->downloadLimit() == 10000;
+                const bool whole = engine->uploadLimit() == 10000 && engine->downloadLimit() == 20000;
+                limitsSplit |= split;
+                limitsOk &= split || (whole && running == 1);
+            }
+        };
+        for (auto engine : allEngines) {
+            connect(engine, &SyncEngine::transmissionProgress, this, checkRunning);
+            connect(engine, &SyncEngine::itemCompleted, this, checkRunning);
+        }
+
+        QSignalSpy finished(&multiSync, SIGNAL(finished()));
+        QSignalSpy missingFinished(engines.back().get(), SIGNAL(finished(bool)));
+        multiSync.start();
+        QVERIFY(finished.wait());
+
+        QCOMPARE(maxRunning, 2);
+        QVERIFY(limitsSplit);
+        QVERIFY(limitsOk);
+
+        // The first sync and the allowed follow-ups, then it gives up
+        QCOMPARE(missingFinished.count(), maxFollowUpSyncs + 1);
+        QVERIFY(!multiSync.allSucceeded());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QVERIFY(QFile::exists(tempDir.path() + "/two/A/new"));
+
+        // A/new for the first folder, the nine files of the tree for the others
+        std::ostringstream report;
+        multiSync.printReport(report);
+        const QStringList totals = QString::fromStdString(report.str()).split('\n').filter(QRegularExpression("^Total "));
+        QCOMPARE(totals.size(), 1);
+        QVERIFY(totals[0].contains(" 3/4 "));
+        QVERIFY(totals[0].contains("0 files, 0.0 MB"));
+        QVERIFY(totals[0].contains("19 files, 0.0 MB"));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestMultiFolderSync)
+#include "testmultifoldersync.moc"
@@ -126,6 +126,88 @@ private slots:
         }
     }
 
+    void testTypedBind() {
+        SqlQuery q(_db);
+        q.prepare("INSERT INTO addresses (id, name, address, entered) VALUES (?1, ?2, ?3, ?4);");
+        q.bindInt64(1, 4);
+        // The query keeps the temporaries alive
+        q.bindText(2, QString::fromUtf8("Nasreddin Hodscha").toUtf8());
+        q.bindText(3, QByteArray("Akşehir"));
+        q.bindInt64(4, Q_INT64_C(14031012240));
+        QVERIFY(q.exec());
+
+        SqlQuery select("SELECT name, address, entered FROM addresses WHERE id=?1", _db);
+        select.bindInt64(1, 4);
+        QVERIFY(select.exec());
+        QVERIFY(select.next());
+        QCOMPARE(select.stringValue(0), QString::fromUtf8("Nasreddin Hodscha"));
+        QCOMPARE(select.baValueView(1), QByteArray("Akşehir"));
+        QCOMPARE(qstrlen(select.baValueView(1).constData()), uint(select.baValueView(1).size()));
+        QCOMPARE(select.int64Value(2), quint64(14031012240));
+        QVERIFY(!select.next());
+    }
+
+    void benchBindAndRead_data() {
+        QTest::addColumn<bool>("typed");
+        QTest::newRow("QVariant") << false;
+        QTest::newRow("typed") << true;
+    }
+
+    void benchBindAndRead() {
+        QFETCH(bool, typed);
+        SqlQuery create("CREATE TABLE IF NOT EXISTS bench (id INTEGER PRIMARY KEY, path TEXT, etag TEXT, size INTEGER);", _db);
+        QVERIFY(create.exec());
+
+        // Similar to what the journal stores for each file
+        const int rows = 10000;
+        QVector<QByteArray> paths;
+        for (int i = 0; i < rows; ++i)
+            paths.append("some/directory/below/the/sync/root/file" + QByteArray::number(i) + ".txt");
+        const QByteArray etag = "5a44bd51cb2f6";
+
+        SqlQuery insert("INSERT OR REPLACE INTO bench (id, path, etag, size) VALUES (?1, ?2, ?3, ?4);", _db);
+        SqlQuery select("SELECT path, etag, size FROM bench WHERE id=?1;", _db);
+        QBENCHMARK {
+            _db.transaction();
+            for (int i = 0; i < rows; ++i) {
+                insert.reset_and_clear_bindings();
+                if (typed) {
+                    insert.bindInt64(1, i);
+                    insert.bindText(2, paths[i]);
+                    insert.bindText(3, etag);
+                    insert.bindInt64(4, i * 100);
+                } else {
+                    insert.bindValue(1, i);
+                    insert.bindValue(2, paths[i]);
+                    insert.bindValue(3, etag);
+                    insert.bindValue(4, qint64(i * 100));
+                }
+                insert.exec();
+            }
+            _db.commit();
+
+            qint64 total = 0;
+            for (int i = 0; i < rows; ++i) {
+                select.reset_and_clear_bindings();
+                if (typed) {
+                    select.bindInt64(1, i);
+                } else {
+                    select.bindValue(1, i);
+                }
+                select.exec();
+                if (select.next()) {
+                    if (typed) {
+                        total += select.baValueView(0).size() + select.baValueView(1).size();
+                    } else {
+                        total += select.baValue(0).size() + select.baValue(1).size();
+                    }
+                    total += select.int64Value(2);
+                }
+            }
+            QVERIFY(total > 0);
+        }
+    }
+
     void testDestructor()
     {
         // This test make sure that the destructor of SqlQuery works even if the SqlDatabase
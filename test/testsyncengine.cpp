@@ -8,6 +8,7 @@
 #include <QtTest>
 #include "syncenginetestutils.h"
 #include <syncengine.h>
+#include "common/remotetreesnapshot.h"
 
 using namespace OCC;
 
@@ -212,6 +213,45 @@ private slots:
         }
     }
 
+    void testNewBigFolder() {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._newBigFolderSizeLimit = 100;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        QSignalSpy bigFolderSpy(&fakeFolder.syncEngine(), &SyncEngine::newBigFolder);
+
+        // The sizes come with the listing of the parent, no extra PROPFIND per folder
+        int sizePropfinds = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation, const QNetworkRequest &req, QIODevice *) -> QNetworkReply * {
+            if (req.attribute(QNetworkRequest::CustomVerbAttribute) == "PROPFIND" && req.rawHeader("Depth") == "0")
+                ++sizePropfinds;
+            return nullptr;
+        });
+
+        fakeFolder.remoteModifier().mkdir("Big");
+        fakeFolder.remoteModifier().insert("Big/file", 150);
+        fakeFolder.remoteModifier().mkdir("A/Big");
+        fakeFolder.remoteModifier().mkdir("A/Big/sub");
+        fakeFolder.remoteModifier().insert("A/Big/sub/file", 150);
+        fakeFolder.remoteModifier().mkdir("Small");
+        fakeFolder.remoteModifier().mkdir("Small/sub");
+        fakeFolder.remoteModifier().insert("Small/sub/file", 50);
+        QVERIFY(fakeFolder.syncOnce());
+
+        QCOMPARE(sizePropfinds, 0);
+        QCOMPARE(bigFolderSpy.count(), 2);
+        QStringList bigFolders;
+        for (const auto &args : bigFolderSpy)
+            bigFolders.append(args[0].toString());
+        bigFolders.sort();
+        QCOMPARE(bigFolders, QStringList({ "A/Big", "Big" }));
+
+        auto local = fakeFolder.currentLocalState();
+        QVERIFY(!local.find("Big"));
+        QVERIFY(!local.find("A/Big"));
+        QVERIFY(local.find("Small/sub/file"));
+    }
+
     void abortAfterFailedMkdir() {
         FakeFolder fakeFolder{FileInfo{}};
         QSignalSpy finishedSpy(&fakeFolder.syncEngine(), SIGNAL(finished(bool)));
@@ -649,6 +689,250 @@ private slots:
         QTextCodec::setCodecForLocale(utf8Locale);
 #endif
     }
+
+    // The parallel reconcile must come to the same decisions as the sequential one
+    void testParallelReconcile_data()
+    {
+        QTest::addColumn<bool>("folderRename");
+        QTest::newRow("file changes") << false;
+        QTest::newRow("with folder rename") << true;
+    }
+
+    void testParallelReconcile()
+    {
+        QFETCH(bool, folderRename);
+
+        auto run = [folderRename](bool parallel) {
+            QMap<QString, int> instructions;
+            FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+            auto options = fakeFolder.syncEngine().syncOptions();
+            options._parallelReconcile = parallel;
+            fakeFolder.syncEngine().setSyncOptions(options);
+            for (int i = 0; i < 10; ++i) {
+                fakeFolder.remoteModifier().mkdir(QString("D%1").arg(i));
+                fakeFolder.remoteModifier().insert(QString("D%1/f").arg(i));
+            }
+            if (!fakeFolder.syncOnce())
+                return instructions;
+
+            fakeFolder.localModifier().appendByte("A/a1");
+            fakeFolder.remoteModifier().appendByte("A/a2");
+            fakeFolder.localModifier().remove("B/b1");
+            fakeFolder.remoteModifier().remove("C/c1");
+            fakeFolder.localModifier().insert("S/new");
+            fakeFolder.remoteModifier().mkdir("D0/sub");
+            fakeFolder.remoteModifier().rename("D1/f", "D2/g");
+            fakeFolder.localModifier().rename("D3/f", "D4/h");
+            fakeFolder.remoteModifier().remove("D5");
+            fakeFolder.localModifier().remove("D6/f");
+            fakeFolder.remoteModifier().appendByte("D6/f");
+            if (folderRename)
+                fakeFolder.remoteModifier().rename("D7", "D7x");
+
+            QSignalSpy completeSpy(&fakeFolder.syncEngine(), SIGNAL(itemCompleted(const SyncFileItemPtr &)));
+            if (!fakeFolder.syncOnce() || fakeFolder.currentLocalState() != fakeFolder.currentRemoteState())
+                return QMap<QString, int>();
+            for (const QList<QVariant> &args : completeSpy) {
+                auto item = args[0].value<SyncFileItemPtr>();
+                instructions[item->_file] = item->_instruction;
+            }
+            return instructions;
+        };
+
+        auto sequential = run(false);
+        QVERIFY(!sequential.isEmpty());
+        QCOMPARE(run(true), sequential);
+    }
+
+    // New files with the content of a synced file are copied on the server
+    void testServerSideCopy()
+    {
+        FakeFolder fakeFolder{ FileInfo{} };
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._serverSideCopyMinSize = 1000;
+        fakeFolder.syncEngine().setSyncOptions(options);
+        fakeFolder.localModifier().mkdir("A");
+        fakeFolder.localModifier().insert("A/big", 5000, 'Z');
+        fakeFolder.localModifier().insert("A/small", 100, 'Z');
+        QVERIFY(fakeFolder.syncOnce());
+
+        QStringList puts, copies;
+        bool failCopy = false;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            auto verb = request.attribute(QNetworkRequest::CustomVerbAttribute);
+            if (verb == "PUT" || op == QNetworkAccessManager::PutOperation)
+                puts.append(getFilePathFromUrl(request.url()));
+            if (verb == "COPY") {
+                copies.append(getFilePathFromUrl(request.url()));
+                if (failCopy)
+                    return new FakeErrorReply{ op, request, this, 412 };
+            }
+            return nullptr;
+        });
+
+        const QDateTime modTime = QDateTime::currentDateTimeUtc().addDays(-1);
+        fakeFolder.localModifier().mkdir("B");
+        fakeFolder.localModifier().insert("B/big", 5000, 'Z');
+        fakeFolder.localModifier().setModTime("B/big", modTime);
+        fakeFolder.localModifier().insert("B/small", 100, 'Z'); // too small
+        fakeFolder.localModifier().insert("B/other", 5000, 'Y'); // different content
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(copies, QStringList{ "A/big" });
+        puts.sort();
+        QCOMPARE(puts, QStringList({ "B/other", "B/small" }));
+
+        auto remoteCopy = fakeFolder.currentRemoteState().find("B/big");
+        QVERIFY(remoteCopy);
+        QCOMPARE(Utility::qDateTimeToTime_t(remoteCopy->lastModified), Utility::qDateTimeToTime_t(modTime));
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("B/big"), &record));
+        QCOMPARE(record._etag, remoteCopy->etag.toUtf8());
+        QCOMPARE(record._fileId, remoteCopy->fileId);
+        QVERIFY(!record._checksumHeader.isEmpty());
+
+        // The source changed on the server since the last sync: upload instead
+        copies.clear();
+        puts.clear();
+        failCopy = true;
+        fakeFolder.localModifier().insert("C", 5000, 'Z');
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(copies.size(), 1);
+        QCOMPARE(puts, QStringList{ "C" });
+    }
+
+    // New remote files with the checksum of a synced local file are copied locally
+    void testLocalCopyInsteadOfDownload()
+    {
+        FakeFolder fakeFolder{ FileInfo{} };
+        fakeFolder.localModifier().mkdir("A");
+        fakeFolder.localModifier().insert("A/big", 5000, 'Z');
+        fakeFolder.localModifier().insert("A/other", 5000, 'Y');
+        QVERIFY(fakeFolder.syncOnce());
+
+        QStringList gets;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation)
+                gets.append(getFilePathFromUrl(request.url()));
+            return nullptr;
+        });
+
+        SyncJournalFileRecord record;
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("A/big"), &record));
+        QVERIFY(record._checksumHeader.startsWith("SHA1:"));
+        FileInfo &remoteInfo = dynamic_cast<FileInfo &>(fakeFolder.remoteModifier());
+        const QDateTime modTime = QDateTime::currentDateTimeUtc().addDays(-2);
+
+        fakeFolder.remoteModifier().insert("copy", 5000, 'Z');
+        fakeFolder.remoteModifier().setModTime("copy", modTime);
+        remoteInfo.find("copy")->checksums = record._checksumHeader;
+        // The local source changed, the checksum doesn't match anymore
+        QVERIFY(fakeFolder.syncJournal().getFileRecord(QByteArrayLiteral("A/other"), &record));
+        fakeFolder.localModifier().appendByte("A/other");
+        fakeFolder.remoteModifier().insert("copy2", 5000, 'Y');
+        remoteInfo.find("copy2")->checksums = record._checksumHeader;
+        QVERIFY(fakeFolder.syncOnce());
+
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(gets, QStringList{ "copy2" });
+        QCOMPARE(Utility::qDateTimeToTime_t(modTime), FileSystem::getModTime(fakeFolder.localPath() + "copy"));
+    }
+
+    /**
+     * Engines of different folders can sync at the same time (owncloudcmd --folders)
+     */
+    void testConcurrentSyncs()
+    {
+        FakeFolder fakeFolder1{ FileInfo::A12_B12_C12_S12() };
+        FakeFolder fakeFolder2{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder1.localModifier().insert("A/new1");
+        fakeFolder1.remoteModifier().appendByte("B/b1");
+        fakeFolder2.localModifier().remove("C/c1");
+        fakeFolder2.remoteModifier().insert("S/new2");
+
+        QSignalSpy finished1(&fakeFolder1.syncEngine(), SIGNAL(finished(bool)));
+        QSignalSpy finished2(&fakeFolder2.syncEngine(), SIGNAL(finished(bool)));
+        fakeFolder1.scheduleSync();
+        fakeFolder2.scheduleSync();
+        QVERIFY(finished1.wait());
+        QVERIFY(finished2.count() == 1 || finished2.wait());
+
+        QVERIFY(finished1[0][0].toBool());
+        QVERIFY(finished2[0][0].toBool());
+        QCOMPARE(fakeFolder1.currentLocalState(), fakeFolder1.currentRemoteState());
+        QCOMPARE(fakeFolder2.currentLocalState(), fakeFolder2.currentRemoteState());
+    }
+    // Unchanged remote subtrees are read from the snapshot and the sync result is the same
+    void testRemoteTreeSnapshot()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        auto &journal = fakeFolder.syncJournal();
+        QCOMPARE(journal.remoteTreeSnapshotGeneration(), qint64(0));
+
+        auto options = fakeFolder.syncEngine().syncOptions();
+        options._remoteTreeSnapshot = true;
+        fakeFolder.syncEngine().setSyncOptions(options);
+
+        // The snapshot is written in the background after the sync
+        auto snapshotWritten = [&]() {
+            RemoteTreeSnapshot snapshot;
+            return snapshot.open(journal.remoteTreeSnapshotFilePath())
+                && snapshot.generation() == journal.remoteTreeSnapshotGeneration();
+        };
+        // Same records in the same order as the journal, whether it was updated or written from scratch
+        auto snapshotMatchesJournal = [&]() {
+            RemoteTreeSnapshot snapshot;
+            if (!snapshot.open(journal.remoteTreeSnapshotFilePath()))
+                return false;
+            QVector<QByteArray> snapshotEntries;
+            QVector<QByteArray> journalEntries;
+            snapshot.forEachBelow(QByteArray(), [&](const RemoteTreeSnapshot::Entry &entry) {
+                snapshotEntries.append(QByteArray(entry.path + ' ' + entry.etag));
+            });
+            journal.getFilesBelowPath(QByteArray(), [&](const SyncJournalFileRecord &record) {
+                journalEntries.append(QByteArray(record._path + ' ' + record._etag));
+            });
+            return snapshotEntries == journalEntries;
+        };
+
+        // Enough entries for a few changes to be merged into the previous snapshot,
+        // and paths that sort differently once the slash is appended
+        fakeFolder.remoteModifier().mkdir("D");
+        for (int i = 0; i < 100; ++i)
+            fakeFolder.remoteModifier().insert(QString("D/d%1").arg(i));
+        fakeFolder.remoteModifier().insert("A-b");
+        fakeFolder.remoteModifier().mkdir("A b");
+        fakeFolder.remoteModifier().insert("A b/c");
+        QVERIFY(fakeFolder.syncOnce());
+        QTRY_VERIFY(snapshotWritten());
+        QVERIFY(snapshotMatchesJournal());
+
+        fakeFolder.remoteModifier().appendByte("A/a1");
+        fakeFolder.remoteModifier().insert("A/new");
+        fakeFolder.localModifier().remove("B/b1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // The sync changed the records, so the snapshot was invalidated and updated
+        QTRY_VERIFY(snapshotWritten());
+        QVERIFY(snapshotMatchesJournal());
+        SyncJournalFileRecord record;
+        QVERIFY(journal.getFileRecord(QByteArray("S/s1"), &record) && record.isValid());
+        QVERIFY(journal.getFileRecord(QByteArray("A/new"), &record) && record.isValid());
+
+        fakeFolder.remoteModifier().rename("C/c1", "S/c1");
+        fakeFolder.remoteModifier().remove("A/a2");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        // A sync right after the previous one doesn't wait for the writer
+        fakeFolder.localModifier().insert("C/local");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QTRY_VERIFY(snapshotWritten());
+        QVERIFY(snapshotMatchesJournal());
+    }
 };
 
 QTEST_GUILESS_MAIN(TestSyncEngine)
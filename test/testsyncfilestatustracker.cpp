@@ -427,6 +427,30 @@ private slots:
         QCOMPARE(statusSpy.statusOf("C/c1"), SyncFileStatus(SyncFileStatus::StatusUpToDate));
     }
 
+    void journalCacheFollowsSync() {
+        FakeFolder fakeFolder{FileInfo::A12_B12_C12_S12()};
+        auto &tracker = fakeFolder.syncEngine().syncFileStatusTracker();
+        QCOMPARE(tracker.fileStatus("A/a1"), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QCOMPARE(tracker.fileStatus("A/a3"), SyncFileStatus(SyncFileStatus::StatusNone));
+
+        // New entries in an already cached directory show up after the sync
+        fakeFolder.localModifier().insert("A/a3");
+        fakeFolder.remoteModifier().insert("A/a4");
+        fakeFolder.localModifier().remove("A/a2");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(tracker.fileStatus("A/a3"), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QCOMPARE(tracker.fileStatus("A/a4"), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QCOMPARE(tracker.fileStatus("A/a2"), SyncFileStatus(SyncFileStatus::StatusNone));
+
+        // Renamed directories take their cached entries along
+        QCOMPARE(tracker.fileStatus("B/b1"), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        fakeFolder.localModifier().rename("B", "B2");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(tracker.fileStatus("B/b1"), SyncFileStatus(SyncFileStatus::StatusNone));
+        QCOMPARE(tracker.fileStatus("B2/b1"), SyncFileStatus(SyncFileStatus::StatusUpToDate));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
     void sharedStatus() {
         SyncFileStatus sharedUpToDateStatus(SyncFileStatus::StatusUpToDate);
         sharedUpToDateStatus.setShared(true);
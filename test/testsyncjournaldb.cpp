@@ -10,6 +10,7 @@
 
 #include "common/syncjournaldb.h"
 #include "common/syncjournalfilerecord.h"
+#include "common/remotetreesnapshot.h"
 
 using namespace OCC;
 
@@ -170,6 +171,27 @@ private slots:
         QVERIFY(!wipedRecord._valid);
     }
 
+    void testLocalDiscoveryState()
+    {
+        typedef SyncJournalDb::LocalDiscoveryState State;
+        QVERIFY(!_db.takeLocalDiscoveryState().isValid());
+
+        State state;
+        state._shutdownTime = 1520000000000;
+        state._lastFullDiscoveryTime = 1510000000000;
+        state._paths = { "A", "A/b c", "d" };
+        _db.setLocalDiscoveryState(state);
+
+        State storedState = _db.takeLocalDiscoveryState();
+        QVERIFY(storedState.isValid());
+        QCOMPARE(storedState._shutdownTime, state._shutdownTime);
+        QCOMPARE(storedState._lastFullDiscoveryTime, state._lastFullDiscoveryTime);
+        QVERIFY(storedState._paths == state._paths);
+
+        // It can only be taken once
+        QVERIFY(!_db.takeLocalDiscoveryState().isValid());
+    }
+
     void testNumericId()
     {
         SyncJournalFileRecord record;
@@ -273,6 +295,40 @@ private slots:
         QCOMPARE(getEtag("foodir/sub"), initialEtag);
     }
 
+    void testFilesInDirectory()
+    {
+        auto makeEntry = [&](const QByteArray &path) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            _db.setFileRecord(record);
+        };
+
+        makeEntry("indir");
+        makeEntry("indir/file");
+        makeEntry("indir/sub");
+        makeEntry("indir/sub/file");
+        makeEntry("indir/sub/sub2/file");
+        makeEntry("indir-2/file");
+        makeEntry("indi/file");
+
+        auto list = [&](const QByteArray &path) {
+            QByteArrayList result;
+            if (!_db.getFilesInDirectory(path, [&](const SyncJournalFileRecord &rec) {
+                    result.append(rec._path);
+                }))
+                result.append("<error>");
+            std::sort(result.begin(), result.end());
+            return result;
+        };
+
+        QCOMPARE(list("indir"), QByteArrayList({ "indir/file", "indir/sub" }));
+        QCOMPARE(list("indir/sub"), QByteArrayList({ "indir/sub/file" }));
+        QCOMPARE(list("indir/sub/sub2"), QByteArrayList({ "indir/sub/sub2/file" }));
+        QCOMPARE(list("indir/file"), QByteArrayList());
+        QVERIFY(list("").contains("indir"));
+        QVERIFY(!list("").contains("indir/file"));
+    }
+
     void testRecursiveDelete()
     {
         auto makeEntry = [&](const QByteArray &path) {
@@ -323,6 +379,63 @@ private slots:
         QVERIFY(checkElements());
     }
 
+    void testRemoteTreeSnapshot()
+    {
+        auto makeEntry = [&](const QByteArray &path, ItemType type) {
+            SyncJournalFileRecord record;
+            record._path = path;
+            record._type = type;
+            record._etag = "etag" + path;
+            record._fileId = "id" + path;
+            record._remotePerm = RemotePermissions("RWDNVCK");
+            record._fileSize = path.size();
+            record._inode = 1000 + path.size();
+            record._modtime = 1234;
+            QVERIFY(_db.setFileRecord(record));
+        };
+        makeEntry("snap", ItemTypeDirectory);
+        makeEntry("snap/a", ItemTypeFile);
+        makeEntry("snap/sub", ItemTypeDirectory);
+        makeEntry("snap/sub/b", ItemTypeFile);
+        makeEntry("snap-2", ItemTypeFile);
+        makeEntry("snap.x", ItemTypeFile);
+
+        QVERIFY(RemoteTreeSnapshot::write(&_db));
+        RemoteTreeSnapshot snapshot;
+        QVERIFY(snapshot.open(_db.remoteTreeSnapshotFilePath()));
+        QCOMPARE(snapshot.generation(), _db.remoteTreeSnapshotGeneration());
+
+        // Must match what getFilesBelowPath returns
+        auto below = [&](const QByteArray &path) {
+            QList<QByteArray> fromDb;
+            _db.getFilesBelowPath(path, [&](const SyncJournalFileRecord &rec) { fromDb.append(rec._path); });
+            QList<QByteArray> fromSnapshot;
+            bool ok = snapshot.forEachBelow(path, [&](const RemoteTreeSnapshot::Entry &entry) {
+                fromSnapshot.append(QByteArray(entry.path.constData(), entry.path.size()));
+            });
+            return ok && fromDb == fromSnapshot ? fromSnapshot : QList<QByteArray>();
+        };
+        QCOMPARE(below("snap"), QList<QByteArray>({ "snap/a", "snap/sub", "snap/sub/b" }));
+        QCOMPARE(below("snap/sub"), QList<QByteArray>({ "snap/sub/b" }));
+        QVERIFY(below("snap/a").isEmpty());
+        QVERIFY(below("").contains("snap-2"));
+
+        snapshot.forEachBelow("snap/sub", [&](const RemoteTreeSnapshot::Entry &entry) {
+            QCOMPARE(entry.etag, QByteArray("etagsnap/sub/b"));
+            QCOMPARE(entry.fileId, QByteArray("idsnap/sub/b"));
+            QCOMPARE(entry.remotePerm, RemotePermissions("RWDNVCK"));
+            QCOMPARE(entry.type, ItemTypeFile);
+            QCOMPARE(entry.fileSize, qint64(10));
+            QCOMPARE(entry.inode, quint64(1010));
+            QCOMPARE(entry.modtime, qint64(1234));
+        });
+
+        // Any change to the records invalidates the snapshot
+        makeEntry("snap/c", ItemTypeFile);
+        QCOMPARE(_db.remoteTreeSnapshotGeneration(), qint64(0));
+        QVERIFY(snapshot.generation() != 0);
+    }
+
 private:
     SyncJournalDb _db;
 };
@@ -621,6 +621,37 @@ private slots:
 
         QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
     }
+
+    // Files moved out of a directory that is removed in the same sync must
+    // be moved before the directory is removed, also with local I/O threads
+    void testMoveOutOfRemovedDirectory()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        auto &remote = fakeFolder.remoteModifier();
+        remote.mkdir("D");
+        for (int i = 0; i < 20; ++i)
+            remote.insert(QString("D/f%1").arg(i));
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        int nGET = 0;
+        fakeFolder.setServerOverride([&](QNetworkAccessManager::Operation op, const QNetworkRequest &, QIODevice *) -> QNetworkReply * {
+            if (op == QNetworkAccessManager::GetOperation)
+                ++nGET;
+            return nullptr;
+        });
+
+        // Into an existing directory and into a new one
+        remote.mkdir("N");
+        for (int i = 0; i < 20; ++i)
+            remote.rename(QString("D/f%1").arg(i), QString(i % 2 ? "B/f%1" : "N/f%1").arg(i));
+        remote.remove("D");
+
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(nGET, 0);
+        QVERIFY(!fakeFolder.currentLocalState().find("D"));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
 };
 
 QTEST_GUILESS_MAIN(TestSyncMove)
@@ -0,0 +1,110 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+#include "syncenginetestutils.h"
+#include "common/synctrace.h"
+#include <syncengine.h>
+
+using namespace OCC;
+
+static QJsonArray traceEvents()
+{
+    QJsonParseError error;
+    auto doc = QJsonDocument::fromJson(SyncTrace::chromeTrace(), &error);
+    if (error.error != QJsonParseError::NoError)
+        qWarning() << "Invalid trace:" << error.errorString();
+    return doc.object().value("traceEvents").toArray();
+}
+
+static QSet<QString> eventNames(const QJsonArray &events)
+{
+    QSet<QString> names;
+    for (const auto &event : events)
+        names.insert(event.toObject().value("name").toString());
+    return names;
+}
+
+class SpanThread : public QThread
+{
+    void run() Q_DECL_OVERRIDE
+    {
+        // More than one chunk of events
+        for (int i = 0; i < 3000; ++i) {
+            SyncTraceScope trace("test", "worker span", "with \"quotes\"\n");
+        }
+    }
+};
+
+class TestSyncTrace : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testDisabled()
+    {
+        SyncTrace::setEnabled(false);
+        { SyncTraceScope trace("test", "disabled span"); }
+        QVERIFY(!eventNames(traceEvents()).contains("disabled span"));
+    }
+
+    void testThreads()
+    {
+        SyncTrace::setEnabled(true);
+        SpanThread thread;
+        thread.setObjectName("worker");
+        thread.start();
+        thread.wait();
+        SyncTrace::addSpan("test", "async span", SyncTrace::now(), QString(), true);
+
+        auto events = traceEvents();
+        int workerSpans = 0;
+        int workerTid = -1;
+        for (const auto &value : events) {
+            auto event = value.toObject();
+            if (event.value("name") == "thread_name" && event.value("args").toObject().value("name") == "worker")
+                workerTid = event.value("tid").toInt();
+            if (event.value("name") == "worker span") {
+                ++workerSpans;
+                QCOMPARE(event.value("ph").toString(), QString("X"));
+                QCOMPARE(event.value("args").toObject().value("detail").toString(), QString("with \"quotes\"\n"));
+                QCOMPARE(event.value("tid").toInt(), workerTid);
+            }
+        }
+        QCOMPARE(workerSpans, 3000);
+        QVERIFY(workerTid > 0);
+
+        QStringList asyncPhases;
+        for (const auto &value : events) {
+            if (value.toObject().value("name") == "async span")
+                asyncPhases.append(value.toObject().value("ph").toString());
+        }
+        QCOMPARE(asyncPhases, QStringList({ "b", "e" }));
+    }
+
+    void testSyncPhases()
+    {
+        SyncTrace::setEnabled(true);
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.localModifier().insert("A/a0");
+        fakeFolder.remoteModifier().appendByte("B/b1");
+        QVERIFY(fakeFolder.syncOnce());
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+
+        auto names = eventNames(traceEvents());
+        QVERIFY(names.contains("reconcile"));
+        QVERIFY(names.contains("PROPFIND"));
+        QVERIFY(names.contains("build job tree"));
+        QVERIFY(names.contains("PropagateDownloadFile"));
+        QVERIFY(names.contains("journal commit"));
+        QVERIFY(names.contains("sync"));
+        SyncTrace::setEnabled(false);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSyncTrace)
+#include "testsynctrace.moc"
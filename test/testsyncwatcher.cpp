@@ -0,0 +1,308 @@
+/*
+ *    This software is in the public domain, furnished "as is", without technical
+ *    support, and with no warranty, express or implied, as to its usefulness for
+ *    any purpose.
+ *
+ */
+
+#include <QtTest>
+
+#include "cmd/syncwatcher.h"
+#include "folderwatcher.h"
+#include "syncenginetestutils.h"
+
+using namespace OCC;
+using namespace std::chrono_literals;
+
+// The watcher of the test is never initialized, the test reports the changes itself
+class TestingSyncWatcher : public SyncWatcher
+{
+public:
+    using SyncWatcher::SyncWatcher;
+
+    FolderWatcher *folderWatcher = nullptr;
+
+    void reportChange(const FakeFolder &fakeFolder, const QString &relativePath)
+    {
+        emit folderWatcher->pathChanged(fakeFolder.localPath() + relativePath);
+    }
+
+protected:
+    FolderWatcher *createFolderWatcher() override
+    {
+        folderWatcher = new FolderWatcher(this);
+        return folderWatcher;
+    }
+};
+
+// The local discovery options of one sync, as the engine saw them
+struct DiscoveryRecord
+{
+    LocalDiscoveryStyle style;
+    QSet<QByteArray> discoveredPaths;
+};
+
+class TestSyncWatcher : public QObject
+{
+    Q_OBJECT
+
+    // The watcher polls with Depth 0 on servers >= 8.1, answer with just the root
+    // like a real server does. Counts the polls.
+    void fakeEtagPolls(FakeFolder &fakeFolder, int *polls)
+    {
+        fakeFolder.syncEngine().account()->setServerVersion("10.0.0");
+        fakeFolder.setServerOverride([this, &fakeFolder, polls](QNetworkAccessManager::Operation op, const QNetworkRequest &request, QIODevice *) -> QNetworkReply * {
+            if (request.attribute(QNetworkRequest::CustomVerbAttribute) != "PROPFIND"
+                || request.rawHeader("Depth") != "0"
+                || !getFilePathFromUrl(request.url()).isEmpty())
+                return nullptr;
+            ++*polls;
+            FileInfo root;
+            root.etag = fakeFolder.remoteModifier().etag;
+            return new FakePropfindReply{root, op, request, this};
+        });
+    }
+
+    // Records the discovery options when a sync starts, for the given paths
+    void recordDiscovery(FakeFolder &fakeFolder, QVector<DiscoveryRecord> *records, const QList<QByteArray> &paths)
+    {
+        auto &engine = fakeFolder.syncEngine();
+        connect(&engine, &SyncEngine::transmissionProgress, this, [&engine, records, paths](const ProgressInfo &progress) {
+            if (progress.status() != ProgressInfo::Starting)
+                return;
+            DiscoveryRecord record;
+            record.style = engine.lastLocalDiscoveryStyle();
+            for (const auto &path : paths) {
+                if (engine.shouldDiscoverLocally(path))
+                    record.discoveredPaths.insert(path);
+            }
+            records->append(record);
+        });
+    }
+
+private slots:
+    void testDiscoveryStyle()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        int polls = 0;
+        fakeEtagPolls(fakeFolder, &polls);
+        QVector<DiscoveryRecord> records;
+        recordDiscovery(fakeFolder, &records, { "A/a1", "B/b1" });
+        QSignalSpy finishedSpy(&fakeFolder.syncEngine(), SIGNAL(finished(bool)));
+
+        TestingSyncWatcher watcher(&fakeFolder.syncEngine(), QString(), 1h, 0);
+        watcher.setSyncDelays(50ms, 500ms);
+        watcher.start();
+
+        // The first sync looks at everything
+        QVERIFY(finishedSpy.wait());
+        QCOMPARE(records.size(), 1);
+        QVERIFY(records[0].style == LocalDiscoveryStyle::FilesystemOnly);
+
+        // Then only at the reported paths: B/b1 is not uploaded
+        fakeFolder.localModifier().appendByte("A/a1");
+        fakeFolder.localModifier().appendByte("B/b1");
+        watcher.reportChange(fakeFolder, "A/a1");
+        QVERIFY(finishedSpy.wait());
+        QCOMPARE(records.size(), 2);
+        QVERIFY(records[1].style == LocalDiscoveryStyle::DatabaseAndFilesystem);
+        QCOMPARE(records[1].discoveredPaths, QSet<QByteArray>{ "A/a1" });
+        QCOMPARE(fakeFolder.currentRemoteState().find("A/a1")->size, fakeFolder.currentLocalState().find("A/a1")->size);
+        QVERIFY(fakeFolder.currentRemoteState().find("B/b1")->size != fakeFolder.currentLocalState().find("B/b1")->size);
+
+        // After lost changes, everything again
+        emit watcher.folderWatcher->lostChanges();
+        QVERIFY(finishedSpy.wait());
+        QCOMPARE(records.size(), 3);
+        QVERIFY(records[2].style == LocalDiscoveryStyle::FilesystemOnly);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        QCOMPARE(finishedSpy.count(), 3);
+    }
+
+    void testDebounce()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        int polls = 0;
+        fakeEtagPolls(fakeFolder, &polls);
+        QSignalSpy finishedSpy(&fakeFolder.syncEngine(), SIGNAL(finished(bool)));
+
+        TestingSyncWatcher watcher(&fakeFolder.syncEngine(), QString(), 1h, 0);
+        watcher.setSyncDelays(200ms, 1000ms);
+        watcher.start();
+        QVERIFY(finishedSpy.wait());
+        finishedSpy.clear();
+
+        // Two changes in quick succession make a single sync
+        fakeFolder.localModifier().insert("A/quick1");
+        watcher.reportChange(fakeFolder, "A/quick1");
+        QTest::qWait(50);
+        fakeFolder.localModifier().insert("A/quick2");
+        watcher.reportChange(fakeFolder, "A/quick2");
+        QVERIFY(finishedSpy.wait());
+        QTest::qWait(400);
+        QCOMPARE(finishedSpy.count(), 1);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        finishedSpy.clear();
+
+        // Changes that keep coming delay the sync up to the maximum delay
+        int changes = 0;
+        QTimer changeTimer;
+        changeTimer.setInterval(100);
+        connect(&changeTimer, &QTimer::timeout, this, [&]() {
+            const QString path = QStringLiteral("A/busy%1").arg(++changes);
+            fakeFolder.localModifier().insert(path);
+            watcher.reportChange(fakeFolder, path);
+        });
+        QElapsedTimer elapsed;
+        elapsed.start();
+        changeTimer.start();
+        QVERIFY(finishedSpy.wait(5000));
+        changeTimer.stop();
+        QVERIFY(elapsed.elapsed() >= 900);
+        QVERIFY(changes >= 5);
+
+        // Changes made while the sync ran are picked up by the next one
+        QTRY_COMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testFollowUpLimit_data()
+    {
+        QTest::addColumn<int>("maxFollowUpSyncs");
+
+        QTest::newRow("none") << 0;
+        QTest::newRow("two") << 2;
+    }
+
+    void testFollowUpLimit()
+    {
+        QFETCH(int, maxFollowUpSyncs);
+
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.syncEngine().account()->setCapabilities({ { "uploadConflictFiles", true } });
+        int polls = 0;
+        fakeEtagPolls(fakeFolder, &polls);
+        QSignalSpy finishedSpy(&fakeFolder.syncEngine(), SIGNAL(finished(bool)));
+
+        TestingSyncWatcher watcher(&fakeFolder.syncEngine(), QString(), 1h, maxFollowUpSyncs);
+        watcher.setSyncDelays(50ms, 500ms);
+
+        // A new local directory conflicting with a new remote file: the
+        // contents of the conflict directory are uploaded by another sync
+        auto createConflict = [&](int n) {
+            const QString name = QStringLiteral("Z%1").arg(n);
+            fakeFolder.localModifier().mkdir(name);
+            fakeFolder.localModifier().insert(name + "/foo");
+            fakeFolder.remoteModifier().insert(name, 63);
+        };
+
+        // Every sync that is followed up creates a new conflict, so the last
+        // one asks for another sync as well
+        int syncs = 0;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::finished, this, [&](bool success) {
+            ++syncs;
+            QVERIFY(success);
+            QCOMPARE(fakeFolder.syncEngine().isAnotherSyncNeeded(), ImmediateFollowUp);
+            if (syncs <= maxFollowUpSyncs) {
+                createConflict(syncs + 1);
+                watcher.reportChange(fakeFolder, QStringLiteral("Z%1/foo").arg(syncs + 1));
+            }
+        });
+
+        createConflict(1);
+        watcher.start();
+        QTRY_COMPARE(finishedSpy.count(), 1 + maxFollowUpSyncs);
+        QTest::qWait(500);
+        QCOMPARE(finishedSpy.count(), 1 + maxFollowUpSyncs);
+    }
+
+    void testPollRemote()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        int polls = 0;
+        fakeEtagPolls(fakeFolder, &polls);
+        QSignalSpy finishedSpy(&fakeFolder.syncEngine(), SIGNAL(finished(bool)));
+
+        TestingSyncWatcher watcher(&fakeFolder.syncEngine(), QString(), 100ms, 0);
+        watcher.setSyncDelays(50ms, 500ms);
+        watcher.start();
+        QVERIFY(finishedSpy.wait());
+
+        // An unchanged etag doesn't start a sync
+        QTest::qWait(500);
+        QVERIFY(polls >= 3);
+        QCOMPARE(finishedSpy.count(), 1);
+
+        // A changed one does
+        fakeFolder.remoteModifier().insert("A/remote");
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(fakeFolder.currentLocalState().find("A/remote"));
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+        finishedSpy.clear();
+
+        // A file that is still changing isn't uploaded...
+        SyncEngine::minimumFileAgeForUpload = 3600 * 1000;
+        fakeFolder.localModifier().insert("A/young");
+        watcher.reportChange(fakeFolder, "A/young");
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(!fakeFolder.currentRemoteState().find("A/young"));
+
+        // ...but retried with the next poll, without another notification
+        SyncEngine::minimumFileAgeForUpload = 0;
+        QVERIFY(finishedSpy.wait());
+        QCOMPARE(finishedSpy.count(), 2);
+        QCOMPARE(fakeFolder.currentLocalState(), fakeFolder.currentRemoteState());
+    }
+
+    void testStopBeforeSyncStarted()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        fakeFolder.remoteModifier().insert("A/remote");
+        QSignalSpy finishedSpy(&fakeFolder.syncEngine(), SIGNAL(finished(bool)));
+
+        TestingSyncWatcher watcher(&fakeFolder.syncEngine(), QString(), 1h, 0);
+        QSignalSpy stoppedSpy(&watcher, SIGNAL(stopped()));
+        watcher.start();
+        watcher.stop();
+
+        // The queued start is cancelled, no sync runs
+        QCOMPARE(stoppedSpy.count(), 1);
+        QTest::qWait(200);
+        QCOMPARE(finishedSpy.count(), 0);
+        QVERIFY(!fakeFolder.syncEngine().isSyncRunning());
+        QVERIFY(!fakeFolder.currentLocalState().find("A/remote"));
+    }
+
+    void testStopDuringSync()
+    {
+        FakeFolder fakeFolder{ FileInfo::A12_B12_C12_S12() };
+        for (int i = 0; i < 20; ++i)
+            fakeFolder.remoteModifier().insert(QStringLiteral("A/remote%1").arg(i));
+        QSignalSpy finishedSpy(&fakeFolder.syncEngine(), SIGNAL(finished(bool)));
+
+        TestingSyncWatcher watcher(&fakeFolder.syncEngine(), QString(), 100ms, 0);
+        watcher.setSyncDelays(50ms, 500ms);
+        QSignalSpy stoppedSpy(&watcher, SIGNAL(stopped()));
+        bool stopRequested = false;
+        connect(&fakeFolder.syncEngine(), &SyncEngine::itemCompleted, this, [&]() {
+            if (!stopRequested) {
+                stopRequested = true;
+                QMetaObject::invokeMethod(&watcher, "stop", Qt::QueuedConnection);
+            }
+        });
+        watcher.start();
+
+        // stopped() comes once the aborted sync is done
+        QVERIFY(stoppedSpy.wait());
+        QCOMPARE(finishedSpy.count(), 1);
+
+        // Neither changes nor polls start another one
+        fakeFolder.localModifier().insert("A/local");
+        watcher.reportChange(fakeFolder, "A/local");
+        QTest::qWait(500);
+        QCOMPARE(finishedSpy.count(), 1);
+        QCOMPARE(stoppedSpy.count(), 1);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSyncWatcher)
+#include "testsyncwatcher.moc"
@@ -18,6 +18,7 @@ private:
   bool _success;
   QStringList _subdirs;
   QStringList _items;
+  QVector<LsColEntry> _entries;
 
 public slots:
   void slotDirectoryListingSubFolders(const QStringList& list)
@@ -32,6 +33,11 @@ public slots:
     _items.append(item);
   }
 
+  void slotDirectoryListingEntry(const LsColEntry &entry)
+  {
+      _entries.append(entry);
+  }
+
   void slotFinishedSuccessfully()
   {
       _success = true;
@@ -43,6 +49,7 @@ private slots:
       _success = false;
       _subdirs.clear();
       _items.clear();
+      _entries.clear();
     }
 
     void cleanup() {
@@ -473,6 +480,175 @@ private slots:
         QVERIFY(_subdirs.size() == 1);
     }
 
+    void testParserIncremental() {
+        const QByteArray testXml = "<?xml version='1.0' encoding='utf-8'?>"
+              "<d:multistatus xmlns:d=\"DAV:\" xmlns:s=\"http://sabredav.org/ns\" xmlns:oc=\"http://owncloud.org/ns\">"
+              "<d:response>"
+              "<d:href>/oc/remote.php/webdav/sharefolder/</d:href>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:id>00004213ocobzus5kn6s</oc:id>"
+              "<oc:permissions>RDNVCK</oc:permissions>"
+              "<oc:size>121780</oc:size>"
+              "<d:getetag>\"5527beb0400b0\"</d:getetag>"
+              "<d:resourcetype>"
+              "<d:collection/>"
+              "</d:resourcetype>"
+              "<d:getlastmodified>Fri, 06 Feb 2015 13:49:55 GMT</d:getlastmodified>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 200 OK</d:status>"
+              "</d:propstat>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<d:getcontentlength/>"
+              "<oc:downloadURL/>"
+              "<oc:dDC/>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 404 Not Found</d:status>"
+              "</d:propstat>"
+              "</d:response>"
+              "<d:response>"
+              "<d:href>/oc/remote.php/webdav/sharefolder/quitte.pdf</d:href>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:id>00004215ocobzus5kn6s</oc:id>"
+              "<oc:permissions>RDNVW</oc:permissions>"
+              "<d:getetag>\"2fa2f0d9ed49ea0c3e409d49e652dea0\"</d:getetag>"
+              "<d:resourcetype/>"
+              "<d:getlastmodified>Fri, 06 Feb 2015 13:49:55 GMT</d:getlastmodified>"
+              "<d:getcontentlength>121780</d:getcontentlength>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 200 OK</d:status>"
+              "</d:propstat>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:downloadURL/>"
+              "<oc:dDC/>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 404 Not Found</d:status>"
+              "</d:propstat>"
+              "</d:response>"
+              "</d:multistatus>";
+
+        LsColXMLParser parser;
+
+        connect( &parser, &LsColXMLParser::directoryListingSubfolders,
+                 this, &TestXmlParse::slotDirectoryListingSubFolders );
+        connect( &parser, &LsColXMLParser::directoryListingEntry,
+                 this, &TestXmlParse::slotDirectoryListingEntry );
+        connect( &parser, &LsColXMLParser::finishedWithoutError,
+                 this, &TestXmlParse::slotFinishedSuccessfully );
+
+        // Feed the reply in small pieces, like readyRead() would
+        QHash <QString, qint64> sizes;
+        parser.start( &sizes, "/oc/remote.php/webdav/sharefolder" );
+        const int secondResponse = testXml.lastIndexOf("<d:response>");
+        for (int pos = 0; pos < secondResponse; pos += 7)
+            QVERIFY(parser.addData( testXml.mid(pos, qMin(7, secondResponse - pos)) ));
+        QCOMPARE(_entries.size(), 1); // emitted before the reply is complete
+        for (int pos = secondResponse; pos < testXml.size(); pos += 7)
+            QVERIFY(parser.addData( testXml.mid(pos, 7) ));
+        QVERIFY(!_success);
+        QVERIFY(parser.finish());
+
+        QVERIFY(_success);
+        QCOMPARE(sizes.size(), 1);
+        QCOMPARE(_subdirs, QStringList("/oc/remote.php/webdav/sharefolder/"));
+        QCOMPARE(_entries.size(), 2);
+
+        const auto &dir = _entries[0];
+        QCOMPARE(dir.href, QString("/oc/remote.php/webdav/sharefolder"));
+        QVERIFY(dir.isCollection);
+        QCOMPARE(dir.size, qint64(121780));
+        QCOMPARE(dir.contentLength, qint64(-1)); // only in the 404 propstat
+        QCOMPARE(dir.fileId, QByteArray("00004213ocobzus5kn6s"));
+        QCOMPARE(dir.remotePerm.toString(), QByteArray("RDNVCK"));
+
+        const auto &file = _entries[1];
+        QCOMPARE(file.href, QString("/oc/remote.php/webdav/sharefolder/quitte.pdf"));
+        QVERIFY(file.hasResourceType);
+        QVERIFY(!file.isCollection);
+        QCOMPARE(file.contentLength, qint64(121780));
+        QCOMPARE(file.etag, QByteArray("\"2fa2f0d9ed49ea0c3e409d49e652dea0\""));
+        QCOMPARE(file.modtime, time_t(1423230595));
+        QVERIFY(file.directDownloadUrl.isEmpty());
+    }
+
+    void testParserTruncatedIncremental() {
+        const QByteArray testXml = "<?xml version='1.0' encoding='utf-8'?>"
+              "<d:multistatus xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\">"
+              "<d:response>"
+              "<d:href>/oc/remote.php/webdav/sharefolder/</d:href>"
+              "<d:propstat>"
+              "<d:prop>";
+
+        LsColXMLParser parser;
+        connect( &parser, &LsColXMLParser::finishedWithoutError,
+                 this, &TestXmlParse::slotFinishedSuccessfully );
+
+        parser.start( nullptr, "/oc/remote.php/webdav/sharefolder" );
+        QVERIFY(parser.addData( testXml ));
+        QVERIFY(!parser.finish());
+        QVERIFY(!_success);
+    }
+
+    void benchParseLargeListing_data() {
+        QTest::addColumn<bool>("propertyMap");
+        QTest::newRow("typed") << false;
+        QTest::newRow("typed and map") << true;
+    }
+
+    void benchParseLargeListing() {
+        QFETCH(bool, propertyMap);
+
+        // Synthetic reply for a folder with 100k files
+        const int entryCount = 100000;
+        QByteArray testXml = "<?xml version='1.0' encoding='utf-8'?>"
+              "<d:multistatus xmlns:d=\"DAV:\" xmlns:s=\"http://sabredav.org/ns\" xmlns:oc=\"http://owncloud.org/ns\">";
+        for (int i = 0; i < entryCount; ++i) {
+            testXml += "<d:response>"
+              "<d:href>/oc/remote.php/webdav/big/file" + QByteArray::number(i) + ".dat</d:href>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:id>" + QByteArray::number(i) + "ocobzus5kn6s</oc:id>"
+              "<oc:permissions>RDNVW</oc:permissions>"
+              "<d:getetag>\"2fa2f0d9ed49ea0c3e409d49e652dea0\"</d:getetag>"
+              "<d:resourcetype/>"
+              "<d:getlastmodified>Fri, 06 Feb 2015 13:49:55 GMT</d:getlastmodified>"
+              "<d:getcontentlength>121780</d:getcontentlength>"
+              "<oc:checksums><oc:checksum>SHA1:3b47b9bc2e0cc5d46e9e42b1ab8cdc7de8c0ae4e</oc:checksum></oc:checksums>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 200 OK</d:status>"
+              "</d:propstat>"
+              "<d:propstat>"
+              "<d:prop>"
+              "<oc:downloadURL/>"
+              "<oc:dDC/>"
+              "</d:prop>"
+              "<d:status>HTTP/1.1 404 Not Found</d:status>"
+              "</d:propstat>"
+              "</d:response>";
+        }
+        testXml += "</d:multistatus>";
+
+        int entries = 0;
+        QBENCHMARK {
+            LsColXMLParser parser;
+            entries = 0;
+            connect(&parser, &LsColXMLParser::directoryListingEntry, this, [&entries] { ++entries; });
+            if (propertyMap)
+                connect(&parser, &LsColXMLParser::directoryListingIterated, this, [] {});
+
+            // Chunks of the size QNAM typically hands out
+            QHash<QString, qint64> sizes;
+            parser.start(&sizes, "/oc/remote.php/webdav/big");
+            for (int pos = 0; pos < testXml.size(); pos += 16384)
+                parser.addData(testXml.mid(pos, 16384));
+            QVERIFY(parser.finish());
+        }
+        QCOMPARE(entries, entryCount);
+    }
+
 };
 
     QTEST_GUILESS_MAIN(TestXmlParse)